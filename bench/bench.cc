@@ -0,0 +1,286 @@
+/*
+  Benchmark runner for sisdel.
+
+  Usage: sisdel-bench [-j] [-s seed] [-n size] [-g file] [-l] [name...]
+
+  Without names all benchmarks are run, otherwise only benchmarks whose
+  name contains one of the names.
+
+  -j       Print results as one JSON object per line.
+  -s seed  Seed of generated sources, default 4711.
+  -n size  Size of generated sources in bytes, with optional k, M or G
+           suffix, default 1M. Benchmarks that need a larger input for
+           stable results may use a multiple of it.
+  -g file  Write a generated source to file, and exit.
+  -l       List benchmarks, and exit.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <errno.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "bench.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Benchmark registry
+//
+///////////////////////////////////////////////////////////////////////////////
+
+struct bench_entry_t {
+	const char *name;
+	bench_fn_t fn;
+};
+
+static std::vector<bench_entry_t>& registry(void)
+{
+	static std::vector<bench_entry_t> entries;
+	return entries;
+}
+
+bench_registrar_t::bench_registrar_t(const char *name, bench_fn_t fn)
+{
+	registry().push_back({name, fn});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Reporting
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static bench_options_t options;
+static const char *current_bench = "";
+
+const bench_options_t& bench_options(void)
+{
+	return options;
+}
+
+void bench_note(const char *format, ...)
+{
+	FILE * const out = options.json ? stderr : stdout;
+	va_list args;
+	va_start(args, format);
+	vfprintf(out, format, args);
+	va_end(args);
+	fflush(out);
+}
+
+// Print a JSON string
+static void print_json(const char *str)
+{
+	putchar('"');
+	for (; *str != '\0'; str++) {
+		const unsigned char ch = static_cast<unsigned char>(*str);
+		if ((ch == '"') || (ch == '\\'))
+			printf("\\%c", ch);
+		else if (ch < 0x20)
+			printf("\\u%04x", ch);
+		else
+			putchar(ch);
+	}
+	putchar('"');
+}
+
+void bench_report(const char *variant, double seconds, size_t bytes,
+		  size_t items)
+{
+	if (options.json) {
+		printf("{\"bench\":");
+		print_json(current_bench);
+		printf(",\"variant\":");
+		print_json(variant);
+		printf(",\"seconds\":%.9g,\"bytes\":%zu,\"items\":%zu",
+		       seconds, bytes, items);
+		if (bytes > 0)
+			printf(",\"bytes_per_second\":%.6g",
+			       static_cast<double>(bytes) / seconds);
+		if (items > 0)
+			printf(",\"items_per_second\":%.6g",
+			       static_cast<double>(items) / seconds);
+		printf(",\"seed\":%u,\"corpus_size\":%zu}\n",
+		       options.corpus.seed, options.corpus.size);
+		fflush(stdout);
+		return;
+	}
+
+	printf("%-20s %-32s %12.3f us", current_bench, variant, seconds * 1e6);
+	if (bytes > 0)
+		printf(" %10.1f MB/s", static_cast<double>(bytes) / seconds / 1e6);
+	if (items > 0)
+		printf(" %10.2f M/s", static_cast<double>(items) / seconds / 1e6);
+	printf("\n");
+	fflush(stdout);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: bench_file_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+bench_file_t::bench_file_t(const std::string& contents)
+{
+	const char *dir = getenv("TMPDIR");
+	std::string name = std::string((dir != NULL) ? dir : "/tmp") +
+		"/sisdel-bench-XXXXXX";
+
+	const int fd = mkstemp(name.data());
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(), name);
+
+	const char *p = contents.data();
+	size_t left = contents.size();
+	while (left > 0) {
+		const ssize_t written = write(fd, p, left);
+		if (written < 0) {
+			const int err = errno;
+			close(fd);
+			unlink(name.c_str());
+			throw std::system_error(err, std::generic_category(), name);
+		}
+		p += written;
+		left -= static_cast<size_t>(written);
+	}
+	close(fd);
+
+	m_name = name;
+}
+
+bench_file_t::~bench_file_t()
+{
+	unlink(m_name.c_str());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Main
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static bool selected(const char *name, int nr_names, char * const names[])
+{
+	if (nr_names == 0)
+		return true;
+
+	for (int idx = 0; idx < nr_names; idx++)
+		if (strstr(name, names[idx]) != NULL)
+			return true;
+
+	return false;
+}
+
+// Parse a size with optional k, M or G suffix
+static bool parse_size(const char *str, size_t& size)
+{
+	char *end;
+	errno = 0;
+	const unsigned long long value = strtoull(str, &end, 10);
+	if ((errno != 0) || (end == str))
+		return false;
+
+	unsigned shift = 0;
+	switch (*end) {
+	case 'k':
+		shift = 10;
+		end++;
+		break;
+	case 'M':
+		shift = 20;
+		end++;
+		break;
+	case 'G':
+		shift = 30;
+		end++;
+		break;
+	}
+	if ((*end != '\0') || (value > (SIZE_MAX >> shift)))
+		return false;
+
+	size = static_cast<size_t>(value) << shift;
+	return true;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-j] [-s seed] [-n size] [-g file] [-l] "
+		"[name...]\n", name);
+}
+
+int main(int argc, char * const argv[])
+{
+	const char *generate = NULL;
+	bool list = false;
+
+	for (int opt; (opt = getopt(argc, argv, "js:n:g:lh")) != -1; ) {
+		switch (opt) {
+		case 'j':
+			options.json = true;
+			break;
+		case 's':
+			options.corpus.seed = static_cast<unsigned>(
+				strtoul(optarg, NULL, 0));
+			break;
+		case 'n':
+			if (!parse_size(optarg, options.corpus.size)) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'g':
+			generate = optarg;
+			break;
+		case 'l':
+			list = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	try {
+		if (generate != NULL) {
+			const std::string contents = make_corpus(options.corpus);
+			std::ofstream out(generate, std::ios::binary);
+			out.write(contents.data(),
+				  static_cast<std::streamsize>(contents.size()));
+			out.close();
+			if (!out)
+				throw std::system_error(errno, std::generic_category(),
+							generate);
+			return 0;
+		}
+
+		for (const auto& entry : registry()) {
+			if (!selected(entry.name, argc - optind, argv + optind))
+				continue;
+			if (list) {
+				printf("%s\n", entry.name);
+				continue;
+			}
+			current_bench = entry.name;
+			entry.fn();
+		}
+	}
+
+	catch (const std::exception& e) {
+		fprintf(stderr, "%s: %s\n", current_bench, e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,151 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef BENCH_HH
+#define BENCH_HH
+
+/**
+ * @file
+ * Minimal benchmark framework.
+ * Benchmarks are functions registered using the BENCH() macro. Each
+ * benchmark calls bench_measure() for each variant it wants to time, and
+ * the result is printed as one line per variant, either as text or as a
+ * JSON object per line for tracking results over time.
+ */
+
+#include <stddef.h>
+#include <chrono>
+#include <string>
+#include "corpus.hh"
+
+/**
+ * Signature of a benchmark function.
+ */
+typedef void (*bench_fn_t)(void);
+
+/**
+ * Registers a benchmark function during static initialization.
+ */
+class bench_registrar_t {
+public:
+	bench_registrar_t(
+		const char *name, /**< [in] Name of benchmark. */
+		bench_fn_t fn     /**< [in] Benchmark function. */
+		);
+};
+
+/**
+ * Define and register a benchmark function.
+ */
+#define BENCH(name)							\
+	static void bench_##name(void);					\
+	static const bench_registrar_t bench_registrar_##name(#name,	\
+							      bench_##name); \
+	static void bench_##name(void)
+
+/**
+ * Options given on the command line.
+ */
+struct bench_options_t {
+	corpus_options_t corpus; /**< Options of generated sources. */
+	bool json = false;       /**< Print results as JSON lines. */
+};
+
+/**
+ * Return options given on the command line.
+ */
+const bench_options_t& bench_options(void);
+
+/**
+ * Print information that is not a measured result, e.g. the size of the
+ * input of the following results. Printed with results as text, and to
+ * standard error with JSON results, so that standard output only has
+ * JSON objects.
+ */
+void bench_note(
+	const char *format, /**< [in] printf() format. */
+	...
+	) __attribute__((format(printf, 1, 2)));
+
+/**
+ * Prevent the compiler from optimizing away a computed value.
+ */
+template <typename T>
+inline void bench_keep(const T& value)
+{
+	asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * Print the result of one measured variant.
+ */
+void bench_report(
+	const char *variant, /**< [in] Name of variant. */
+	double seconds,      /**< [in] Best time for one iteration. */
+	size_t bytes,        /**< [in] Bytes processed per iteration, or 0. */
+	size_t items         /**< [in] Items processed per iteration, or 0. */
+	);
+
+/**
+ * Time a variant of a benchmark.
+ * The function is run repeatedly for a fixed time budget, and the best
+ * iteration time is reported. Taking the best time rather than the
+ * average filters out noise from other processes.
+ */
+template <typename F>
+void bench_measure(
+	const char *variant, /**< [in] Name of variant. */
+	size_t bytes,        /**< [in] Bytes processed per call to f. */
+	size_t items,        /**< [in] Items processed per call to f. */
+	F f                  /**< [in] Function to time. */
+	)
+{
+	typedef std::chrono::steady_clock clock_t_;
+	const auto budget = std::chrono::milliseconds(300);
+	const auto stop = clock_t_::now() + budget;
+	double best = 0;
+	size_t nr_runs = 0;
+
+	do {
+		const auto start = clock_t_::now();
+		f();
+		const std::chrono::duration<double> elapsed =
+			clock_t_::now() - start;
+		if ((nr_runs == 0) || (elapsed.count() < best))
+			best = elapsed.count();
+		nr_runs++;
+	} while ((clock_t_::now() < stop) || (nr_runs < 3));
+
+	bench_report(variant, best, bytes, items);
+}
+
+/**
+ * Temporary file, removed when the object is destructed.
+ */
+class bench_file_t {
+public:
+	/**
+	 * Write contents to a new temporary file.
+	 */
+	explicit bench_file_t(
+		const std::string& contents /**< [in] File contents. */
+		);
+
+	~bench_file_t();
+
+	bench_file_t(const bench_file_t&) = delete;
+	bench_file_t& operator=(const bench_file_t&) = delete;
+
+	/**
+	 * Return name of the file.
+	 */
+	const char *name(void) const noexcept
+		{ return m_name.c_str(); }
+
+private:
+	std::string m_name;
+};
+
+#endif // BENCH_HH
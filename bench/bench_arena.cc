@@ -0,0 +1,118 @@
+/*
+  Benchmark of building a parse tree of the tokens of a generated source,
+  with nodes owned by shared pointers and with nodes in an arena.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <array>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "arena.hh"
+#include "bench.hh"
+#include "token.hh"
+
+namespace {
+
+// Nodes modelled like parser_elements.hh before and after the arena
+
+struct shared_node_t {
+	virtual ~shared_node_t() {}
+	uint64_t value = 0;
+};
+
+struct shared_block_t : public shared_node_t {
+	std::vector<std::shared_ptr<shared_node_t>> entries;
+};
+
+struct arena_node_t {
+	uint64_t value = 0;
+};
+
+struct arena_block_t : public arena_node_t {
+	explicit arena_block_t(arena_t& arena)
+		: entries(&arena) {}
+	std::pmr::vector<arena_node_t*> entries;
+};
+
+}
+
+// One block per line, with a leaf per token
+static size_t build_shared(const std::vector<compact_token_t>& tokens)
+{
+	auto root = std::make_shared<shared_block_t>();
+	auto line = std::make_shared<shared_block_t>();
+
+	for (const compact_token_t& token : tokens) {
+		if (token.kind == token_kind_t::eol) {
+			root->entries.push_back(line);
+			line = std::make_shared<shared_block_t>();
+			continue;
+		}
+		auto leaf = std::make_shared<shared_node_t>();
+		leaf->value = token.value;
+		line->entries.push_back(leaf);
+	}
+	root->entries.push_back(line);
+
+	return root->entries.size();
+}
+
+static size_t build_arena(const std::vector<compact_token_t>& tokens,
+			  arena_t& arena)
+{
+	arena_block_t *root = arena.create<arena_block_t>(arena);
+	arena_block_t *line = arena.create<arena_block_t>(arena);
+
+	for (const compact_token_t& token : tokens) {
+		if (token.kind == token_kind_t::eol) {
+			root->entries.push_back(line);
+			line = arena.create<arena_block_t>(arena);
+			continue;
+		}
+		arena_node_t *leaf = arena.create<arena_node_t>();
+		leaf->value = token.value;
+		line->entries.push_back(leaf);
+	}
+	root->entries.push_back(line);
+
+	return root->entries.size();
+}
+
+BENCH(arena)
+{
+	const std::string contents = make_corpus(bench_options().corpus);
+	const bench_file_t file(contents);
+	std::vector<compact_token_t> tokens;
+
+	{
+		environment_t env;
+		tokenizer_t lexer(env, file.name());
+		std::array<compact_token_t, 256> batch;
+		for (size_t nr = lexer.next_batch(batch); nr > 0;
+		     nr = lexer.next_batch(batch))
+			tokens.insert(tokens.end(), batch.begin(), batch.begin() + nr);
+	}
+
+	size_t nr_chunks;
+	{
+		arena_t arena;
+		build_arena(tokens, arena);
+		nr_chunks = arena.nr_chunks();
+	}
+
+	bench_note("%zu tokens, %zu arena chunks:\n", tokens.size(), nr_chunks);
+
+	bench_measure("shared_ptr", 0, tokens.size(), [&]() {
+		bench_keep(build_shared(tokens));
+	});
+
+	bench_measure("arena", 0, tokens.size(), [&]() {
+		arena_t arena;
+		bench_keep(build_arena(tokens, arena));
+	});
+}
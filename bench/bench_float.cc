@@ -0,0 +1,103 @@
+/*
+  Benchmarks for floating point literal scanning and conversion.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <stdlib.h>
+#include <array>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hh"
+#include "token.hh"
+
+// Source with lines of decimal floating point literals of varying length
+static std::string float_source(size_t nr_literals,
+				std::vector<std::string>& literals)
+{
+	std::default_random_engine r(4711);
+	std::uniform_int_distribution<int> len_dist(1, 9);
+	std::uniform_int_distribution<int> digit_dist(0, 9);
+	std::string source;
+
+	for (size_t idx = 0; idx < nr_literals; idx++) {
+		std::string literal(1, static_cast<char>('1' + digit_dist(r) % 9));
+		for (int len = len_dist(r); len > 0; len--)
+			literal += static_cast<char>('0' + digit_dist(r));
+		literal += '.';
+		for (int len = len_dist(r); len > 0; len--)
+			literal += static_cast<char>('0' + digit_dist(r));
+		literals.push_back(literal);
+
+		source += literal;
+		source += ((idx % 8) == 7) ? '\n' : ' ';
+	}
+
+	return source;
+}
+
+// Lex the whole file, calling on_float for each floating point literal
+template <typename F>
+static void lex(const char *filename, F on_float)
+{
+	environment_t env;
+	tokenizer_t lexer(env, filename);
+	std::array<compact_token_t, 256> tokens;
+
+	for (size_t nr = lexer.next_batch(tokens); nr > 0;
+	     nr = lexer.next_batch(tokens))
+		for (size_t idx = 0; idx < nr; idx++)
+			if (tokens[idx].kind == token_kind_t::floating)
+				on_float(lexer.floating(tokens[idx]));
+}
+
+BENCH(float_literals)
+{
+	const size_t nr_literals = 200000;
+	std::vector<std::string> literals;
+	const std::string source = float_source(nr_literals, literals);
+	const bench_file_t file(source);
+
+	bench_measure("lex, deferred", source.size(), nr_literals, [&]() {
+		lex(file.name(), [](const float_literal_t& f) {
+			bench_keep(f);
+		});
+	});
+
+	bench_measure("lex, to_double()", source.size(), nr_literals, [&]() {
+		lex(file.name(), [](const float_literal_t& f) {
+			bench_keep(f.to_double());
+		});
+	});
+
+	// What every float literal cost before conversion was deferred
+	bench_measure("lex, to_mp_float()", source.size(), nr_literals, [&]() {
+		lex(file.name(), [](const float_literal_t& f) {
+			bench_keep(f.to_mp_float());
+		});
+	});
+
+	// Conversion only, compared with the C library
+	environment_t env;
+	tokenizer_t lexer(env, file.name());
+	std::vector<float_literal_t> floats;
+	std::array<compact_token_t, 256> tokens;
+	for (size_t nr = lexer.next_batch(tokens); nr > 0;
+	     nr = lexer.next_batch(tokens))
+		for (size_t idx = 0; idx < nr; idx++)
+			if (tokens[idx].kind == token_kind_t::floating)
+				floats.push_back(lexer.floating(tokens[idx]));
+
+	bench_measure("to_double()", 0, nr_literals, [&]() {
+		for (const auto& f : floats)
+			bench_keep(f.to_double());
+	});
+
+	bench_measure("strtod()", 0, nr_literals, [&]() {
+		for (const auto& literal : literals)
+			bench_keep(strtod(literal.c_str(), NULL));
+	});
+}
@@ -0,0 +1,180 @@
+/*
+  Benchmarks comparing the word-at-a-time string hash with Bob Jenkin's
+  one-at-a-time hash, for collision rate and throughput.
+
+  The identifier corpus is read from the Sisdel documentation, from the
+  directory given by the SISDEL_CORPUS environment variable, or doc/ in
+  the source tree by default. A larger generated corpus is used as well.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "bench.hh"
+#include "hash.hh"
+
+#ifndef SISDEL_SOURCE_DIR
+#define SISDEL_SOURCE_DIR "."
+#endif
+
+static hash_t one_at_a_time(const char *str, size_t len)
+{
+	hash_t hash = 0;
+	for (size_t idx = 0; idx < len; idx++)
+		hash = hash_next(str[idx], hash);
+	return hash_finish(hash);
+}
+
+static hash_t word_at_a_time(const char *str, size_t len)
+{
+	return hash_bytes(str, len);
+}
+
+// Unique identifier-like words from all documentation files
+static std::vector<std::string> doc_identifiers(void)
+{
+	const char *dir = getenv("SISDEL_CORPUS");
+	const std::filesystem::path path(
+		(dir != NULL) ? dir : SISDEL_SOURCE_DIR "/doc");
+	std::unordered_set<std::string> words;
+
+	for (const auto& entry :
+		     std::filesystem::recursive_directory_iterator(path)) {
+		const std::string ext = entry.path().extension().string();
+		if ((ext != ".md") && (ext != ".ebnf") && (ext != ".rst"))
+			continue;
+
+		std::ifstream in(entry.path());
+		const std::string text((std::istreambuf_iterator<char>(in)),
+				       std::istreambuf_iterator<char>());
+		std::string word;
+		for (char ch : text) {
+			if (isalnum(static_cast<unsigned char>(ch)) ||
+			    (ch == '_') || (ch == '-')) {
+				word += ch;
+			} else if (!word.empty()) {
+				words.insert(word);
+				word.clear();
+			}
+		}
+	}
+
+	return std::vector<std::string>(words.begin(), words.end());
+}
+
+// Identifiers as found in a large module tree: common prefixes and
+// suffixes around shorter words
+static std::vector<std::string> generated_identifiers(size_t nr)
+{
+	static const char * const parts[] = {
+		"get", "set", "is", "nr", "value", "list", "node", "type",
+		"name", "index", "count", "buffer", "parse", "token", "file",
+		"size", "first", "last", "next", "prev", "module", "unit"
+	};
+	const size_t nr_parts = sizeof(parts) / sizeof(parts[0]);
+	std::default_random_engine r(4711);
+	std::uniform_int_distribution<size_t> part_dist(0, nr_parts - 1);
+	std::uniform_int_distribution<int> len_dist(1, 4);
+	std::unordered_set<std::string> words;
+
+	while (words.size() < nr) {
+		std::string word = parts[part_dist(r)];
+		for (int len = len_dist(r); len > 1; len--)
+			word += std::string("_") + parts[part_dist(r)];
+		if (len_dist(r) == 1)
+			word += std::to_string(words.size() % 100);
+		words.insert(word);
+	}
+
+	return std::vector<std::string>(words.begin(), words.end());
+}
+
+// Print number of full 32-bit collisions, and collisions in a hash table
+// of twice the number of strings, using low and high hash bits
+template <typename F>
+static void collisions(const char *name, const std::vector<std::string>& words,
+		       F hash_fn)
+{
+	size_t nr_slots = 1;
+	unsigned slot_bits = 0;
+	while (nr_slots < 2 * words.size()) {
+		nr_slots *= 2;
+		slot_bits++;
+	}
+
+	std::unordered_set<hash_t> hashes;
+	std::vector<bool> low_used(nr_slots), high_used(nr_slots);
+	size_t low_collisions = 0, high_collisions = 0;
+
+	for (const auto& word : words) {
+		const hash_t hash = hash_fn(word.data(), word.size());
+		hashes.insert(hash);
+
+		const size_t low = hash & (nr_slots - 1);
+		const size_t high = (slot_bits == 0) ? 0 :
+			(static_cast<uint64_t>(hash) << slot_bits) >> 32;
+		low_collisions += low_used[low] ? 1 : 0;
+		high_collisions += high_used[high] ? 1 : 0;
+		low_used[low] = true;
+		high_used[high] = true;
+	}
+
+	// Expected slot collisions for a random hash
+	const double n = static_cast<double>(words.size());
+	const double m = static_cast<double>(nr_slots);
+	const double expected = n - m * (1.0 - std::pow(1.0 - 1.0 / m, n));
+
+	bench_note("%-20s %-32s %6zu full, %6zu low bits, %6zu high bits "
+		   "(random: %.0f)\n", "", name, words.size() - hashes.size(),
+		   low_collisions, high_collisions, expected);
+}
+
+template <typename F>
+static void throughput(const char *name, const std::vector<std::string>& words,
+		       F hash_fn)
+{
+	size_t bytes = 0;
+	for (const auto& word : words)
+		bytes += word.size();
+
+	bench_measure(name, bytes, words.size(), [&]() {
+		for (const auto& word : words)
+			bench_keep(hash_fn(word.data(), word.size()));
+	});
+}
+
+// Variants are named after the corpus as well, so that results from the
+// two corpora can be told apart in JSON output
+static void compare(const char *corpus, const std::vector<std::string>& words)
+{
+	const std::string one = std::string(corpus) + ", one-at-a-time";
+	const std::string word = std::string(corpus) + ", word-at-a-time";
+
+	collisions(one.c_str(), words, one_at_a_time);
+	collisions(word.c_str(), words, word_at_a_time);
+	throughput(one.c_str(), words, one_at_a_time);
+	throughput(word.c_str(), words, word_at_a_time);
+}
+
+BENCH(hash)
+{
+	const std::vector<std::string> docs = doc_identifiers();
+	bench_note("Documentation corpus, %zu identifiers:\n", docs.size());
+	compare("docs", docs);
+
+	const std::vector<std::string> generated = generated_identifiers(500000);
+	bench_note("Generated corpus, %zu identifiers:\n", generated.size());
+	compare("generated", generated);
+}
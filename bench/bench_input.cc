@@ -0,0 +1,138 @@
+/*
+  Benchmark of the skip functions of mmap_file_t, which the token scanner
+  is built on, and of the UTF-8 validation of its contents, over a
+  generated source.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <string>
+#include <vector>
+
+#include "bench.hh"
+#include "char_class.hh"
+#include "mmap_file.hh"
+#include "utf8.hh"
+
+BENCH(skip)
+{
+	const std::string contents = make_corpus(bench_options().corpus);
+	const bench_file_t file(contents);
+	environment_t env;
+
+	static constexpr char_class_t separators("\n\r\t ");
+	static constexpr char_class_t word_end("\"'#\n\r\t ");
+
+	size_t nr_lines = 0;
+	size_t nr_words = 0;
+	{
+		mmap_file_t input(env, file.name());
+		while (!input.eof()) {
+			input.skip_until('\n');
+			if (!input.eof())
+				input.skip();
+			nr_lines++;
+		}
+	}
+	{
+		mmap_file_t input(env, file.name());
+		while (!input.eof()) {
+			hash_t hash;
+			input.skip(separators);
+			if (input.eof())
+				break;
+			if (input.skip_until_hashed(word_end, hash) == 0)
+				input.skip();
+			nr_words++;
+		}
+	}
+
+	bench_note("%zu bytes, %zu lines, %zu words:\n", contents.size(),
+		   nr_lines, nr_words);
+
+	bench_measure("skip_until line", contents.size(), nr_lines, [&]() {
+		mmap_file_t input(env, file.name());
+		while (!input.eof()) {
+			input.skip_until('\n');
+			if (!input.eof())
+				input.skip();
+		}
+	});
+
+	bench_measure("skip blanks", contents.size(), nr_lines, [&]() {
+		mmap_file_t input(env, file.name());
+		while (!input.eof()) {
+			bench_keep(input.skip(separators));
+			if (!input.eof())
+				input.skip_until('\n');
+		}
+	});
+
+	bench_measure("skip_until_hashed words", contents.size(), nr_words, [&]() {
+		mmap_file_t input(env, file.name());
+		while (!input.eof()) {
+			hash_t hash;
+			input.skip(separators);
+			if (input.eof())
+				break;
+			if (input.skip_until_hashed(word_end, hash) == 0)
+				input.skip();
+			bench_keep(hash);
+		}
+	});
+}
+
+BENCH(utf8)
+{
+	const std::string ascii = make_corpus(bench_options().corpus);
+
+	// Same source with every 'a' replaced by a two byte character, and
+	// every 'e' by a three byte character
+	std::string mixed;
+	for (const char ch : ascii)
+		if (ch == 'a')
+			mixed += "\xc3\xa4";
+		else if (ch == 'e')
+			mixed += "\xe2\x82\xac";
+		else
+			mixed += ch;
+
+	bench_note("%zu bytes ASCII, %zu bytes mixed:\n", ascii.size(),
+		   mixed.size());
+
+	static const struct {
+		simd_level_t level;
+		const char *ascii_name;
+		const char *mixed_name;
+	} levels[] = {
+		{ simd_level_t::scalar, "validate scalar ascii", "validate scalar mixed" },
+		{ simd_level_t::sse2, "validate sse2 ascii", "validate sse2 mixed" },
+		{ simd_level_t::avx2, "validate avx2 ascii", "validate avx2 mixed" },
+	};
+	const simd_level_t original = char_class_t::simd_level();
+
+	for (const auto& level : levels) {
+		if (char_class_t::set_simd_level(level.level) != level.level)
+			continue;
+
+		const std::string * const texts[] = { &ascii, &mixed };
+		for (const std::string *text : texts) {
+			bench_measure((text == &ascii) ? level.ascii_name : level.mixed_name,
+				      text->size(), 0, [&]() {
+				utf8_validator_t validator;
+				std::vector<size_t> invalid;
+				validator.validate(text->data(), text->data() + text->size(),
+						   0, invalid);
+				validator.finish(invalid);
+				bench_keep(invalid);
+			});
+		}
+	}
+
+	char_class_t::set_simd_level(original);
+
+	bench_measure("utf8_length mixed", mixed.size(), 0, [&]() {
+		bench_keep(utf8_length(mixed.data(), mixed.data() + mixed.size()));
+	});
+}
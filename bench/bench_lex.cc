@@ -0,0 +1,159 @@
+/*
+  Benchmark of scanning a generated source, of scanning one large file
+  sequentially and split into chunks scanned in parallel, and of
+  scanning it again after edits.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <stdio.h>
+#include <array>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.hh"
+#include "incremental.hh"
+#include "token.hh"
+#include "work_pool.hh"
+
+// Generated module, with indentation, comments and literals of all kinds
+static std::string make_module(size_t size)
+{
+	std::string contents;
+	contents.reserve(size + 128);
+
+	for (size_t line = 0; contents.size() < size; line++) {
+		contents += std::string(line % 3, '\t');
+		contents += "name" + std::to_string(line % 5000) + " is \"text "
+			+ std::to_string(line % 100) + "\" " + std::to_string(line)
+			+ " 3.14159\n";
+		if (line % 10 == 0)
+			contents += "# comment\n\n";
+	}
+
+	return contents;
+}
+
+BENCH(lex)
+{
+	const std::string contents = make_corpus(bench_options().corpus);
+	const bench_file_t file(contents);
+	size_t nr_tokens = 0;
+
+	{
+		environment_t env;
+		tokenizer_t lexer(env, file.name());
+		while (std::unique_ptr<const token_t>(lexer.next()))
+			nr_tokens++;
+	}
+
+	bench_note("%zu bytes, %zu tokens:\n", contents.size(), nr_tokens);
+
+	bench_measure("next", contents.size(), nr_tokens, [&]() {
+		environment_t env;
+		tokenizer_t lexer(env, file.name());
+		while (std::unique_ptr<const token_t> token{lexer.next()})
+			bench_keep(token);
+	});
+
+	bench_measure("next_batch", contents.size(), nr_tokens, [&]() {
+		environment_t env;
+		tokenizer_t lexer(env, file.name());
+		std::array<compact_token_t, 256> tokens;
+		size_t nr_scanned = 0;
+		for (size_t nr = lexer.next_batch(tokens); nr > 0;
+		     nr = lexer.next_batch(tokens))
+			nr_scanned += nr;
+		bench_keep(nr_scanned);
+	});
+}
+
+BENCH(lex_parallel)
+{
+	const std::string contents = make_module(32 * 1024 * 1024);
+	const bench_file_t file(contents);
+	size_t nr_tokens = 0;
+
+	{
+		environment_t env;
+		tokenizer_t lexer(env, file.name());
+		std::array<compact_token_t, 256> tokens;
+		for (size_t nr = lexer.next_batch(tokens); nr > 0;
+		     nr = lexer.next_batch(tokens))
+			nr_tokens += nr;
+	}
+
+	bench_note("%zu bytes, %zu tokens:\n", contents.size(), nr_tokens);
+
+	bench_measure("sequential", contents.size(), nr_tokens, [&]() {
+		environment_t env;
+		tokenizer_t lexer(env, file.name());
+		std::array<compact_token_t, 256> tokens;
+		size_t nr_scanned = 0;
+		for (size_t nr = lexer.next_batch(tokens); nr > 0;
+		     nr = lexer.next_batch(tokens))
+			nr_scanned += nr;
+		bench_keep(nr_scanned);
+	});
+
+	const size_t max_threads = std::max(
+		std::thread::hardware_concurrency(), 1u);
+	for (size_t nr_threads = 1; nr_threads <= max_threads; nr_threads *= 2) {
+		work_pool_t pool(nr_threads);
+		const std::string variant = "parallel, " + std::to_string(nr_threads)
+			+ " threads";
+
+		bench_measure(variant.c_str(), contents.size(), nr_tokens, [&]() {
+			environment_t env;
+			tokenizer_t lexer(env, file.name());
+			std::vector<compact_token_t> tokens;
+			bench_keep(lexer.next_all(tokens, pool));
+		});
+	}
+}
+
+BENCH(lex_incremental)
+{
+	// About 100k lines
+	std::string text = make_module(3 * 1024 * 1024);
+	environment_t env;
+	incremental_tokenizer_t incremental(env, "edited");
+
+	bench_measure("initial", text.size(), 1, [&]() {
+		incremental_tokenizer_t initial(env, "edited");
+		bench_keep(initial.update(text, 0, 0, text.size()).nr_inserted);
+	});
+	incremental.update(text, 0, 0, text.size());
+
+	// Replace a character in identifiers at random places, and then
+	// restore it. Characters are replaced in place, so that the time
+	// does not include moving the rest of the text.
+	static constexpr size_t nr_edits = 1000;
+	std::default_random_engine r(4711);
+	std::vector<size_t> offsets;
+	while (offsets.size() < nr_edits) {
+		const size_t offset = text.find("name", r() % text.size());
+		if (offset != std::string::npos)
+			offsets.push_back(offset + 1);
+	}
+
+	size_t nr_scanned = 0;
+	bench_measure("single character edits", 0, 2 * nr_edits, [&]() {
+		nr_scanned = 0;
+		for (size_t offset : offsets) {
+			text[offset] = 'x';
+			incremental.update(text, offset, 1, 1);
+			nr_scanned += incremental.nr_scanned();
+			text[offset] = 'a';
+			incremental.update(text, offset, 1, 1);
+		}
+	});
+
+	bench_note("%-20s %-32s %zu tokens, %zu bytes scanned per edit\n", "",
+		   "single character edits", incremental.size(),
+		   nr_scanned / (2 * nr_edits));
+}
@@ -0,0 +1,114 @@
+/*
+  Benchmark of file loading strategies, for different distributions of
+  file sizes.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hh"
+#include "file_loader.hh"
+
+// Files with sizes uniformly distributed between min_size and max_size
+struct distribution_t {
+	const char *name;
+	size_t nr_files;
+	size_t min_size;
+	size_t max_size;
+};
+
+static std::vector<std::unique_ptr<bench_file_t>> make_files(
+	const distribution_t& dist)
+{
+	static const std::string line = "identifier \"string\" 12345 67.89\n";
+	std::default_random_engine r(4711);
+	std::uniform_int_distribution<size_t> size_dist(dist.min_size,
+							dist.max_size);
+	std::vector<std::unique_ptr<bench_file_t>> files;
+
+	for (size_t idx = 0; idx < dist.nr_files; idx++) {
+		const size_t size = size_dist(r);
+		std::string contents;
+		contents.reserve(size + line.size());
+		while (contents.size() < size)
+			contents += line;
+		contents.resize(size);
+		files.emplace_back(new bench_file_t(contents));
+	}
+
+	return files;
+}
+
+// Load all files and read every byte, the way the tokenizer would
+static size_t load_all(const std::vector<std::unique_ptr<bench_file_t>>& files,
+		       const load_options_t& options)
+{
+	size_t nr_lines = 0;
+
+	for (const auto& file : files) {
+		const file_loader_t loader(file->name(), options);
+		const char *p = loader.data();
+		const char * const end = p + loader.size();
+		while ((p = static_cast<const char*>(
+				memchr(p, '\n', static_cast<size_t>(end - p)))) != NULL) {
+			nr_lines++;
+			p++;
+		}
+	}
+
+	return nr_lines;
+}
+
+BENCH(file_load)
+{
+	static const distribution_t distributions[] = {
+		{"tiny modules", 2000, 200, 8 * 1024},
+		{"small modules", 500, 8 * 1024, 64 * 1024},
+		{"medium files", 32, 256 * 1024, 4 * 1024 * 1024},
+		{"large files", 2, 24 * 1024 * 1024, 32 * 1024 * 1024},
+	};
+
+	for (const auto& dist : distributions) {
+		const auto files = make_files(dist);
+		size_t total = 0;
+		for (const auto& file : files) {
+			const file_loader_t loader(file->name(), load_options_t());
+			total += loader.size();
+		}
+
+		bench_note("%s, %zu files, %zu bytes:\n", dist.name, files.size(), total);
+
+		for (size_t idx = 0; idx < nr_load_strategies; idx++) {
+			load_options_t options;
+			options.strategy = static_cast<load_strategy_t>(idx);
+			const load_counters_t before = file_loader_t::counters();
+
+			bench_measure(load_strategy_name(options.strategy), total,
+				      files.size(), [&]() {
+				bench_keep(load_all(files, options));
+			});
+
+			if (options.strategy != load_strategy_t::automatic)
+				continue;
+
+			// Report which strategies the automatic selection used
+			const load_counters_t after = file_loader_t::counters();
+			bench_note("%-20s %-32s", "", "automatic selected");
+			for (size_t used = 1; used < nr_load_strategies; used++) {
+				const size_t nr = after.nr_files[used] - before.nr_files[used];
+				if (nr > 0)
+					bench_note(" %s: %zu", load_strategy_name(
+							   static_cast<load_strategy_t>(used)), nr);
+			}
+			bench_note(", buffer reuses: %zu\n",
+				   after.nr_buffer_reuses - before.nr_buffer_reuses);
+		}
+	}
+}
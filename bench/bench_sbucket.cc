@@ -0,0 +1,257 @@
+/*
+  Benchmarks for the string bucket.
+
+  The chained_sbucket_t class is the string bucket implementation used
+  before sbucket became an open-addressing hash table, kept here as
+  reference.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <array>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.hh"
+#include "sbucket.hh"
+
+// Fixed number of chained buckets, each new entry appended to the chain
+class chained_sbucket_t {
+public:
+	chained_sbucket_t() { m_buckets.fill(-1); }
+
+	string_idx_t find_add_hashed(const char *str, size_t str_len,
+				     hash_t hash)
+	{
+		const size_t bucket_idx = hash % nr_buckets;
+		ssize_t idx;
+
+		for (idx = m_buckets[bucket_idx]; idx >= 0;
+		     idx = m_entry[idx].next_idx)
+			if ((m_entry[idx].str.compare(0, str_len, str, str_len) == 0)
+			    && (m_entry[idx].str.length() == str_len))
+				return idx;
+
+		const string_idx_t new_idx = m_entry.size();
+		m_entry.push_back({-1, std::string(str, str_len)});
+
+		if (m_buckets[bucket_idx] < 0) {
+			m_buckets[bucket_idx] = new_idx;
+		} else {
+			for (idx = m_buckets[bucket_idx];
+			     m_entry[idx].next_idx >= 0;
+			     idx = m_entry[idx].next_idx);
+			m_entry[idx].next_idx = new_idx;
+		}
+
+		return new_idx;
+	}
+
+	// Same definition as sbucket::stats_t, probe length of a string is
+	// its position in the chain
+	sbucket::stats_t stats(void) const
+	{
+		sbucket::stats_t stats = {m_entry.size(), nr_buckets, 0, 0,
+					  0, 0};
+
+		for (ssize_t head : m_buckets) {
+			size_t probe = 0;
+			for (ssize_t idx = head; idx >= 0;
+			     idx = m_entry[idx].next_idx) {
+				probe++;
+				stats.total_probes += probe;
+			}
+			stats.max_probe = std::max(stats.max_probe, probe);
+		}
+
+		return stats;
+	}
+
+private:
+	struct entry_t {
+		ssize_t next_idx;
+		std::string str;
+	};
+
+	static const size_t nr_buckets = 4096;
+	std::array<ssize_t, nr_buckets> m_buckets;
+	std::vector<entry_t> m_entry;
+};
+
+struct hashed_string_t {
+	std::string str;
+	hash_t hash;
+};
+
+// Identifier-like strings: a few common prefixes and a numeric suffix
+static std::vector<hashed_string_t> identifiers(size_t nr)
+{
+	static const char * const prefixes[] = {
+		"", "m_", "get_", "set_", "is_", "nr_", "tmp", "value_"
+	};
+	std::default_random_engine r(4711);
+	std::uniform_int_distribution<size_t> prefix_dist(0, 7);
+	std::vector<hashed_string_t> result;
+
+	for (size_t idx = 0; idx < nr; idx++) {
+		hashed_string_t s;
+		s.str = std::string(prefixes[prefix_dist(r)]) + "id" +
+			std::to_string(idx);
+		s.hash = hash_bytes(s.str.data(), s.str.size());
+		result.push_back(s);
+	}
+
+	return result;
+}
+
+template <typename T>
+static void run(const char *name, const std::vector<hashed_string_t>& strings,
+		const std::vector<size_t>& order)
+{
+	const std::string insert_name = std::string(name) + ", insert";
+	bench_measure(insert_name.c_str(), 0, strings.size(), [&]() {
+		T bucket;
+		for (const auto& s : strings)
+			bench_keep(bucket.find_add_hashed(s.str.data(),
+							  s.str.size(), s.hash));
+	});
+
+	T bucket;
+	for (const auto& s : strings)
+		bucket.find_add_hashed(s.str.data(), s.str.size(), s.hash);
+
+	const std::string lookup_name = std::string(name) + ", lookup";
+	bench_measure(lookup_name.c_str(), 0, order.size(), [&]() {
+		for (size_t idx : order) {
+			const auto& s = strings[idx];
+			bench_keep(bucket.find_add_hashed(s.str.data(),
+							  s.str.size(), s.hash));
+		}
+	});
+
+	const sbucket::stats_t stats = bucket.stats();
+	bench_note("%-20s %-32s %12.2f avg %6zu max probes, %zu slots\n",
+		   "", name,
+		   static_cast<double>(stats.total_probes) /
+		   static_cast<double>(stats.nr_strings),
+		   stats.max_probe, stats.nr_slots);
+}
+
+BENCH(sbucket)
+{
+	for (size_t nr : {1000, 100000, 400000}) {
+		const std::vector<hashed_string_t> strings = identifiers(nr);
+
+		std::vector<size_t> order(strings.size());
+		for (size_t idx = 0; idx < order.size(); idx++)
+			order[idx] = idx;
+		std::shuffle(order.begin(), order.end(),
+			     std::default_random_engine(17));
+
+		bench_note("%zu strings:\n", nr);
+		run<chained_sbucket_t>("chained", strings, order);
+		run<sbucket>("open addressing", strings, order);
+	}
+}
+
+// Intern a stream of identifier occurrences split between threads, the
+// way parallel tokenizers sharing one bucket would
+BENCH(sbucket_threads)
+{
+	const std::vector<hashed_string_t> strings = identifiers(100000);
+	const size_t nr_occurrences = 2000000;
+
+	// Skewed distribution, a few identifiers are much more common than
+	// the rest
+	std::default_random_engine r(4711);
+	std::uniform_real_distribution<double> dist(0.0, 1.0);
+	std::vector<size_t> occurrences(nr_occurrences);
+	for (auto& occurrence : occurrences) {
+		const double x = dist(r);
+		occurrence = static_cast<size_t>(x * x * x *
+						 static_cast<double>(strings.size()));
+	}
+
+	bench_measure("single_thread mode", 0, nr_occurrences, [&]() {
+		sbucket bucket(sbucket_mode_t::single_thread);
+		for (size_t idx : occurrences) {
+			const auto& s = strings[idx];
+			bench_keep(bucket.find_add_hashed(s.str.data(),
+							  s.str.size(), s.hash));
+		}
+	});
+
+	// Powers of two up to the number of hardware threads, plus the
+	// number of hardware threads itself
+	const size_t max_threads =
+		std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<size_t> thread_counts;
+	for (size_t nr = 1; nr < max_threads; nr *= 2)
+		thread_counts.push_back(nr);
+	thread_counts.push_back(max_threads);
+
+	for (size_t nr_threads : thread_counts) {
+		const std::string name = "concurrent, " +
+			std::to_string(nr_threads) + " threads";
+		bench_measure(name.c_str(), 0, nr_occurrences, [&]() {
+			sbucket bucket(sbucket_mode_t::concurrent);
+			std::vector<std::thread> threads;
+			for (size_t t = 0; t < nr_threads; t++) {
+				threads.emplace_back([&, t]() {
+					const size_t begin = nr_occurrences * t / nr_threads;
+					const size_t end = nr_occurrences * (t + 1) / nr_threads;
+					for (size_t n = begin; n < end; n++) {
+						const auto& s = strings[occurrences[n]];
+						bench_keep(bucket.find_add_hashed(
+								   s.str.data(), s.str.size(),
+								   s.hash));
+					}
+				});
+			}
+			for (auto& thread : threads)
+				thread.join();
+		});
+	}
+}
+
+// Warm start from an image compared to interning the whole vocabulary.
+// Startup is the constructor plus looking up a few hundred identifiers,
+// as a tokenizer would at the start of a file.
+BENCH(sbucket_image)
+{
+	for (size_t nr : {10000, 100000, 1000000}) {
+		const std::vector<hashed_string_t> strings = identifiers(nr);
+		const size_t nr_first = std::min<size_t>(nr, 500);
+
+		bench_file_t image("");
+		{
+			sbucket bucket;
+			for (const auto& s : strings)
+				bucket.find_add_hashed(s.str.data(), s.str.size(),
+						       s.hash);
+			bucket.save(image.name());
+		}
+
+		bench_note("%zu strings:\n", nr);
+		bench_measure("intern vocabulary", 0, nr, [&]() {
+			sbucket bucket;
+			for (const auto& s : strings)
+				bench_keep(bucket.find_add_hashed(s.str.data(),
+								  s.str.size(), s.hash));
+		});
+		bench_measure("open image", 0, nr_first, [&]() {
+			sbucket bucket(image.name());
+			for (size_t idx = 0; idx < nr_first; idx++) {
+				const auto& s = strings[idx * (nr / nr_first)];
+				bench_keep(bucket.find_add_hashed(s.str.data(),
+								  s.str.size(), s.hash));
+			}
+		});
+	}
+}
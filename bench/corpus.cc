@@ -0,0 +1,210 @@
+/*
+  Generator of synthetic Sisdel sources.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "corpus.hh"
+
+// Distributions of the standard library are implementation defined, so
+// only the raw output of the engine is used, to give the same source
+// with all standard libraries.
+class corpus_random_t {
+public:
+	explicit corpus_random_t(unsigned seed)
+		: m_engine(seed) {}
+
+	// Return a number in [0, n)
+	size_t below(size_t n)
+		{ return m_engine() % n; }
+
+	// Return true with a probability of percent / 100
+	bool chance(unsigned percent)
+		{ return below(100) < percent; }
+
+	// Return a number in [0, n), where lower numbers are more common
+	size_t skewed(size_t n)
+		{
+			const double x = static_cast<double>(m_engine()) /
+				static_cast<double>(std::mt19937::max());
+			return std::min(static_cast<size_t>(
+				x * x * x * static_cast<double>(n)), n - 1);
+		}
+
+private:
+	std::mt19937 m_engine;
+};
+
+// Identifier names, built from word parts in camel and kebab case
+static std::vector<std::string> make_names(corpus_random_t& r, size_t nr)
+{
+	static const char * const parts[] = {
+		"my", "weight", "count", "index", "buffer", "node", "value",
+		"size", "get", "set", "list", "map", "key", "input", "output",
+		"file", "line", "token", "parse", "result", "state", "handle",
+		"max", "min", "total", "length", "offset", "next", "prev", "unit",
+	};
+	static constexpr size_t nr_parts = sizeof(parts) / sizeof(parts[0]);
+
+	std::vector<std::string> names;
+	names.reserve(nr);
+	for (size_t idx = 0; idx < nr; idx++) {
+		std::string name = parts[r.below(nr_parts)];
+		const bool kebab = r.chance(30);
+		for (size_t nr_words = 1 + r.below(3); nr_words > 0; nr_words--) {
+			std::string part = parts[r.below(nr_parts)];
+			if (kebab)
+				name += '-';
+			else
+				part[0] = static_cast<char>(part[0] - 'a' + 'A');
+			name += part;
+		}
+		if (r.chance(20))
+			name += std::to_string(idx);
+		names.push_back(std::move(name));
+	}
+
+	return names;
+}
+
+// Digits in a base, with digit separators between some of them
+static void add_digits(corpus_random_t& r, std::string& out, unsigned base,
+		       size_t nr_digits, bool separators)
+{
+	static const char digits[] = "0123456789abcdef";
+
+	// Leading zeros are valid, but not realistic
+	out += digits[1 + r.below(base - 1)];
+	for (size_t idx = 1; idx < nr_digits; idx++) {
+		if (separators && ((nr_digits - idx) % 3 == 0))
+			out += '\'';
+		out += digits[r.below(base)];
+	}
+}
+
+static void add_number(corpus_random_t& r, std::string& out)
+{
+	static const char * const prefixes[] = { "0b", "0o", "", "0x" };
+	static const unsigned bases[] = { 2, 8, 10, 16 };
+
+	// Mostly decimal numbers
+	const size_t kind = r.chance(70) ? 2 : r.below(4);
+	const unsigned base = bases[kind];
+	out += prefixes[kind];
+
+	// A few integers that do not fit in 64 bits
+	if (r.chance(1)) {
+		add_digits(r, out, base, 70 + r.below(30), false);
+		return;
+	}
+
+	const size_t max_digits = (base == 10) ? 9 : (base == 16) ? 8 : 16;
+	add_digits(r, out, base, 1 + r.below(max_digits), r.chance(20));
+	if (r.chance(25)) {
+		out += '.';
+		add_digits(r, out, base, 1 + r.below(6), false);
+	}
+}
+
+static void add_string(corpus_random_t& r, std::string& out,
+		       const std::vector<std::string>& names)
+{
+	out += '"';
+	for (size_t nr_words = 1 + r.below(5); nr_words > 0; nr_words--) {
+		out += names[r.skewed(names.size())];
+		if (nr_words > 1)
+			out += ' ';
+	}
+	out += '"';
+}
+
+// Expression of identifiers, literals and bracketed groups
+static void add_expression(corpus_random_t& r, std::string& out,
+			   const std::vector<std::string>& names, size_t depth)
+{
+	static const char * const operators[] = { "+", "%", "*", "/", "<", "==" };
+
+	for (size_t nr_terms = 1 + r.below(4); nr_terms > 0; nr_terms--) {
+		const size_t kind = r.below(10);
+		if (kind < 4)
+			out += names[r.skewed(names.size())];
+		else if (kind < 7)
+			add_number(r, out);
+		else if (kind < 8)
+			add_string(r, out, names);
+		else if (depth < 2) {
+			const bool paren = r.chance(50);
+			out += paren ? "( " : "[ ";
+			if (!paren) {
+				out += names[r.skewed(names.size())];
+				out += " : ";
+			}
+			add_expression(r, out, names, depth + 1);
+			out += paren ? " )" : " ]";
+		} else
+			out += names[r.skewed(names.size())];
+
+		if (nr_terms > 1) {
+			out += ' ';
+			out += operators[r.below(6)];
+			out += ' ';
+		}
+	}
+}
+
+std::string make_corpus(const corpus_options_t& options)
+{
+	corpus_random_t r(options.seed);
+	const std::vector<std::string> names = make_names(
+		r, std::max<size_t>(options.nr_identifiers, 1));
+
+	std::string out;
+	out.reserve(options.size + 256);
+
+	size_t depth = 0;
+	while (out.size() < options.size) {
+		const size_t kind = r.below(20);
+
+		if (kind == 0) {
+			// Empty line
+			out += '\n';
+			continue;
+		}
+
+		out.append(depth, '\t');
+		if (kind == 1) {
+			out += "# ";
+			out += names[r.skewed(names.size())];
+			out += " is ";
+			out += names[r.skewed(names.size())];
+		} else if ((kind < 4) && (depth < 6)) {
+			// Start of a block
+			out += names[r.skewed(names.size())];
+			out += " is function [ unit : ";
+			out += names[r.skewed(names.size())];
+			out += " ] do";
+			depth++;
+		} else {
+			out += names[r.skewed(names.size())];
+			out += " is ";
+			add_expression(r, out, names, 0);
+			if (r.chance(10)) {
+				out += " # ";
+				out += names[r.skewed(names.size())];
+			}
+
+			// End of a block
+			if ((depth > 0) && r.chance(25))
+				depth -= 1 + r.below(depth);
+		}
+		out += '\n';
+	}
+
+	return out;
+}
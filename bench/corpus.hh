@@ -0,0 +1,45 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef CORPUS_HH
+#define CORPUS_HH
+
+/**
+ * @file
+ * Generator of synthetic Sisdel sources for benchmarks.
+ * The generated text is determined by the options only, so the same seed
+ * and size always give the same source, and results of different builds
+ * can be compared.
+ */
+
+#include <stddef.h>
+#include <string>
+
+/**
+ * Options of a generated source.
+ */
+struct corpus_options_t {
+	size_t size = 1024 * 1024;    /**< Size in bytes. The source ends at
+				       * the first line ending at or after
+				       * this size. */
+	unsigned seed = 4711;         /**< Seed of the random generator. */
+	size_t nr_identifiers = 5000; /**< Number of distinct identifier
+				       * names. */
+};
+
+/**
+ * Generate a Sisdel source.
+ * The source has definitions nested in indented blocks, comment lines,
+ * trailing comments and empty lines. Identifier names are drawn with a
+ * skewed distribution, so that some are much more common than others, as
+ * in real sources. Literals are strings and numbers in all bases, with
+ * and without digit separators, and some integers too large for 64 bits.
+ * All generated sources can be scanned without errors.
+ */
+std::string make_corpus(
+	const corpus_options_t& options /**< [in] Options. */
+	);
+
+#endif // CORPUS_HH
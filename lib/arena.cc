@@ -0,0 +1,76 @@
+/*
+  Implementation of region allocation.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <new>
+
+#include "arena.hh"
+#include "metrics.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: arena_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+arena_t::arena_t(size_t chunk_size)
+	: m_chunk_size(chunk_size), m_next(nullptr), m_end(nullptr),
+	  m_chunks(nullptr), m_destructors(nullptr), m_nr_chunks(0),
+	  m_bytes_used(0)
+{}
+
+arena_t::~arena_t()
+{
+	release();
+}
+
+void *arena_t::alloc_chunk(size_t size, size_t alignment)
+{
+	// Room for the header, and for aligning the allocation after it
+	const size_t needed = sizeof(chunk_t) + alignment + size;
+	const bool own_chunk = (size > m_chunk_size / 4) || (needed > m_chunk_size);
+	const size_t chunk_size = own_chunk ? needed : m_chunk_size;
+
+	chunk_t * const chunk = static_cast<chunk_t*>(::operator new(chunk_size));
+	chunk->next = m_chunks;
+	m_chunks = chunk;
+	m_nr_chunks++;
+	metrics_add(metric_t::arena_chunks);
+
+	char * const data = reinterpret_cast<char*>(chunk + 1);
+
+	// A large object does not replace the current chunk, which may
+	// still have room for many small ones
+	if (own_chunk) {
+		const uintptr_t at = (reinterpret_cast<uintptr_t>(data) +
+				      (alignment - 1)) & ~(alignment - 1);
+		m_bytes_used += size;
+		return reinterpret_cast<void*>(at);
+	}
+
+	m_next = data;
+	m_end = reinterpret_cast<char*>(chunk) + chunk_size;
+	return alloc(size, alignment);
+}
+
+void arena_t::release(void) noexcept
+{
+	for (destructor_t *record = m_destructors; record != nullptr;
+	     record = record->next)
+		record->destroy(record->object);
+	m_destructors = nullptr;
+
+	while (m_chunks != nullptr) {
+		chunk_t * const next = m_chunks->next;
+		::operator delete(m_chunks);
+		m_chunks = next;
+	}
+
+	m_next = nullptr;
+	m_end = nullptr;
+	m_nr_chunks = 0;
+	m_bytes_used = 0;
+}
@@ -0,0 +1,176 @@
+/*
+  Implementation of the character class scanning primitives.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <atomic>
+
+#include "char_class.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHAR_CLASS_X86 1
+#include <immintrin.h>
+#else
+#define CHAR_CLASS_X86 0
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Scanning kernels
+//
+// All kernels return a pointer to the first byte in [p, end) whose class
+// membership equals want_member, or end if there is no such byte.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static const char *scan_scalar(const char *p, const char *end,
+			       const char_class_t& cls, bool want_member)
+{
+	while ((p < end) && (cls.contains(*p) != want_member))
+		p++;
+	return p;
+}
+
+#if CHAR_CLASS_X86
+
+static const char *scan_sse2(const char *p, const char *end,
+			     const char_class_t& cls, bool want_member)
+{
+	const size_t nr = cls.nr_members();
+	__m128i members[char_class_t::max_vector_members];
+	for (size_t idx = 0; idx < nr; idx++)
+		members[idx] = _mm_set1_epi8(cls.members()[idx]);
+
+	const bool has_below = (cls.below() > 0);
+	const __m128i below_max = _mm_set1_epi8(static_cast<char>(cls.below() - 1));
+
+	const unsigned invert = want_member ? 0 : 0xffff;
+
+	while (end - p >= 16) {
+		const __m128i data = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*>(p));
+		// Bytes below the range are those not changed by min
+		__m128i hit = has_below
+			? _mm_cmpeq_epi8(_mm_min_epu8(data, below_max), data)
+			: _mm_setzero_si128();
+		for (size_t idx = 0; idx < nr; idx++)
+			hit = _mm_or_si128(hit, _mm_cmpeq_epi8(data, members[idx]));
+		const unsigned mask =
+			static_cast<unsigned>(_mm_movemask_epi8(hit)) ^ invert;
+		if (mask != 0)
+			return p + __builtin_ctz(mask);
+		p += 16;
+	}
+
+	return scan_scalar(p, end, cls, want_member);
+}
+
+__attribute__((target("avx2")))
+static const char *scan_avx2(const char *p, const char *end,
+			     const char_class_t& cls, bool want_member)
+{
+	const size_t nr = cls.nr_members();
+	__m256i members[char_class_t::max_vector_members];
+	for (size_t idx = 0; idx < nr; idx++)
+		members[idx] = _mm256_set1_epi8(cls.members()[idx]);
+
+	const bool has_below = (cls.below() > 0);
+	const __m256i below_max = _mm256_set1_epi8(static_cast<char>(cls.below() - 1));
+
+	const unsigned invert = want_member ? 0 : 0xffffffff;
+
+	while (end - p >= 32) {
+		const __m256i data = _mm256_loadu_si256(
+			reinterpret_cast<const __m256i*>(p));
+		__m256i hit = has_below
+			? _mm256_cmpeq_epi8(_mm256_min_epu8(data, below_max), data)
+			: _mm256_setzero_si256();
+		for (size_t idx = 0; idx < nr; idx++)
+			hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(data, members[idx]));
+		const unsigned mask =
+			static_cast<unsigned>(_mm256_movemask_epi8(hit)) ^ invert;
+		if (mask != 0)
+			return p + __builtin_ctz(mask);
+		p += 32;
+	}
+
+	return scan_sse2(p, end, cls, want_member);
+}
+
+#endif // CHAR_CLASS_X86
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Runtime selection of kernel
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static simd_level_t supported_simd_level(void)
+{
+#if CHAR_CLASS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return simd_level_t::avx2;
+	return simd_level_t::sse2;
+#else
+	return simd_level_t::scalar;
+#endif
+}
+
+static std::atomic<simd_level_t>& current_simd_level(void)
+{
+	static std::atomic<simd_level_t> level(supported_simd_level());
+	return level;
+}
+
+static const char *scan(const char *begin, const char *end,
+			const char_class_t& cls, bool want_member)
+{
+	if (cls.nr_members() > char_class_t::max_vector_members)
+		return scan_scalar(begin, end, cls, want_member);
+
+	switch (current_simd_level().load(std::memory_order_relaxed)) {
+#if CHAR_CLASS_X86
+	case simd_level_t::avx2:
+		return scan_avx2(begin, end, cls, want_member);
+	case simd_level_t::sse2:
+		return scan_sse2(begin, end, cls, want_member);
+#endif
+	default:
+		return scan_scalar(begin, end, cls, want_member);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: char_class_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+const char *char_class_t::find_first_of(const char *begin,
+					const char *end) const noexcept
+{
+	return scan(begin, end, *this, true);
+}
+
+const char *char_class_t::find_first_not_of(const char *begin,
+					    const char *end) const noexcept
+{
+	return scan(begin, end, *this, false);
+}
+
+simd_level_t char_class_t::simd_level(void) noexcept
+{
+	return current_simd_level().load(std::memory_order_relaxed);
+}
+
+simd_level_t char_class_t::set_simd_level(simd_level_t level) noexcept
+{
+	const simd_level_t supported = supported_simd_level();
+	if (level > supported)
+		level = supported;
+	current_simd_level().store(level, std::memory_order_relaxed);
+	return level;
+}
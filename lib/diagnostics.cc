@@ -0,0 +1,63 @@
+/*
+  Implementation of compact error records.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include "diagnostics.hh"
+#include "trace.hh"
+
+const char *error_message(error_code_t code) noexcept
+{
+	switch (code) {
+	case error_code_t::trailing_float:
+		return "Trailing garbage after float constant";
+	case error_code_t::trailing_integer:
+		return "Trailing garbage after integer constant";
+	case error_code_t::trailing_string:
+		return "Trailing garbage after string constant";
+	case error_code_t::invalid_identifier:
+		return "Invalid identifier name";
+	case error_code_t::unterminated_string:
+		return "Unterminated string constant";
+	case error_code_t::token_too_long:
+		return "Token does not fit in input buffer";
+	case error_code_t::invalid_utf8:
+		return "Invalid UTF-8 sequence";
+	}
+	return "Unknown error";
+}
+
+void print_error(std::ostream& os, const position_t& token_start,
+		 const position_t& error_at, std::string_view msg)
+{
+	const size_t column = error_at.column();
+
+	os << token_start << ": error: " << msg
+	   << "\n        " << token_start.str()
+	   << "\n        " << std::string((column > 0) ? column - 1 : 0, ' ') << '^';
+}
+
+void diagnostic_t::print(std::ostream& os) const
+{
+	print_error(os, start_position(), at_position(), error_message(code));
+}
+
+void diagnostics_t::add(error_code_t code, const position_t& token_start,
+			const position_t& error_at)
+{
+	m_diagnostics.push_back({ token_start.offset(), error_at.offset(),
+				  token_start.file_id(), code });
+
+	SISDEL_TRACE(parser_error, token_start.file_id(), token_start.offset(),
+		     error_at.offset(), error_message(code));
+}
+
+void diagnostics_t::print(std::ostream& os) const
+{
+	for (const diagnostic_t& diagnostic : m_diagnostics) {
+		diagnostic.print(os);
+		os << '\n';
+	}
+}
@@ -8,19 +8,20 @@
 #include <sstream>
 
 #include "error.hh"
-
-static std::string repeat_spaces(size_t nr)
-{
-	std::string str(nr, ' ');
-	return str;
-}
+#include "trace.hh"
 
 parser_error::parser_error(const position_t& token_start, const position_t& error_at, const std::string& msg)
 {
 	std::stringstream ss;
-	ss << token_start << ": error: " << msg
-	   << "\n        " << token_start.str()
-	   << "\n        " << repeat_spaces(error_at.column() - 1) << '^';
+	print_error(ss, token_start, error_at, msg);
 
 	m_what = ss.str();
+
+	SISDEL_TRACE(parser_error, token_start.file_id(), token_start.offset(),
+		     error_at.offset(), msg.c_str());
+}
+
+parser_error::parser_error(const position_t& token_start, const position_t& error_at, error_code_t code)
+	: parser_error(token_start, error_at, error_message(code))
+{
 }
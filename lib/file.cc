@@ -9,6 +9,7 @@
 #include <system_error>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -21,15 +22,21 @@ static size_t file_size(int fd) {
 		throw std::system_error(errno, std::generic_category(), "open");
 	}
 
-	const off_t end_offset = lseek(fd, 0, SEEK_END);
+	// One system call, instead of seeking to the end and back
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		const int err = errno;
+		close(fd);
+		throw std::system_error(err, std::generic_category(), "fstat");
+	}
 
-	if (end_offset < 0)
-		throw std::system_error(errno, std::generic_category(), "seek_end");
+	// Size of pipes and devices is not known in advance
+	if (!S_ISREG(st.st_mode)) {
+		close(fd);
+		throw std::system_error(ESPIPE, std::generic_category(), "Not a regular file");
+	}
 
-	if (lseek(fd, 0, SEEK_SET) < 0)
-		throw std::system_error(errno, std::generic_category(), "seek_set");
-	
-	return static_cast<size_t>(end_offset);
+	return static_cast<size_t>(st.st_size);
 }
 
 file_t::file_t(const char *name, int flags)
@@ -0,0 +1,297 @@
+/*
+  Implementation of the file_loader_t class.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "file_loader.hh"
+#include "metrics.hh"
+#include "trace.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Counters and read buffer cache
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct counters_t {
+	std::array<std::atomic<size_t>, nr_load_strategies> nr_files;
+	std::array<std::atomic<size_t>, nr_load_strategies> nr_bytes;
+	std::atomic<size_t> nr_buffer_reuses;
+};
+
+// Read buffers no longer in use. Buffers are only reused by the thread
+// that released them, so no locking is needed.
+struct buffer_cache_t {
+	// Number of buffers kept per thread
+	static constexpr size_t max_buffers = 4;
+
+	std::vector<std::pair<std::unique_ptr<char[]>, size_t>> buffers;
+};
+
+}
+
+static counters_t load_counters;
+
+static thread_local buffer_cache_t buffer_cache;
+
+// Smallest read buffer allocated, so that buffers can be reused for files
+// of different sizes
+static constexpr size_t min_buffer_capacity = 64 * 1024;
+
+// Alignment needed for transparent huge pages
+static constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+// Contents of empty files
+static const char no_contents[load_padding] = {};
+
+// Round up to a multiple of a power of two
+static size_t round_up(size_t size, size_t alignment)
+{
+	return (size + alignment - 1) & ~(alignment - 1);
+}
+
+static void count_load(load_strategy_t strategy, size_t size)
+{
+	const size_t idx = static_cast<size_t>(strategy);
+	load_counters.nr_files[idx].fetch_add(1, std::memory_order_relaxed);
+	load_counters.nr_bytes[idx].fetch_add(size, std::memory_order_relaxed);
+}
+
+// Select strategy for a file of given size.
+static load_strategy_t select_strategy(const load_options_t& options,
+				       size_t size)
+{
+	// Empty files can not be mapped
+	if (size == 0)
+		return load_strategy_t::read;
+
+	if (options.strategy != load_strategy_t::automatic)
+		return options.strategy;
+
+	if (size <= options.read_limit)
+		return load_strategy_t::read;
+	if (size <= options.populate_limit)
+		return load_strategy_t::mmap_populate;
+	if (options.huge_pages)
+		return load_strategy_t::huge_pages;
+	return load_strategy_t::mmap;
+}
+
+const char *load_strategy_name(load_strategy_t strategy) noexcept
+{
+	switch (strategy) {
+	case load_strategy_t::automatic:
+		return "automatic";
+	case load_strategy_t::read:
+		return "read";
+	case load_strategy_t::mmap:
+		return "mmap";
+	case load_strategy_t::mmap_populate:
+		return "mmap_populate";
+	case load_strategy_t::huge_pages:
+		return "huge_pages";
+	case load_strategy_t::nr_strategies:
+		break;
+	}
+	return "unknown";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: file_loader_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+file_loader_t::file_loader_t(const char *name, const load_options_t& options)
+	: m_file(name, O_RDONLY), m_strategy(select_strategy(options, m_file.size())),
+	  m_size(m_file.size()), m_data(no_contents), m_buffer(), m_capacity(0),
+	  m_mapping(NULL), m_mapping_length(0)
+{
+	const metrics_timer_t timer(phase_t::load);
+
+	switch (m_strategy) {
+	case load_strategy_t::mmap:
+		load_mmap(0);
+		break;
+	case load_strategy_t::mmap_populate:
+		load_mmap(MAP_POPULATE);
+		break;
+	case load_strategy_t::huge_pages:
+		load_huge_pages();
+		break;
+	default:
+		m_strategy = load_strategy_t::read;
+		load_read();
+		break;
+	}
+
+	count_load(m_strategy, m_size);
+	metrics_add(metric_t::files_loaded);
+	metrics_add(metric_t::bytes_loaded, m_size);
+	SISDEL_TRACE(file_open, name, m_size, load_strategy_name(m_strategy));
+}
+
+file_loader_t::~file_loader_t()
+{
+	if (m_mapping != NULL)
+		munmap(m_mapping, m_mapping_length);
+
+	if (m_buffer) {
+		auto& buffers = buffer_cache.buffers;
+		if (buffers.size() < buffer_cache_t::max_buffers)
+			buffers.emplace_back(std::move(m_buffer), m_capacity);
+	}
+}
+
+load_counters_t file_loader_t::counters(void) noexcept
+{
+	load_counters_t result;
+
+	for (size_t idx = 0; idx < nr_load_strategies; idx++) {
+		result.nr_files[idx] = load_counters.nr_files[idx].load(
+			std::memory_order_relaxed);
+		result.nr_bytes[idx] = load_counters.nr_bytes[idx].load(
+			std::memory_order_relaxed);
+	}
+	result.nr_buffer_reuses = load_counters.nr_buffer_reuses.load(
+		std::memory_order_relaxed);
+
+	return result;
+}
+
+void file_loader_t::pread_all(char *dest)
+{
+	size_t done = 0;
+
+	while (done < m_size) {
+		const ssize_t nr = pread(m_file.fd(), dest + done, m_size - done,
+					 static_cast<off_t>(done));
+		if (nr < 0) {
+			if (errno == EINTR)
+				continue;
+			throw std::system_error(errno, std::generic_category(), "pread");
+		}
+
+		// File was truncated after its size was read
+		if (nr == 0)
+			break;
+
+		done += static_cast<size_t>(nr);
+	}
+
+	m_size = done;
+}
+
+void file_loader_t::load_read(void)
+{
+	if (m_size == 0)
+		return;
+
+	// Take the first cached buffer large enough
+	auto& buffers = buffer_cache.buffers;
+	for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+		if (it->second >= m_size) {
+			m_buffer = std::move(it->first);
+			m_capacity = it->second;
+			buffers.erase(it);
+			load_counters.nr_buffer_reuses.fetch_add(1, std::memory_order_relaxed);
+			break;
+		}
+	}
+
+	if (!m_buffer) {
+		m_capacity = std::max(m_size, min_buffer_capacity);
+		m_buffer.reset(new char[m_capacity + load_padding]);
+	}
+
+	pread_all(m_buffer.get());
+	memset(m_buffer.get() + m_size, 0, load_padding);
+	m_data = m_buffer.get();
+}
+
+void file_loader_t::load_mmap(int flags)
+{
+	// The rest of the last page is zero. If it is too short for the
+	// padding, reserve zero pages for it, and map the file over the
+	// start of them.
+	const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	void *reserved = NULL;
+	size_t length = m_size;
+	if (round_up(m_size, page_size) - m_size < load_padding) {
+		length = round_up(m_size + load_padding, page_size);
+		reserved = mmap(NULL, length, PROT_READ,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (reserved == MAP_FAILED)
+			throw std::system_error(errno, std::generic_category(), "mmap");
+		flags |= MAP_FIXED;
+	}
+
+	void * const map = mmap(reserved, m_size, PROT_READ, MAP_PRIVATE | flags,
+				m_file.fd(), 0);
+	if (map == MAP_FAILED) {
+		const int error = errno;
+		if (reserved != NULL)
+			munmap(reserved, length);
+		throw std::system_error(error, std::generic_category(), "mmap");
+	}
+
+	m_mapping = map;
+	m_mapping_length = length;
+	m_data = static_cast<const char*>(map);
+
+	// The tokenizer reads the file from start to end, so read ahead
+	// aggressively and drop pages once passed. Only a hint, errors are
+	// ignored.
+	if ((flags & MAP_POPULATE) == 0)
+		(void) madvise(map, m_size, MADV_SEQUENTIAL);
+}
+
+void file_loader_t::load_huge_pages(void)
+{
+	// Huge pages are not available for regular file mappings, so the
+	// file is read into anonymous memory. Allocate an extra huge page to
+	// be able to align the start.
+	const size_t length = round_up(m_size + load_padding, huge_page_size)
+		+ huge_page_size;
+	void * const map = mmap(NULL, length, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+		throw std::system_error(errno, std::generic_category(), "mmap");
+
+	m_mapping = map;
+	m_mapping_length = length;
+
+	char * const aligned = reinterpret_cast<char*>(
+		(reinterpret_cast<uintptr_t>(map) + huge_page_size - 1) &
+		~static_cast<uintptr_t>(huge_page_size - 1));
+
+	// Only a hint, not all kernels support transparent huge pages
+	(void) madvise(aligned, length - static_cast<size_t>(aligned - static_cast<char*>(map)),
+		       MADV_HUGEPAGE);
+
+	try {
+		pread_all(aligned);
+	}
+	catch (...) {
+		munmap(map, length);
+		throw;
+	}
+	m_data = aligned;
+}
@@ -0,0 +1,320 @@
+/*
+  Implementation of the float_literal_t class.
+
+  The decimal conversion is the Eisel-Lemire algorithm, as described in
+  "Number Parsing at a Gigabyte per Second" by Daniel Lemire, with the
+  refinement from "Fast Number Parsing Without Fallback" by Noble Mushtak
+  and Daniel Lemire, showing that a 128-bit approximation of the power of
+  five is always sufficient.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+
+#include "float_literal.hh"
+#include "metrics.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Powers of five table
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Smallest and largest decimal exponent handled by the table. Values with
+// smaller exponents are always rounded to zero, and with larger to
+// infinity.
+static constexpr int64_t smallest_power = -342;
+static constexpr int64_t largest_power = 308;
+
+typedef std::array<uint64_t, 2 * (largest_power - smallest_power + 1)> power_table_t;
+
+// 128-bit approximations of 5^q, normalized so that the most significant
+// bit is set. Entry 2*n is the high 64 bits and 2*n+1 the low 64 bits for
+// q = smallest_power + n. Positive powers are truncated, negative powers
+// rounded up.
+static power_table_t build_power_table(void)
+{
+	power_table_t table;
+	const mp_int one(1);
+	const mp_int mask64((one << 64) - 1);
+	size_t idx = 0;
+
+	for (int64_t q = smallest_power; q <= largest_power; q++) {
+		mp_int value;
+		if (q < 0) {
+			const mp_int power5 = boost::multiprecision::pow(
+				mp_int(5), static_cast<unsigned>(-q));
+			// Smallest z where 2^z >= 5^-q
+			const unsigned z = static_cast<unsigned>(
+				boost::multiprecision::msb(power5)) + 1;
+			if (q >= -27) {
+				value = (one << (z + 127)) / power5 + 1;
+			} else {
+				value = (one << (2 * z + 128)) / power5 + 1;
+				const unsigned bits = static_cast<unsigned>(
+					boost::multiprecision::msb(value)) + 1;
+				if (bits > 128)
+					value >>= bits - 128;
+			}
+		} else {
+			value = boost::multiprecision::pow(
+				mp_int(5), static_cast<unsigned>(q));
+			const unsigned msb = static_cast<unsigned>(
+				boost::multiprecision::msb(value));
+			if (msb < 127)
+				value <<= 127 - msb;
+			else
+				value >>= msb - 127;
+		}
+		table[idx++] = static_cast<uint64_t>(mp_int(value >> 64));
+		table[idx++] = static_cast<uint64_t>(mp_int(value & mask64));
+	}
+
+	return table;
+}
+
+static const power_table_t& power_table(void)
+{
+	static const power_table_t table = build_power_table();
+	return table;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Decimal conversion
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static double make_double(uint64_t mantissa, int64_t exponent)
+{
+	const uint64_t bits = mantissa | (static_cast<uint64_t>(exponent) << 52);
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+double decimal_to_double(uint64_t w, int64_t q) noexcept
+{
+	static constexpr double powers_of_ten[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	// Clinger's fast path: both w and 10^q are exact doubles, so a
+	// single correctly rounded operation gives the result
+	if ((q >= -22) && (q <= 22) && (w <= (static_cast<uint64_t>(1) << 53))) {
+		const double d = static_cast<double>(w);
+		return (q < 0) ? d / powers_of_ten[-q] : d * powers_of_ten[q];
+	}
+
+	if ((w == 0) || (q < smallest_power))
+		return 0.0;
+	if (q > largest_power)
+		return std::numeric_limits<double>::infinity();
+
+	const power_table_t& table = power_table();
+	const size_t idx = 2 * static_cast<size_t>(q - smallest_power);
+
+	// Normalize w so that its most significant bit is set
+	int lz = __builtin_clzll(w);
+	w <<= lz;
+
+	// Multiply with the high 64 bits of 5^q. Only if the result is too
+	// close to a rounding boundary, use the low 64 bits too.
+	unsigned __int128 product =
+		static_cast<unsigned __int128>(w) * table[idx];
+	uint64_t upper = static_cast<uint64_t>(product >> 64);
+	uint64_t lower = static_cast<uint64_t>(product);
+	if ((upper & 0x1ff) == 0x1ff) {
+		const uint64_t second = static_cast<uint64_t>(
+			(static_cast<unsigned __int128>(w) * table[idx + 1]) >> 64);
+		lower += second;
+		if (second > lower)
+			upper++;
+	}
+
+	const uint64_t upperbit = upper >> 63;
+	uint64_t mantissa = upper >> (upperbit + 9);
+	lz += static_cast<int>(1 ^ upperbit);
+
+	// floor(log2(10^q)) is (217706 * q) >> 16 for the supported range
+	int64_t exponent = (((152170 + 65536) * q) >> 16) + 1024 + 63 - lz;
+
+	if (exponent <= 0) {
+		// Subnormal
+		if (-exponent + 1 >= 64)
+			return 0.0;
+		mantissa >>= -exponent + 1;
+		mantissa += mantissa & 1;
+		mantissa >>= 1;
+		exponent = (mantissa < (static_cast<uint64_t>(1) << 52)) ? 0 : 1;
+		return make_double(mantissa & ~(static_cast<uint64_t>(1) << 52),
+				   exponent);
+	}
+
+	// Exactly half way between two doubles is only possible for small
+	// exponents. Then round to even instead of rounding up.
+	if ((lower <= 1) && (q >= -4) && (q <= 23) && ((mantissa & 3) == 1)) {
+		if ((mantissa << (upperbit + 64 - 52 - 3)) == upper)
+			mantissa &= ~static_cast<uint64_t>(1);
+	}
+
+	mantissa += mantissa & 1;
+	mantissa >>= 1;
+
+	if (mantissa >= (static_cast<uint64_t>(1) << 53)) {
+		// Rounding overflowed into next binade
+		mantissa = static_cast<uint64_t>(1) << 52;
+		exponent++;
+	}
+	mantissa &= ~(static_cast<uint64_t>(1) << 52);
+
+	if (exponent > 2046)
+		return std::numeric_limits<double>::infinity();
+
+	return make_double(mantissa, exponent);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Power of two base conversion
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Calculate mantissa * 2^exponent, correctly rounded. Bit 0 of the
+// mantissa may be a sticky bit, representing bits already dropped.
+static double binary_to_double(uint64_t mantissa, int64_t exponent)
+{
+	if (mantissa == 0)
+		return 0.0;
+
+	const int64_t msb = 63 - __builtin_clzll(mantissa);
+
+	if (msb + exponent > 1023)
+		return std::numeric_limits<double>::infinity();
+
+	if (msb + exponent >= -1022) {
+		// Normal result. The conversion of the mantissa is correctly
+		// rounded, and scaling by a power of two is then exact.
+		return std::ldexp(static_cast<double>(mantissa),
+				  static_cast<int>(exponent));
+	}
+
+	// Subnormal result, round mantissa to the bits available below the
+	// smallest normal exponent
+	const int64_t shift = -1074 - exponent;
+	if (shift <= 0)
+		return std::ldexp(static_cast<double>(mantissa),
+				  static_cast<int>(exponent));
+	if (shift > 64)
+		return 0.0;
+
+	uint64_t quotient, remainder, half;
+	if (shift == 64) {
+		quotient = 0;
+		remainder = mantissa;
+		half = static_cast<uint64_t>(1) << 63;
+	} else {
+		quotient = mantissa >> shift;
+		remainder = mantissa & ((static_cast<uint64_t>(1) << shift) - 1);
+		half = static_cast<uint64_t>(1) << (shift - 1);
+	}
+	if ((remainder > half) || ((remainder == half) && (quotient & 1)))
+		quotient++;
+
+	return std::ldexp(static_cast<double>(quotient), -1074);
+}
+
+static unsigned bits_per_digit(unsigned base)
+{
+	switch (base) {
+	case 2:
+		return 1;
+	case 8:
+		return 3;
+	default:
+		return 4;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: float_literal_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+double float_literal_t::to_double(void) const
+{
+	if (m_base == 10) {
+		if (m_small)
+			return decimal_to_double(m_mantissa,
+						 -static_cast<int64_t>(m_nr_decimals));
+
+		// Mantissa does not fit in 64 bits, let strtod() do the
+		// rounding. Exponent notation avoids depending on locale.
+		const std::string str = m_big_mantissa.str() + "e-" +
+			std::to_string(m_nr_decimals);
+		return strtod(str.c_str(), NULL);
+	}
+
+	int64_t exponent = -static_cast<int64_t>(m_nr_decimals * bits_per_digit(m_base));
+
+	if (m_small)
+		return binary_to_double(m_mantissa, exponent);
+
+	// Keep the 64 most significant bits, and let bit 0 tell whether any
+	// of the dropped bits were set
+	const unsigned msb = static_cast<unsigned>(
+		boost::multiprecision::msb(m_big_mantissa));
+	const unsigned drop = msb - 63;
+	const mp_int top = m_big_mantissa >> drop;
+	uint64_t mantissa = static_cast<uint64_t>(top);
+	if (mp_int(top << drop) != m_big_mantissa)
+		mantissa |= 1;
+	exponent += drop;
+
+	return binary_to_double(mantissa, exponent);
+}
+
+// Extra decimal digits of precision used by to_mp_float(). Without them,
+// rounding to the binary precision could change the last digit of the
+// literal.
+static constexpr unsigned mp_float_guard_digits = 10;
+
+mp_float float_literal_t::to_mp_float(void) const
+{
+	metrics_add(metric_t::float_conversions);
+
+	// Decimal digits needed to represent all digits of the literal, plus
+	// guard digits so that rounding by the conversion only affects
+	// digits beyond the last digit of the literal
+	const double digits10 = std::ceil(static_cast<double>(m_nr_digits) *
+					  std::log10(static_cast<double>(m_base)));
+	const unsigned precision = std::max(static_cast<unsigned>(digits10), 1u) +
+		mp_float_guard_digits;
+
+	// Assigning integers keeps the precision of the target, so the only
+	// rounding is by the division. Constructing from an mp_int would
+	// round it to the default precision.
+	mp_float value(0, precision);
+	value = mantissa();
+
+	if (m_nr_decimals > 0) {
+		// The power is evaluated as an integer first, assigning the
+		// expression would evaluate it as an mp_float
+		const mp_int power = boost::multiprecision::pow(
+			mp_int(m_base), static_cast<unsigned>(m_nr_decimals));
+		mp_float divisor(0, precision);
+		divisor = power;
+		value /= divisor;
+	}
+
+	return value;
+}
@@ -0,0 +1,188 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef ARENA_HH
+#define ARENA_HH
+
+/**
+ * @file
+ * Region allocation.
+ * An arena hands out memory from large chunks, and frees all of it at
+ * once. It is intended for the nodes of a parse tree, which are created
+ * one at a time while parsing a compilation unit, and all become garbage
+ * together. Nodes refer to each other using plain pointers, which are
+ * valid until the arena is released, so there is neither an allocation
+ * nor a reference count per node.
+ * @par
+ * The arena is a std::pmr::memory_resource, so containers in the nodes,
+ * e.g. std::pmr::vector and std::pmr::map, can allocate from it too.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Arena of objects freed together.
+ * Objects are placed one after the other in chunks, and a new chunk is
+ * only allocated when the current one is full. Objects larger than a
+ * quarter of a chunk get a chunk of their own, so that little of the
+ * current chunk is wasted. Deallocating single objects does nothing.
+ * @par
+ * Destructors of objects created by create() are run when the arena is
+ * released, in reverse order of creation, unless the object type is
+ * trivially destructible.
+ * @par
+ * An arena is not thread safe. Use one arena per compilation unit, or
+ * per thread.
+ */
+class arena_t : public std::pmr::memory_resource {
+public:
+	/**
+	 * Default chunk size.
+	 */
+	static constexpr size_t default_chunk_size = 64 * 1024;
+
+	/**
+	 * Constructor.
+	 * No memory is allocated until the first allocation.
+	 */
+	explicit arena_t(
+		size_t chunk_size = default_chunk_size /**< [in] Size of each
+							* chunk, including
+							* its header. */
+		);
+
+	/**
+	 * Destructor, see release().
+	 */
+	~arena_t() override;
+
+	// Objects refer to the arena by address.
+	arena_t(const arena_t&) = delete;
+	arena_t& operator=(const arena_t&) = delete;
+
+	/**
+	 * Allocate memory.
+	 * @returns Pointer to at least size bytes, aligned as given, valid
+	 *          until the arena is released.
+	 * @throws std::bad_alloc if out of memory.
+	 */
+	void *alloc(
+		size_t size,                                   /**< [in] Number
+								* of bytes, not
+								* 0. */
+		size_t alignment = alignof(std::max_align_t)   /**< [in] Power
+								* of 2. */
+		)
+		{
+			const uintptr_t at = (reinterpret_cast<uintptr_t>(m_next) +
+					      (alignment - 1)) & ~(alignment - 1);
+			if (at + size > reinterpret_cast<uintptr_t>(m_end))
+				return alloc_chunk(size, alignment);
+
+			m_next = reinterpret_cast<char*>(at + size);
+			m_bytes_used += size;
+			return reinterpret_cast<void*>(at);
+		}
+
+	/**
+	 * Create an object in the arena.
+	 * @returns Pointer to the object, valid until the arena is
+	 *          released.
+	 */
+	template <typename T, typename... Args>
+	T *create(
+		Args&&... args /**< [in] Arguments to the constructor. */
+		)
+		{
+			if constexpr (std::is_trivially_destructible_v<T>) {
+				return new (alloc(sizeof(T), alignof(T)))
+					T(std::forward<Args>(args)...);
+			} else {
+				// The destructor record is allocated first, so
+				// that a throwing constructor leaves no record
+				// of an object that was never constructed
+				destructor_t *record = static_cast<destructor_t*>(
+					alloc(sizeof(destructor_t), alignof(destructor_t)));
+				T *object = new (alloc(sizeof(T), alignof(T)))
+					T(std::forward<Args>(args)...);
+				*record = { &destroy<T>, object, m_destructors };
+				m_destructors = record;
+				return object;
+			}
+		}
+
+	/**
+	 * Destroy all objects, and free all memory.
+	 * All pointers into the arena become invalid. The arena can then be
+	 * used again.
+	 */
+	void release(void) noexcept;
+
+	/**
+	 * Return number of chunks allocated since construction or the last
+	 * release(), which is the number of allocations made from the heap.
+	 */
+	size_t nr_chunks(void) const noexcept
+		{ return m_nr_chunks; }
+
+	/**
+	 * Return number of bytes handed out since construction or the last
+	 * release(), not counting alignment padding.
+	 */
+	size_t bytes_used(void) const noexcept
+		{ return m_bytes_used; }
+
+protected:
+	// From std::pmr::memory_resource.
+	void *do_allocate(size_t bytes, size_t alignment) override
+		{ return alloc((bytes > 0) ? bytes : 1, alignment); }
+	void do_deallocate(void *, size_t, size_t) noexcept override
+		{}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{ return this == &other; }
+
+private:
+	// Header at the start of each chunk.
+	struct chunk_t {
+		chunk_t *next;
+	};
+
+	// Record of an object whose destructor must be run.
+	struct destructor_t {
+		void (*destroy)(void *object);
+		void *object;
+		destructor_t *next;
+	};
+
+	template <typename T>
+	static void destroy(void *object) noexcept
+		{ static_cast<T*>(object)->~T(); }
+
+	// Allocate from a new chunk.
+	void *alloc_chunk(size_t size, size_t alignment);
+
+	// Size of chunks, including the header.
+	const size_t m_chunk_size;
+
+	// Free part of the current chunk.
+	char *m_next;
+	char *m_end;
+
+	// All chunks, most recently allocated first.
+	chunk_t *m_chunks;
+
+	// Objects to destroy, most recently created first.
+	destructor_t *m_destructors;
+
+	size_t m_nr_chunks;
+	size_t m_bytes_used;
+};
+
+#endif // ARENA_HH
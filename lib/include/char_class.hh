@@ -0,0 +1,178 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef CHAR_CLASS_HH
+#define CHAR_CLASS_HH
+
+/**
+ * @file
+ * Character classes and vectorized scanning primitives.
+ * A character class is a set of bytes. The scanning primitives find the
+ * first byte in a buffer that is, or is not, a member of a given class.
+ * @par
+ * Scanning is done 16 (SSE2) or 32 (AVX2) bytes at a time when the CPU
+ * supports it, with a scalar fallback for other CPUs and for classes too
+ * large to be handled by the vector implementations. The implementation
+ * is selected at runtime, the first time a scan is made.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Vector instruction set used by the scanning primitives.
+ */
+enum class simd_level_t {
+	scalar, /**< Byte at a time, works on all CPUs. */
+	sse2,   /**< 16 bytes at a time. */
+	avx2    /**< 32 bytes at a time. */
+};
+
+/**
+ * Set of bytes.
+ * Class membership is stored both as a bitmap, used by the scalar
+ * implementation, and as a list of member bytes, used by the vector
+ * implementations. A class may also contain all bytes below a given
+ * value, e.g. the control characters, which the vector implementations
+ * check using a single comparison rather than one per member.
+ * @todo Should use Unicode characters rather than bytes.
+ */
+class char_class_t {
+public:
+	/**
+	 * Maximum number of members for the vector implementations to be
+	 * used. Larger classes are always scanned using the scalar
+	 * implementation.
+	 */
+	static constexpr size_t max_vector_members = 16;
+
+	/**
+	 * Construct a character class from a C string.
+	 * As with strchr(), the terminating '\\0' character is considered
+	 * to be part of the class. This makes scanning using a character
+	 * class give the same result as a strchr() based loop.
+	 */
+	constexpr char_class_t(
+		const char *chars /**< [in] Characters in the class. */
+		) noexcept
+		: m_bitmap{}, m_members{}, m_nr_members(0), m_below(0)
+		{
+			do {
+				add(*chars);
+			} while (*chars++ != '\0');
+		}
+
+	/**
+	 * Construct a character class from a C string and a range of bytes.
+	 * Same as char_class_t(const char*), but also containing all bytes
+	 * below a given value. These are not counted as members by
+	 * nr_members().
+	 */
+	constexpr char_class_t(
+		const char *chars, /**< [in] Characters in the class. */
+		uint8_t below      /**< [in] Bytes below this value are also
+				    * in the class. */
+		) noexcept
+		: m_bitmap{}, m_members{}, m_nr_members(0), m_below(below)
+		{
+			for (unsigned byte = 0; byte < below; byte++)
+				m_bitmap[byte >> 6] |= static_cast<uint64_t>(1) << (byte & 63);
+			do {
+				add(*chars);
+			} while (*chars++ != '\0');
+		}
+
+	/**
+	 * Construct a character class containing a single character.
+	 */
+	constexpr explicit char_class_t(
+		char ch /**< [in] The only member of the class. */
+		) noexcept
+		: m_bitmap{}, m_members{}, m_nr_members(0), m_below(0)
+		{ add(ch); }
+
+	/**
+	 * Check for class membership.
+	 * @returns true if ch is a member of this class, false otherwise.
+	 */
+	constexpr bool contains(
+		char ch /**< [in] Character to check. */
+		) const noexcept
+		{
+			const uint8_t byte = static_cast<uint8_t>(ch);
+			return (m_bitmap[byte >> 6] >> (byte & 63)) & 1;
+		}
+
+	/**
+	 * Find first byte that is a member of this class.
+	 * @returns Pointer to first member byte in [begin, end), or end if
+	 *          no such byte was found.
+	 */
+	const char *find_first_of(
+		const char *begin, /**< [in] Start of buffer to scan. */
+		const char *end    /**< [in] First byte past the buffer. */
+		) const noexcept;
+
+	/**
+	 * Find first byte that is not a member of this class.
+	 * @returns Pointer to first non-member byte in [begin, end), or end
+	 *          if no such byte was found.
+	 */
+	const char *find_first_not_of(
+		const char *begin, /**< [in] Start of buffer to scan. */
+		const char *end    /**< [in] First byte past the buffer. */
+		) const noexcept;
+
+	/**
+	 * Return the instruction set used by the scanning primitives.
+	 * @returns The best instruction set supported by the running CPU,
+	 *          unless overridden by set_simd_level().
+	 */
+	static simd_level_t simd_level(void) noexcept;
+
+	/**
+	 * Override the instruction set used by the scanning primitives.
+	 * Intended for tests and benchmarks. Requesting an instruction set
+	 * not supported by the running CPU selects the best supported one.
+	 * @returns The instruction set actually selected.
+	 */
+	static simd_level_t set_simd_level(
+		simd_level_t level /**< [in] Wanted instruction set. */
+		) noexcept;
+
+	// Used by the implementation of the scanning primitives.
+	constexpr const char *members(void) const noexcept
+		{ return m_members; }
+	constexpr size_t nr_members(void) const noexcept
+		{ return m_nr_members; }
+	constexpr uint8_t below(void) const noexcept
+		{ return m_below; }
+
+private:
+	constexpr void add(char ch) noexcept
+		{
+			if (contains(ch))
+				return;
+			const uint8_t byte = static_cast<uint8_t>(ch);
+			m_bitmap[byte >> 6] |= static_cast<uint64_t>(1) << (byte & 63);
+			if (m_nr_members < max_vector_members)
+				m_members[m_nr_members] = ch;
+			m_nr_members++;
+		}
+
+	// One bit per possible byte value.
+	uint64_t m_bitmap[4];
+
+	// Member bytes, only valid if m_nr_members <= max_vector_members.
+	char m_members[max_vector_members];
+
+	// Number of member bytes, not counting those below m_below.
+	size_t m_nr_members;
+
+	// All bytes below this value are members.
+	uint8_t m_below;
+};
+
+#endif // CHAR_CLASS_HH
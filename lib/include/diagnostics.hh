@@ -0,0 +1,162 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef DIAGNOSTICS_HH
+#define DIAGNOSTICS_HH
+
+/**
+ * @file
+ * Compact error records.
+ * A diagnostic is recorded as an error code and two byte offsets, the
+ * message text, line, column and the caret line are only rendered when
+ * the diagnostic is printed. Recording an error is then cheap enough to
+ * continue scanning after it, and report all errors of a file in one
+ * pass.
+ * @par
+ * Rendering needs the input file, see position_t, so diagnostics must be
+ * printed before the input file object is destructed.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include "position.hh"
+
+/**
+ * Kind of error.
+ */
+enum class error_code_t : uint8_t {
+	trailing_float,      /**< Trailing garbage after float constant. */
+	trailing_integer,    /**< Trailing garbage after integer constant. */
+	trailing_string,     /**< Trailing garbage after string constant. */
+	invalid_identifier,  /**< Invalid identifier name. */
+	unterminated_string, /**< End of input inside a string constant. */
+	token_too_long,      /**< Token does not fit in input buffer. */
+	invalid_utf8         /**< Invalid UTF-8 sequence. */
+};
+
+/**
+ * Return message of an error code.
+ * @returns Message, without position, valid for the life time of the
+ *          process.
+ */
+const char *error_message(
+	error_code_t code /**< [in] Error code. */
+	) noexcept;
+
+/**
+ * Print an error message.
+ * Output format is "file:line:column: error: message", followed by the
+ * line containing the erroneous token and a caret pointing at the error.
+ */
+void print_error(
+	std::ostream& os,              /**< [in] Stream to print to. */
+	const position_t& token_start, /**< [in] Start of erroneous token. */
+	const position_t& error_at,    /**< [in] Where the error was found. */
+	std::string_view msg           /**< [in] Error message. */
+	);
+
+/**
+ * One recorded error.
+ */
+struct diagnostic_t {
+	/**
+	 * Byte offset of the erroneous token.
+	 */
+	size_t start;
+
+	/**
+	 * Byte offset where the error was found, which is where the caret
+	 * points.
+	 */
+	size_t at;
+
+	/**
+	 * Identity of the input file.
+	 */
+	file_id_t file;
+
+	/**
+	 * Kind of error.
+	 */
+	error_code_t code;
+
+	/**
+	 * Return position of the erroneous token.
+	 */
+	constexpr position_t start_position(void) const noexcept
+		{ return position_t(file, start); }
+
+	/**
+	 * Return position where the error was found.
+	 */
+	constexpr position_t at_position(void) const noexcept
+		{ return position_t(file, at); }
+
+	/**
+	 * Print the diagnostic, see print_error().
+	 */
+	void print(
+		std::ostream& os /**< [in] Stream to print to. */
+		) const;
+};
+
+/**
+ * Buffer of recorded errors, in the order they were found.
+ */
+class diagnostics_t {
+public:
+	/**
+	 * Record an error.
+	 */
+	void add(
+		error_code_t code,             /**< [in] Kind of error. */
+		const position_t& token_start, /**< [in] Start of erroneous
+						* token. */
+		const position_t& error_at     /**< [in] Where the error was
+						* found. */
+		);
+
+	/**
+	 * Print all errors, each followed by a line feed.
+	 */
+	void print(
+		std::ostream& os /**< [in] Stream to print to. */
+		) const;
+
+	/**
+	 * Return number of recorded errors.
+	 */
+	size_t size(void) const noexcept
+		{ return m_diagnostics.size(); }
+
+	/**
+	 * Check whether any errors have been recorded.
+	 */
+	bool empty(void) const noexcept
+		{ return m_diagnostics.empty(); }
+
+	/**
+	 * Return a recorded error.
+	 */
+	const diagnostic_t& operator[](
+		size_t idx /**< [in] Index, in order of recording. */
+		) const noexcept
+		{ return m_diagnostics[idx]; }
+
+	std::vector<diagnostic_t>::const_iterator begin(void) const noexcept
+		{ return m_diagnostics.begin(); }
+
+	std::vector<diagnostic_t>::const_iterator end(void) const noexcept
+		{ return m_diagnostics.end(); }
+
+private:
+	std::vector<diagnostic_t> m_diagnostics;
+};
+
+#endif // DIAGNOSTICS_HH
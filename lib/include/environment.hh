@@ -11,10 +11,33 @@
 class environment_t;
 
 #include "sbucket.hh"
+#include "file_loader.hh"
 
 class environment_t {
 public:
-	environment_t() = default;
+	/**
+	 * Constructor.
+	 * Use concurrent mode if the environment is shared by threads, e.g.
+	 * when tokenizing several files in parallel.
+	 */
+	explicit environment_t(
+		sbucket_mode_t mode = sbucket_mode_t::single_thread
+			/**< [in] Thread safety mode of the string bucket. */
+		)
+		: m_sbucket(mode) {}
+
+	/**
+	 * Constructor, warm starting the string bucket from an image.
+	 * @throws std::system_error if the image can not be used.
+	 * @seealso sbucket::save
+	 */
+	explicit environment_t(
+		const char *image_filename, /**< [in] String bucket image. */
+		sbucket_mode_t mode = sbucket_mode_t::single_thread
+			/**< [in] Thread safety mode of the string bucket. */
+		)
+		: m_sbucket(image_filename, mode) {}
+
 	~environment_t() = default;
 
 	class sbucket& sbucket() { return m_sbucket; }
@@ -22,9 +45,13 @@ public:
 
 	const size_t spaces_per_tab = 8;
 
-	// I guess move should using default
-	environment_t(environment_t &&) = default;
-	environment_t& operator=(environment_t &&) = default;
+	// How input files are loaded into memory
+	load_options_t load_options;
+
+	// Can not be moved, since the string bucket may be shared between
+	// threads
+	environment_t(environment_t &&) = delete;
+	environment_t& operator=(environment_t &&) = delete;
 
 	// Not sure how to handle copy yet
 	environment_t(const environment_t &) = delete;
@@ -10,16 +10,28 @@
 
 
 #include <exception>
+#include <string>
 
+#include "diagnostics.hh"
 #include "position.hh"
 #include "sbucket.hh"
 #include "environment.hh"
 
+/**
+ * Error in the input.
+ * The message is formatted when the exception is created, since the
+ * input file, needed to find line and column, is usually destructed
+ * while the exception propagates. Use diagnostics_t to record errors
+ * without formatting them.
+ */
 class parser_error : public std::exception {
 public:
 	parser_error(const position_t& token_start,
 		     const position_t& error_at, const std::string& msg);
 
+	parser_error(const position_t& token_start,
+		     const position_t& error_at, error_code_t code);
+
 	const char *what() const noexcept { return m_what.c_str(); }
 
 private:
@@ -0,0 +1,170 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef FILE_LOADER_HH
+#define FILE_LOADER_HH
+
+/**
+ * @file
+ * Loading whole files into memory.
+ * The cheapest way of getting a file into memory depends on its size.
+ * For small files, the system calls needed to map and unmap the file,
+ * and the page faults when touching it, cost more than copying the file
+ * into a buffer that is reused between files. Medium sized files are
+ * mapped and pre-faulted in one system call, and large files are mapped
+ * with a sequential access hint, or optionally copied into huge pages.
+ */
+
+#include <stddef.h>
+#include <array>
+#include <memory>
+#include "file.hh"
+
+/**
+ * Number of zero bytes following the contents of every loaded file.
+ */
+inline constexpr size_t load_padding = 32;
+
+/**
+ * How a file is loaded into memory.
+ */
+enum class load_strategy_t {
+	automatic,     /**< Select by file size, see load_options_t. */
+	read,          /**< pread() into a buffer reused between files. */
+	mmap,          /**< Memory map, with sequential access hint. */
+	mmap_populate, /**< Memory map and fault in all pages up front. */
+	huge_pages,    /**< Read into anonymous memory backed by
+			* transparent huge pages. */
+	nr_strategies  /**< Number of strategies, not a strategy. */
+};
+
+/**
+ * Number of load strategies, for sizing arrays indexed by strategy.
+ */
+inline constexpr size_t nr_load_strategies =
+	static_cast<size_t>(load_strategy_t::nr_strategies);
+
+/**
+ * Return name of a load strategy.
+ */
+const char *load_strategy_name(
+	load_strategy_t strategy /**< [in] Strategy. */
+	) noexcept;
+
+/**
+ * Options for selecting load strategy.
+ * With the automatic strategy, files up to read_limit bytes are read,
+ * files up to populate_limit bytes are mapped and pre-faulted, and larger
+ * files are mapped, or read into huge pages if huge_pages is set.
+ */
+struct load_options_t {
+	/** Strategy to use, automatic selects by file size. */
+	load_strategy_t strategy = load_strategy_t::automatic;
+
+	/** Largest file to read into a buffer. */
+	size_t read_limit = 64 * 1024;
+
+	/** Largest file to map with MAP_POPULATE. */
+	size_t populate_limit = 16 * 1024 * 1024;
+
+	/** Read files larger than populate_limit into huge pages. */
+	bool huge_pages = false;
+};
+
+/**
+ * Counters telling which strategies have been used.
+ * Counted over all threads since the process started.
+ */
+struct load_counters_t {
+	/** Number of files loaded, indexed by load_strategy_t. */
+	std::array<size_t, nr_load_strategies> nr_files;
+
+	/** Number of bytes loaded, indexed by load_strategy_t. */
+	std::array<size_t, nr_load_strategies> nr_bytes;
+
+	/** Number of times a read buffer was reused instead of allocated. */
+	size_t nr_buffer_reuses;
+};
+
+/**
+ * Whole file loaded into memory.
+ * The file contents are available, read-only, until the object is
+ * destructed. The contents are followed by load_padding zero bytes,
+ * whatever strategy was used.
+ */
+class file_loader_t {
+public:
+	/**
+	 * Load file.
+	 * @throws std::system_error if the file can not be opened or read.
+	 */
+	file_loader_t(
+		const char *name,             /**< [in] Path to file. */
+		const load_options_t& options /**< [in] Strategy selection. */
+		);
+
+	/**
+	 * Destructor.
+	 * Read buffers are kept for reuse by later loads in the same
+	 * thread.
+	 */
+	~file_loader_t();
+
+	/**
+	 * Return file contents, followed by load_padding zero bytes.
+	 */
+	constexpr const char *data(void) const noexcept
+		{ return m_data; }
+
+	/**
+	 * Return file size.
+	 */
+	constexpr size_t size(void) const noexcept
+		{ return m_size; }
+
+	/**
+	 * Return strategy used to load the file, never automatic.
+	 */
+	constexpr load_strategy_t strategy(void) const noexcept
+		{ return m_strategy; }
+
+	/**
+	 * Return counters for all loads so far.
+	 */
+	static load_counters_t counters(void) noexcept;
+
+	// Forbidden methods
+	file_loader_t() = delete;
+	file_loader_t(const file_loader_t&) = delete;
+	file_loader_t& operator=(const file_loader_t&) = delete;
+
+private:
+	// Load using a specific strategy.
+	void load_read(void);
+	void load_mmap(int flags);
+	void load_huge_pages(void);
+
+	// Read whole file into memory at dest.
+	void pread_all(char *dest);
+
+	const file_t m_file;
+	load_strategy_t m_strategy;
+	size_t m_size;
+
+	// File contents.
+	const char *m_data;
+
+	// Read buffer and its capacity, returned to the buffer cache of
+	// the thread when destructed.
+	std::unique_ptr<char[]> m_buffer;
+	size_t m_capacity;
+
+	// Mapping to unmap, the file mapping or the anonymous huge page
+	// mapping.
+	void *m_mapping;
+	size_t m_mapping_length;
+};
+
+#endif // FILE_LOADER_HH
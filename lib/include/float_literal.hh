@@ -0,0 +1,124 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef FLOAT_LITERAL_HH
+#define FLOAT_LITERAL_HH
+
+/**
+ * @file
+ * Floating point literals.
+ * A floating point literal is stored exactly, as the digits of the
+ * literal with the decimal point removed, and the number of digits
+ * after the decimal point. Conversion into a floating point type is only
+ * done when the value is asked for.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "multiprecision.hh"
+
+/**
+ * Exact floating point literal.
+ * The value of the literal is mantissa * base ^ -nr_decimals, where
+ * mantissa is the literal digits with the decimal point removed.
+ * Mantissas fitting in 64 bits are stored without allocating memory.
+ */
+class float_literal_t {
+public:
+	/**
+	 * Construct a literal with a mantissa fitting in 64 bits.
+	 */
+	float_literal_t(
+		unsigned base,      /**< [in] Base, one of 2, 8, 10 or 16. */
+		uint64_t mantissa,  /**< [in] All digits as an integer. */
+		size_t nr_digits,   /**< [in] Total number of digits. */
+		size_t nr_decimals  /**< [in] Number of digits after the
+				     * decimal point. */
+		) noexcept
+		: m_mantissa(mantissa), m_big_mantissa(), m_nr_digits(nr_digits),
+		  m_nr_decimals(nr_decimals), m_base(static_cast<uint8_t>(base)),
+		  m_small(true) {}
+
+	/**
+	 * Construct a literal with a mantissa not fitting in 64 bits.
+	 */
+	float_literal_t(
+		unsigned base,         /**< [in] Base, one of 2, 8, 10 or
+					* 16. */
+		const mp_int& mantissa,/**< [in] All digits as an integer. */
+		size_t nr_digits,      /**< [in] Total number of digits. */
+		size_t nr_decimals     /**< [in] Number of digits after the
+					* decimal point. */
+		)
+		: m_mantissa(0), m_big_mantissa(mantissa), m_nr_digits(nr_digits),
+		  m_nr_decimals(nr_decimals), m_base(static_cast<uint8_t>(base)),
+		  m_small(false) {}
+
+	/**
+	 * Return base of the literal.
+	 */
+	constexpr unsigned base(void) const noexcept
+		{ return m_base; }
+
+	/**
+	 * Return total number of digits in the literal.
+	 */
+	constexpr size_t nr_digits(void) const noexcept
+		{ return m_nr_digits; }
+
+	/**
+	 * Return number of digits after the decimal point.
+	 */
+	constexpr size_t nr_decimals(void) const noexcept
+		{ return m_nr_decimals; }
+
+	/**
+	 * Return mantissa, i.e. all digits as an integer.
+	 */
+	mp_int mantissa(void) const
+		{ return m_small ? mp_int(m_mantissa) : m_big_mantissa; }
+
+	/**
+	 * Convert to double.
+	 * The result is correctly rounded, i.e. it is the double closest to
+	 * the exact value of the literal, ties rounded to even. Values too
+	 * large for a double become infinity.
+	 * @par
+	 * Decimal literals with a mantissa fitting in 64 bits are converted
+	 * using the Eisel-Lemire algorithm, other decimal literals using
+	 * strtod(). Literals in power of two bases are converted by
+	 * shifting the mantissa.
+	 */
+	double to_double(void) const;
+
+	/**
+	 * Convert to multi-precision float.
+	 * Precision is set to fit all digits of the literal, plus ten guard
+	 * digits so that the value is correct to well within one unit of
+	 * the last digit of the literal.
+	 */
+	mp_float to_mp_float(void) const;
+
+private:
+	uint64_t m_mantissa;
+	mp_int m_big_mantissa;
+	size_t m_nr_digits;
+	size_t m_nr_decimals;
+	uint8_t m_base;
+	bool m_small;
+};
+
+/**
+ * Convert decimal mantissa and exponent to double.
+ * Calculates w * 10 ^ q, correctly rounded, using the Eisel-Lemire
+ * algorithm. Exposed for testing.
+ * @returns The double closest to w * 10 ^ q.
+ */
+double decimal_to_double(
+	uint64_t w, /**< [in] Decimal mantissa. */
+	int64_t q   /**< [in] Decimal exponent. */
+	) noexcept;
+
+#endif // FLOAT_LITERAL_HH
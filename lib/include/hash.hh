@@ -1,7 +1,14 @@
 /*
   This file contains hash functions for hashing short strings.
-  The algorithm is Bob Jenkin's one-at-a-time hash, which produces good
-  hash values for short strings.
+
+  The string hash is a word-at-a-time hash in the style of wyhash: eight
+  bytes at a time are mixed into the state using a 64x64->128 bit
+  multiplication, folding the high half into the low half. It can be
+  calculated incrementally using hasher_t, or in one go using
+  hash_bytes(), both giving the same hash value.
+
+  Bob Jenkin's one-at-a-time hash is still available through hash_next()
+  and hash_finish() for callers hashing one character at a time.
 
   SPDX-License-Identifier: MIT
   */
@@ -9,10 +16,167 @@
 #ifndef HASH_H
 #define HASH_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 typedef uint32_t hash_t;
 
+// Constants from wyhash
+static constexpr uint64_t hash_secret0 = 0xa0761d6478bd642full;
+static constexpr uint64_t hash_secret1 = 0xe7037ed1a0b428dbull;
+static constexpr uint64_t hash_secret2 = 0x8ebc6af09c88c6e3ull;
+static constexpr uint64_t hash_seed = 0x589965cc75374cc3ull;
+
+// Multiply and fold high half into low half
+static inline uint64_t hash_mum(uint64_t a, uint64_t b)
+{
+	const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+	return static_cast<uint64_t>(product) ^
+		static_cast<uint64_t>(product >> 64);
+}
+
+// Load 8 bytes as a little-endian word, so that hash values do not
+// depend on the byte order of the machine
+static inline uint64_t hash_load64(const char *data)
+{
+	uint64_t word;
+	memcpy(&word, data, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	word = __builtin_bswap64(word);
+#endif
+	return word;
+}
+
+// Load 4 bytes as a little-endian word
+static inline uint64_t hash_load32(const char *data)
+{
+	uint32_t word;
+	memcpy(&word, data, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	word = __builtin_bswap32(word);
+#endif
+	return word;
+}
+
+// Load less than 8 bytes as a little-endian word, zero extended. Uses
+// overlapping loads instead of a loop over the bytes.
+static inline uint64_t hash_load_tail(const char *data, size_t len)
+{
+	if (len >= 4)
+		return hash_load32(data) |
+			(hash_load32(data + len - 4) << (8 * (len - 4)));
+	if (len == 0)
+		return 0;
+
+	const auto byte = [data](size_t idx) {
+		return static_cast<uint64_t>(static_cast<unsigned char>(data[idx]));
+	};
+	return byte(0) | (byte(len / 2) << (8 * (len / 2))) |
+		(byte(len - 1) << (8 * (len - 1)));
+}
+
+// Mix one word into the hash state
+static inline uint64_t hash_word(uint64_t state, uint64_t word)
+{
+	return hash_mum(word ^ hash_secret0, state ^ hash_secret1);
+}
+
+// Mix the last partial word and the length, and fold into a hash_t
+static inline hash_t hash_final(uint64_t state, uint64_t tail, uint64_t len)
+{
+	const uint64_t result = hash_mum(state ^ len ^ hash_secret2,
+					 tail ^ hash_secret1);
+	return static_cast<hash_t>(result ^ (result >> 32));
+}
+
+/**
+ * Hash a string in one go.
+ * @returns Same hash value as hasher_t would for the same bytes.
+ */
+static inline hash_t hash_bytes(
+	const char *data, /**< [in] Bytes to hash. */
+	size_t len,       /**< [in] Number of bytes. */
+	uint64_t seed = hash_seed /**< [in] Initial state. */
+	)
+{
+	uint64_t state = seed;
+	size_t left = len;
+
+	for (; left >= 8; left -= 8, data += 8)
+		state = hash_word(state, hash_load64(data));
+
+	// If at least one full word was hashed, the last partial word can be
+	// loaded together with already hashed bytes and shifted down
+	uint64_t tail;
+	if ((left > 0) && (len >= 8))
+		tail = hash_load64(data + left - 8) >> (8 * (8 - left));
+	else
+		tail = hash_load_tail(data, left);
+
+	return hash_final(state, tail, len);
+}
+
+/**
+ * Incremental string hash.
+ * Bytes can be added in any number of update() calls, and the resulting
+ * hash value is the same as hash_bytes() gives for all bytes at once.
+ * This allows hashing strings spanning several input buffers.
+ */
+class hasher_t {
+public:
+	/**
+	 * Start a new hash.
+	 */
+	explicit constexpr hasher_t(
+		uint64_t seed = hash_seed /**< [in] Initial state. */
+		) noexcept
+		: m_state(seed), m_tail(0), m_length(0) {}
+
+	/**
+	 * Add bytes to the hash.
+	 */
+	void update(
+		const char *data, /**< [in] Bytes to add. */
+		size_t len        /**< [in] Number of bytes. */
+		) noexcept
+		{
+			size_t nr_tail = m_length & 7;
+			m_length += len;
+
+			// Complete a partial word from a previous call
+			if (nr_tail > 0) {
+				for (; (nr_tail < 8) && (len > 0); nr_tail++, len--)
+					m_tail |= static_cast<uint64_t>(
+						static_cast<unsigned char>(*data++))
+						<< (8 * nr_tail);
+				if (nr_tail < 8)
+					return;
+				m_state = hash_word(m_state, m_tail);
+				m_tail = 0;
+			}
+
+			for (; len >= 8; len -= 8, data += 8)
+				m_state = hash_word(m_state, hash_load64(data));
+
+			m_tail = hash_load_tail(data, len);
+		}
+
+	/**
+	 * Return hash of all bytes added so far.
+	 */
+	hash_t finish(void) const noexcept
+		{ return hash_final(m_state, m_tail, m_length); }
+
+private:
+	uint64_t m_state;  // Mixed full words
+	uint64_t m_tail;   // Bytes of last partial word
+	uint64_t m_length; // Total number of bytes
+};
+
+/**
+ * One-at-a-time hash, add a character.
+ */
 static inline hash_t hash_next(char chr, hash_t hash)
 {
 	hash += (hash_t) chr;
@@ -21,15 +185,21 @@ static inline hash_t hash_next(char chr, hash_t hash)
 	return hash;
 }
 
+/**
+ * Add a value to a hash.
+ * The bytes of the value are mixed a word at a time, with the hash so
+ * far as seed.
+ */
 template <typename T>
 static inline hash_t hash_next(T data, hash_t hash)
 {
-	const char * const byte = reinterpret_cast<const char*>(&data);
-	for (size_t idx = 0; idx < sizeof(T); idx++)
-		hash = hash_next(byte[idx], hash);
-	return hash;
+	return hash_bytes(reinterpret_cast<const char*>(&data), sizeof(T),
+			  hash_seed ^ hash);
 }
 
+/**
+ * One-at-a-time hash, final avalanche.
+ */
 static inline hash_t hash_finish(hash_t hash)
 {
 	hash += (hash << 3);
@@ -0,0 +1,201 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef INCREMENTAL_HH
+#define INCREMENTAL_HH
+
+/**
+ * @file
+ * Incremental token scanner.
+ * Keeps the token stream of a text that is being edited, e.g. in an
+ * editor, and updates it after each edit by scanning only the lines
+ * affected by the edit.
+ */
+
+#include <stddef.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "environment.hh"
+#include "token.hh"
+
+/**
+ * Incremental token scanner.
+ * Tokens are the same as tokenizer_t gives when scanning the whole text,
+ * except that literal table indexes of big_integer and floating tokens
+ * refer to the tables of this object.
+ * @par
+ * After an edit, scanning restarts at the last end of line token before
+ * the edit, and stops at the first end of line token after the edit
+ * which has the same offset, relative to the end of the edit, and
+ * indentation as an end of line token of the previous token stream.
+ * Scanning is then in the same state as it was for the previous text,
+ * so the rest of the previous tokens are kept, with offsets adjusted by
+ * the size change of the edit.
+ * @par
+ * Tokens are stored in blocks, each with its own base offset, so that
+ * adjusting offsets and splicing in new tokens only depend on the number
+ * of blocks and the size of the scanned part, not the number of tokens.
+ */
+class incremental_tokenizer_t {
+public:
+	/**
+	 * Tokens replaced by an update.
+	 * Tokens [first, first + nr_removed) of the previous token stream
+	 * were replaced by tokens [first, first + nr_inserted) of the new
+	 * token stream.
+	 */
+	struct change_t {
+		size_t first;       /**< Index of first replaced token. */
+		size_t nr_removed;  /**< Number of previous tokens replaced. */
+		size_t nr_inserted; /**< Number of new tokens. */
+	};
+
+	/**
+	 * Constructor.
+	 * The token stream is empty, as for an empty text. Scan the initial
+	 * text by calling update() with an edit inserting all of it.
+	 */
+	incremental_tokenizer_t(
+		environment_t& env, /**< [in] Environment, whose string bucket
+				     * is used for string indexes. */
+		const char *name    /**< [in] Name to use in positions of
+				     * errors, e.g. the path of the edited
+				     * file. */
+		);
+
+	/**
+	 * Destructor.
+	 */
+	~incremental_tokenizer_t();
+
+	// Forbidden methods
+	incremental_tokenizer_t(const incremental_tokenizer_t&) = delete;
+	incremental_tokenizer_t& operator=(const incremental_tokenizer_t&) = delete;
+
+	/**
+	 * Update token stream after an edit.
+	 * The edit replaced removed bytes at offset of the previous text
+	 * with inserted bytes, giving text.
+	 * @par
+	 * If the text can not be scanned, the exception from the scanner is
+	 * thrown and the token stream is not changed. The edit is then
+	 * remembered, and scanned together with the edit of the next
+	 * update, so later edits are still given relative to the text
+	 * passed to the last update.
+	 *
+	 * @returns Tokens that were replaced.
+	 * @throws parser_error if text is not valid.
+	 * @throws std::system_error if the edit is not consistent with the
+	 *         size of the text.
+	 */
+	change_t update(
+		std::string_view text, /**< [in] Text after the edit, only used
+					* during the call. */
+		size_t offset,         /**< [in] Start of the edit. */
+		size_t removed,        /**< [in] Number of bytes removed from
+					* the previous text. */
+		size_t inserted        /**< [in] Number of bytes inserted
+					* instead. */
+		);
+
+	/**
+	 * Return identity used in positions of errors. It is the same for
+	 * all updates.
+	 */
+	file_id_t id(void) const noexcept
+		{ return m_id; }
+
+	/**
+	 * Return number of tokens.
+	 */
+	size_t size(void) const noexcept
+		{ return m_nr_tokens; }
+
+	/**
+	 * Return a token.
+	 */
+	compact_token_t operator[](
+		size_t idx /**< [in] Token index, must be less than size(). */
+		) const;
+
+	/**
+	 * Return all tokens.
+	 */
+	std::vector<compact_token_t> tokens(void) const;
+
+	/**
+	 * Return integer literal of a token.
+	 * @seealso tokenizer_t::integer
+	 */
+	mp_int integer(
+		const compact_token_t& token /**< [in] Integer token. */
+		) const
+		{
+			if (token.kind == token_kind_t::integer)
+				return mp_int(token.value);
+			return m_integers[token.value];
+		}
+
+	/**
+	 * Return floating point literal of a token.
+	 * @seealso tokenizer_t::floating
+	 */
+	const float_literal_t& floating(
+		const compact_token_t& token /**< [in] Floating point token. */
+		) const
+		{ return m_floats[token.value]; }
+
+	/**
+	 * Return number of bytes scanned by the last successful update.
+	 */
+	size_t nr_scanned(void) const noexcept
+		{ return m_nr_scanned; }
+
+private:
+	// Tokens with offsets relative to base, which is the offset of the
+	// first token.
+	struct block_t {
+		size_t first;  // Index of first token
+		size_t base;
+		std::vector<compact_token_t> tokens;
+	};
+
+	// Position of a token in the blocks.
+	struct cursor_t {
+		size_t block;
+		size_t idx;
+	};
+
+	cursor_t find(size_t token_idx) const;
+	size_t restart_token(size_t offset) const;
+	void splice(size_t first, size_t nr_removed,
+		    const std::vector<compact_token_t>& tokens, size_t delta);
+
+	environment_t& m_env;
+
+	// Identity of the inputs of all updates.
+	const file_id_t m_id;
+
+	std::vector<block_t> m_blocks;
+	size_t m_nr_tokens;
+
+	// Size of the text of the current token stream.
+	size_t m_size;
+
+	// Edit not yet scanned, since the text had errors.
+	bool m_pending;
+	size_t m_pending_offset;
+	size_t m_pending_removed;
+	size_t m_pending_inserted;
+
+	size_t m_nr_scanned;
+
+	// Literal tables. Entries of replaced tokens are not reused.
+	std::vector<mp_int> m_integers;
+	std::vector<float_literal_t> m_floats;
+};
+
+#endif // INCREMENTAL_HH
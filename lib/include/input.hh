@@ -0,0 +1,593 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef INPUT_HH
+#define INPUT_HH
+
+/**
+ * @file
+ * Input source for the token parser.
+ * The token parser reads its input through input_t, which provides a
+ * window of contiguous bytes and scanning primitives working on it.
+ * Inputs either have all their contents in the window from the start,
+ * like mmap_file_t, or refill the window as it is consumed, like
+ * stream_file_t.
+ */
+
+#include "char_class.hh"
+#include "sbucket.hh"
+#include "environment.hh"
+#include "position.hh"
+#include "utf8.hh"
+#include <stdint.h>
+#include <string_view>
+#include <vector>
+
+/**
+ * Number of zero bytes following the window of every input.
+ * The first of them is a sentinel, letting scanning loops find end of
+ * window by the '\0' character they stop at anyway, rather than by
+ * checking bounds for each byte. The rest allow reading a machine word
+ * at any position in the window.
+ */
+inline constexpr size_t input_padding = 32;
+
+/**
+ * Input source.
+ * Bytes are read from a window, [data(), data() + remaining()). When the
+ * window has been consumed, the scanning methods call refill() to make
+ * more bytes available, so callers do not need to know whether the whole
+ * input is in memory.
+ * @par
+ * Refilling may move the window. Bytes from the current position, and
+ * from the marker if one has been started, are always kept, so pointers
+ * returned by data() and views returned by marker_end() are valid until
+ * the next call to a method that may refill. For inputs having all
+ * contents in the window, they are valid as long as the input object is.
+ * @par
+ * The window is always followed by input_padding zero bytes, also when
+ * empty. Inputs must keep them zero when refilling.
+ * @par
+ * Input is UTF-8. Bytes are validated as they are added to the window,
+ * see validate_window(), and the offsets of invalid sequences are made
+ * available through invalid_utf8(). Scanning works on bytes, so it is up
+ * to the caller to check for invalid sequences in what it has scanned.
+ * @todo Should use Unicode characters rather than bytes.
+ */
+class input_t {
+public:
+	/**
+	 * Destructor.
+	 * Positions referring to this input can still be printed after
+	 * destruction, but will no longer provide line and column.
+	 */
+	virtual ~input_t();
+
+	/**
+	 * Peek at current character.
+	 * @returns Current character, or '\0' if end of input.
+	 * @todo Should return a Unicode 32-bit character, uchar32_t.
+	 */
+	char peek(void)
+		{
+			// Bounds only need checking at a '\0' character, which
+			// the window is followed by
+			const char ch = *m_buff;
+			return ((ch != '\0') || (m_buff < m_end)) ? ch : peek_refill(0);
+		}
+
+	/**
+	 * Peek at a character ahead of the current one.
+	 * @returns Character at given distance from current character, or
+	 *          '\0' if past end of input.
+	 */
+	char peek(
+		size_t ahead /**< [in] Distance from current character,
+			      * 0 is the current character. */
+		)
+		{ return (ahead < remaining()) ? m_buff[ahead] : peek_refill(ahead); }
+
+	/**
+	 * Get pointer to current character.
+	 * Allows scanning several characters at a time, use remaining() to
+	 * find out how many characters that can be read.
+	 * @returns Pointer to current character.
+	 */
+	constexpr const char *data(void) const noexcept
+		{ return m_buff; }
+
+	/**
+	 * Get number of characters left in the window.
+	 * For inputs refilling the window, there may be more characters
+	 * after these.
+	 * @returns Number of bytes from current position to end of window.
+	 */
+	constexpr size_t remaining(void) const noexcept
+		{ return static_cast<size_t>(m_end - m_buff); }
+
+	/**
+	 * Return end of input status.
+	 * Refills the window if it has been consumed.
+	 * @returns true if no more characters can be read, false otherwise.
+	 */
+	bool eof(void)
+		{ return (m_buff >= m_end) && !refill(); }
+
+	/**
+	 * Skip until a non-matching character.
+	 * Skip will stop when either a character not matching skip_ch
+	 * is encountered, or until end of input.
+	 * @returns Number of bytes skipped.
+	 * @todo skip_ch should be of type uchar32_t.
+	 */
+	size_t skip(
+		char skip_ch /**< [in] Character to be skipped. */
+		);
+
+	/**
+	 * Skip until any character not in given string.
+	 * Skip will stop when either a character not matching any characters
+	 * in skip_str is encountered, or until end of input.
+	 * @returns Number of bytes skipped.
+	 * @todo skip_str should be of type uchar32_t*.
+	 */
+	size_t skip(
+		const char *skip_str /**< [in] Array of characters to be
+				      * skipped. */
+		)
+		{ return skip(char_class_t(skip_str)); }
+
+	/**
+	 * Skip until any character not in given character class.
+	 * Same as skip(const char*), but avoids building the character
+	 * class for each call.
+	 * @returns Number of bytes skipped.
+	 */
+	size_t skip(
+		const char_class_t& skip_class /**< [in] Characters to be
+						* skipped. */
+		);
+
+	/**
+	 * Skip until matching character.
+	 * Skip will stop when either a character matching until_ch is
+	 * encountered, or until end of input. Reaching end of input is not
+	 * an error, eof() tells whether the character was found.
+	 * @todo until_ch should be of type uchar32_t.
+	 */
+	void skip_until(
+		char until_ch /**< [in] Character to find. */
+		);
+
+	/**
+	 * Skip until matching any character in given character class.
+	 * Like skip_until(), reaching end of input is not an error.
+	 * @returns Number of bytes skipped.
+	 */
+	size_t skip_until_any(
+		const char_class_t& until_class /**< [in] Characters to be
+						 * found. */
+		);
+
+	/**
+	 * Skip until matching character, calculate hash for skipped characters.
+	 * The hash is calculated incrementally, so it does not matter if
+	 * the skipped characters span several refills. Skipping stops at
+	 * end of input, which is not an error, eof() tells whether the
+	 * character was found.
+	 * @returns Number of bytes skipped.
+	 * @todo Return string_idx_t of string being skipped. Remove hash
+	 *       parameter and marker_start() and marker_end().
+	 * @todo unil_ch should be of type uchar32_t.
+	 */
+	size_t skip_until_hashed(
+		char until_ch, /**< [in] Character to find. */
+		hash_t& hash   /**< [out] Hash of skipped characters. */
+		);
+
+	/**
+	 * Skip until matching any character in given string, calculate hash
+	 * for skipped characters.
+	 * @returns Number of bytes skipped.
+	 * @todo Return string_idx_t of string being skipped. Remove hash
+	 *       parameter and marker_start() and marker_end().
+	 * @todo until_str should be of type uchar32_t*.
+	 */
+	size_t skip_until_hashed(
+		const char* until_str, /**< [in] Array of characters to be
+					* found. */
+		hash_t& hash           /**< [out] Hash of skipped characters. */
+		)
+		{ return skip_until_hashed(char_class_t(until_str), hash); }
+
+	/**
+	 * Skip until matching any character in given character class,
+	 * calculate hash for skipped characters.
+	 * Same as skip_until_hashed(const char*, hash_t&), but avoids
+	 * building the character class for each call. As for the other
+	 * overloads, reaching end of input is not an error.
+	 * @returns Number of bytes skipped.
+	 */
+	size_t skip_until_hashed(
+		const char_class_t& until_class, /**< [in] Characters to be
+						  * found. */
+		hash_t& hash                     /**< [out] Hash of skipped
+						  * characters. */
+		);
+
+	/**
+	 * Skip a single character.
+	 * Refills the window if it has been consumed. Does nothing at end of
+	 * input.
+	 */
+	void skip(void)
+		{
+			if ((m_buff < m_end) || refill())
+				m_buff++;
+		}
+
+	/**
+	 * Skip a number of characters.
+	 * Intended to be used together with data() and remaining().
+	 */
+	void skip_bytes(
+		size_t nr /**< [in] Number of bytes to skip, must not be
+			   * larger than remaining(). */
+		)
+		{ m_buff += nr; }
+
+	/**
+	 * Get current input position.
+	 * @returns Copy of a position_t object containing the current input
+	 *          position.
+	 * @seealso position_t
+	 */
+	constexpr const position_t get_position(void) const noexcept
+		{ return position_t(m_id, offset()); }
+
+	/**
+	 * Get input position for a byte offset.
+	 * Intended for finding the position of an already scanned token,
+	 * e.g. from a compact_token_t.
+	 * @returns Copy of a position_t object for the given offset.
+	 * @seealso offset
+	 */
+	constexpr const position_t get_position(
+		size_t offset /**< [in] Byte offset from start of input. */
+		) const noexcept
+		{ return position_t(m_id, offset); }
+
+	/**
+	 * Get current byte offset.
+	 * @returns Number of bytes from start of input to current position.
+	 */
+	constexpr size_t offset(void) const noexcept
+		{ return m_window_offset + static_cast<size_t>(m_buff - m_window); }
+
+	/**
+	 * Get offset of the first invalid UTF-8 sequence not yet dropped.
+	 * Only bytes that have been in the window are validated, so
+	 * sequences beyond what has been scanned may not have been found
+	 * yet. A sequence left incomplete by end of input is found when
+	 * end of input is.
+	 * @returns Offset of the first byte of the sequence, or SIZE_MAX if
+	 *          no invalid sequence has been found.
+	 * @seealso drop_invalid_utf8
+	 */
+	size_t invalid_utf8(void) const noexcept
+		{
+			return (m_next_invalid < m_invalid.size())
+				? m_invalid[m_next_invalid] : SIZE_MAX;
+		}
+
+	/**
+	 * Drop invalid UTF-8 sequences that have been handled.
+	 */
+	void drop_invalid_utf8(
+		size_t end /**< [in] Drop sequences starting before this
+			    * offset. */
+		) noexcept
+		{
+			while ((m_next_invalid < m_invalid.size()) &&
+			       (m_invalid[m_next_invalid] < end))
+				m_next_invalid++;
+		}
+
+	/**
+	 * Calculate line and column for a byte offset.
+	 * Line and column both start from 1. Column is a count of Unicode
+	 * code points, with tab characters expanded according to the
+	 * environment.
+	 */
+	virtual void line_column(
+		size_t offset,  /**< [in] Byte offset from start of input. */
+		size_t& line,   /**< [out] Line number. */
+		size_t& column  /**< [out] Column number. */
+		) const = 0;
+
+	/**
+	 * Get text of the line containing a byte offset.
+	 * @returns The line without the line-feed character, or as much of
+	 *          it as the input still has available. The string is
+	 *          valid until the input is refilled.
+	 */
+	virtual std::string_view line_str(
+		size_t offset /**< [in] Byte offset from start of input. */
+		) const = 0;
+
+	/**
+	 * Return true if all contents are in the window, i.e. the input
+	 * never needs to be refilled.
+	 */
+	virtual bool in_memory(void) const noexcept = 0;
+
+	/**
+	 * Make all remaining contents available in the window, for inputs
+	 * that can do so without reading anything twice, e.g. by copying a
+	 * text that is already in memory.
+	 * @returns in_memory() after loading.
+	 */
+	virtual bool load_all(void)
+		{ return in_memory(); }
+
+	/**
+	 * Get identity of this input.
+	 * @returns Identity used by position_t to refer to this input.
+	 */
+	constexpr file_id_t id(void) const noexcept
+		{ return m_id; }
+
+	/**
+	 * Find input object given its identity.
+	 * @returns Pointer to the input object, or NULL if it has been
+	 *          destructed.
+	 */
+	static const input_t *find(
+		file_id_t id /**< [in] Input identity. */
+		);
+
+	/**
+	 * Number of destructed inputs kept before their identities are
+	 * reused.
+	 */
+	static constexpr size_t id_reuse_delay = 256;
+
+	/**
+	 * Get name of input given its identity.
+	 * @returns Pointer to a C string which is the name of the input,
+	 *          including path, valid for the life time of the program.
+	 *          The name is kept after the input object has been
+	 *          destructed, until its identity is reused by a new input,
+	 *          after which the name of the new input is returned. That
+	 *          happens at the earliest when id_reuse_delay more inputs
+	 *          have been destructed, so a position should not be kept
+	 *          much longer than its input.
+	 */
+	static const char *filename(
+		file_id_t id /**< [in] Input identity. */
+		);
+
+	/**
+	 * Get number of input identities in use.
+	 * @returns Number of identities of inputs alive, and of destructed
+	 *          inputs whose names are kept.
+	 */
+	static size_t nr_ids(void);
+
+	/**
+	 * Reserve an identity for inputs replacing each other, e.g. the
+	 * successive versions of an edited text. Inputs constructed with the
+	 * identity are found by find() while they exist, and the identity
+	 * is kept when they are destructed.
+	 * @returns Identity, to be released by release_id().
+	 */
+	static file_id_t reserve_id(
+		const char *name /**< [in] Name of the inputs. */
+		);
+
+	/**
+	 * Release an identity reserved by reserve_id().
+	 * No input using the identity may exist.
+	 */
+	static void release_id(
+		file_id_t id /**< [in] Reserved identity. */
+		);
+
+	/**
+	 * Get name of input.
+	 * @returns Pointer to a C string which is the name of the input,
+	 *          including path. This pointer is valid as long as the
+	 *          environment object given in the construtor is valid.
+	 * @todo Should return string_idx_t, when environment object has
+	 *       become thread local.
+	 */
+	const char * filename(void) const
+		{ return m_env.sbucket()[m_filename]; }
+
+	/**
+	 * Set starting position for the marker.
+	 * Bytes from the marker are kept in the window until marker_end() is
+	 * called.
+	 * @seealso marker_end
+	 * @todo Remove once skip_until_hashed() has been re-designed.
+	 */
+	void marker_start(void)
+		{ m_marker_start = m_buff; m_marker_open = true; }
+
+	/**
+	 * Creating string based on marker selection, and end the selection.
+	 * @note Must have used marker_start() to start the selection.
+	 * @returns String with characters starting at position when
+	 *          marker_start() was called, and ending at current
+	 *          position. The string refers to the window, and is valid
+	 *          until the input is refilled.
+	 * @seealso marker_start
+	 * @todo Remove once skip_until_hashed() has been re-designed.
+	 */
+	std::string_view marker_end(void) noexcept
+		{
+			m_marker_open = false;
+			return std::string_view(m_marker_start,
+						static_cast<size_t>(m_buff - m_marker_start));
+		}
+
+	// Having multiple references to the same input is not supported.
+	input_t(const input_t &) = delete;
+	input_t& operator=(const input_t &) = delete;
+
+protected:
+	/**
+	 * Constructor, used by inputs.
+	 * The window is initially empty, and set by the constructor of the
+	 * input.
+	 */
+	input_t(
+		environment_t &env, /**< [in] Environment object containing
+				     * string bucket where to store the
+				     * input name. */
+		const char *name    /**< [in] Name of input. This name will be
+				     * stored in the string bucket in the
+				     * environment object. */
+		);
+
+	/**
+	 * Constructor, used by inputs with an identity from reserve_id().
+	 * The name is taken from the identity.
+	 */
+	input_t(
+		environment_t &env, /**< [in] Environment object containing
+				     * string bucket where to store the
+				     * input name. */
+		file_id_t id        /**< [in] Reserved identity. */
+		);
+
+	/**
+	 * Constructor, used by views of another input.
+	 * The view has the same window, identity and name as the other
+	 * input, but its own current position.
+	 */
+	input_t(
+		const input_t& input, /**< [in] Input to view, must be in
+				       * memory. */
+		size_t offset         /**< [in] Start position of the view. */
+		);
+
+	/**
+	 * Make more bytes available at end of window.
+	 * Bytes from data(), and from the marker if started, must be kept.
+	 * The window may be moved, in which case m_window, m_buff, m_end
+	 * and m_marker_start must be updated to the new location, and
+	 * m_window_offset to the input offset of m_window.
+	 * @returns false if at end of input, true if bytes were added.
+	 */
+	virtual bool refill(void) = 0;
+
+	/**
+	 * Validate bytes added to the window.
+	 * Called by inputs after having set or refilled the window. Bytes
+	 * from the end of what has already been validated to the end of the
+	 * window are validated, and invalid sequences recorded.
+	 */
+	void validate_window(
+		bool at_end /**< [in] Whether the window ends at end of
+			     * input. */
+		);
+
+	/**
+	 * Return true if the marker has been started and not ended.
+	 */
+	constexpr bool marker_open(void) const noexcept
+		{ return m_marker_open; }
+
+	// Environment reference as given by constructor.
+	environment_t& m_env;
+
+	// Start of window, and input offset of it.
+	const char * m_window;
+	size_t m_window_offset;
+
+	// Current position.
+	const char * m_buff;
+
+	// First character past end of window.
+	const char * m_end;
+
+	// Position for last call to marker_start().
+	const char * m_marker_start;
+
+private:
+	// Refill until the character at given distance is available.
+	char peek_refill(size_t ahead);
+
+	// Hash all characters from current position up to given position,
+	// and then move current position there.
+	hash_t advance_hashed(const char *to);
+
+	// Input name, index to string bucket.
+	const string_idx_t m_filename;
+
+	// Identity used by position_t objects referring to this input.
+	const file_id_t m_id;
+
+	// Whether the identity was registered by this object, false for
+	// views and for reserved identities.
+	const bool m_registered;
+
+	// Whether find() returns this object, false for views.
+	const bool m_attached;
+
+	// Whether the marker selection is in progress.
+	bool m_marker_open;
+
+	// UTF-8 validation state, and offset of the first byte not yet
+	// validated.
+	utf8_validator_t m_validator;
+	size_t m_validated;
+
+	// Offsets of invalid UTF-8 sequences found, in increasing order, and
+	// index of the first one not yet dropped.
+	std::vector<size_t> m_invalid;
+	size_t m_next_invalid;
+};
+
+/**
+ * View of an in-memory input, starting at a given offset.
+ * Lets several scanners read the same input independently, e.g. to scan
+ * different parts of a file in parallel. Offsets and positions are the
+ * same as for the viewed input, which must outlive the view. Invalid
+ * UTF-8 sequences at or after the start of the view are those of the
+ * viewed input.
+ */
+class input_view_t : public input_t {
+public:
+	/**
+	 * Constructor.
+	 */
+	input_view_t(
+		const input_t& input, /**< [in] Input to view, must be in
+				       * memory. */
+		size_t offset         /**< [in] Start position of the view. */
+		)
+		: input_t(input, offset), m_input(input) {}
+
+	void line_column(size_t offset, size_t& line, size_t& column) const override
+		{ m_input.line_column(offset, line, column); }
+
+	std::string_view line_str(size_t offset) const override
+		{ return m_input.line_str(offset); }
+
+	bool in_memory(void) const noexcept override
+		{ return true; }
+
+protected:
+	// The viewed input is already in memory.
+	bool refill(void) override
+		{ return false; }
+
+private:
+	const input_t& m_input;
+};
+
+#endif // INPUT_HH
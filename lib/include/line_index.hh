@@ -0,0 +1,98 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef LINE_INDEX_HH
+#define LINE_INDEX_HH
+
+/**
+ * @file
+ * Line index for input files.
+ * The line index stores the byte offset where each line starts. It is
+ * built once per file, and then used to translate byte offsets into line
+ * numbers using a binary search, and line numbers into byte offsets
+ * using a table lookup.
+ */
+
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Offsets of line starts in a buffer.
+ * Lines are numbered from 1. Line 1 always starts at offset 0, and each
+ * line-feed character starts a new line. A buffer ending with a line-feed
+ * character therefore has an empty last line.
+ */
+class line_index_t {
+public:
+	/**
+	 * Construct an empty index, containing only line 1.
+	 */
+	line_index_t() : m_starts(1, 0) {}
+
+	/**
+	 * Build index for a buffer.
+	 * Line-feed characters are found using the same vector instruction
+	 * set as the character class scanning primitives.
+	 * @seealso char_class_t
+	 */
+	line_index_t(
+		const char *begin, /**< [in] Start of buffer. */
+		const char *end    /**< [in] First byte past the buffer. */
+		);
+
+	/**
+	 * Extend index with bytes following the already indexed ones.
+	 * Used for inputs that are read a block at a time, where the whole
+	 * input is never in memory at once. The index still grows by one
+	 * offset per line appended.
+	 */
+	void append(
+		const char *begin, /**< [in] Start of following bytes. */
+		const char *end    /**< [in] First byte past them. */
+		);
+
+	/**
+	 * Return number of lines.
+	 */
+	size_t nr_lines(void) const noexcept
+		{ return m_starts.size(); }
+
+	/**
+	 * Find line containing a byte offset.
+	 * @returns Line number, starting from 1.
+	 */
+	size_t line_of(
+		size_t offset /**< [in] Byte offset from start of buffer. */
+		) const noexcept;
+
+	/**
+	 * Return byte offset where a line starts.
+	 * @returns Offset of first byte in line, or offset past the buffer
+	 *          for a line past the last line.
+	 */
+	size_t line_start(
+		size_t line /**< [in] Line number, starting from 1. */
+		) const noexcept
+		{ return (line - 1 < m_starts.size()) ? m_starts[line - 1] : m_size; }
+
+	/**
+	 * Return byte offset where a line ends.
+	 * @returns Offset of the line-feed character ending the line, or
+	 *          size of the buffer for the last line.
+	 */
+	size_t line_end(
+		size_t line /**< [in] Line number, starting from 1. */
+		) const noexcept
+		{ return (line < m_starts.size()) ? m_starts[line] - 1 : m_size; }
+
+private:
+	// Offset of the first byte of each line, index 0 is line 1.
+	std::vector<size_t> m_starts;
+
+	// Size of the indexed buffer.
+	size_t m_size = 0;
+};
+
+#endif // LINE_INDEX_HH
@@ -0,0 +1,136 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef MEMORY_INPUT_HH
+#define MEMORY_INPUT_HH
+
+/**
+ * @file
+ * Input for the token parser from a caller owned buffer.
+ */
+
+#include "input.hh"
+#include "line_index.hh"
+#include "environment.hh"
+#include <memory>
+#include <mutex>
+#include <string_view>
+
+/**
+ * Read text that is already in memory, e.g. the buffer of an editor.
+ * The text must not be changed or freed while the input object exists.
+ * @par
+ * The caller's text is not followed by padding, so the window is a copy
+ * of it, refilled by copying chunk_size bytes at a time. Only the part
+ * of the text that is scanned is copied, which matters when scanning a
+ * few lines of a large text. Texts fitting in one chunk are in the
+ * window from the start, like mmap_file_t, and load_all() copies the
+ * rest of a larger text in one go.
+ */
+class memory_input_t : public input_t {
+public:
+	/**
+	 * Number of bytes copied into the window by each refill.
+	 */
+	static constexpr size_t chunk_size = 16 * 1024;
+
+	/**
+	 * Constructor.
+	 */
+	memory_input_t(
+		environment_t &env,    /**< [in] Environment object containing
+					* string bucket where to store the
+					* name. */
+		std::string_view text, /**< [in] Text to read. */
+		const char *name,      /**< [in] Name to use in positions, e.g.
+					* the path of the edited file. */
+		size_t start = 0       /**< [in] Offset where to start reading,
+					* must not be larger than the size of
+					* the text. */
+		);
+
+	/**
+	 * Constructor, for an input with an identity reserved by
+	 * input_t::reserve_id(). Used for successive versions of an edited
+	 * text, so that they do not each register an identity.
+	 */
+	memory_input_t(
+		environment_t &env,    /**< [in] Environment object containing
+					* string bucket where to store the
+					* name. */
+		std::string_view text, /**< [in] Text to read. */
+		file_id_t id,          /**< [in] Reserved identity, which also
+					* gives the name. */
+		size_t start = 0       /**< [in] Offset where to start reading,
+					* must not be larger than the size of
+					* the text. */
+		);
+
+	/**
+	 * Destructor.
+	 */
+	~memory_input_t() override = default;
+
+	/**
+	 * Calculate line and column for a byte offset.
+	 * The line index is built on first use.
+	 */
+	void line_column(
+		size_t offset,  /**< [in] Byte offset from start of text. */
+		size_t& line,   /**< [out] Line number. */
+		size_t& column  /**< [out] Column number. */
+		) const override;
+
+	/**
+	 * Get text of the line containing a byte offset.
+	 * @returns The line without its line break, valid as long as the
+	 *          text is.
+	 */
+	std::string_view line_str(
+		size_t offset /**< [in] Byte offset from start of text. */
+		) const override;
+
+	bool in_memory(void) const noexcept override
+		{
+			return m_window_offset +
+				static_cast<size_t>(m_end - m_window) == m_text.size();
+		}
+
+	/**
+	 * Copy the rest of the text into the window at once, rather than
+	 * chunk by chunk.
+	 */
+	bool load_all(void) override;
+
+protected:
+	// Copy the next chunk of the text into the window.
+	bool refill(void) override;
+
+private:
+	// Need parameters to construct this class.
+	memory_input_t() = delete;
+
+	// Text being read.
+	const std::string_view m_text;
+
+	// Window, and its size not counting the padding after it.
+	std::unique_ptr<char[]> m_buffer;
+	size_t m_capacity;
+
+	// Set the window to start at the given offset.
+	void start_at(size_t start);
+
+	// Copy text from offset start up to offset end into the window,
+	// keeping current position and marker.
+	void copy_window(size_t start, size_t end);
+
+	// Line index, built on first use.
+	mutable std::once_flag m_line_index_built;
+	mutable line_index_t m_line_index;
+
+	const line_index_t& line_index(void) const;
+};
+
+#endif // MEMORY_INPUT_HH
@@ -0,0 +1,274 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef METRICS_HH
+#define METRICS_HH
+
+/**
+ * @file
+ * Performance counters.
+ * Counters are kept per thread, so counting is a plain add to memory
+ * owned by the counting thread, without locking or atomic
+ * read-modify-write instructions. A snapshot sums the counters of all
+ * running threads, and of all threads that have exited.
+ * @par
+ * Counters are only compiled in when SISDEL_METRICS is defined, which
+ * the USE_METRICS CMake option does. Otherwise all counting functions
+ * are empty inline functions, and snapshots are all zeros.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+
+class sbucket;
+
+/**
+ * Counters.
+ */
+enum class metric_t : unsigned {
+	bytes_scanned,      /**< Bytes scanned by tokenizer_t. */
+	tokens_eol,         /**< Tokens given to callers of tokenizer_t, by
+			     * token_kind_t, in token_kind_t order. */
+	tokens_string,      /**< See tokens_eol. */
+	tokens_identifier,  /**< See tokens_eol. */
+	tokens_integer,     /**< See tokens_eol. */
+	tokens_big_integer, /**< See tokens_eol. */
+	tokens_floating,    /**< See tokens_eol. */
+	sbucket_hits,       /**< sbucket lookups finding the string. */
+	sbucket_misses,     /**< sbucket lookups adding the string. */
+	bytes_interned,     /**< Bytes of strings added to sbuckets. */
+	big_literals,       /**< Number literals that did not fit in 64 bits,
+			     * and were converted to GMP integers. */
+	float_conversions,  /**< Float literals converted to GMP floats. */
+	files_loaded,       /**< Files loaded by file_loader_t. */
+	bytes_loaded,       /**< Bytes loaded by file_loader_t. */
+	arena_chunks,       /**< Chunks allocated by arena_t. */
+	nr_metrics          /**< Number of counters. */
+};
+
+/**
+ * Phases that time is measured for.
+ * Time is summed over all threads, so with several threads, a phase can
+ * take more time than the wall clock time. Phases may nest, e.g. files
+ * are loaded while scanning.
+ */
+enum class phase_t : unsigned {
+	load,     /**< Loading files. */
+	cache,    /**< Looking up and saving token cache entries. */
+	scan,     /**< Scanning tokens. */
+	output,   /**< Writing results. */
+	nr_phases /**< Number of phases. */
+};
+
+/**
+ * Number of buckets of the probe length histogram. Bucket n counts
+ * lookups examining [2^n, 2^(n+1)) hash table slots, except the last
+ * one which counts all longer probe sequences.
+ */
+inline constexpr size_t nr_probe_buckets = 8;
+
+/**
+ * Sum of counters.
+ */
+struct metrics_snapshot_t {
+	/** Counters, indexed by metric_t. */
+	std::array<uint64_t, static_cast<size_t>(metric_t::nr_metrics)> counters{};
+	/** sbucket lookup probe length histogram. */
+	std::array<uint64_t, nr_probe_buckets> probes{};
+	/** Nanoseconds spent per phase, indexed by phase_t. */
+	std::array<uint64_t, static_cast<size_t>(phase_t::nr_phases)> phase_ns{};
+
+	/**
+	 * Return a counter.
+	 */
+	uint64_t operator[](
+		metric_t metric /**< [in] Counter. */
+		) const noexcept
+		{ return counters[static_cast<size_t>(metric)]; }
+};
+
+/**
+ * Output formats of metrics_print().
+ */
+enum class metrics_format_t {
+	text, /**< One counter per line. */
+	json  /**< One JSON object. */
+};
+
+/**
+ * Whether counters are compiled in.
+ */
+#ifdef SISDEL_METRICS
+inline constexpr bool metrics_enabled = true;
+#else
+inline constexpr bool metrics_enabled = false;
+#endif
+
+/**
+ * Return name of a counter, as used by metrics_print().
+ */
+const char *metric_name(
+	metric_t metric /**< [in] Counter. */
+	) noexcept;
+
+/**
+ * Return name of a phase, as used by metrics_print().
+ */
+const char *phase_name(
+	phase_t phase /**< [in] Phase. */
+	) noexcept;
+
+/**
+ * Sum counters of all threads.
+ * Counters of running threads are read while they may be counting, so
+ * the snapshot is only exact if no other thread is counting.
+ */
+metrics_snapshot_t metrics_snapshot(void);
+
+/**
+ * Print counters.
+ * If strings is given, its hash table statistics are printed as well,
+ * e.g. its load factor.
+ */
+void metrics_print(
+	std::ostream& os,                     /**< [in] Stream to print to. */
+	const metrics_snapshot_t& snapshot,   /**< [in] Counters. */
+	metrics_format_t format,              /**< [in] Output format. */
+	const sbucket *strings = nullptr      /**< [in] String bucket, or
+					       * nullptr. */
+	);
+
+#ifdef SISDEL_METRICS
+
+/**
+ * Counters of one thread.
+ * Only written by its own thread, and read by metrics_snapshot(). The
+ * counters are atomic only so that reading them from another thread is
+ * not a data race, they are updated by relaxed loads and stores.
+ */
+class metrics_thread_t {
+public:
+	metrics_thread_t();
+	~metrics_thread_t();
+
+	void add(size_t idx, uint64_t value) noexcept
+		{ inc(m_counters[idx], value); }
+
+	void probe(uint32_t probes) noexcept
+		{
+			const size_t bucket = (probes == 0) ? 0 : std::min<size_t>(
+				31 - static_cast<size_t>(__builtin_clz(probes)),
+				nr_probe_buckets - 1);
+			inc(m_probes[bucket], 1);
+		}
+
+	void phase(size_t idx, uint64_t ns) noexcept
+		{ inc(m_phase_ns[idx], ns); }
+
+	// Add counters to a snapshot.
+	void collect(metrics_snapshot_t& snapshot) const noexcept;
+
+	metrics_thread_t(const metrics_thread_t&) = delete;
+	metrics_thread_t& operator=(const metrics_thread_t&) = delete;
+
+private:
+	static void inc(std::atomic<uint64_t>& counter, uint64_t value) noexcept
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + value,
+				      std::memory_order_relaxed);
+		}
+
+	std::array<std::atomic<uint64_t>, static_cast<size_t>(metric_t::nr_metrics)> m_counters{};
+	std::array<std::atomic<uint64_t>, nr_probe_buckets> m_probes{};
+	std::array<std::atomic<uint64_t>, static_cast<size_t>(phase_t::nr_phases)> m_phase_ns{};
+};
+
+/**
+ * Return counters of the calling thread.
+ */
+inline metrics_thread_t& metrics_thread(void)
+{
+	static thread_local metrics_thread_t counters;
+	return counters;
+}
+
+#endif // SISDEL_METRICS
+
+/**
+ * Add to a counter.
+ */
+inline void metrics_add(
+	metric_t metric,   /**< [in] Counter. */
+	uint64_t value = 1 /**< [in] Value to add. */
+	) noexcept
+{
+#ifdef SISDEL_METRICS
+	metrics_thread().add(static_cast<size_t>(metric), value);
+#else
+	(void) metric;
+	(void) value;
+#endif
+}
+
+/**
+ * Count an sbucket lookup in the probe length histogram.
+ */
+inline void metrics_probe(
+	uint32_t probes /**< [in] Hash table slots examined. */
+	) noexcept
+{
+#ifdef SISDEL_METRICS
+	metrics_thread().probe(probes);
+#else
+	(void) probes;
+#endif
+}
+
+/**
+ * Measure time of a phase, from construction to destruction.
+ */
+class metrics_timer_t {
+public:
+	/**
+	 * Start measuring.
+	 */
+	explicit metrics_timer_t(
+		phase_t phase /**< [in] Phase to add the time to. */
+		) noexcept
+#ifdef SISDEL_METRICS
+		: m_phase(phase), m_start(std::chrono::steady_clock::now()) {}
+#else
+		{ (void) phase; }
+#endif
+
+	/**
+	 * Stop measuring, adding the time to the phase.
+	 */
+	~metrics_timer_t()
+		{
+#ifdef SISDEL_METRICS
+			const auto elapsed = std::chrono::steady_clock::now() - m_start;
+			metrics_thread().phase(static_cast<size_t>(m_phase),
+				static_cast<uint64_t>(std::chrono::duration_cast<
+					std::chrono::nanoseconds>(elapsed).count()));
+#endif
+		}
+
+	metrics_timer_t(const metrics_timer_t&) = delete;
+	metrics_timer_t& operator=(const metrics_timer_t&) = delete;
+
+#ifdef SISDEL_METRICS
+private:
+	const phase_t m_phase;
+	const std::chrono::steady_clock::time_point m_start;
+#endif
+};
+
+#endif // METRICS_HH
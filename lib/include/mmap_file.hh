@@ -9,33 +9,34 @@
 /**
  * @file
  * Memory mapped file for the token parser.
- * @todo The public part of the class interface should be made into a base
- *       class which mmap_file_t then inherits from. Then a cstream-class
- *       could be implemented to allow really big files and piping from
- *       cin.
  */
 
-#include "file.hh"
-#include "sbucket.hh"
+#include "file_loader.hh"
+#include "input.hh"
+#include "line_index.hh"
 #include "environment.hh"
 #include "error.hh"
 #include "position.hh"
-
-class position_t;
+#include <mutex>
+#include <string_view>
 
 /**
- * Read a memory mapped file.
- * The file reader only supports streamed reading to make it possible to
- * implement true stream reading file reader in the future.
- * Memory mapped file is used for sake of performance, but the tradeoff is
- * harder to support large files and lack of possibility to read from
- * cin.
+ * Read a file loaded into memory as a whole.
+ * The whole file is in the window from the start, so the input is never
+ * refilled, and strings referring to the file contents are valid as long
+ * as the file object is.
+ * The file is memory mapped or read into a buffer, depending on its size
+ * and the load options of the environment, see file_loader_t. Having
+ * the whole file in memory is used for sake of performance, but the
+ * tradeoff is harder to support large files and lack of possibility to
+ * read from pipes. Use stream_file_t for those.
  * @todo Should use Unicode characters rather than bytes.
  */
-class mmap_file_t {
+class mmap_file_t : public input_t {
 public:
 	/**
 	 * Constructor.
+	 * Loads the file using the load options of the environment.
 	 */
 	mmap_file_t(
 		environment_t &env, /**< [in] Environment object containing
@@ -47,130 +48,49 @@ public:
 		);
 
 	/**
-	 * Move assignment operator.
+	 * Destructor.
 	 */
-	mmap_file_t& operator=(
-		mmap_file_t &&from /**< [in] Object to transfer information
-				    * from. */
-		);
+	~mmap_file_t() override = default;
 
 	/**
-	 * Peek at current character.
-	 * @returns Current character, or '\0' if end of file.
-	 * @todo Should return a Unicode 32-bit character, uchar32_t.
+	 * Calculate line and column for a byte offset.
+	 * @note The line index is built on first call.
 	 */
-	constexpr char peek(void) const noexcept
-		{ return eof() ? '\0' : *m_buff; }
+	void line_column(
+		size_t offset,  /**< [in] Byte offset from start of file. */
+		size_t& line,   /**< [out] Line number. */
+		size_t& column  /**< [out] Column number. */
+		) const override;
 
 	/**
-	 * Return end of file status.
-	 * @returns true if no more characters can be read, false otherwise.
+	 * Get text of the line containing a byte offset.
+	 * @returns The line without the line-feed character. The string is
+	 *          valid as long as this object is.
 	 */
-	constexpr bool eof(void) const noexcept
-		{ return m_buff >= m_end; }
+	std::string_view line_str(
+		size_t offset /**< [in] Byte offset from start of file. */
+		) const override;
 
-	/**
-	 * Skip until a non-matching character.
-	 * Skip will stop when either a character not matching skip_ch
-	 * is encountered, or until end of file.
-	 * @returns Number of bytes skipped.
-	 * @todo skip_ch should be of type uchar32_t.
-	 */
-	size_t skip(
-		char skip_ch /**< [in] Character to be skipped. */
-		);
+	bool in_memory(void) const noexcept override
+		{ return true; }
 
 	/**
-	 * Skip until any character not in given string.
-	 * Skip will stop when either a character not matching any characters
-	 * in skip_str is encountered, or until end of file.
-	 * @returns Number of bytes skipped.
-	 * @todo skip_str should be of type uchar32_t*.
+	 * Return strategy used to load the file.
 	 */
-	size_t skip(
-		const char *skip_str /**< [in] Array of characters to be
-				      * skipped. */
-		);
+	load_strategy_t load_strategy(void) const noexcept
+		{ return m_map.strategy(); }
 
 	/**
-	 * Skip until matching character.
-	 * Skip will stop when either a character matching until_ch is
-	 * encountered, or until end of file.
-	 * @todo until_ch should be of type uchar32_t.
+	 * Get line index for this file.
+	 * The index is built on first call, which scans the whole file.
+	 * @returns Line index, valid as long as this object is.
 	 */
-	void skip_until(
-		char until_ch /**< [in] Character to find. */
-		);
+	const line_index_t& line_index(void) const;
 
-	/**
-	 * Skip until matching character, calculate hash for skipped characters.
-	 * @returns Number of bytes skipped.
-	 * @todo Return string_idx_t of string being skipped. Remove hash
-	 *       parameter and marker_start() and marker_end(). This will make
-	 *       a stream implementation easier.
-	 * @todo unil_ch should be of type uchar32_t.
-	 */
-	size_t skip_until_hashed(
-		char until_ch, /**< [in] Character to find. */
-		hash_t& hash   /**< [out] Hash of skipped characters. */
-		);
-
-	/**
-	 * Skip until matching any character in given string, calculate hash
-	 * for skipped characters.
-	 * @returns Number of bytes skipped.
-	 * @todo Return string_idx_t of string being skipped. Remove hash
-	 *       parameter and marker_start() and marker_end(). This will make
-	 *       a stream implementation easier.
-	 * @todo until_str should be of type uchar32_t*.
-	 */
-	size_t skip_until_hashed(
-		const char* until_str, /**< [in] Array of characters to be
-					* found. */
-		hash_t& hash           /**< [out] Hash of skipped characters. */
-		);
-
-	/**
-	 * Skip a single character.
-	 */
-	void skip(void);
-
-	/**
-	 * Get current file position.
-	 * @returns Copy of a position_t object containing the current file
-	 *          position.
-	 * @seealso position_t
-	 */
-	const position_t get_position(void) const noexcept;
-
-	/**
-	 * Get name of input file.
-	 * @returns Pointer to a C string which is the name of the input file,
-	 *          including path. This pointer is valid as long as the
-	 *          environment object given in the construtor is valid.
-	 * @todo Should return string_idx_t, when environment object has
-	 *       become thread local.
-	 */
-	constexpr const char * filename(void) const
-		{ return m_env.sbucket()[m_filename]; }
-
-	/**
-	 * Set starting position for the marker.
-	 * @seealso marker_end
-	 * @todo Remove once skip_until_hashed() has been re-designed.
-	 */
-	void marker_start(void) { m_marker_start = m_buff; }
-
-	/**
-	 * Creating string based on marker selection.
-	 * @note Must have used marker_start() to start the selection.
-	 * @returns String with characters starting at position when
-	 *          marker_start() was called, and ending at current
-	 *          position.
-	 * @seealso marker_start
-	 * @todo Remove once skip_until_hashed() has been re-designed.
-	 */
-	std::string marker_end(void);
+protected:
+	// The whole file is already in the window.
+	bool refill(void) override
+		{ return false; }
 
 private:
 	
@@ -179,59 +99,12 @@ private:
 	// Need parameters to construct this class.
 	mmap_file_t() = delete;
 
-	// Having multiple references to the same file is not supported.
-	mmap_file_t(const mmap_file_t &) = delete;
-
-	// Having multiple references to the same file is not supported.
-	mmap_file_t& operator=(const mmap_file_t &) = delete;
-	
-	// Class to wrap map()/munmap() to make deallocation work with
-	// exceptions
-	class mmap_t {
-	public:
-		mmap_t(const char *name);
-		~mmap_t();
-		constexpr const char *map(void) const noexcept
-			{ return m_map; }
-		constexpr size_t file_size(void) const noexcept
-			{ return m_file.size(); }
-
-		// Forbidden methods
-		mmap_t() = delete;
-		mmap_t(const mmap_t&) = delete;
-		mmap_t& operator=(const mmap_t&) = delete;
-
-	private:
-		const file_t m_file;
-		const char * const m_map;
-	};
-
-	// Environment reference as given by constructor.
-	environment_t& m_env;
-
-	// Memory mapped file.
-	mmap_t m_map;
-
-	// Current file position.
-	const char * m_buff;
-
-	// Start of current line.
-	const char * m_start;
-
-	// First character past end of file.
-	const char * const m_end;
-
-	// Column count.
-	size_t m_col;
-
-	// Line count.
-	size_t m_line;
-
-	// File name, index to string bucket.
-	const string_idx_t m_filename;
+	// File contents.
+	file_loader_t m_map;
 
-	// File position for last call to marker_start().
-	const char * m_marker_start;
+	// Line index, built on first use by line_index().
+	mutable std::once_flag m_line_index_built;
+	mutable line_index_t m_line_index;
 };
 
 
@@ -0,0 +1,82 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef MODULE_TREE_HH
+#define MODULE_TREE_HH
+
+/**
+ * @file
+ * Module hierarchies.
+ * A source file is a module, and a directory tree of source files is a
+ * module hierarchy. This file declares functions for finding the modules
+ * of a hierarchy, and tokenizing all of them in parallel.
+ */
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "environment.hh"
+#include "token_cache.hh"
+#include "work_pool.hh"
+
+/**
+ * Source file of a module.
+ */
+struct module_file_t {
+	std::string path; /**< Path to the file. */
+	size_t size;      /**< File size in bytes. */
+};
+
+/**
+ * Find all modules in a directory tree.
+ * Hidden files and directories, i.e. with names starting with '.', are
+ * skipped. If root is a file, it is the only module.
+ *
+ * @returns Modules sorted by path, so the order does not depend on the
+ *          order of directory entries.
+ * @throws std::system_error if root can not be read.
+ */
+std::vector<module_file_t> find_modules(
+	const char *root,     /**< [in] Root of the hierarchy. */
+	const char *extension /**< [in] Only include files with names ending
+			       * with this, e.g. ".sis". NULL includes all
+			       * files. */
+	);
+
+/**
+ * Result of tokenizing one module.
+ */
+struct module_result_t {
+	size_t nr_tokens; /**< Number of tokens, up to any error. */
+	double seconds;   /**< Time spent tokenizing, including loading. */
+	std::string error;/**< Error message, empty if successful. */
+};
+
+/**
+ * Tokenize modules in parallel.
+ * Each module is tokenized by one worker, and the largest modules are
+ * started first, so that a large module started last does not delay
+ * the end of the run. Strings of all modules are added to the string
+ * bucket of the environment, which must therefore be in concurrent mode
+ * if the pool has more than one worker.
+ * @par
+ * If a token cache is given, modules found in it are not scanned, and
+ * tokens of the other modules are saved in it. Failing to save tokens is
+ * reported as an error of the module.
+ *
+ * @returns Results, in the same order as files.
+ * @throws std::system_error if the string bucket is not in concurrent
+ *         mode and the pool has several workers.
+ */
+std::vector<module_result_t> tokenize_modules(
+	environment_t& env,                      /**< [in] Shared environment. */
+	const std::vector<module_file_t>& files, /**< [in] Modules to tokenize. */
+	work_pool_t& pool,                       /**< [in] Workers to use. */
+	token_cache_t *cache = nullptr           /**< [in] Token cache, or
+						  * nullptr to scan all
+						  * modules. */
+	);
+
+#endif // MODULE_TREE_HH
@@ -0,0 +1,34 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef MULTIPRECISION_HH
+#define MULTIPRECISION_HH
+
+/**
+ * @file
+ * Multi-precision number types.
+ */
+
+#include <boost/multiprecision/mpfr.hpp>
+#include <boost/multiprecision/gmp.hpp>
+
+/**
+ * Multi-precision integer type.
+ * This type is used to store Sisdel integers, which are by default multi-
+ * precision integers. This means that the integer can be as large as the
+ * available memory allows.
+ */
+typedef boost::multiprecision::number<boost::multiprecision::gmp_int> mp_int;
+
+/**
+ * Multi-precision floating point type.
+ * This type is used to store Sisdel floating point numbers, which are by
+ * default multi-precision floating point numbers. This means that the
+ * value can be as large, and with selectable precision, as the available
+ * memory allows.
+ */
+typedef boost::multiprecision::number<boost::multiprecision::mpfr_float_backend<0> > mp_float;
+
+#endif // MULTIPRECISION_HH
@@ -4,6 +4,11 @@
   This file declares the objects used to give tokens structure. They are then
   used to provide byte code.
 
+  All nodes of a compilation unit are created in one arena_t, using
+  arena.create<T>(), and refer to each other using plain pointers. The
+  pointers are valid until the arena is released, which frees the whole
+  tree at once.
+
   SPDX-License-Identifier: MIT
 
 */
@@ -13,6 +18,11 @@
 
 #include "__cplusplus.h"
 
+#include <map>
+#include <memory_resource>
+#include <vector>
+
+#include "arena.hh"
 #include "file.h"
 #include "sbucket.h"
 
@@ -24,14 +34,14 @@ namespace sisdel {
 	
 	struct data_t {
 	public:
-		data_t(const token_t& token);
+		data_t(arena_t& arena, const token_t& token);
 		virtual ~data() noexcept {}
 		
 		string_idx_t name(void) const noexcept
 			{ return typeid(*this).name(); }
 		const type_t& type(void) const noexcept
 			{ return *m_type; }
-		void type(std::shared_ptr<type_t> type)
+		void type(type_t *type)
 			{ m_type = type; }
 		const position_t& declared_at(void) const noexcept
 			{ return m_declared_at; }
@@ -39,8 +49,8 @@ namespace sisdel {
 		// Check if constraints are fullfilled given thread scope
 		bool is_valid(const scope_t& thread_scope) const
 			{
-				for (const constraint_expression_t ce : m_constraints)
-					if (!ce.is_valid(thread_scope))
+				for (const constraint_expression_t *ce : m_constraints)
+					if (!ce->is_valid(thread_scope))
 						return false;
 				return true;
 			}
@@ -62,7 +72,7 @@ namespace sisdel {
 		virtual hash_t hash_next(hash_t hash) const noexcept
 			{
 				hash = hash_next(m_declared_at.hash(), hash);
-				hash = hash_next(m_type.hash(), hash);
+				hash = hash_next(m_type->hash(), hash);
 			}
 		
 		// NOTE: Remember to updated hash_next() function above if
@@ -71,9 +81,9 @@ namespace sisdel {
 
 		// NOTE: If this object is a type, m_type will refer to
 		//       itself. FIXME: Is this a problem?
-		std::shared_ptr<type_t> m_type;
+		type_t *m_type;
 
-		std::vector<constraint_expression_t> m_constraints;
+		std::pmr::vector<constraint_expression_t*> m_constraints;
 	};
 
 	struct type_constraint_t : public data_t {
@@ -103,11 +113,11 @@ namespace sisdel {
 
 	struct unit_expression_t : public data_t {
 	public:
-		unit_t(std::shared_ptr<data_t> expression);
+		unit_t(data_t *expression);
 		bool compatible_with(const unit_t& unit) const;
 
 	private:
-		shared_ptr<data_t> m_expression;
+		data_t *m_expression;
 	};
 	
 	//
@@ -125,10 +135,10 @@ namespace sisdel {
 		bool compatible_with(const type_t& rhs) const noexcept
 			= 0;
 		void add_constraint(
-			std::shared_ptr<constraint_t> constraint) = 0;
+			constraint_t *constraint) = 0;
 		const unit_t& unit(void) const noexcept = 0;
-		shared_ptr<unit_t> unit(void) noexcept = 0;
-		void unit(shared_ptr<unit_t> new_unit) noexcept = 0;
+		unit_t *unit(void) noexcept = 0;
+		void unit(unit_t *new_unit) noexcept = 0;
 
 		// From data_t
 
@@ -136,7 +146,7 @@ namespace sisdel {
 
 	private:
 		const type_info m_base_type;
-		std::vector<type_constraint_t> m_type_constraints;
+		std::pmr::vector<type_constraint_t*> m_type_constraints;
 	};
 
 	// Scope is either a lexical scope, unit scope or a thread scope. The
@@ -144,8 +154,9 @@ namespace sisdel {
 	// identifier name "thread".
 	struct scope_t : public data_t {
 	public:
-		scope_t(const position_t& position,
-			std::shared_ptr<scope_t> parent);
+		scope_t(arena_t& arena,
+			const position_t& position,
+			scope_t *parent);
 
 		// From data_t
 
@@ -154,24 +165,24 @@ namespace sisdel {
 		// Unique members
 
 		const data_t& operator[](string_idx_t idx) const;
-		shared_ptr<data_t> operator[](string_idx_t idx);
-		std::shared_ptr<scope_t> parent(void) const noexcept
+		data_t *operator[](string_idx_t idx);
+		scope_t *parent(void) const noexcept
 			{ return m_parent; }
 
 	private:
 		const position_t m_position;
-		const std::shared_ptr<scope_t> m_parent;
-		std::map<string_idx_t, shared_ptr<data_t> > m_symbols;
+		scope_t * const m_parent;
+		std::pmr::map<string_idx_t, data_t*> m_symbols;
 	};
 
 	struct operator_t : public data_t {
 	public:
 		opeator_t(const position_t& position,
-			  std::shared_ptr<scope_t> scope,
-			  std::shared_ptr<data_t> code);
-		std::shared_ptr<data_t> run(const scope_t& thread_scope,
-					    std::shared_ptr<data_t> lhs,
-					    std::shared_ptr<data_t> rhs);
+			  scope_t *scope,
+			  data_t *code);
+		data_t *run(const scope_t& thread_scope,
+			    data_t *lhs,
+			    data_t *rhs);
 
 	struct real_number_t : public data_t {
 	public:
@@ -211,12 +222,12 @@ namespace sisdel {
 
 	struct map_t : public data_t {
 	public:
-		map_t(const position_t& position);
-		add(std::shared_ptr<data_t> key,
-		    std::shared_ptr<data_t> value);
+		map_t(arena_t& arena, const position_t& position);
+		add(data_t *key,
+		    data_t *value);
 
 	private:
-		std::map<std::shared_ptr<data_t>, std::shared_ptr<data_t> > m_map;
+		std::pmr::map<data_t*, data_t*> m_map;
 	};
 
 	// Expression describes how a number of data objects can calculate
@@ -228,45 +239,45 @@ namespace sisdel {
 	struct expression_t : public data_t {
 	public:
 		expression_t(const position_t& position,
-			     shared_ptr<data_t> lhs,
-			     shared_ptr<operator_t> operator,
-			     shared_ptr<data_t> rhs);
+			     data_t *lhs,
+			     operator_t *operator,
+			     data_t *rhs);
 		
 		// Calculate value of expression, and return the result
-		shared_ptr<data_t> value(void);
+		data_t *value(void);
 
 	private:
-		shared_ptr<data_t> m_lhs;
-		shared_ptr<operator_t> m_operator;
-		shared_ptr<data_t> m_rhs;
+		data_t *m_lhs;
+		operator_t *m_operator;
+		data_t *m_rhs;
 	};
 
 	struct constraint_expression_t : public data_t {
 	public:
 		constraint_expression_t(const position_t& position,
-					std::shared_ptr<data_t> lhs,
-					std::shared_ptr<operator_t> operator,
-					std::shared_ptr<data_t> rhs);
+					data_t *lhs,
+					operator_t *operator,
+					data_t *rhs);
 		bool is_valid(const scope_t& thread_scope);
 
 	private:
-		std::shared_ptr<data_t> m_lhs;
-		std::shared_ptr<operator_t> m_operator;
-		std::shared_ptr<data_t> m_rhs;
+		data_t *m_lhs;
+		operator_t *m_operator;
+		data_t *m_rhs;
 	};
 
 	private:
-		std::shared_ptr<scope_t> m_scope;
-		std::shared_ptr<data_t> m_code;
+		scope_t *m_scope;
+		data_t *m_code;
 	};
 	
 	struct block_t : public data_t {
 	public:
-		block_t(const position_t& position);
-		void append(std::shared_ptr<data_t> data);
+		block_t(arena_t& arena, const position_t& position);
+		void append(data_t *data);
 
 	private:
-		std::vector<std::shared_ptr<data_t> > m_entries;
+		std::pmr::vector<data_t*> m_entries;
 	};
 	
 };
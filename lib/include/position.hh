@@ -11,75 +11,70 @@
  * Declare position_t class.
  */
 
-#include "environment.hh"
-#include "sbucket.hh"
+#include <stdint.h>
+#include <ostream>
+#include <string_view>
 
-class mmap_file_t;
+/**
+ * Input file identity.
+ * Each opened input file is given an identity, unique among the files
+ * open at the same time. It is used to find the file given a position_t,
+ * without risking to refer to a destructed file object. Identities of
+ * destructed files are reused after a delay, see input_t::filename().
+ */
+typedef uint32_t file_id_t;
 
 /**
  * Input file position.
  * This class is intended to give position information for diagnostic
  * messages, e.g. when the scanner or parser encounters an error.
+ * @par
+ * The position is stored as file identity and byte offset only. Line,
+ * column and the text of the line are calculated from the input file
+ * when asked for, which is expected to be only when a diagnostic message
+ * is formatted. If the input file has been destructed, line and column
+ * are reported as 0 and the line text as empty.
  */
 class position_t {
 public:
 	/**
 	 * Constructor for position_t.
-	 * NOTE: Is is the caller's responsibility to make sure that the
-	 *       object given by file argument is not destructed before this
-	 *       class is.
 	 */
-	position_t(std::string& str,         /**< The whole input line where
-					      * the position can be found. */
-		   const mmap_file_t * file, /**< Object used for file input.
-					      * @todo Make environment object
-					      * thread local, so this parameter
-					      * does not need to be given.
-					      * It should be replaced with a
-					      * string_idx_t so that there is
-					      * no risk pointing at a destructed
-					      * file object. When done, remove
-					      * operator== since the class
-					      * then becomes trivial. */
-		   size_t line, /**< Line number in the input file that str
-				 * parameter is referring to, starting from 1.
-				*/
-		   size_t col   /**< Column in str where the position is at,
-				 * starting from 1. */
-		)
-		: m_str(str), m_file(file), m_line(line), m_col(col) {}
+	constexpr position_t(
+		file_id_t file, /**< Identity of the input file. */
+		size_t offset   /**< Byte offset from start of the input
+				 * file. */
+		) noexcept
+		: m_file(file), m_offset(offset) {}
 
 	/**
 	 * Comparison operator.
 	 * Compares two positions.
 	 * @returns true if both positions are identical, false otherwise.
 	 */
-	bool operator==(
+	constexpr bool operator==(
 		const position_t& rhs /**< The object on the right hand side
 				       * of the assignment. */
-		) const noexcept
-		{
-			return (m_str == rhs.m_str) &&
-				(m_file == rhs.m_file) &&
-				(m_line == rhs.m_line) &&
-				(m_col == rhs.m_col);
-		}
+		) const noexcept = default;
 
 	/**
 	 * Return the code line containing the file position.
 	 * The string is the line of code representing the file position.
-	 * @returns One line of code without the line-feed character.
+	 * @returns One line of code without the line-feed character. The
+	 *          string refers to the input file, and is valid as long as
+	 *          the input file object is.
 	 */
-	constexpr const std::string& str(void) const noexcept { return m_str; }
+	std::string_view str(void) const;
 
 	/**
 	 * Return the column where the position is at.
-	 * This is a byte index starting from 1, i.e. it does not consider
-	 * that Unicode characters can consist of several bytes.
-	 * @returns Column byte offset into the input line, starting from 1.
+	 * This is a count of Unicode code points starting from 1, i.e. a
+	 * character consisting of several bytes counts as one column. Tab
+	 * characters are expanded according to the environment.
+	 * @returns Column of the position in the input line, starting from
+	 *          1.
 	 */
-	constexpr size_t column(void) const noexcept
-		{ return m_col; }
+	size_t column(void) const;
 
 	/**
 	 * Return the line containing the file position.
@@ -87,20 +82,31 @@ public:
 	 * file representing this position.
 	 * @returns Line number of the input line, starting from 1.
 	 */
-	constexpr size_t line(void) const noexcept
-		{ return m_line; }
+	size_t line(void) const;
+
+	/**
+	 * Return name of the input file.
+	 * @returns Name of the input file, kept after the file has been
+	 *          destructed until its identity is reused, see
+	 *          input_t::filename().
+	 */
+	const char *filename(void) const;
 
 	/**
-	 * Return file input reader that produced this position.
+	 * Return identity of the input file.
 	 */
-	constexpr const mmap_file_t& file(void) const noexcept
-		{ return *m_file; }
-	
+	constexpr file_id_t file_id(void) const noexcept
+		{ return m_file; }
+
+	/**
+	 * Return byte offset from start of the input file.
+	 */
+	constexpr size_t offset(void) const noexcept
+		{ return m_offset; }
+
 private:
-	const std::string m_str;
-	const mmap_file_t * const m_file;
-	const size_t m_line;
-	const size_t m_col;
+	file_id_t m_file;
+	size_t m_offset;
 };
 
 /**
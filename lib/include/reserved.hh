@@ -0,0 +1,173 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef RESERVED_HH
+#define RESERVED_HH
+
+/**
+ * @file
+ * Reserved identifiers.
+ * Reserved identifiers are parentheses, brackets, braces and keywords.
+ * They are given fixed string indexes, the same in every sbucket, so
+ * that the parser can compare identifiers against compile time
+ * constants.
+ * @par
+ * Reserved spellings are found using a perfect hash calculated at
+ * compile time, which is tried before the general sbucket hash table.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <string_view>
+#include "sbucket.hh"
+
+/**
+ * Fixed string indexes of reserved identifiers.
+ * Every sbucket is pre-seeded with the reserved spellings, so these are
+ * the first string indexes of each bucket.
+ */
+enum reserved_idx_t : string_idx_t {
+	reserved_paren_open,    /**< ( */
+	reserved_paren_close,   /**< ) */
+	reserved_bracket_open,  /**< [ */
+	reserved_bracket_close, /**< ] */
+	reserved_brace_open,    /**< { */
+	reserved_brace_close,   /**< } */
+	reserved_use,           /**< use */
+	reserved_operator,      /**< operator */
+	reserved_is,            /**< is */
+	reserved_then,          /**< then */
+	reserved_else,          /**< else */
+	reserved_foreach,       /**< foreach */
+	reserved_do,            /**< do */
+	nr_reserved             /**< Number of reserved identifiers. */
+};
+
+/**
+ * Spellings of reserved identifiers, indexed by reserved_idx_t.
+ */
+inline constexpr std::array<std::string_view, nr_reserved> reserved_spellings = {
+	"(", ")", "[", "]", "{", "}",
+	"use", "operator", "is", "then", "else", "foreach", "do"
+};
+
+/**
+ * Length of the longest reserved spelling.
+ */
+inline constexpr size_t reserved_max_length = [] {
+	size_t max_length = 0;
+	for (const auto& spelling : reserved_spellings)
+		max_length = std::max(max_length, spelling.size());
+	return max_length;
+}();
+
+/**
+ * Returned by reserved_find() when the string is not reserved.
+ */
+inline constexpr string_idx_t reserved_not_found = SIZE_MAX;
+
+/**
+ * Perfect hash of reserved spellings.
+ * The hash is a multiplicative hash of length, first and last
+ * character, using a multiplier found at compile time such that no two
+ * reserved spellings share a slot.
+ */
+class reserved_hash_t {
+public:
+	/** Number of slots is 2^slot_bits. */
+	static constexpr unsigned slot_bits = 5;
+
+	/** Number of slots. */
+	static constexpr size_t nr_slots = static_cast<size_t>(1) << slot_bits;
+
+	/**
+	 * Find multiplier and fill slot table.
+	 */
+	consteval reserved_hash_t() : m_multiplier(0), m_slots()
+		{
+			// Odd multipliers, starting from the golden ratio
+			for (uint32_t attempt = 0; attempt < 100000; attempt++) {
+				m_multiplier = 0x9e3779b1u + 2 * attempt;
+				if (fill())
+					return;
+			}
+			throw "No perfect hash found for reserved spellings";
+		}
+
+	/**
+	 * Return slot for a non-empty string.
+	 */
+	constexpr size_t slot(
+		const char *str, /**< [in] String, not null terminated. */
+		size_t len       /**< [in] String length, at least 1. */
+		) const noexcept
+		{
+			const uint32_t key =
+				static_cast<uint32_t>(static_cast<unsigned char>(str[0])) |
+				(static_cast<uint32_t>(static_cast<unsigned char>(str[len - 1])) << 8) |
+				(static_cast<uint32_t>(len) << 16);
+			return (key * m_multiplier) >> (32 - slot_bits);
+		}
+
+	/**
+	 * Return reserved index stored in a slot, or nr_reserved if the
+	 * slot is empty.
+	 */
+	constexpr string_idx_t at(size_t slot_idx) const noexcept
+		{ return m_slots[slot_idx]; }
+
+private:
+	// Try current multipliers, returns false if two spellings collide.
+	constexpr bool fill(void)
+		{
+			for (auto& slot_entry : m_slots)
+				slot_entry = nr_reserved;
+			for (size_t idx = 0; idx < nr_reserved; idx++) {
+				const std::string_view s = reserved_spellings[idx];
+				const size_t slot_idx = slot(s.data(), s.size());
+				if (m_slots[slot_idx] != nr_reserved)
+					return false;
+				m_slots[slot_idx] = static_cast<uint8_t>(idx);
+			}
+			return true;
+		}
+
+	uint32_t m_multiplier;
+	std::array<uint8_t, nr_slots> m_slots;
+};
+
+static_assert(nr_reserved < UINT8_MAX,
+	      "Reserved index must fit in a perfect hash slot");
+
+/**
+ * Perfect hash table of reserved spellings.
+ */
+inline constexpr reserved_hash_t reserved_hash;
+
+/**
+ * Find reserved identifier.
+ * @returns Reserved string index, or reserved_not_found if the string is
+ *          not a reserved spelling.
+ */
+inline string_idx_t reserved_find(
+	const char *str, /**< [in] String, not null terminated. */
+	size_t len       /**< [in] String length. */
+	) noexcept
+{
+	if ((len == 0) || (len > reserved_max_length))
+		return reserved_not_found;
+
+	const string_idx_t idx = reserved_hash.at(reserved_hash.slot(str, len));
+	if ((idx == nr_reserved) || (reserved_spellings[idx].size() != len) ||
+	    (memcmp(reserved_spellings[idx].data(), str, len) != 0))
+		return reserved_not_found;
+
+	return idx;
+}
+
+#endif // RESERVED_HH
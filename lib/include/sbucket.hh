@@ -14,21 +14,33 @@
  * making string handling easier.
  */
 
+#include <array>
+#include <atomic>
 #include <memory>
-#include <vector>
 #include <string>
-#include <array>
+#include <string_view>
+#include <stdint.h>
 #include "hash.hh"
 #include "assert.h"
 
 /**
  * Integer index for strings.
  * Equivalent indexes are guaranteed to be equivalent strings, and
- * vice versa. Negative values are for reserved token names, such as
- * new-line, end-of-file, parenthesis, brackets, etc.
+ * vice versa. The lowest values are for reserved identifiers, such as
+ * parentheses, brackets and keywords.
+ * @seealso reserved_idx_t
  */
 typedef size_t string_idx_t;
 
+/**
+ * Thread safety mode of a string bucket.
+ */
+enum class sbucket_mode_t {
+	single_thread, /**< Only used from one thread at a time. */
+	concurrent     /**< Strings can be added and looked up from several
+			* threads at the same time. */
+};
+
 /**
  * String bucket, give unique strings unique IDs.
  * Each unique string is given a string ID, string_idx_t. This makes
@@ -39,6 +51,21 @@ typedef size_t string_idx_t;
  * Tracepoints use tp_sisdel as tracepoint provider, using LTTng as
  * tracepoint framework.
  *
+ * In concurrent mode, the hash table is split into shards selected by
+ * the most significant bits of the hash value, each protected by its own
+ * reader/writer lock. Looking up a string already in the bucket only
+ * takes the shard lock for reading. String indexes are taken from one
+ * shared counter, so they are dense also in concurrent mode, and a
+ * string gets the same index no matter which thread adds it first. The
+ * order in which concurrently added strings get their indexes is not
+ * defined though.
+ *
+ * A bucket can be saved as an image file, and a later bucket can be
+ * constructed from that image. The image is memory mapped read-only, so
+ * construction does not depend on the number of strings in the image.
+ * Strings in the image keep their indexes, and strings added later are
+ * stored in the bucket itself, leaving the image file unchanged.
+ *
  * @note You can not remove strings, since the life time of string_idx_t
  *       is the life time of an sbucket object.
  *
@@ -47,9 +74,33 @@ typedef size_t string_idx_t;
 class sbucket {
 public:
 	/**
-	 * Default and only constructor.
+	 * Default constructor.
+	 * Creates a bucket containing only the reserved identifiers, which
+	 * get the indexes listed in reserved_idx_t. The hash table grows as
+	 * strings are added, string_idx_t values are not affected by this.
 	 */
-	sbucket();
+	explicit sbucket(
+		sbucket_mode_t mode = sbucket_mode_t::single_thread
+			/**< [in] Whether the bucket is shared between
+			 * threads. */
+		);
+
+	/**
+	 * Construct bucket from an image file.
+	 * The bucket contains all strings in the image, with the same
+	 * indexes as when the image was saved. The image file must not be
+	 * modified while the bucket exists.
+	 *
+	 * @throws std::system_error if the file can not be mapped, or is not
+	 *         a valid image for this version of the library.
+	 * @seealso save
+	 */
+	explicit sbucket(
+		const char *image_filename, /**< [in] Image file name. */
+		sbucket_mode_t mode = sbucket_mode_t::single_thread
+			/**< [in] Whether the bucket is shared between
+			 * threads. */
+		);
 
 	/**
 	 * Destructor.
@@ -66,6 +117,9 @@ public:
 	 * for the given string. This makes it more effective since there
 	 * is no need for going through the string once more only to
 	 * calculate the hash.
+	 * @par
+	 * Reserved identifiers are found using a perfect hash, before the
+	 * hash table is searched.
 	 *
 	 * @returns The string_idx_t corresponding to the given string.
 	 *
@@ -92,10 +146,10 @@ public:
 	 * @todo str should be of 32-bit Unicode string type.
 	 */
 	string_idx_t find_add_hashed(
-		const std::string& str, /**< String to be translated. */
-		hash_t hash             /**< String hash value. */
+		std::string_view str, /**< String to be translated. */
+		hash_t hash           /**< String hash value. */
 		)
-		{ return find_add_hashed(str.c_str(), str.length(), hash); }
+		{ return find_add_hashed(str.data(), str.length(), hash); }
 
 	/**
 	 * Translate given hashed string to string_idx_t, adding if needed.
@@ -116,59 +170,232 @@ public:
 	/**
 	 * Return string content given its string_idx_t value.
 	 *
-	 * @returns String corresponding to the given string_idx_t.
+	 * @returns String corresponding to the given string_idx_t. The
+	 *          string is null terminated, and valid for the life time
+	 *          of the bucket.
 	 *
 	 * @todo Returned string should be Unicode uchar32_t string.
 	 */
-	const char *operator[](string_idx_t idx) const;
+	const char *operator[](string_idx_t idx) const noexcept
+		{ return view(idx).data(); }
+
+	/**
+	 * Return string content given its string_idx_t value.
+	 * Same as operator[], but without having to find the length of
+	 * the string.
+	 *
+	 * @returns String corresponding to the given string_idx_t, valid
+	 *          for the life time of the bucket.
+	 */
+	std::string_view view(string_idx_t idx) const noexcept
+		{
+			if (idx < m_image_size) {
+				// Damaged image entries read as empty strings
+				const image_entry_t& e = m_image_entries[idx];
+				if (!image_entry_valid(e, m_image_strings,
+						       m_image_strings_size))
+					return std::string_view("", 0);
+				return std::string_view(
+					m_image_strings + e.offset, e.length);
+			}
+			const entry_t& e = entry(idx);
+			return std::string_view(e.str, e.length);
+		}
+
+	/**
+	 * Return number of strings in the bucket.
+	 * Since string indexes are dense, this is also the string_idx_t
+	 * value the next added string will get. In concurrent mode, strings
+	 * being added by other threads may be included in the count before
+	 * they can be looked up.
+	 */
+	size_t size(void) const noexcept
+		{ return m_size.load(std::memory_order_relaxed); }
+
+	/**
+	 * Return thread safety mode of the bucket.
+	 */
+	sbucket_mode_t mode(void) const noexcept
+		{ return m_mode; }
+
+	/**
+	 * Hash table statistics.
+	 * Probe lengths count the slots inspected when looking up a string
+	 * already in the bucket, so the shortest possible probe length is
+	 * 1.
+	 */
+	struct stats_t {
+		size_t nr_strings;   /**< Number of strings stored. */
+		size_t nr_slots;     /**< Number of hash table slots. */
+		size_t total_probes; /**< Sum of probe lengths of all strings. */
+		size_t max_probe;    /**< Longest probe length. */
+		size_t nr_chunks;    /**< Number of string storage chunks. */
+		size_t arena_bytes;  /**< Bytes allocated for string storage. */
+	};
+
+	/**
+	 * Collect hash table statistics.
+	 * Intended for benchmarks and tuning, walks the whole table. Slot
+	 * counts and probe lengths are summed over all shards.
+	 */
+	stats_t stats(void) const noexcept;
+
+	/**
+	 * Save bucket as an image file.
+	 * The image contains all strings of the bucket, including strings
+	 * from the image the bucket was constructed from. The file is
+	 * written under a temporary name and then renamed, so a bucket
+	 * constructed from the old image is not affected. Strings must not
+	 * be added while the image is saved.
+	 *
+	 * @throws std::system_error if the file can not be written.
+	 */
+	void save(
+		const char *image_filename /**< [in] Image file name. */
+		) const;
+
+	/**
+	 * Return number of strings coming from the image file.
+	 * Zero if the bucket was not constructed from an image.
+	 */
+	size_t image_size(void) const noexcept
+		{ return m_image_size; }
 
 	/**
 	 * Copy constructor.
+	 * Not supported, since entries refer to string storage owned by the
+	 * bucket.
 	 */
-	sbucket(const sbucket &other) = default;
+	sbucket(const sbucket &other) = delete;
 
 	/**
 	 * Move constructor.
+	 * Not supported, since the bucket may be shared between threads.
 	 */
-	sbucket(sbucket &&tmp) = default;
+	sbucket(sbucket &&tmp) = delete;
 
 	/**
 	 * Copy operator.
+	 * Not supported, since entries refer to string storage owned by the
+	 * bucket.
 	 */
-	sbucket& operator=(const sbucket &other) = default;
+	sbucket& operator=(const sbucket &other) = delete;
 
 	/**
 	 * Move operator.
+	 * Not supported, since the bucket may be shared between threads.
 	 */
-	sbucket& operator=(sbucket &&tmp) = default;
+	sbucket& operator=(sbucket &&tmp) = delete;
 
 private:
-	class idx_entry {
-	public:
-		idx_entry(string_idx_t idx, const char *str, size_t str_len)
-			: m_idx(idx), m_next_idx(-1), m_str(str, str_len)
-			{}
+	// Hash table shard, defined in sbucket.cc.
+	class shard_t;
+
+	// Memory mapped image file, defined in sbucket.cc.
+	class image_t;
 
-		// Index of this entry
-		const string_idx_t m_idx;
+	// String table entry in an image file. The offset is relative to
+	// the string section of the image.
+	struct image_entry_t {
+		uint64_t offset; // Offset of null terminated string
+		uint32_t length; // String length, excluding null terminator
+		hash_t hash;     // Hash value of the string
+	};
 
-		// Index to next entry if >= 0, or end of chain if < 0
-		ssize_t m_next_idx;
+	// Return whether an image entry, including its null terminator, is
+	// within a string section of strings_size bytes, and the string is
+	// null terminated.
+	static bool image_entry_valid(const image_entry_t& e,
+				      const char *strings,
+				      uint64_t strings_size) noexcept
+		{ return (e.offset < strings_size) &&
+				(e.length < strings_size - e.offset) &&
+				(strings[e.offset + e.length] == '\0'); }
 
-		// The string
-		const std::string m_str;
+	// Common part of the public constructors.
+	sbucket(sbucket_mode_t mode, std::unique_ptr<const image_t> image);
+
+	// String table entry. The string is stored null terminated in the
+	// arena of the shard that owns it.
+	struct entry_t {
+		const char *str; // String in the arena
+		uint32_t length; // String length, excluding null terminator
+		hash_t hash;     // Hash value of the string
 	};
 
-	// Number of buckets. Needs to be a power of two.
-	static const size_t m_nr_buckets = 4096;
+	// Largest number of strings, chosen so that string indexes fit in
+	// 32 bits in the hash table slots.
+	static constexpr size_t max_strings = UINT32_MAX;
+
+	// Number of entries in the first entry table segment. Each following
+	// segment is twice the size of the previous one.
+	static constexpr size_t segment_base = 1024;
+
+	// Number of segments needed to hold max_strings entries.
+	static constexpr size_t nr_segments = 23;
+
+	// Number of shards in concurrent mode is 2^concurrent_shard_bits.
+	static constexpr unsigned concurrent_shard_bits = 6;
+
+	// Return entry table segment and offset in it for a string index.
+	static constexpr size_t segment_of(string_idx_t idx) noexcept
+		{ return 63 - static_cast<size_t>(
+				__builtin_clzll(idx / segment_base + 1)); }
+	static constexpr size_t segment_offset(string_idx_t idx,
+					       size_t segment) noexcept
+		{ return idx - segment_base * ((static_cast<size_t>(1) << segment) - 1); }
+
+	// Return entry for a string index not in the image.
+	const entry_t& entry(string_idx_t idx) const noexcept
+		{
+			const size_t local = idx - m_image_size;
+			const size_t segment = segment_of(local);
+			return m_segments[segment].load(std::memory_order_acquire)
+				[segment_offset(local, segment)];
+		}
+
+	// Return hash of any string in the bucket.
+	hash_t entry_hash(string_idx_t idx) const noexcept
+		{ return (idx < m_image_size) ? m_image_entries[idx].hash :
+				entry(idx).hash; }
+
+	// Store entry for a new string index, allocating its segment if
+	// needed.
+	void set_entry(string_idx_t idx, const entry_t& new_entry);
+
+	// Find string in hash table, adding it if not found.
+	string_idx_t intern(const char *str, size_t str_len, hash_t hash);
+
+	// Add string known not to be in the bucket to a shard, which must be
+	// locked in concurrent mode. Not counted in the performance counters.
+	string_idx_t add(shard_t& shard, const char *str, uint32_t length,
+			 hash_t hash);
+
+	// Thread safety mode.
+	const sbucket_mode_t m_mode;
+
+	// Image the bucket was constructed from, if any. Strings with index
+	// below m_image_size are found in the image, and never added to the
+	// shards or the entry table.
+	const std::unique_ptr<const image_t> m_image;
+	const image_entry_t *m_image_entries = nullptr;
+	const char *m_image_strings = nullptr;
+	uint64_t m_image_strings_size = 0;
+	size_t m_image_size = 0;
+
+	// Shards are selected by the m_shard_bits most significant bits of
+	// the hash value. Single thread mode uses a single shard.
+	const unsigned m_shard_bits;
+	std::unique_ptr<shard_t[]> m_shards;
 
-	// The last bits of the hash code translates into a bucket.
-	// A bucket is a linked lists of strings sharing that last bit
-	// of the hash code.
-	std::array<ssize_t, m_nr_buckets> m_buckets;
+	// Translate string_idx_t -> string, for strings not in the image,
+	// starting with index m_image_size. The table is split into segments
+	// of growing size, which are never moved once allocated. This lets
+	// other threads read entries while new segments are added.
+	std::array<std::atomic<entry_t*>, nr_segments> m_segments;
 
-	// Translate string_idx_t -> m_hash index
-	std::vector<idx_entry> m_entry;
+	// Number of strings, and next string index to assign.
+	std::atomic<size_t> m_size;
 };
 
 #endif /* SBUCKET_H */
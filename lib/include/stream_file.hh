@@ -0,0 +1,152 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef STREAM_FILE_HH
+#define STREAM_FILE_HH
+
+/**
+ * @file
+ * Streamed input for the token parser, for pipes and standard input.
+ */
+
+#include <memory>
+#include <string_view>
+#include "input.hh"
+#include "line_index.hh"
+#include "environment.hh"
+
+/**
+ * Read a file descriptor into a fixed size buffer.
+ * Works with any readable file descriptor, including pipes and standard
+ * input.
+ * @par
+ * Memory use is O(lines) of the input read so far, not bounded. The text
+ * is kept in a buffer of fixed size, but the line index stores the start
+ * offset of every line read, 8 bytes per line. It is kept in full so
+ * that positions of earlier tokens, e.g. in diagnostics formatted when
+ * the whole input has been scanned, still get their line numbers.
+ * @par
+ * The buffer is a linear buffer compacted when refilled, not a ring
+ * buffer. When the window runs out, bytes that are no longer needed are
+ * dropped from the start of the buffer, and the rest of it is filled by
+ * reading more input. Bytes of the token being scanned, i.e. from the
+ * marker or the current position, are kept, so a token is always
+ * contiguous in the buffer and can be used without copying. A token
+ * longer than the buffer is reported as a parser_error.
+ * @par
+ * The start of the line being scanned is also kept when it fits in half
+ * of the buffer, so that diagnostics about the current line can show
+ * its text. Text of earlier lines is not available, line_str() returns
+ * an empty string for those.
+ */
+class stream_file_t : public input_t {
+public:
+	/**
+	 * Default buffer size.
+	 */
+	static constexpr size_t default_capacity = 64 * 1024;
+
+	/**
+	 * Open a file for streamed reading.
+	 * @throws std::system_error if the file can not be opened.
+	 */
+	stream_file_t(
+		environment_t &env,  /**< [in] Environment object containing
+				      * string bucket where to store the file
+				      * name. */
+		const char *name,    /**< [in] Path to file to read. */
+		size_t capacity = default_capacity
+				     /**< [in] Buffer size in bytes. */
+		);
+
+	/**
+	 * Read from an already open file descriptor.
+	 * The file descriptor is not closed by the destructor.
+	 */
+	stream_file_t(
+		environment_t &env,  /**< [in] Environment object containing
+				      * string bucket where to store the
+				      * name. */
+		int fd,              /**< [in] File descriptor to read, e.g.
+				      * STDIN_FILENO. */
+		const char *name,    /**< [in] Name to use in positions, e.g.
+				      * "<stdin>". */
+		size_t capacity = default_capacity
+				     /**< [in] Buffer size in bytes. */
+		);
+
+	/**
+	 * Destructor.
+	 * Closes the file if it was opened by the constructor.
+	 */
+	~stream_file_t() override;
+
+	/**
+	 * Calculate line and column for a byte offset.
+	 * Line numbers are known for all input read so far. Code points are
+	 * only counted, and tab characters expanded, if the start of the
+	 * line is still in the buffer, otherwise column is a byte count from
+	 * the start of the line.
+	 */
+	void line_column(
+		size_t offset,  /**< [in] Byte offset from start of input. */
+		size_t& line,   /**< [out] Line number. */
+		size_t& column  /**< [out] Column number. */
+		) const override;
+
+	/**
+	 * Get text of the line containing a byte offset.
+	 * @returns The part of the line that is still in the buffer, or an
+	 *          empty string if the start of the line has been dropped.
+	 *          Valid until the input is refilled.
+	 */
+	std::string_view line_str(
+		size_t offset /**< [in] Byte offset from start of input. */
+		) const override;
+
+	bool in_memory(void) const noexcept override
+		{ return false; }
+
+	/**
+	 * Return number of times the buffer has been refilled.
+	 */
+	size_t nr_refills(void) const noexcept
+		{ return m_nr_refills; }
+
+	/**
+	 * Return number of bytes moved to the start of the buffer to keep
+	 * tokens contiguous.
+	 */
+	size_t bytes_moved(void) const noexcept
+		{ return m_bytes_moved; }
+
+protected:
+	// Drop consumed bytes and read more input.
+	bool refill(void) override;
+
+private:
+	// Need parameters to construct this class.
+	stream_file_t() = delete;
+
+	// Buffer, and its size not counting the padding after it.
+	const std::unique_ptr<char[]> m_buffer;
+	const size_t m_capacity;
+
+	// File descriptor, and whether it is closed by the destructor.
+	const int m_fd;
+	const bool m_owns_fd;
+
+	// Set when read() has returned end of file.
+	bool m_at_end;
+
+	// Line starts of all input read so far, grows with each line read.
+	line_index_t m_line_index;
+
+	// Statistics.
+	size_t m_nr_refills;
+	size_t m_bytes_moved;
+};
+
+#endif // STREAM_FILE_HH
@@ -17,38 +17,81 @@
  */
 
 #include <memory>
+#include <ostream>
+#include <span>
 #include <system_error>
+#include <vector>
+#include "diagnostics.hh"
 #include "environment.hh"
 #include "sbucket.hh"
 #include "position.hh"
+#include "input.hh"
 #include "mmap_file.hh"
-#include <boost/multiprecision/mpfr.hpp>
-#include <boost/multiprecision/gmp.hpp>
+#include "multiprecision.hh"
+#include "float_literal.hh"
+#include "token_cache.hh"
+
+class token_t;
+class work_pool_t;
 
 /**
- * Multi-precision integer type.
- * This type is used to store Sisdel integers, which are by default multi-
- * precision integers. This means that the integer can be as large as the
- * available memory allows.
+ * Version of the scanning rules.
+ * Increment when the scanner gives different tokens for the same input,
+ * so that token streams saved by an earlier version are not used.
+ * @seealso token_cache_t
  */
-typedef boost::multiprecision::number<boost::multiprecision::gmp_int> mp_int;
+inline constexpr uint32_t tokenizer_version = 2;
 
 /**
- * Multi-precision floating point type.
- * This type is used to store Sisdel floating point numbers, which are by
- * default multi-precision floating point numbers. This means that the
- * value can be as large, and with selectable precision, as the available
- * memory allows.
+ * Kind of token.
+ * Tells what kind of value a compact_token_t carries.
  */
-typedef boost::multiprecision::number<boost::multiprecision::mpfr_float_backend<0> > mp_float;
+enum class token_kind_t : uint8_t {
+	eol,        /**< End of line, value is indentation level. */
+	string,     /**< String, value is a string_idx_t. */
+	identifier, /**< Identifier, value is a string_idx_t. */
+	integer,    /**< Integer fitting in 64 bits, value is the integer. */
+	big_integer,/**< Integer not fitting in 64 bits, value is an index
+		     * to the integer literal table of the tokenizer. */
+	floating    /**< Floating point number, value is an index to the
+		     * floating point literal table of the tokenizer. */
+};
 
-class token_t;
+/**
+ * Compact token.
+ * Value type alternative to the token_t class hierarchy. Scanning into
+ * compact tokens does not allocate memory per token, and the kind of
+ * token is found by a switch on kind rather than using typeid and
+ * dynamic_cast.
+ * @par
+ * Integers fitting in 64 bits are stored in the token itself. Larger
+ * integers and floating point numbers are kept in literal tables owned
+ * by the tokenizer, use tokenizer_t::integer() and
+ * tokenizer_t::floating() to get them.
+ */
+struct compact_token_t {
+	/**
+	 * Byte offset into the input file where the token starts.
+	 */
+	size_t offset;
+
+	/**
+	 * Token value, interpretation depends on kind.
+	 * @seealso token_kind_t
+	 */
+	uint64_t value;
+
+	/**
+	 * Kind of token.
+	 */
+	token_kind_t kind;
+};
 
 /**
  * Token scanner.
- * Reads the given file and split it into a stream of tokens.
- *
- * @todo Implement support for standard input as source.
+ * Reads the given input and split it into a stream of tokens. The input
+ * is either a memory mapped file, or any other input_t, e.g. a
+ * stream_file_t reading standard input.
  */
 class tokenizer_t {
 public:
@@ -64,6 +107,32 @@ public:
 		const char* file    /**< Name of file in UTF8 format. */
 		);
 
+	/**
+	 * Construct the scanner reading from an input source.
+	 */
+	tokenizer_t(
+		environment_t& env,            /**< Reference to environment
+						* object. */
+		std::unique_ptr<input_t> input /**< Input to read, owned by
+						* the scanner. */
+		);
+
+	/**
+	 * Construct the scanner, using a token cache.
+	 * If the cache has tokens for the contents of the file, tokens are
+	 * read from the cache rather than scanned. Otherwise, the file is
+	 * scanned and its tokens are saved in the cache when end of file has
+	 * been reached.
+	 *
+	 * @throws std::system_error if the file can not be read, or the
+	 *         tokens can not be saved in the cache.
+	 */
+	tokenizer_t(
+		environment_t& env,  /**< Reference to environment object. */
+		const char* file,    /**< Name of file in UTF8 format. */
+		token_cache_t& cache /**< Cache to use. */
+		);
+
 	/**
 	 * Return next token.
 	 *
@@ -71,13 +140,157 @@ public:
 	 */
 	const token_t* next(void);
 
+	/**
+	 * Fill a caller provided buffer with tokens.
+	 * Does not allocate memory per token, except for multi-precision
+	 * literals.
+	 *
+	 * @returns Number of tokens stored in the buffer. If less than
+	 *          the size of the buffer, end of file has been reached.
+	 *          Returns 0 when there are no more tokens.
+	 */
+	size_t next_batch(
+		std::span<compact_token_t> tokens /**< [out] Buffer where to
+						   * store tokens. */
+		);
+
+	/**
+	 * Scan all remaining tokens, using several threads.
+	 * The input is cut into chunks at line boundaries, and the chunks
+	 * are scanned in parallel. The result is exactly the same as
+	 * scanning sequentially with next_batch(), including string indexes,
+	 * which are assigned in order of first appearance in the input.
+	 * @par
+	 * Each chunk is scanned with its own string bucket, so the string
+	 * bucket of the environment needs not be in concurrent mode. Only
+	 * the unique strings of each chunk are added to it, in chunk order,
+	 * by the calling thread.
+	 * @par
+	 * Inputs are first loaded whole using input_t::load_all(). Inputs
+	 * that can not be, or are smaller than min_chunk_size, are scanned
+	 * sequentially. So are inputs with
+	 * errors, or with tokens spanning a cut, e.g. a string containing
+	 * line breaks, so that the tokens and any exception thrown are the
+	 * same as for sequential scanning.
+	 *
+	 * @returns Number of tokens appended to tokens.
+	 */
+	size_t next_all(
+		std::vector<compact_token_t>& tokens, /**< [out] Vector where to
+						       * append tokens. */
+		work_pool_t& pool,                    /**< [in] Workers to use. */
+		size_t min_chunk_size = 256 * 1024    /**< [in] Minimum number of
+						       * bytes per chunk. */
+		);
+
+	/**
+	 * Record lexical errors rather than throwing parser_error.
+	 * After an error, the erroneous token is dropped and scanning
+	 * resumes at the next token separator, so that all lexical errors
+	 * of the input are found in one pass. Errors are recorded in the
+	 * order they are found, also when using next_all().
+	 * @par
+	 * Tokens of an input with errors are not saved in the token cache.
+	 * Errors of the input itself, e.g. a token not fitting in the
+	 * buffer of a stream_file_t, are still thrown.
+	 * @par
+	 * Invalid UTF-8 is reported once per token containing it, and the
+	 * token is dropped. Invalid UTF-8 in comments is also reported.
+	 */
+	void set_diagnostics(
+		diagnostics_t *diagnostics /**< [in] Where to record errors,
+					    * or nullptr to throw. */
+		) noexcept
+		{ m_diagnostics = diagnostics; }
+
+	/**
+	 * Return integer literal of a compact token.
+	 * Token kind must be token_kind_t::integer or
+	 * token_kind_t::big_integer.
+	 *
+	 * @returns The literal as a multi-precision integer.
+	 */
+	mp_int integer(
+		const compact_token_t& token /**< [in] Integer token. */
+		) const
+		{
+			if (token.kind == token_kind_t::integer)
+				return mp_int(token.value);
+			return m_integers[token.value];
+		}
+
+	/**
+	 * Return floating point literal referred to by a compact token.
+	 * Token kind must be token_kind_t::floating. The literal is stored
+	 * exactly, use float_literal_t::to_double() or
+	 * float_literal_t::to_mp_float() to get its value.
+	 *
+	 * @returns Reference to the literal, valid as long as this
+	 *          tokenizer object is.
+	 */
+	const float_literal_t& floating(
+		const compact_token_t& token /**< [in] Floating point token. */
+		) const
+		{ return m_floats[token.value]; }
+
+	/**
+	 * Determine where in the input file a compact token was found.
+	 *
+	 * @returns Position in input file.
+	 */
+	const position_t position(
+		const compact_token_t& token /**< [in] Token to locate. */
+		) const
+		{ return m_input->get_position(token.offset); }
+
+	/**
+	 * Print a compact token.
+	 * Uses the same format as operator<< for token_t.
+	 */
+	void print(
+		std::ostream& os,            /**< [in] Stream to print to. */
+		const compact_token_t& token /**< [in] Token to print. */
+		) const;
+
 private:
-	void get_number(mp_int& nr, char base,
-			const char *valid_digits, size_t& nr_digits);
+	bool lex(compact_token_t& token);
+	bool lex_token(compact_token_t& token);
+	bool scan(compact_token_t& token);
+	size_t lex_until(size_t end, std::vector<compact_token_t>& tokens);
+	void replay(compact_token_t& token);
+	void store(void);
+	void account(std::span<const compact_token_t> tokens);
+	void report(error_code_t code, size_t token_start, size_t error_at);
+	void error(error_code_t code, size_t token_start);
+	bool get_number(uint64_t& small, mp_int& big, bool fits,
+			unsigned base, size_t& nr_digits);
 
 	environment_t& m_env;
-	mmap_file_t m_file;
-	position_t m_startofline;
+	const std::unique_ptr<input_t> m_input;
+	input_t& m_file;
+
+	// Literal tables referred to by compact tokens. Integers are only
+	// stored here when they do not fit in 64 bits.
+	std::vector<mp_int> m_integers;
+	std::vector<float_literal_t> m_floats;
+
+	// Cache where to save tokens when end of file is reached, and tokens
+	// scanned so far. Null if not saving tokens.
+	token_cache_t *m_cache;
+	std::vector<compact_token_t> m_scanned;
+
+	// Cache entry when replaying tokens, its string indexes translated
+	// to the environment, and position of next token to replay.
+	std::unique_ptr<const token_cache_t::entry_t> m_cached;
+	std::vector<string_idx_t> m_cached_strings;
+	size_t m_next_cached;
+	token_cache_t::entry_t::cursor_t m_cached_cursor;
+
+	// Offset up to which scanned bytes have been counted.
+	size_t m_counted;
+
+	// Where to record errors, null if errors are thrown.
+	diagnostics_t *m_diagnostics;
 };
 
 /**
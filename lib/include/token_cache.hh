@@ -0,0 +1,222 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef TOKEN_CACHE_HH
+#define TOKEN_CACHE_HH
+
+/**
+ * @file
+ * On-disk cache of token streams.
+ * Scanning a module that has not changed since it was last scanned gives
+ * the same tokens, so the token stream can be saved and used again.
+ * Entries are keyed by a hash of the file contents and the version of
+ * the scanner, so an entry is found no matter the path of the file, and
+ * is not used after changes to the scanning rules.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "file.hh"
+#include "float_literal.hh"
+#include "hash.hh"
+#include "multiprecision.hh"
+#include "sbucket.hh"
+
+struct compact_token_t;
+
+/**
+ * Directory of cached token streams.
+ * Each entry is a file holding the tokens of one source file, with
+ * string and literal tables of its own, so that entries do not depend on
+ * the string indexes of any sbucket. Entries are memory mapped when
+ * used.
+ * @par
+ * Entries are written to a temporary file which is then renamed, so
+ * several processes and threads can share a cache directory.
+ */
+class token_cache_t {
+public:
+	/**
+	 * Memory mapped cache entry.
+	 * Tokens refer to the tables of the entry: string and identifier
+	 * token values are indexes to the string table, and big_integer and
+	 * floating token values are indexes to the literal tables.
+	 */
+	class entry_t;
+
+	/**
+	 * Statistics, counted since the cache object was created.
+	 */
+	struct stats_t {
+		size_t nr_hits;   /**< Lookups that found a valid entry. */
+		size_t nr_misses; /**< Lookups that found no valid entry. */
+		size_t nr_stores; /**< Entries written. */
+	};
+
+	/**
+	 * Open a cache directory, creating it if needed.
+	 * @throws std::system_error if the directory can not be created.
+	 */
+	explicit token_cache_t(
+		const char *directory /**< [in] Cache directory. */
+		);
+
+	/**
+	 * Destructor.
+	 */
+	~token_cache_t();
+
+	/**
+	 * Find cached tokens of a source file.
+	 * Entries that can not be read, or that were written by another
+	 * version of the library, are not found.
+	 *
+	 * @returns The entry, or nullptr if there is none.
+	 */
+	std::unique_ptr<const entry_t> find(
+		std::string_view contents /**< [in] Contents of source file. */
+		);
+
+	/**
+	 * Save tokens of a source file.
+	 * String indexes of tokens are translated using strings, and literal
+	 * table indexes refer to integers and floats.
+	 *
+	 * @throws std::system_error if the entry can not be written.
+	 */
+	void store(
+		std::string_view contents,                /**< [in] Contents of
+							   * source file. */
+		std::span<const compact_token_t> tokens,  /**< [in] All tokens of
+							   * the file. */
+		const sbucket& strings,                   /**< [in] Strings of
+							   * tokens. */
+		const std::vector<mp_int>& integers,      /**< [in] Literals of
+							   * big_integer tokens. */
+		const std::vector<float_literal_t>& floats/**< [in] Literals of
+							   * floating tokens. */
+		);
+
+	/**
+	 * Return path of the entry for a source file.
+	 */
+	std::string path(
+		std::string_view contents /**< [in] Contents of source file. */
+		) const;
+
+	/**
+	 * Return statistics.
+	 */
+	stats_t stats(void) const noexcept;
+
+	// Forbidden methods
+	token_cache_t(const token_cache_t&) = delete;
+	token_cache_t& operator=(const token_cache_t&) = delete;
+
+private:
+	const std::string m_directory;
+
+	std::atomic<size_t> m_nr_hits;
+	std::atomic<size_t> m_nr_misses;
+	std::atomic<size_t> m_nr_stores;
+};
+
+/**
+ * Memory mapped cache entry.
+ */
+class token_cache_t::entry_t {
+public:
+	/**
+	 * Map an entry file.
+	 * @throws std::system_error if the file can not be mapped, or is
+	 *         not a valid entry for contents.
+	 */
+	entry_t(
+		const char *filename,     /**< [in] Entry file. */
+		std::string_view contents /**< [in] Contents of source file. */
+		);
+
+	/**
+	 * Destructor.
+	 */
+	~entry_t();
+
+	/**
+	 * Return number of tokens.
+	 */
+	size_t nr_tokens(void) const noexcept;
+
+	/**
+	 * Position when decoding tokens.
+	 * Tokens are variable length encoded, so they are decoded in order,
+	 * starting with a default constructed cursor.
+	 */
+	struct cursor_t {
+		size_t pos = 0;         /**< Byte position of next token. */
+		size_t offset = 0;      /**< Offset of previous token. */
+		size_t nr_integers = 0; /**< big_integer tokens decoded. */
+		size_t nr_floats = 0;   /**< floating tokens decoded. */
+	};
+
+	/**
+	 * Decode next token, with values referring to the tables of the
+	 * entry. Must be called at most nr_tokens() times per cursor.
+	 */
+	compact_token_t next(
+		cursor_t& cursor /**< [in,out] Position of token. */
+		) const noexcept;
+
+	/**
+	 * Return number of strings in the string table.
+	 */
+	size_t nr_strings(void) const noexcept;
+
+	/**
+	 * Return a string of the string table.
+	 */
+	std::string_view string(
+		size_t idx /**< [in] String index. */
+		) const noexcept;
+
+	/**
+	 * Return hash of a string of the string table, as given by
+	 * hash_bytes().
+	 */
+	hash_t string_hash(
+		size_t idx /**< [in] String index. */
+		) const noexcept;
+
+	/**
+	 * Return literals of big_integer tokens.
+	 */
+	std::vector<mp_int> integers(void) const;
+
+	/**
+	 * Return literals of floating tokens.
+	 */
+	std::vector<float_literal_t> floats(void) const;
+
+	// Forbidden methods
+	entry_t(const entry_t&) = delete;
+	entry_t& operator=(const entry_t&) = delete;
+
+private:
+	// Throw if the entry is not valid.
+	void validate(const char *filename, std::string_view contents) const;
+
+	// Start of encoded tokens.
+	const uint8_t *tokens(void) const noexcept;
+
+	const file_t m_file;
+	const char *m_map;
+};
+
+#endif // TOKEN_CACHE_HH
@@ -0,0 +1,137 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+/**
+ * @file
+ * LTTng tracepoint provider tp_sisdel.
+ * Only used when tracepoints are enabled, include trace.hh and use
+ * SISDEL_TRACE() rather than including this file.
+ * @par
+ * As for all LTTng tracepoint provider headers, this file is included
+ * several times by lttng/tracepoint-event.h, so it has no ordinary
+ * include guard.
+ * @par
+ * Example session:
+ * @code
+ * lttng create
+ * lttng enable-event --userspace 'tp_sisdel:*'
+ * lttng start
+ * sisdel-parser file.sis
+ * lttng stop
+ * lttng view
+ * @endcode
+ */
+
+#undef TRACEPOINT_PROVIDER
+#define TRACEPOINT_PROVIDER tp_sisdel
+
+#undef TRACEPOINT_INCLUDE
+#define TRACEPOINT_INCLUDE "tp_sisdel.hh"
+
+#if !defined(TP_SISDEL_HH) || defined(TRACEPOINT_HEADER_MULTI_READ)
+#define TP_SISDEL_HH
+
+#include <stdint.h>
+#include <lttng/tracepoint.h>
+
+/*
+ * A file was opened and its contents made available, by mapping or
+ * reading it.
+ */
+TRACEPOINT_EVENT(
+	tp_sisdel,
+	file_open,
+	TP_ARGS(
+		const char *, name,    /* Path of the file */
+		uint64_t, size,        /* File size in bytes */
+		const char *, strategy /* Name of the load strategy used */
+		),
+	TP_FIELDS(
+		ctf_string(name, name)
+		ctf_integer(uint64_t, size, size)
+		ctf_string(strategy, strategy)
+		)
+	)
+
+/*
+ * A token was given to the caller of the scanner.
+ */
+TRACEPOINT_EVENT(
+	tp_sisdel,
+	token,
+	TP_ARGS(
+		uint32_t, file_id, /* Input identity, as in position_t */
+		int, kind,         /* token_kind_t */
+		uint64_t, offset,  /* Byte offset of the token */
+		uint64_t, value    /* Token value */
+		),
+	TP_FIELDS(
+		ctf_integer(uint32_t, file_id, file_id)
+		ctf_integer(int, kind, kind)
+		ctf_integer(uint64_t, offset, offset)
+		ctf_integer(uint64_t, value, value)
+		)
+	)
+
+/*
+ * A string looked up in an sbucket was already there.
+ */
+TRACEPOINT_EVENT(
+	tp_sisdel,
+	sbucket_hit,
+	TP_ARGS(
+		uint64_t, idx,   /* string_idx_t of the string */
+		uint32_t, probes /* Hash table slots examined, 0 for reserved
+				  * identifiers */
+		),
+	TP_FIELDS(
+		ctf_integer(uint64_t, idx, idx)
+		ctf_integer(uint32_t, probes, probes)
+		)
+	)
+
+/*
+ * A string looked up in an sbucket was not there, and was added.
+ */
+TRACEPOINT_EVENT(
+	tp_sisdel,
+	sbucket_insert,
+	TP_ARGS(
+		uint64_t, idx,    /* string_idx_t given to the string */
+		uint32_t, length, /* String length in bytes */
+		uint32_t, probes  /* Hash table slots examined by the lookup */
+		),
+	TP_FIELDS(
+		ctf_integer(uint64_t, idx, idx)
+		ctf_integer(uint32_t, length, length)
+		ctf_integer(uint32_t, probes, probes)
+		)
+	)
+
+/*
+ * A parser_error was created.
+ */
+TRACEPOINT_EVENT(
+	tp_sisdel,
+	parser_error,
+	TP_ARGS(
+		uint32_t, file_id,      /* Input identity, as in position_t */
+		uint64_t, token_start,  /* Byte offset of the erroneous token */
+		uint64_t, error_at,     /* Byte offset of the error */
+		const char *, message   /* Error message, without position */
+		),
+	TP_FIELDS(
+		ctf_integer(uint32_t, file_id, file_id)
+		ctf_integer(uint64_t, token_start, token_start)
+		ctf_integer(uint64_t, error_at, error_at)
+		ctf_string(message, message)
+		)
+	)
+
+TRACEPOINT_LOGLEVEL(tp_sisdel, parser_error, TRACE_ERR)
+
+#endif // TP_SISDEL_HH
+
+#include <lttng/tracepoint-event.h>
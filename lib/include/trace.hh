@@ -0,0 +1,52 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef TRACE_HH
+#define TRACE_HH
+
+/**
+ * @file
+ * Tracepoints.
+ * Tracepoints use tp_sisdel as tracepoint provider, using LTTng as
+ * tracepoint framework. They are only compiled in when the library is
+ * built with SISDEL_TRACEPOINTS defined, which the USE_LTTNG CMake
+ * option does. Otherwise SISDEL_TRACE() expands to nothing, and its
+ * arguments are type checked but never evaluated.
+ * @par
+ * Events are declared in tp_sisdel.hh.
+ */
+
+#ifdef SISDEL_TRACEPOINTS
+
+#include "tp_sisdel.hh"
+
+/**
+ * Emit a tp_sisdel event.
+ */
+#define SISDEL_TRACE(event, ...) tracepoint(tp_sisdel, event, __VA_ARGS__)
+
+#else
+
+/*
+ * Takes the arguments of disabled tracepoints, so that variables only
+ * used by tracepoints are not reported as unused.
+ */
+template <typename... T>
+inline void trace_disabled(const T&...) noexcept
+{
+}
+
+/**
+ * Emit a tp_sisdel event. Compiled out.
+ */
+#define SISDEL_TRACE(event, ...)				\
+	do {							\
+		if (false)					\
+			trace_disabled(__VA_ARGS__);		\
+	} while (0)
+
+#endif // SISDEL_TRACEPOINTS
+
+#endif // TRACE_HH
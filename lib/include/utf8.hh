@@ -0,0 +1,97 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef UTF8_HH
+#define UTF8_HH
+
+/**
+ * @file
+ * UTF-8 validation.
+ * Input is validated a buffer at a time, as it becomes available. Runs
+ * of ASCII characters are skipped 32 (AVX2), 16 (SSE2) or 8 bytes at a
+ * time, and with AVX2, non-ASCII text is validated 32 bytes at a time
+ * using the lookup table algorithm of Keiser and Lemire, "Validating
+ * UTF-8 In Less Than One Instruction Per Byte". Invalid sequences are
+ * located by a byte at a time state machine, which is only used for the
+ * blocks containing them.
+ * @par
+ * The instruction set is selected as for the character class scanning
+ * primitives, see char_class_t::simd_level().
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Validator of UTF-8 text given in parts.
+ * A sequence may be split between parts. After an invalid sequence,
+ * validation continues at the first byte not accepted as part of it, so
+ * all invalid sequences are found.
+ * @par
+ * Valid UTF-8 is as defined by RFC 3629, i.e. without overlong
+ * encodings, surrogates and code points above U+10FFFF.
+ */
+class utf8_validator_t {
+public:
+	/**
+	 * Validate next part of the text.
+	 * Offsets of invalid sequences are appended to invalid. The offset
+	 * of a sequence is the offset of its first byte, which may be in
+	 * an earlier part.
+	 */
+	void validate(
+		const char *begin,          /**< [in] Start of part. */
+		const char *end,            /**< [in] End of part. */
+		size_t offset,              /**< [in] Offset of begin in the
+					     * text. */
+		std::vector<size_t>& invalid /**< [out] Offsets of invalid
+					     * sequences. */
+		);
+
+	/**
+	 * End of text.
+	 * If the text ended within a sequence, its offset is appended to
+	 * invalid.
+	 */
+	void finish(
+		std::vector<size_t>& invalid /**< [out] Offsets of invalid
+					     * sequences. */
+		);
+
+	// Used by the implementation of validate(). Validates one byte at a
+	// time, until end, or until the first sequence boundary at or after
+	// stop, and returns where it stopped.
+	const char *validate_scalar(const char *p, const char *stop,
+				    const char *end, const char *begin,
+				    size_t offset, std::vector<size_t>& invalid);
+	constexpr bool in_sequence(void) const noexcept
+		{ return m_remaining > 0; }
+
+private:
+	// Number of continuation bytes left of the current sequence, 0 if
+	// between sequences.
+	unsigned m_remaining = 0;
+
+	// Range of the next continuation byte.
+	uint8_t m_low = 0x80;
+	uint8_t m_high = 0xbf;
+
+	// Offset of the first byte of the current sequence.
+	size_t m_start = 0;
+};
+
+/**
+ * Count code points.
+ * For valid UTF-8, this is the number of bytes that are not
+ * continuation bytes.
+ * @returns Number of code points in [begin, end).
+ */
+size_t utf8_length(
+	const char *begin, /**< [in] Start of text. */
+	const char *end    /**< [in] End of text. */
+	) noexcept;
+
+#endif // UTF8_HH
@@ -0,0 +1,135 @@
+/*
+  SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef WORK_POOL_HH
+#define WORK_POOL_HH
+
+/**
+ * @file
+ * Work-stealing thread pool.
+ * Runs a set of independent tasks on a fixed number of threads. Each
+ * thread has its own task queue, and takes tasks from the front of it.
+ * A thread that runs out of tasks steals from the back of the queue of
+ * another thread, so that threads stay busy even when task sizes vary a
+ * lot, without all threads contending for one shared queue.
+ */
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+/**
+ * Work-stealing thread pool.
+ * The threads are started by the constructor, and wait for work between
+ * calls to run(). The thread calling run() takes part in running the
+ * tasks, as worker 0.
+ */
+class work_pool_t {
+public:
+	/**
+	 * Task function.
+	 * Called with the task index, and the index of the worker running
+	 * it, which can be used to select per-worker scratch data.
+	 */
+	typedef std::function<void(size_t task, size_t worker)> task_fn_t;
+
+	/**
+	 * Start worker threads.
+	 */
+	explicit work_pool_t(
+		size_t nr_workers = 0 /**< [in] Number of workers, including
+				       * the thread calling run(). 0 uses
+				       * the number of hardware threads. */
+		);
+
+	/**
+	 * Stop worker threads.
+	 */
+	~work_pool_t();
+
+	/**
+	 * Run tasks, and wait for all of them to finish.
+	 * Tasks are dealt to the worker queues in the given order, so
+	 * tasks early in the order are started first. Listing the most
+	 * expensive tasks first gives the best balance between workers.
+	 * @par
+	 * If tasks throw, the remaining tasks are still run, and the first
+	 * exception is then rethrown.
+	 */
+	void run(
+		std::span<const size_t> order, /**< [in] Task indexes, in the
+						* order to start them. */
+		const task_fn_t& fn            /**< [in] Task function. */
+		);
+
+	/**
+	 * Run tasks 0 to nr_tasks - 1, in index order.
+	 */
+	void run(
+		size_t nr_tasks,    /**< [in] Number of tasks. */
+		const task_fn_t& fn /**< [in] Task function. */
+		);
+
+	/**
+	 * Return number of workers, including the thread calling run().
+	 */
+	size_t nr_workers(void) const noexcept
+		{ return m_queues.size(); }
+
+	/**
+	 * Return number of tasks stolen from another worker, since the pool
+	 * was created.
+	 */
+	size_t nr_steals(void) const noexcept
+		{ return m_nr_steals.load(std::memory_order_relaxed); }
+
+	// Forbidden methods
+	work_pool_t(const work_pool_t&) = delete;
+	work_pool_t& operator=(const work_pool_t&) = delete;
+
+private:
+	// Task queue of one worker, aligned to avoid false sharing between
+	// workers.
+	struct alignas(64) queue_t {
+		std::mutex lock;
+		std::vector<size_t> tasks; // Tasks not yet started
+		size_t front = 0;          // Next task for the owner
+	};
+
+	// Take next task for a worker, from its own queue or by stealing.
+	// Returns false when all queues are empty.
+	bool next_task(size_t worker, size_t& task);
+
+	// Run tasks until all queues are empty.
+	void work(size_t worker);
+
+	// Worker thread main loop.
+	void thread_main(size_t worker);
+
+	std::vector<std::unique_ptr<queue_t>> m_queues;
+	std::vector<std::thread> m_threads;
+
+	// Current run, protected by m_lock. Workers wait on m_wakeup for a
+	// new generation, and run() waits on m_done for nr_busy to reach 0.
+	std::mutex m_lock;
+	std::condition_variable m_wakeup;
+	std::condition_variable m_done;
+	size_t m_generation = 0;
+	size_t m_nr_busy = 0;
+	bool m_stop = false;
+	const task_fn_t *m_fn = nullptr;
+	std::exception_ptr m_error;
+
+	std::atomic<size_t> m_nr_steals;
+};
+
+#endif // WORK_POOL_HH
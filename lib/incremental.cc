@@ -0,0 +1,266 @@
+/*
+  Implementation of the incremental_tokenizer_t class.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <system_error>
+
+#include "incremental.hh"
+#include "memory_input.hh"
+
+// Number of tokens per block when splitting blocks
+static constexpr size_t block_size = 256;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: incremental_tokenizer_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+incremental_tokenizer_t::incremental_tokenizer_t(environment_t& env,
+						 const char *name)
+	: m_env(env), m_id(input_t::reserve_id(name)), m_blocks(), m_nr_tokens(0), m_size(0),
+	  m_pending(false), m_pending_offset(0), m_pending_removed(0),
+	  m_pending_inserted(0), m_nr_scanned(0), m_integers(), m_floats()
+{
+}
+
+incremental_tokenizer_t::~incremental_tokenizer_t()
+{
+	input_t::release_id(m_id);
+}
+
+incremental_tokenizer_t::cursor_t incremental_tokenizer_t::find(
+	size_t token_idx) const
+{
+	if (token_idx >= m_nr_tokens)
+		return { m_blocks.size(), 0 };
+
+	const auto block = std::partition_point(
+		m_blocks.begin(), m_blocks.end(),
+		[token_idx](const block_t& b) { return b.first <= token_idx; }) - 1;
+
+	return { static_cast<size_t>(block - m_blocks.begin()),
+		 token_idx - block->first };
+}
+
+compact_token_t incremental_tokenizer_t::operator[](size_t idx) const
+{
+	const cursor_t at = find(idx);
+	const block_t& block = m_blocks[at.block];
+	compact_token_t token = block.tokens[at.idx];
+	token.offset += block.base;
+	return token;
+}
+
+std::vector<compact_token_t> incremental_tokenizer_t::tokens(void) const
+{
+	std::vector<compact_token_t> all;
+	all.reserve(m_nr_tokens);
+
+	for (const block_t& block : m_blocks)
+		for (compact_token_t token : block.tokens) {
+			token.offset += block.base;
+			all.push_back(token);
+		}
+
+	return all;
+}
+
+// Find index of last end of line token before offset. Returns size() if
+// there is none.
+size_t incremental_tokenizer_t::restart_token(size_t offset) const
+{
+	size_t block = static_cast<size_t>(std::partition_point(
+		m_blocks.begin(), m_blocks.end(),
+		[offset](const block_t& b) { return b.base < offset; })
+		- m_blocks.begin());
+
+	while (block-- > 0) {
+		const block_t& b = m_blocks[block];
+		for (size_t idx = b.tokens.size(); idx-- > 0; ) {
+			if ((b.tokens[idx].kind == token_kind_t::eol)
+			    && (b.base + b.tokens[idx].offset < offset))
+				return b.first + idx;
+		}
+	}
+
+	return m_nr_tokens;
+}
+
+// Replace nr_removed tokens starting at first with tokens, and add delta
+// to offsets of the tokens after them.
+void incremental_tokenizer_t::splice(size_t first, size_t nr_removed,
+				     const std::vector<compact_token_t>& tokens,
+				     size_t delta)
+{
+	cursor_t begin = find(first);
+	const cursor_t end = find(first + nr_removed);
+
+	// Appending to the end extends the last block
+	if ((begin.block == m_blocks.size()) && !m_blocks.empty())
+		begin = { m_blocks.size() - 1, m_blocks.back().tokens.size() };
+
+	const size_t end_block = std::min(end.block + 1, m_blocks.size());
+
+	// Tokens of the blocks touched by the change, with absolute offsets
+	std::vector<compact_token_t> merged;
+	if (begin.block < m_blocks.size()) {
+		const block_t& b = m_blocks[begin.block];
+		for (size_t idx = 0; idx < begin.idx; idx++)
+			merged.push_back({ b.base + b.tokens[idx].offset,
+					   b.tokens[idx].value, b.tokens[idx].kind });
+	}
+	merged.insert(merged.end(), tokens.begin(), tokens.end());
+	if (end.block < m_blocks.size()) {
+		const block_t& b = m_blocks[end.block];
+		for (size_t idx = end.idx; idx < b.tokens.size(); idx++)
+			merged.push_back({ b.base + b.tokens[idx].offset + delta,
+					   b.tokens[idx].value, b.tokens[idx].kind });
+	}
+
+	// Split into new blocks, keeping blocks of up to twice the block
+	// size whole
+	const size_t first_merged = (begin.block < m_blocks.size())
+		? m_blocks[begin.block].first : m_nr_tokens;
+	std::vector<block_t> blocks;
+	for (size_t pos = 0; pos < merged.size(); ) {
+		const size_t nr = (merged.size() - pos <= 2 * block_size)
+			? merged.size() - pos : block_size;
+		block_t block{ first_merged + pos, merged[pos].offset, {} };
+		block.tokens.reserve(nr);
+		for (size_t idx = pos; idx < pos + nr; idx++)
+			block.tokens.push_back({ merged[idx].offset - block.base,
+						 merged[idx].value, merged[idx].kind });
+		blocks.push_back(std::move(block));
+		pos += nr;
+	}
+
+	const size_t begin_block = std::min(begin.block, m_blocks.size());
+	m_blocks.erase(m_blocks.begin() + static_cast<ptrdiff_t>(begin_block),
+		       m_blocks.begin() + static_cast<ptrdiff_t>(end_block));
+	m_blocks.insert(m_blocks.begin() + static_cast<ptrdiff_t>(begin_block),
+			std::make_move_iterator(blocks.begin()),
+			std::make_move_iterator(blocks.end()));
+
+	// Blocks after the change only need their base and first index
+	// adjusted
+	const size_t nr_tokens = m_nr_tokens - nr_removed + tokens.size();
+	for (size_t block = begin_block + blocks.size(); block < m_blocks.size(); block++) {
+		m_blocks[block].first += tokens.size() - nr_removed;
+		m_blocks[block].base += delta;
+	}
+	m_nr_tokens = nr_tokens;
+}
+
+incremental_tokenizer_t::change_t incremental_tokenizer_t::update(
+	std::string_view text, size_t offset, size_t removed, size_t inserted)
+{
+	if (m_pending) {
+		// Combine with the edit that was not scanned. Its inserted
+		// bytes are what this edit is relative to.
+		const size_t mid_end = std::max(m_pending_offset + m_pending_inserted,
+						offset + removed);
+		const size_t start = std::min(m_pending_offset, offset);
+		const size_t old_end = mid_end - m_pending_inserted + m_pending_removed;
+		const size_t new_end = mid_end - removed + inserted;
+		offset = start;
+		removed = old_end - start;
+		inserted = new_end - start;
+	}
+
+	if ((offset > m_size) || (removed > m_size - offset)
+	    || (text.size() != m_size - removed + inserted)
+	    || (offset + inserted > text.size()))
+		throw std::system_error(EINVAL, std::generic_category(),
+					"Edit does not match size of text");
+
+	// Offset change of text after the edit, modulo 2^64
+	const size_t delta = inserted - removed;
+	const size_t edit_end = offset + inserted;
+
+	// Restart just after the last token before the end of line token,
+	// where scanning is known to be between tokens. The text before the
+	// edit is the same as for the previous token stream.
+	size_t first = restart_token(offset);
+	size_t start = 0;
+	if (first < m_nr_tokens) {
+		start = (*this)[first].offset;
+		while ((start > 0) && (strchr("\t\n\r ", text[start - 1]) != NULL))
+			start--;
+	} else {
+		first = 0;
+	}
+
+	std::vector<compact_token_t> tokens;
+	size_t nr_removed = m_nr_tokens - first;
+	size_t scan_end = text.size();
+
+	try {
+		tokenizer_t lexer(m_env, std::make_unique<memory_input_t>(
+					  m_env, text, m_id, start));
+
+		cursor_t old = find(first);
+		size_t old_idx = first;
+		compact_token_t token;
+
+		while (lexer.next_batch(std::span(&token, 1)) == 1) {
+			if (token.kind == token_kind_t::big_integer) {
+				m_integers.push_back(lexer.integer(token));
+				token.value = m_integers.size() - 1;
+			} else if (token.kind == token_kind_t::floating) {
+				m_floats.push_back(lexer.floating(token));
+				token.value = m_floats.size() - 1;
+			}
+			tokens.push_back(token);
+
+			if ((token.kind != token_kind_t::eol) || (token.offset < edit_end))
+				continue;
+
+			// Look for an end of line token at the same place in
+			// the previous token stream
+			const size_t old_offset = token.offset - delta;
+			const block_t *block = NULL;
+			for (; old_idx < m_nr_tokens; old_idx++, old.idx++) {
+				if (old.idx == m_blocks[old.block].tokens.size())
+					old = { old.block + 1, 0 };
+				block = &m_blocks[old.block];
+				if (block->base + block->tokens[old.idx].offset >= old_offset)
+					break;
+			}
+			if (old_idx == m_nr_tokens)
+				continue;
+
+			const compact_token_t& previous = block->tokens[old.idx];
+			if ((block->base + previous.offset == old_offset)
+			    && (previous.kind == token_kind_t::eol)
+			    && (previous.value == token.value)) {
+				nr_removed = old_idx + 1 - first;
+				scan_end = token.offset;
+				break;
+			}
+		}
+	}
+
+	catch (...) {
+		m_pending = true;
+		m_pending_offset = offset;
+		m_pending_removed = removed;
+		m_pending_inserted = inserted;
+		throw;
+	}
+
+	m_pending = false;
+	m_size = text.size();
+	m_nr_scanned = scan_end - start;
+
+	splice(first, nr_removed, tokens, delta);
+
+	return { first, nr_removed, tokens.size() };
+}
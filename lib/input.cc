@@ -0,0 +1,305 @@
+/*
+  Implementation of the input_t class.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+#include <string.h>
+
+#include "input.hh"
+#include "hash.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Input registry, translating file_id_t into input_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct registry_entry_t {
+	const input_t *input;
+	const std::string *name;
+};
+
+// Identities of destructed inputs are queued, and reused once more than
+// input_t::id_reuse_delay of them are waiting. The registry then only
+// grows with the number of inputs alive at the same time, while the name
+// of a recently destructed input is still found.
+//
+// Names are interned and never freed, so reusing an identity only changes
+// which name its entry points at. Names already returned by filename()
+// stay valid, also when the identity is reused by another thread. The
+// elements of an unordered_set keep their addresses when it grows.
+struct registry_t {
+	std::mutex lock;
+	std::deque<registry_entry_t> entries;
+	std::deque<file_id_t> released;
+	std::unordered_set<std::string> names;
+};
+
+}
+
+static registry_t& registry(void)
+{
+	static registry_t reg;
+	return reg;
+}
+
+static file_id_t register_input(const input_t *input, const char *name)
+{
+	registry_t& reg = registry();
+	const std::lock_guard<std::mutex> guard(reg.lock);
+	const std::string * const interned = &*reg.names.emplace(name).first;
+
+	if (reg.released.size() > input_t::id_reuse_delay) {
+		const file_id_t id = reg.released.front();
+		reg.released.pop_front();
+		reg.entries[id] = registry_entry_t{input, interned};
+		return id;
+	}
+
+	reg.entries.push_back(registry_entry_t{input, interned});
+	return static_cast<file_id_t>(reg.entries.size() - 1);
+}
+
+static void unregister_input(file_id_t id)
+{
+	registry_t& reg = registry();
+	const std::lock_guard<std::mutex> guard(reg.lock);
+	reg.entries[id].input = NULL;
+	reg.released.push_back(id);
+}
+
+// Let a reserved identity refer to an input
+static void attach_input(file_id_t id, const input_t *input)
+{
+	registry_t& reg = registry();
+	const std::lock_guard<std::mutex> guard(reg.lock);
+	reg.entries[id].input = input;
+}
+
+static void detach_input(file_id_t id, const input_t *input)
+{
+	registry_t& reg = registry();
+	const std::lock_guard<std::mutex> guard(reg.lock);
+	if (reg.entries[id].input == input)
+		reg.entries[id].input = NULL;
+}
+
+const input_t *input_t::find(file_id_t id)
+{
+	registry_t& reg = registry();
+	const std::lock_guard<std::mutex> guard(reg.lock);
+	return (id < reg.entries.size()) ? reg.entries[id].input : NULL;
+}
+
+size_t input_t::nr_ids(void)
+{
+	registry_t& reg = registry();
+	const std::lock_guard<std::mutex> guard(reg.lock);
+	return reg.entries.size();
+}
+
+file_id_t input_t::reserve_id(const char *name)
+{
+	return register_input(NULL, name);
+}
+
+void input_t::release_id(file_id_t id)
+{
+	unregister_input(id);
+}
+
+const char *input_t::filename(file_id_t id)
+{
+	registry_t& reg = registry();
+	const std::lock_guard<std::mutex> guard(reg.lock);
+	return (id < reg.entries.size()) ? reg.entries[id].name->c_str() : "";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: input_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+input_t::input_t(environment_t &env, const char *name)
+	: m_env(env), m_window(NULL), m_window_offset(0), m_buff(NULL),
+	  m_end(NULL), m_marker_start(NULL),
+	  m_filename(m_env.sbucket().find_add(name)),
+	  m_id(register_input(this, name)), m_registered(true),
+	  m_attached(true), m_marker_open(false), m_validator(), m_validated(0),
+	  m_invalid(), m_next_invalid(0)
+{}
+
+input_t::input_t(environment_t &env, file_id_t id)
+	: m_env(env), m_window(NULL), m_window_offset(0), m_buff(NULL),
+	  m_end(NULL), m_marker_start(NULL),
+	  m_filename(m_env.sbucket().find_add(filename(id))),
+	  m_id(id), m_registered(false), m_attached(true),
+	  m_marker_open(false), m_validator(), m_validated(0), m_invalid(),
+	  m_next_invalid(0)
+{
+	attach_input(m_id, this);
+}
+
+input_t::input_t(const input_t& input, size_t offset)
+	: m_env(input.m_env), m_window(input.m_window),
+	  m_window_offset(input.m_window_offset),
+	  m_buff(input.m_window + (offset - input.m_window_offset)),
+	  m_end(input.m_end), m_marker_start(m_buff),
+	  m_filename(input.m_filename), m_id(input.m_id), m_registered(false),
+	  m_attached(false), m_marker_open(false), m_validator(), m_validated(input.m_validated),
+	  m_invalid(input.m_invalid), m_next_invalid(0)
+{
+	drop_invalid_utf8(offset);
+}
+
+input_t::~input_t()
+{
+	if (m_registered)
+		unregister_input(m_id);
+	else if (m_attached)
+		detach_input(m_id, this);
+}
+
+void input_t::validate_window(bool at_end)
+{
+	const size_t window_end = m_window_offset +
+		static_cast<size_t>(m_end - m_window);
+	const size_t from = std::max(m_validated, m_window_offset);
+
+	m_validator.validate(m_window + (from - m_window_offset), m_end, from,
+			     m_invalid);
+	m_validated = window_end;
+
+	if (at_end)
+		m_validator.finish(m_invalid);
+}
+
+char input_t::peek_refill(size_t ahead)
+{
+	while ((ahead >= remaining()) && refill())
+		;
+
+	return (ahead < remaining()) ? m_buff[ahead] : '\0';
+}
+
+size_t input_t::skip(char skip_ch)
+{
+	return skip(char_class_t(skip_ch));
+}
+
+size_t input_t::skip(const char_class_t& skip_class)
+{
+	const size_t from = offset();
+
+	do
+		m_buff = skip_class.find_first_not_of(m_buff, m_end);
+	while ((m_buff >= m_end) && refill());
+
+	return offset() - from;
+}
+
+void input_t::skip_until(char until_ch)
+{
+	for (;;) {
+		const char * const found = static_cast<const char*>(
+			memchr(m_buff, until_ch, remaining()));
+
+		if (found != NULL) {
+			m_buff = found;
+			return;
+		}
+
+		m_buff = m_end;
+		if (!refill())
+			return;
+	}
+}
+
+size_t input_t::skip_until_any(const char_class_t& until_class)
+{
+	const size_t from = offset();
+
+	do
+		m_buff = until_class.find_first_of(m_buff, m_end);
+	while ((m_buff >= m_end) && refill());
+
+	return offset() - from;
+}
+
+size_t input_t::skip_until_hashed(char until_ch, hash_t& hash)
+{
+	const size_t from = offset();
+	const char *found = static_cast<const char*>(
+		memchr(m_buff, until_ch, remaining()));
+
+	// Common case, the whole string is in the window
+	if (found != NULL) {
+		hash = advance_hashed(found);
+		return offset() - from;
+	}
+
+	hasher_t hasher;
+	for (;;) {
+		hasher.update(m_buff, remaining());
+		m_buff = m_end;
+
+		if (!refill()) {
+			hash = hasher.finish();
+			return offset() - from;
+		}
+
+		found = static_cast<const char*>(memchr(m_buff, until_ch, remaining()));
+		if (found != NULL)
+			break;
+	}
+
+	hasher.update(m_buff, static_cast<size_t>(found - m_buff));
+	m_buff = found;
+	hash = hasher.finish();
+
+	return offset() - from;
+}
+
+size_t input_t::skip_until_hashed(const char_class_t& until_class,
+				  hash_t& hash)
+{
+	const size_t from = offset();
+	const char *found = until_class.find_first_of(m_buff, m_end);
+
+	if (found < m_end) {
+		// Common case, the whole string is in the window
+		hash = advance_hashed(found);
+	} else {
+		hasher_t hasher;
+		for (;;) {
+			hasher.update(m_buff, static_cast<size_t>(found - m_buff));
+			m_buff = found;
+			if ((found < m_end) || !refill())
+				break;
+			found = until_class.find_first_of(m_buff, m_end);
+		}
+		hash = hasher.finish();
+	}
+
+	return offset() - from;
+}
+
+hash_t input_t::advance_hashed(const char *to)
+{
+	const hash_t hash = hash_bytes(m_buff, static_cast<size_t>(to - m_buff));
+
+	m_buff = to;
+
+	return hash;
+}
@@ -0,0 +1,147 @@
+/*
+  Implementation of the line_index_t class.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <algorithm>
+
+#include "line_index.hh"
+#include "char_class.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LINE_INDEX_X86 1
+#include <immintrin.h>
+#else
+#define LINE_INDEX_X86 0
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Line-feed scanning kernels
+//
+// The kernels call on_mask(offset, mask) for each block of bytes that
+// contains line-feed characters. Bit n in mask is set if the byte at
+// offset + n is a line-feed character.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename F>
+static void scan_scalar(const char *begin, const char *p, const char *end,
+			F& on_mask)
+{
+	for (; p < end; p++)
+		if (*p == '\n')
+			on_mask(static_cast<size_t>(p - begin), 1u);
+}
+
+#if LINE_INDEX_X86
+
+template <typename F>
+static void scan_sse2(const char *begin, const char *p, const char *end,
+		      F& on_mask)
+{
+	const __m128i nl = _mm_set1_epi8('\n');
+
+	for (; end - p >= 16; p += 16) {
+		const __m128i data = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*>(p));
+		const unsigned mask = static_cast<unsigned>(
+			_mm_movemask_epi8(_mm_cmpeq_epi8(data, nl)));
+		if (mask != 0)
+			on_mask(static_cast<size_t>(p - begin), mask);
+	}
+
+	scan_scalar(begin, p, end, on_mask);
+}
+
+template <typename F>
+__attribute__((target("avx2")))
+static void scan_avx2(const char *begin, const char *p, const char *end,
+		      F& on_mask)
+{
+	const __m256i nl = _mm256_set1_epi8('\n');
+
+	for (; end - p >= 32; p += 32) {
+		const __m256i data = _mm256_loadu_si256(
+			reinterpret_cast<const __m256i*>(p));
+		const unsigned mask = static_cast<unsigned>(
+			_mm256_movemask_epi8(_mm256_cmpeq_epi8(data, nl)));
+		if (mask != 0)
+			on_mask(static_cast<size_t>(p - begin), mask);
+	}
+
+	scan_sse2(begin, p, end, on_mask);
+}
+
+#endif // LINE_INDEX_X86
+
+template <typename F>
+static void scan(const char *begin, const char *end, F& on_mask)
+{
+	switch (char_class_t::simd_level()) {
+#if LINE_INDEX_X86
+	case simd_level_t::avx2:
+		scan_avx2(begin, begin, end, on_mask);
+		break;
+	case simd_level_t::sse2:
+		scan_sse2(begin, begin, end, on_mask);
+		break;
+#endif
+	default:
+		scan_scalar(begin, begin, end, on_mask);
+		break;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: line_index_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+line_index_t::line_index_t(const char *begin, const char *end)
+	: m_starts(), m_size(static_cast<size_t>(end - begin))
+{
+	// First pass counts line-feeds, so the index is allocated only once
+	size_t nr_newlines = 0;
+	auto count = [&nr_newlines](size_t, unsigned mask) {
+		nr_newlines += static_cast<size_t>(__builtin_popcount(mask));
+	};
+	scan(begin, end, count);
+
+	m_starts.reserve(nr_newlines + 1);
+	m_starts.push_back(0);
+
+	// Second pass stores the offset following each line-feed
+	auto store = [this](size_t offset, unsigned mask) {
+		for (; mask != 0; mask &= mask - 1)
+			m_starts.push_back(offset + static_cast<size_t>(
+						   __builtin_ctz(mask)) + 1);
+	};
+	scan(begin, end, store);
+}
+
+void line_index_t::append(const char *begin, const char *end)
+{
+	const size_t base = m_size;
+
+	auto store = [this, base](size_t offset, unsigned mask) {
+		for (; mask != 0; mask &= mask - 1)
+			m_starts.push_back(base + offset + static_cast<size_t>(
+						   __builtin_ctz(mask)) + 1);
+	};
+	scan(begin, end, store);
+
+	m_size += static_cast<size_t>(end - begin);
+}
+
+size_t line_index_t::line_of(size_t offset) const noexcept
+{
+	// Find first line starting after offset, the line before it is the
+	// one containing offset
+	const auto next = std::upper_bound(m_starts.begin(), m_starts.end(),
+					   offset);
+	return static_cast<size_t>(next - m_starts.begin());
+}
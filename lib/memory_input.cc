@@ -0,0 +1,133 @@
+/*
+  Implementation of the memory_input_t class.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <algorithm>
+#include <mutex>
+#include <system_error>
+
+#include <errno.h>
+#include <string.h>
+
+#include "memory_input.hh"
+#include "utf8.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: memory_input_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+memory_input_t::memory_input_t(environment_t &env, std::string_view text,
+			       const char *name, size_t start)
+	: input_t(env, name), m_text(text), m_buffer(), m_capacity(0),
+	  m_line_index_built(), m_line_index()
+{
+	start_at(start);
+}
+
+memory_input_t::memory_input_t(environment_t &env, std::string_view text,
+			       file_id_t id, size_t start)
+	: input_t(env, id), m_text(text), m_buffer(), m_capacity(0),
+	  m_line_index_built(), m_line_index()
+{
+	start_at(start);
+}
+
+void memory_input_t::start_at(size_t start)
+{
+	if (start > m_text.size())
+		throw std::system_error(EINVAL, std::generic_category(),
+					"memory_input_t: Start is past end of text");
+
+	m_window_offset = start;
+	copy_window(start, std::min(m_text.size(), start + chunk_size));
+	m_buff = m_window;
+	m_marker_start = m_buff;
+}
+
+void memory_input_t::copy_window(size_t start, size_t end)
+{
+	const size_t position = offset();
+	const size_t marker = m_window_offset +
+		static_cast<size_t>(m_marker_start - m_window);
+
+	// Text is copied from the caller's text rather than moved within
+	// the window, so a new buffer needs no copy of the old one
+	if (!m_buffer || (end - start > m_capacity)) {
+		m_capacity = std::max(end - start, 2 * m_capacity);
+		m_buffer.reset(new char[m_capacity + input_padding]);
+	}
+
+	char * const buffer = m_buffer.get();
+	memcpy(buffer, m_text.data() + start, end - start);
+	memset(buffer + (end - start), 0, input_padding);
+
+	m_window = buffer;
+	m_window_offset = start;
+	m_buff = buffer + (position - start);
+	m_end = buffer + (end - start);
+	m_marker_start = marker_open() ? buffer + (marker - start) : m_buff;
+	validate_window(end == m_text.size());
+}
+
+bool memory_input_t::load_all(void)
+{
+	if (!in_memory())
+		copy_window(m_window_offset, m_text.size());
+	return true;
+}
+
+bool memory_input_t::refill(void)
+{
+	const size_t window_end = m_window_offset +
+		static_cast<size_t>(m_end - m_window);
+	if (window_end == m_text.size())
+		return false;
+
+	// Keep the current token
+	size_t keep = offset();
+	if (marker_open())
+		keep = std::min(keep, m_window_offset +
+				static_cast<size_t>(m_marker_start - m_window));
+
+	copy_window(keep, std::min(m_text.size(), window_end + chunk_size));
+	return true;
+}
+
+const line_index_t& memory_input_t::line_index(void) const
+{
+	std::call_once(m_line_index_built, [this]() {
+		m_line_index = line_index_t(m_text.data(),
+					     m_text.data() + m_text.size());
+	});
+	return m_line_index;
+}
+
+void memory_input_t::line_column(size_t offset, size_t& line,
+				 size_t& column) const
+{
+	const line_index_t& index = line_index();
+	const char * const at = m_text.data() + std::min(offset, m_text.size());
+
+	line = index.line_of(offset);
+
+	const char * const line_start = m_text.data() + index.line_start(line);
+	const size_t nr_tabs = static_cast<size_t>(
+		std::count(line_start, at, '\t'));
+	column = 1 + utf8_length(line_start, at)
+		+ nr_tabs * (m_env.spaces_per_tab - 1);
+}
+
+std::string_view memory_input_t::line_str(size_t offset) const
+{
+	const line_index_t& index = line_index();
+	const size_t line = index.line_of(offset);
+	const size_t start = index.line_start(line);
+
+	return std::string_view(m_text.data() + start,
+				index.line_end(line) - start);
+}
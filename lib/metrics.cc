@@ -0,0 +1,220 @@
+/*
+  Implementation of performance counters.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "metrics.hh"
+#include "sbucket.hh"
+
+#ifdef SISDEL_METRICS
+
+namespace {
+
+// Counters of running threads, and sum of counters of exited threads
+struct registry_t {
+	std::mutex lock;
+	std::vector<const metrics_thread_t*> threads;
+	metrics_snapshot_t exited;
+};
+
+}
+
+// Never destructed, since threads may exit after static destructors have
+// run
+static registry_t& registry(void)
+{
+	static registry_t * const instance = new registry_t;
+	return *instance;
+}
+
+metrics_thread_t::metrics_thread_t()
+{
+	registry_t& r = registry();
+	const std::lock_guard<std::mutex> lock(r.lock);
+	r.threads.push_back(this);
+}
+
+metrics_thread_t::~metrics_thread_t()
+{
+	registry_t& r = registry();
+	const std::lock_guard<std::mutex> lock(r.lock);
+	collect(r.exited);
+	std::erase(r.threads, this);
+}
+
+void metrics_thread_t::collect(metrics_snapshot_t& snapshot) const noexcept
+{
+	for (size_t idx = 0; idx < m_counters.size(); idx++)
+		snapshot.counters[idx] += m_counters[idx].load(std::memory_order_relaxed);
+	for (size_t idx = 0; idx < m_probes.size(); idx++)
+		snapshot.probes[idx] += m_probes[idx].load(std::memory_order_relaxed);
+	for (size_t idx = 0; idx < m_phase_ns.size(); idx++)
+		snapshot.phase_ns[idx] += m_phase_ns[idx].load(std::memory_order_relaxed);
+}
+
+metrics_snapshot_t metrics_snapshot(void)
+{
+	registry_t& r = registry();
+	const std::lock_guard<std::mutex> lock(r.lock);
+
+	metrics_snapshot_t snapshot = r.exited;
+	for (const metrics_thread_t *thread : r.threads)
+		thread->collect(snapshot);
+
+	return snapshot;
+}
+
+#else
+
+metrics_snapshot_t metrics_snapshot(void)
+{
+	return metrics_snapshot_t();
+}
+
+#endif // SISDEL_METRICS
+
+const char *metric_name(metric_t metric) noexcept
+{
+	switch (metric) {
+	case metric_t::bytes_scanned:
+		return "bytes_scanned";
+	case metric_t::tokens_eol:
+		return "tokens_eol";
+	case metric_t::tokens_string:
+		return "tokens_string";
+	case metric_t::tokens_identifier:
+		return "tokens_identifier";
+	case metric_t::tokens_integer:
+		return "tokens_integer";
+	case metric_t::tokens_big_integer:
+		return "tokens_big_integer";
+	case metric_t::tokens_floating:
+		return "tokens_floating";
+	case metric_t::sbucket_hits:
+		return "sbucket_hits";
+	case metric_t::sbucket_misses:
+		return "sbucket_misses";
+	case metric_t::bytes_interned:
+		return "bytes_interned";
+	case metric_t::big_literals:
+		return "big_literals";
+	case metric_t::float_conversions:
+		return "float_conversions";
+	case metric_t::files_loaded:
+		return "files_loaded";
+	case metric_t::bytes_loaded:
+		return "bytes_loaded";
+	case metric_t::arena_chunks:
+		return "arena_chunks";
+	case metric_t::nr_metrics:
+		break;
+	}
+	return "unknown";
+}
+
+const char *phase_name(phase_t phase) noexcept
+{
+	switch (phase) {
+	case phase_t::load:
+		return "load";
+	case phase_t::cache:
+		return "cache";
+	case phase_t::scan:
+		return "scan";
+	case phase_t::output:
+		return "output";
+	case phase_t::nr_phases:
+		break;
+	}
+	return "unknown";
+}
+
+// Label of a probe length histogram bucket, e.g. "4-7"
+static std::string probe_label(size_t bucket)
+{
+	const size_t low = static_cast<size_t>(1) << bucket;
+	if (bucket + 1 == nr_probe_buckets)
+		return std::to_string(low) + "-";
+	if (bucket == 0)
+		return "1";
+	return std::to_string(low) + "-" + std::to_string(2 * low - 1);
+}
+
+void metrics_print(std::ostream& os, const metrics_snapshot_t& snapshot,
+		   metrics_format_t format, const sbucket *strings)
+{
+	const bool json = (format == metrics_format_t::json);
+	const char *separator = "";
+
+	// Print a name and value pair
+	const auto field = [&](const std::string& name, auto value) {
+		if (json)
+			os << separator << '"' << name << "\":" << value;
+		else
+			os << name << std::string(name.size() < 32 ? 32 - name.size() : 1, ' ')
+			   << value << '\n';
+		separator = ",";
+	};
+
+	// Start and end a JSON object, or a group of text lines
+	const auto begin = [&](const char *name) {
+		if (json) {
+			os << separator << '"' << name << "\":{";
+			separator = "";
+		}
+	};
+	const auto end = [&]() {
+		if (json) {
+			os << '}';
+			separator = ",";
+		}
+	};
+
+	if (json)
+		os << '{';
+
+	begin("counters");
+	for (size_t idx = 0; idx < snapshot.counters.size(); idx++)
+		field(metric_name(static_cast<metric_t>(idx)), snapshot.counters[idx]);
+	end();
+
+	begin("sbucket_probes");
+	for (size_t idx = 0; idx < snapshot.probes.size(); idx++)
+		field((json ? "" : "sbucket_probes ") + probe_label(idx),
+		      snapshot.probes[idx]);
+	end();
+
+	begin("phase_ms");
+	for (size_t idx = 0; idx < snapshot.phase_ns.size(); idx++)
+		field((json ? "" : "phase_ms ") +
+		      std::string(phase_name(static_cast<phase_t>(idx))),
+		      static_cast<double>(snapshot.phase_ns[idx]) / 1e6);
+	end();
+
+	if (strings != nullptr) {
+		const sbucket::stats_t stats = strings->stats();
+		begin("sbucket");
+		field(json ? "strings" : "sbucket strings", stats.nr_strings);
+		field(json ? "slots" : "sbucket slots", stats.nr_slots);
+		field(json ? "load_factor" : "sbucket load_factor",
+		      (stats.nr_slots == 0) ? 0.0 :
+		      static_cast<double>(stats.nr_strings) /
+		      static_cast<double>(stats.nr_slots));
+		field(json ? "average_probe" : "sbucket average_probe",
+		      (stats.nr_strings == 0) ? 0.0 :
+		      static_cast<double>(stats.total_probes) /
+		      static_cast<double>(stats.nr_strings));
+		field(json ? "max_probe" : "sbucket max_probe", stats.max_probe);
+		field(json ? "arena_bytes" : "sbucket arena_bytes", stats.arena_bytes);
+		end();
+	}
+
+	if (json)
+		os << "}\n";
+}
@@ -5,9 +5,11 @@
 
 */
 
+#include <algorithm>
+#include <mutex>
+#include <string>
 #include <system_error>
 
-#include <sys/mman.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <string.h>
@@ -15,31 +17,10 @@
 #include "mmap_file.hh"
 #include "position.hh"
 #include "file.hh"
+#include "utf8.hh"
 
-///////////////////////////////////////////////////////////////////////////////
-//
-// Private class: mmap_t
-//
-///////////////////////////////////////////////////////////////////////////////
-
-static const void *mmap_wrap(size_t length, int fd)
-{
-	const void * const ptr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
-	if (ptr == NULL)
-		throw std::system_error(errno, std::generic_category(), "mmap");
-
-	return ptr;
-}
-
-mmap_file_t::mmap_t::mmap_t(const char *name)
-	: m_file(name, O_RDONLY), m_map(static_cast<const char*>(mmap_wrap(m_file.size(), m_file.fd())))
-{
-}
-
-mmap_file_t::mmap_t::~mmap_t()
-{
-	munmap((void*)m_map, m_file.size());
-}
+static_assert(load_padding >= input_padding,
+	      "Loaded files must be padded as inputs");
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -48,124 +29,45 @@ mmap_file_t::mmap_t::~mmap_t()
 ///////////////////////////////////////////////////////////////////////////////
 
 mmap_file_t::mmap_file_t(environment_t &env, const char * name)
-	: m_env(env), m_map(name), m_buff(m_map.map()), m_start(m_buff),
-	  m_end(m_buff + m_map.file_size()), m_col(1), m_line(1),
-	  m_filename(m_env.sbucket().find_add(name))
-{}
-
-size_t mmap_file_t::skip(char skip_ch)
+	: input_t(env, name), m_map(name, env.load_options), m_line_index_built(),
+	  m_line_index()
 {
-	size_t count = 0;
-
-	while (!eof() && (*m_buff == skip_ch)) {
-		skip();
-		count++;
-	}
-	
-	return count;
+	m_window = m_map.data();
+	m_buff = m_window;
+	m_end = m_window + m_map.size();
+	m_marker_start = m_buff;
+	validate_window(true);
 }
 
-size_t mmap_file_t::skip(const char *skip_str)
+const line_index_t& mmap_file_t::line_index(void) const
 {
-	size_t count = 0;
-
-	while (!eof() && (strchr(skip_str, *m_buff) != NULL)) {
-		skip();
-		count++;
-	}
-
-	return count;
+	std::call_once(m_line_index_built, [this]() {
+		m_line_index = line_index_t(m_map.data(), m_end);
+	});
+	return m_line_index;
 }
 
-void mmap_file_t::skip_until(char until_ch)
+void mmap_file_t::line_column(size_t offset, size_t& line,
+			      size_t& column) const
 {
-	if (eof())
-		throw std::system_error(EINVAL, std::generic_category(), "Failed finding character");
-	while (*m_buff != until_ch) {
-		skip();
-		if (eof())
-			throw std::system_error(EINVAL, std::generic_category(), "Failed finding character");
-	}
-}
-
-size_t mmap_file_t::skip_until_hashed(char until_ch, hash_t& hash)
-{
-	size_t count = 0;
-	hash = 0;
-	if (eof())
-		throw std::system_error(EINVAL, std::generic_category(), "Failed finding character");
-	while (*m_buff != until_ch) {
-		hash = hash_next(*m_buff, hash);
-		count++;
-		skip();
-		if (eof())
-			throw std::system_error(EINVAL, std::generic_category(), "Failed finding character");
-	}
+	const line_index_t& index = line_index();
+	const char * const at = m_map.data() + std::min(offset, m_map.size());
 
-	hash = hash_finish(hash);
+	line = index.line_of(offset);
 
-	return count;
+	const char * const line_start = m_map.data() + index.line_start(line);
+	const size_t nr_tabs = static_cast<size_t>(
+		std::count(line_start, at, '\t'));
+	column = 1 + utf8_length(line_start, at)
+		+ nr_tabs * (m_env.spaces_per_tab - 1);
 }
 
-size_t mmap_file_t::skip_until_hashed(const char* until_str, hash_t& hash)
+std::string_view mmap_file_t::line_str(size_t offset) const
 {
-	size_t count = 0;
-	hash = 0;
-	if (eof())
-		throw std::system_error(EINVAL, std::generic_category(), "Failed finding character");
-	while (strchr(until_str, *m_buff) == NULL) {
-		hash = hash_next(*m_buff, hash);
-		count++;
-		skip();
-		if (eof())
-			throw std::system_error(EINVAL, std::generic_category(), "Failed finding character");
-	}
-
-	hash = hash_finish(hash);
-
-	return count;
-}
-
-// This function will move the current character one step forward. This function
-// is called by all other functions for moving the current character pointer.
-void mmap_file_t::skip(void)
-{
-	if (eof())
-		throw std::system_error(EPIPE, std::generic_category(), "mmap_file_t::skip");
-	if ((*m_buff) == '\n') {
-		m_line++;
-		m_col = 1;
-		m_start = m_buff + 1;
-	} else if ((*m_buff) == '\t') {
-		m_col += m_env.spaces_per_tab;
-	} else {
-		m_col++;
-	}
-	m_buff++;
-}
+	const line_index_t& index = line_index();
+	const size_t line = index.line_of(offset);
+	const size_t start = index.line_start(line);
 
-size_t strsz(const char * str, char find, const char * end)
-{
-	size_t idx = 0;
-	
-	while (str != end) {
-		if (str[idx] == find)
-			return idx;
-		idx++;
-	}
-
-	return idx;
-}
-
-const position_t mmap_file_t::get_position(void) const noexcept
-{
-	std::string line(m_start, strsz(m_start, '\n', m_end));
-	position_t position(line, this, m_line, m_col);
-	return position;
-}
-
-std::string mmap_file_t::marker_end(void)
-{
-	std::string str(m_marker_start, m_buff - m_marker_start);
-	return str;
+	return std::string_view(m_map.data() + start,
+				index.line_end(line) - start);
 }
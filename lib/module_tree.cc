@@ -0,0 +1,109 @@
+/*
+  Finding and tokenizing modules of a module hierarchy.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <numeric>
+#include <system_error>
+
+#include <errno.h>
+#include <string.h>
+
+#include "module_tree.hh"
+#include "token.hh"
+
+std::vector<module_file_t> find_modules(const char *root, const char *extension)
+{
+	namespace fs = std::filesystem;
+	std::vector<module_file_t> files;
+
+	const auto add = [&](const fs::path& path, size_t size) {
+		const std::string name = path.string();
+		if ((extension != NULL) && !name.ends_with(extension))
+			return;
+		files.push_back(module_file_t{name, size});
+	};
+
+	if (!fs::is_directory(root)) {
+		add(root, fs::file_size(root));
+		return files;
+	}
+
+	for (auto it = fs::recursive_directory_iterator(root);
+	     it != fs::recursive_directory_iterator(); ++it) {
+		if (it->path().filename().string().starts_with('.')) {
+			if (it->is_directory())
+				it.disable_recursion_pending();
+			continue;
+		}
+		if (it->is_regular_file())
+			add(it->path(), it->file_size());
+	}
+
+	std::sort(files.begin(), files.end(),
+		  [](const module_file_t& a, const module_file_t& b) {
+			  return a.path < b.path;
+		  });
+
+	return files;
+}
+
+// Tokenize one module, counting tokens.
+static void tokenize_module(environment_t& env, const module_file_t& file,
+			    token_cache_t *cache, module_result_t& result)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	result.nr_tokens = 0;
+	try {
+		tokenizer_t lexer = (cache != nullptr)
+			? tokenizer_t(env, file.path.c_str(), *cache)
+			: tokenizer_t(env, file.path.c_str());
+		std::array<compact_token_t, 256> tokens;
+
+		for (size_t nr = lexer.next_batch(tokens);
+		     nr > 0;
+		     nr = lexer.next_batch(tokens))
+			result.nr_tokens += nr;
+	}
+	catch (const parser_error& e) {
+		result.error = e.what();
+	}
+	catch (const std::system_error& e) {
+		result.error = e.what();
+	}
+
+	result.seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<module_result_t> tokenize_modules(
+	environment_t& env, const std::vector<module_file_t>& files,
+	work_pool_t& pool, token_cache_t *cache)
+{
+	if ((pool.nr_workers() > 1) &&
+	    (env.sbucket().mode() != sbucket_mode_t::concurrent))
+		throw std::system_error(EINVAL, std::generic_category(),
+					"tokenize_modules: Environment not in concurrent mode");
+
+	std::vector<module_result_t> results(files.size());
+
+	// Largest first
+	std::vector<size_t> order(files.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return files[a].size > files[b].size;
+	});
+
+	pool.run(order, [&](size_t task, size_t) {
+		tokenize_module(env, files[task], cache, results[task]);
+	});
+
+	return results;
+}
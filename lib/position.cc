@@ -5,12 +5,43 @@
 */
 
 #include "position.hh"
-#include "mmap_file.hh"
-#include <sstream>
-#include <string.h>
+#include "input.hh"
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable_v<position_t>,
+	      "position_t is copied into every token");
+
+std::string_view position_t::str(void) const
+{
+	const input_t * const file = input_t::find(m_file);
+	return (file == NULL) ? std::string_view() : file->line_str(m_offset);
+}
+
+size_t position_t::column(void) const
+{
+	const input_t * const file = input_t::find(m_file);
+	size_t line = 0, column = 0;
+	if (file != NULL)
+		file->line_column(m_offset, line, column);
+	return column;
+}
+
+size_t position_t::line(void) const
+{
+	const input_t * const file = input_t::find(m_file);
+	size_t line = 0, column = 0;
+	if (file != NULL)
+		file->line_column(m_offset, line, column);
+	return line;
+}
+
+const char *position_t::filename(void) const
+{
+	return input_t::filename(m_file);
+}
 
 std::ostream& operator<<(std::ostream& os, const position_t& m)
-{ 
-	os << m.file().filename() << ':' << m.line() << ':' << m.column();
+{
+	os << m.filename() << ':' << m.line() << ':' << m.column();
 	return os;
 }
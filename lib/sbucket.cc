@@ -2,91 +2,701 @@
   Translate strings into string indexes. For each unique string, there is a
   correspondingly unique index. This makes string comparisons as simple as
   comparing indexes.
-  
+
   SPDX-License-Identifier: MIT
 
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
 #include <utility>
+#include <vector>
 #include "sbucket.hh"
+#include "reserved.hh"
+#include "file.hh"
 #include "hash.hh"
+#include "metrics.hh"
+#include "trace.hh"
 
 /*
- * Public function implementation
+ * Hash table slots
+ *
+ * Both shards and image files use open-addressing hash tables with linear
+ * probing and Robin Hood ordering, i.e. an entry is never stored further
+ * from its home slot than the entries it passes. This keeps probe
+ * sequences short and lets a lookup stop as soon as it reaches an entry
+ * closer to its home slot than the looked up string would be.
  */
 
-sbucket::sbucket()
-	: m_entry()
+namespace {
+
+// Hash table slot. The hash and length of the string are stored in the
+// slot, so that most mismatches are found without touching the string
+// itself. The layout is part of the image file format.
+struct slot_t {
+	hash_t hash;     // Hash value of the string
+	uint32_t length; // String length
+	uint32_t idx;    // string_idx_t of the string, or empty_idx
+};
+
+static_assert(sizeof(slot_t) == 12, "Image file format depends on slot_t");
+
+}
+
+// Slot index value for unused slots
+static constexpr uint32_t empty_idx = UINT32_MAX;
+
+// Distance from the slot where the hash wants to be to the slot where the
+// entry is stored.
+static inline size_t slot_distance(size_t slot_idx, hash_t hash, size_t mask)
 {
-	m_buckets.fill(-1);
+	return (slot_idx - hash) & mask;
 }
 
-sbucket::~sbucket()
+// Find string in slot table, using matches(idx) to compare the strings of
+// slots with equal hash and length. Returns empty_idx if not found. The
+// number of slots examined is returned in probes.
+template <typename F>
+static uint32_t slots_find(const slot_t *slots, size_t mask, uint32_t length,
+			   hash_t hash, uint32_t& probes, F matches)
 {
+	size_t dist = 0;
+
+	for (size_t slot_idx = hash & mask; ;
+	     slot_idx = (slot_idx + 1) & mask, dist++) {
+		const slot_t& curr = slots[slot_idx];
+
+		// An empty slot, or an entry closer to its home slot than the
+		// string would be, ends the probe sequence
+		if ((curr.idx == empty_idx) ||
+		    (slot_distance(slot_idx, curr.hash, mask) < dist)) {
+			probes = static_cast<uint32_t>(dist + 1);
+			return empty_idx;
+		}
+
+		if ((curr.hash == hash) && (curr.length == length) &&
+		    matches(curr.idx)) {
+			probes = static_cast<uint32_t>(dist + 1);
+			return curr.idx;
+		}
+	}
 }
 
-string_idx_t sbucket::find_add_hashed(const char *str,
-				    size_t str_len,
-				    hash_t hash)
+// Insert a slot known not to be in the table, and with at least one empty
+// slot in the table.
+static void slots_insert(slot_t *slots, size_t mask, slot_t slot)
+{
+	size_t dist = 0;
+
+	for (size_t slot_idx = slot.hash & mask; ;
+	     slot_idx = (slot_idx + 1) & mask, dist++) {
+		slot_t& curr = slots[slot_idx];
+
+		if (curr.idx == empty_idx) {
+			curr = slot;
+			return;
+		}
+
+		// Robin Hood: take the slot from an entry closer to its home,
+		// and continue inserting that entry instead
+		const size_t curr_dist = slot_distance(slot_idx, curr.hash, mask);
+		if (curr_dist < dist) {
+			std::swap(curr, slot);
+			dist = curr_dist;
+		}
+	}
+}
+
+// Add probe lengths of a slot table to statistics.
+static void slots_stats(const slot_t *slots, size_t nr_slots,
+			sbucket::stats_t& stats)
+{
+	stats.nr_slots += nr_slots;
+
+	for (size_t slot_idx = 0; slot_idx < nr_slots; slot_idx++) {
+		const slot_t& slot = slots[slot_idx];
+		if (slot.idx == empty_idx)
+			continue;
+		const size_t probe = slot_distance(slot_idx, slot.hash,
+						   nr_slots - 1) + 1;
+		stats.total_probes += probe;
+		stats.max_probe = std::max(stats.max_probe, probe);
+	}
+}
+
+/*
+ * Class: sbucket::shard_t
+ */
+
+// One hash table with its own string storage. Shards are aligned to cache
+// lines, so that locking one shard does not disturb threads using
+// another.
+class alignas(64) sbucket::shard_t {
+public:
+	shard_t() : m_slots(initial_capacity, slot_t{0, 0, empty_idx}) {}
+
+	// Find string, returns empty_idx if not found.
+	uint32_t find(const sbucket& bucket, const char *str, uint32_t length,
+		      hash_t hash, uint32_t& probes) const noexcept
+		{
+			return slots_find(m_slots.data(), m_slots.size() - 1,
+					  length, hash, probes, [&](uint32_t idx) {
+				return memcmp(bucket.entry(idx).str, str,
+					      length) == 0;
+			});
+		}
+
+	// Add a string known not to be in the shard, growing the table if
+	// needed.
+	void add(hash_t hash, uint32_t length, uint32_t idx);
+
+	// Copy string into the arena, adding a null terminator.
+	const char *arena_add(const char *str, size_t str_len);
+
+	// Add statistics for this shard.
+	void stats(stats_t& stats) const noexcept;
+
+	// Protects the rest of the shard in concurrent mode.
+	mutable std::shared_mutex m_lock;
+
+private:
+	// Number of slots in a new table. Needs to be a power of two.
+	static constexpr size_t initial_capacity = 256;
+
+	// Size of arena chunks. Strings longer than a quarter of this are
+	// given a chunk of their own.
+	static constexpr size_t chunk_size = 64 * 1024;
+
+	// Hash table.
+	std::vector<slot_t> m_slots;
+
+	// Number of used slots.
+	size_t m_nr_used = 0;
+
+	// Append-only string storage. Chunks are never moved or freed
+	// while the bucket exists, so string addresses are stable.
+	std::vector<std::unique_ptr<char[]>> m_chunks;
+
+	// Unused part of the current chunk.
+	char *m_chunk_next = nullptr;
+	size_t m_chunk_left = 0;
+
+	// Total bytes allocated for chunks.
+	size_t m_arena_bytes = 0;
+};
+
+void sbucket::shard_t::add(hash_t hash, uint32_t length, uint32_t idx)
+{
+	// Keep load factor at most 7/8, doubling the number of slots and
+	// reinserting all entries when needed
+	if (((m_nr_used + 1) * 8) > (m_slots.size() * 7)) {
+		std::vector<slot_t> old(m_slots.size() * 2,
+					slot_t{0, 0, empty_idx});
+		m_slots.swap(old);
+
+		for (const slot_t& slot : old)
+			if (slot.idx != empty_idx)
+				slots_insert(m_slots.data(), m_slots.size() - 1,
+					     slot);
+	}
+
+	slots_insert(m_slots.data(), m_slots.size() - 1,
+		     slot_t{hash, length, idx});
+	m_nr_used++;
+}
+
+const char *sbucket::shard_t::arena_add(const char *str, size_t str_len)
+{
+	const size_t size = str_len + 1;
+	char *dest;
+
+	if (size > chunk_size / 4) {
+		// Large string, give it a chunk of its own and keep using the
+		// current chunk for small strings
+		m_chunks.emplace_back(new char[size]);
+		m_arena_bytes += size;
+		dest = m_chunks.back().get();
+	} else {
+		if (size > m_chunk_left) {
+			m_chunks.emplace_back(new char[chunk_size]);
+			m_arena_bytes += chunk_size;
+			m_chunk_next = m_chunks.back().get();
+			m_chunk_left = chunk_size;
+		}
+		dest = m_chunk_next;
+		m_chunk_next += size;
+		m_chunk_left -= size;
+	}
+
+	memcpy(dest, str, str_len);
+	dest[str_len] = '\0';
+
+	return dest;
+}
+
+void sbucket::shard_t::stats(stats_t& stats) const noexcept
+{
+	stats.nr_chunks += m_chunks.size();
+	stats.arena_bytes += m_arena_bytes;
+	slots_stats(m_slots.data(), m_slots.size(), stats);
+}
+
+/*
+ * Class: sbucket::image_t
+ *
+ * Image file layout, all sections aligned to 64 bytes:
+ *
+ *   image_header_t
+ *   image_entry_t[nr_strings]  Indexed by string_idx_t
+ *   slot_t[nr_slots]           Hash table
+ *   char[strings_size]         Null terminated strings
+ *
+ * Integers are stored in the byte order of the machine that saved the
+ * image. An image saved on a machine with another byte order is rejected
+ * as having the wrong version.
+ */
+
+namespace {
+
+struct image_header_t {
+	char magic[8];           // image_magic
+	uint32_t version;        // image_version
+	uint32_t hash_check;     // Hash of image_magic, detects hash changes
+	uint64_t nr_strings;     // Number of strings
+	uint64_t nr_slots;       // Number of hash table slots, a power of two
+	uint64_t entries_offset; // File offset of string table
+	uint64_t slots_offset;   // File offset of hash table
+	uint64_t strings_offset; // File offset of strings
+	uint64_t strings_size;   // Size of strings section
+};
+
+}
+
+static constexpr char image_magic[8] = {'S', 'I', 'S', 'D', 'E', 'L', 'S', 'B'};
+
+// Increment when the image format changes
+static constexpr uint32_t image_version = 1;
+
+static constexpr size_t image_alignment = 64;
+
+static inline uint64_t image_align(uint64_t offset)
+{
+	return (offset + image_alignment - 1) & ~(image_alignment - 1);
+}
+
+class sbucket::image_t {
+public:
+	explicit image_t(const char *filename);
+	~image_t();
+
+	const image_header_t& header(void) const noexcept
+		{ return *reinterpret_cast<const image_header_t*>(m_map); }
+	const image_entry_t *entries(void) const noexcept
+		{ return reinterpret_cast<const image_entry_t*>(
+				m_map + header().entries_offset); }
+	const slot_t *slots(void) const noexcept
+		{ return reinterpret_cast<const slot_t*>(
+				m_map + header().slots_offset); }
+	const char *strings(void) const noexcept
+		{ return m_map + header().strings_offset; }
+
+	// Find string, returns empty_idx if not found. Only the header and
+	// the reserved entries are validated when opening the image, so
+	// slots and entries are checked before use. A slot referring to a
+	// damaged entry never matches.
+	uint32_t find(const char *str, uint32_t length,
+		      hash_t hash, uint32_t& probes) const noexcept
+		{
+			const image_header_t& h = header();
+			const image_entry_t * const table = entries();
+			const char * const blob = strings();
+			return slots_find(slots(), h.nr_slots - 1,
+					  length, hash, probes, [&](uint32_t idx) {
+				return (idx < h.nr_strings) &&
+				       image_entry_valid(table[idx], blob,
+							 h.strings_size) &&
+				       (memcmp(blob + table[idx].offset, str,
+					       length) == 0);
+			});
+		}
+
+	// Forbidden methods
+	image_t(const image_t&) = delete;
+	image_t& operator=(const image_t&) = delete;
+
+private:
+	// Throw if the image is not valid.
+	void validate(const char *filename) const;
+
+	const file_t m_file;
+	const char *m_map;
+};
+
+sbucket::image_t::image_t(const char *filename)
+	: m_file(filename, O_RDONLY), m_map(nullptr)
+{
+	if (m_file.size() < sizeof(image_header_t))
+		throw std::system_error(EINVAL, std::generic_category(),
+					std::string(filename) + ": Not an sbucket image");
+
+	void * const map = mmap(NULL, m_file.size(), PROT_READ, MAP_PRIVATE,
+				m_file.fd(), 0);
+	if (map == MAP_FAILED)
+		throw std::system_error(errno, std::generic_category(), filename);
+	m_map = static_cast<const char*>(map);
+
+	try {
+		validate(filename);
+	}
+	catch (...) {
+		munmap(map, m_file.size());
+		throw;
+	}
+}
+
+sbucket::image_t::~image_t()
+{
+	munmap(const_cast<char*>(m_map), m_file.size());
+}
+
+void sbucket::image_t::validate(const char *filename) const
+{
+	const image_header_t& h = header();
+	const auto fail = [filename](const char *what) {
+		throw std::system_error(EINVAL, std::generic_category(),
+					std::string(filename) + ": " + what);
+	};
+
+	if (memcmp(h.magic, image_magic, sizeof(image_magic)) != 0)
+		fail("Not an sbucket image");
+	if (h.version != image_version)
+		fail("Unsupported sbucket image version");
+	if (h.hash_check != hash_bytes(image_magic, sizeof(image_magic)))
+		fail("sbucket image uses another hash function");
+
+	// Sections must be within the file, and not overlap. Section sizes
+	// are compared by dividing, as multiplying could overflow.
+	const uint64_t size = m_file.size();
+	if ((h.nr_strings < nr_reserved) || (h.nr_strings >= max_strings) ||
+	    (h.nr_slots <= h.nr_strings) || ((h.nr_slots & (h.nr_slots - 1)) != 0) ||
+	    (h.entries_offset < sizeof(image_header_t)) ||
+	    (h.entries_offset % image_alignment != 0) ||
+	    (h.slots_offset % image_alignment != 0) ||
+	    (h.slots_offset < h.entries_offset) ||
+	    (h.nr_strings > (h.slots_offset - h.entries_offset) / sizeof(image_entry_t)) ||
+	    (h.strings_offset < h.slots_offset) ||
+	    (h.nr_slots > (h.strings_offset - h.slots_offset) / sizeof(slot_t)) ||
+	    (h.strings_offset > size) || (h.strings_size > size - h.strings_offset))
+		fail("Corrupt sbucket image");
+
+	// Reserved identifiers must have their fixed indexes. Checking only
+	// these, and not every string, keeps opening the image independent
+	// of its size.
+	for (size_t idx = 0; idx < nr_reserved; idx++) {
+		const image_entry_t& e = entries()[idx];
+		if (!image_entry_valid(e, strings(), h.strings_size) ||
+		    (std::string_view(strings() + e.offset, e.length) !=
+		     reserved_spellings[idx]))
+			fail("Corrupt sbucket image");
+	}
+}
+
+/*
+ * Private function implementation
+ */
+
+void sbucket::set_entry(string_idx_t idx, const entry_t& new_entry)
+{
+	const size_t local = idx - m_image_size;
+	const size_t segment = segment_of(local);
+	entry_t *entries = m_segments[segment].load(std::memory_order_acquire);
+
+	if (entries == nullptr) {
+		// Several shards may need the same segment at the same time,
+		// only one of them gets to install it
+		std::unique_ptr<entry_t[]> alloc(
+			new entry_t[segment_base << segment]);
+		if (m_segments[segment].compare_exchange_strong(
+			    entries, alloc.get(), std::memory_order_acq_rel))
+			entries = alloc.release();
+	}
+
+	entries[segment_offset(local, segment)] = new_entry;
+}
+
+// Count and trace a lookup that found the string
+static inline void lookup_hit(string_idx_t idx, uint32_t probes)
+{
+	metrics_add(metric_t::sbucket_hits);
+	metrics_probe(probes);
+	SISDEL_TRACE(sbucket_hit, idx, probes);
+}
+
+// Count and trace a lookup that added the string
+static inline void lookup_insert(string_idx_t idx, uint32_t length,
+				 uint32_t probes)
+{
+	metrics_add(metric_t::sbucket_misses);
+	metrics_add(metric_t::bytes_interned, length);
+	metrics_probe(probes);
+	SISDEL_TRACE(sbucket_insert, idx, length, probes);
+}
+
+string_idx_t sbucket::intern(const char *str, size_t str_len, hash_t hash)
 {
-	const size_t bucket_idx = hash % m_nr_buckets;
-	ssize_t idx;
+	if (str_len >= UINT32_MAX)
+		throw std::length_error("sbucket: String too long");
 
-	for (idx = m_buckets[bucket_idx];
-	     idx >= 0;
-	     idx = m_entry[idx].m_next_idx) {
-		if ((m_entry[idx].m_str.compare(0, str_len, str, str_len) == 0)
-		    && (m_entry[idx].m_str.length() == str_len)) {
+	const uint32_t length = static_cast<uint32_t>(str_len);
+	uint32_t probes = 0;
+
+	// The image is never modified, so it can be searched without locking
+	if (m_image) {
+		const uint32_t idx = m_image->find(str, length, hash, probes);
+		if (idx != empty_idx) {
+			lookup_hit(idx, probes);
+			return idx;
+		}
+	}
+
+	shard_t& shard = m_shards[(static_cast<uint64_t>(hash) << m_shard_bits) >> 32];
+
+	if (m_mode == sbucket_mode_t::concurrent) {
+		// Most strings are already in the bucket, so first look for
+		// the string only holding the lock for reading
+		std::shared_lock<std::shared_mutex> lock(shard.m_lock);
+		const uint32_t idx = shard.find(*this, str, length, hash, probes);
+		if (idx != empty_idx) {
+			lookup_hit(idx, probes);
 			return idx;
 		}
 	}
 
+	std::unique_lock<std::shared_mutex> lock(shard.m_lock, std::defer_lock);
+	if (m_mode == sbucket_mode_t::concurrent)
+		lock.lock();
+
+	// Look again, another thread may have added the string while the
+	// lock was not held
+	const uint32_t idx = shard.find(*this, str, length, hash, probes);
+	if (idx != empty_idx) {
+		lookup_hit(idx, probes);
+		return idx;
+	}
+
 	/*
 	 * Not found, add.
 	 */
 
+	const string_idx_t new_idx = add(shard, str, length, hash);
+	lookup_insert(new_idx, length, probes);
+
+	return new_idx;
+}
+
+string_idx_t sbucket::add(shard_t& shard, const char *str, uint32_t length,
+			  hash_t hash)
+{
+	const char * const stored = shard.arena_add(str, length);
+
 	// Assign a new string_idx_t for the new entry
-	const string_idx_t new_idx = m_entry.size();
-
-	{
-		idx_entry new_entry(new_idx, str, str_len);
-		m_entry.push_back(std::move(new_entry));
-	}
-
-	if (m_buckets[bucket_idx] < 0)
-		// First entry in the bucket chain
-		m_buckets[bucket_idx] = new_idx;
-	else {
-		// Start from beginning in the bucket, and find that last
-		// entry in the chain
-		for (idx = m_buckets[bucket_idx];
-		     m_entry[idx].m_next_idx >= 0;
-		     idx = m_entry[idx].m_next_idx);
-		
-		// Link to previous chain in bucket chain
-		m_entry[idx].m_next_idx = new_idx;
-	}
-	
+	const string_idx_t new_idx = m_size.fetch_add(1, std::memory_order_relaxed);
+	if (new_idx >= max_strings) {
+		m_size.fetch_sub(1, std::memory_order_relaxed);
+		throw std::length_error("sbucket: Too many strings");
+	}
+
+	set_entry(new_idx, entry_t{stored, length, hash});
+	shard.add(hash, length, static_cast<uint32_t>(new_idx));
+
 	return new_idx;
 }
 
+/*
+ * Public function implementation
+ */
+
+sbucket::sbucket(sbucket_mode_t mode, std::unique_ptr<const image_t> image)
+	: m_mode(mode), m_image(std::move(image)),
+	  m_shard_bits((mode == sbucket_mode_t::concurrent) ?
+		       concurrent_shard_bits : 0),
+	  m_shards(new shard_t[static_cast<size_t>(1) << m_shard_bits]),
+	  m_segments(), m_size(0)
+{
+	static_assert(segment_of(max_strings - 1) < nr_segments,
+		      "Entry table segments can not hold max_strings");
+
+	for (auto& segment : m_segments)
+		segment.store(nullptr, std::memory_order_relaxed);
+
+	if (m_image) {
+		// The image already starts with the reserved identifiers
+		m_image_entries = m_image->entries();
+		m_image_strings = m_image->strings();
+		m_image_strings_size = m_image->header().strings_size;
+		m_image_size = m_image->header().nr_strings;
+		m_size.store(m_image_size, std::memory_order_relaxed);
+		return;
+	}
+
+	// Pre-seed reserved identifiers, so they get their fixed indexes.
+	// They are added directly, since they are known to be distinct, and
+	// should not show up as lookups in the performance counters.
+	for (const auto& spelling : reserved_spellings) {
+		const hash_t hash = hash_bytes(spelling.data(), spelling.size());
+		add(m_shards[(static_cast<uint64_t>(hash) << m_shard_bits) >> 32],
+		    spelling.data(), static_cast<uint32_t>(spelling.size()), hash);
+	}
+}
+
+sbucket::sbucket(sbucket_mode_t mode)
+	: sbucket(mode, nullptr)
+{
+}
+
+sbucket::sbucket(const char *image_filename, sbucket_mode_t mode)
+	: sbucket(mode, std::make_unique<const image_t>(image_filename))
+{
+}
+
+sbucket::~sbucket()
+{
+	for (auto& segment : m_segments)
+		delete[] segment.load(std::memory_order_relaxed);
+}
+
+string_idx_t sbucket::find_add_hashed(const char *str,
+				    size_t str_len,
+				    hash_t hash)
+{
+	const string_idx_t reserved = reserved_find(str, str_len);
+	if (reserved != reserved_not_found) {
+		metrics_add(metric_t::sbucket_hits);
+		SISDEL_TRACE(sbucket_hit, reserved, 0u);
+		return reserved;
+	}
+
+	return intern(str, str_len, hash);
+}
+
 string_idx_t sbucket::find_add(const char *str)
 {
-	hash_t hash = 0;
-	size_t str_len = 0;
-	const char *curr;
-	
-	for (curr = str; *curr != '\0'; curr++) {
-		hash = hash_next(*curr, hash);
-		str_len++;
+	const size_t str_len = strlen(str);
+
+	return find_add_hashed(str, str_len, hash_bytes(str, str_len));
+}
+
+sbucket::stats_t sbucket::stats(void) const noexcept
+{
+	stats_t stats = {size(), 0, 0, 0, 0, 0};
+
+	if (m_image)
+		slots_stats(m_image->slots(), m_image->header().nr_slots, stats);
+
+	for (size_t shard_idx = 0;
+	     shard_idx < (static_cast<size_t>(1) << m_shard_bits);
+	     shard_idx++) {
+		const shard_t& shard = m_shards[shard_idx];
+		std::shared_lock<std::shared_mutex> lock(shard.m_lock, std::defer_lock);
+		if (m_mode == sbucket_mode_t::concurrent)
+			lock.lock();
+		shard.stats(stats);
 	}
-	
-	hash = hash_finish(hash);
 
-	return find_add_hashed(str, str_len, hash);
+	return stats;
 }
 
-const char *sbucket::operator[](string_idx_t idx) const {
-	const char * const str = m_entry[idx].m_str.c_str();
-	return str;
+void sbucket::save(const char *image_filename) const
+{
+	const size_t nr_strings = size();
+
+	// Same load factor limit as the shards
+	size_t nr_slots = 1;
+	while ((nr_slots * 7) < ((nr_strings + 1) * 8))
+		nr_slots *= 2;
+
+	image_header_t header = {};
+	memcpy(header.magic, image_magic, sizeof(image_magic));
+	header.version = image_version;
+	header.hash_check = hash_bytes(image_magic, sizeof(image_magic));
+	header.nr_strings = nr_strings;
+	header.nr_slots = nr_slots;
+
+	std::vector<image_entry_t> entries(nr_strings);
+	std::vector<slot_t> slots(nr_slots, slot_t{0, 0, empty_idx});
+	uint64_t strings_size = 0;
+
+	for (size_t idx = 0; idx < nr_strings; idx++) {
+		const std::string_view str = view(idx);
+		const hash_t hash = entry_hash(idx);
+		entries[idx] = image_entry_t{strings_size,
+					     static_cast<uint32_t>(str.size()), hash};
+		slots_insert(slots.data(), nr_slots - 1,
+			     slot_t{hash, static_cast<uint32_t>(str.size()),
+				    static_cast<uint32_t>(idx)});
+		strings_size += str.size() + 1;
+	}
+
+	header.entries_offset = image_align(sizeof(header));
+	header.slots_offset = image_align(header.entries_offset +
+					  nr_strings * sizeof(image_entry_t));
+	header.strings_offset = image_align(header.slots_offset +
+					    nr_slots * sizeof(slot_t));
+	header.strings_size = strings_size;
+
+	// Write to a temporary file, and rename it when complete, so that
+	// buckets mapping an older image are not affected
+	const std::string tmp_filename = std::string(image_filename) + ".tmp";
+	FILE * const file = fopen(tmp_filename.c_str(), "wb");
+	if (file == NULL)
+		throw std::system_error(errno, std::generic_category(), tmp_filename);
+
+	uint64_t offset = 0;
+	const auto write = [&](const void *data, size_t size) {
+		if (fwrite(data, 1, size, file) != size) {
+			const int err = errno;
+			fclose(file);
+			unlink(tmp_filename.c_str());
+			throw std::system_error(err, std::generic_category(),
+						tmp_filename);
+		}
+		offset += size;
+	};
+	const auto pad_to = [&](uint64_t to) {
+		static const char zeros[image_alignment] = {};
+		write(zeros, to - offset);
+	};
+
+	write(&header, sizeof(header));
+	pad_to(header.entries_offset);
+	write(entries.data(), entries.size() * sizeof(image_entry_t));
+	pad_to(header.slots_offset);
+	write(slots.data(), slots.size() * sizeof(slot_t));
+	pad_to(header.strings_offset);
+	for (size_t idx = 0; idx < nr_strings; idx++) {
+		const std::string_view str = view(idx);
+		write(str.data(), str.size() + 1);
+	}
+
+	if (fclose(file) != 0) {
+		const int err = errno;
+		unlink(tmp_filename.c_str());
+		throw std::system_error(err, std::generic_category(), tmp_filename);
+	}
+
+	if (rename(tmp_filename.c_str(), image_filename) != 0) {
+		const int err = errno;
+		unlink(tmp_filename.c_str());
+		throw std::system_error(err, std::generic_category(), image_filename);
+	}
 }
@@ -0,0 +1,169 @@
+/*
+  Implementation of the stream_file_t class.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <algorithm>
+#include <system_error>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stream_file.hh"
+#include "error.hh"
+#include "utf8.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: stream_file_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static int open_stream(const char *name)
+{
+	const int fd = open(name, O_RDONLY);
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(), name);
+
+	return fd;
+}
+
+stream_file_t::stream_file_t(environment_t &env, int fd, const char *name,
+			     size_t capacity)
+	: input_t(env, name), m_buffer(new char[capacity + input_padding]()),
+	  m_capacity(capacity), m_fd(fd), m_owns_fd(false), m_at_end(false),
+	  m_line_index(), m_nr_refills(0), m_bytes_moved(0)
+{
+	if (capacity == 0)
+		throw std::system_error(EINVAL, std::generic_category(),
+					"stream_file_t: Buffer size must not be 0");
+
+	m_window = m_buffer.get();
+	m_buff = m_window;
+	m_end = m_window;
+	m_marker_start = m_buff;
+}
+
+stream_file_t::stream_file_t(environment_t &env, const char *name,
+			     size_t capacity)
+	: input_t(env, name), m_buffer(new char[capacity + input_padding]()),
+	  m_capacity(capacity), m_fd(open_stream(name)), m_owns_fd(true),
+	  m_at_end(false), m_line_index(), m_nr_refills(0), m_bytes_moved(0)
+{
+	if (capacity == 0) {
+		close(m_fd);
+		throw std::system_error(EINVAL, std::generic_category(),
+					"stream_file_t: Buffer size must not be 0");
+	}
+
+	m_window = m_buffer.get();
+	m_buff = m_window;
+	m_end = m_window;
+	m_marker_start = m_buff;
+}
+
+stream_file_t::~stream_file_t()
+{
+	if (m_owns_fd)
+		close(m_fd);
+}
+
+bool stream_file_t::refill(void)
+{
+	if (m_at_end)
+		return false;
+
+	char * const buffer = m_buffer.get();
+
+	// Keep the current token, and the start of the current line if it
+	// is not too long
+	size_t keep = offset();
+	if (marker_open())
+		keep = std::min(keep, m_window_offset +
+				static_cast<size_t>(m_marker_start - m_window));
+	const size_t line_start = m_line_index.line_start(
+		m_line_index.line_of(offset()));
+	if ((line_start >= m_window_offset) &&
+	    (offset() - line_start <= m_capacity / 2))
+		keep = std::min(keep, line_start);
+
+	// Move kept bytes to start of buffer
+	const size_t drop = keep - m_window_offset;
+	if (drop > 0) {
+		const size_t used = static_cast<size_t>(m_end - m_window);
+		memmove(buffer, buffer + drop, used - drop);
+		m_bytes_moved += used - drop;
+		m_window_offset += drop;
+		m_buff -= drop;
+		m_end -= drop;
+		m_marker_start = marker_open() ? m_marker_start - drop : m_buff;
+		memset(buffer + used - drop, 0, input_padding);
+	}
+
+	const size_t used = static_cast<size_t>(m_end - m_window);
+	if (used == m_capacity)
+		throw parser_error(get_position(keep), get_position(),
+				   error_code_t::token_too_long);
+
+	ssize_t nr;
+	do
+		nr = read(m_fd, buffer + used, m_capacity - used);
+	while ((nr < 0) && (errno == EINTR));
+
+	if (nr < 0)
+		throw std::system_error(errno, std::generic_category(), filename());
+
+	if (nr == 0) {
+		m_at_end = true;
+		validate_window(true);
+		return false;
+	}
+
+	m_line_index.append(m_end, m_end + nr);
+	m_end += nr;
+	memset(buffer + used + static_cast<size_t>(nr), 0, input_padding);
+	validate_window(false);
+	m_nr_refills++;
+
+	return true;
+}
+
+void stream_file_t::line_column(size_t offset, size_t& line,
+				size_t& column) const
+{
+	line = m_line_index.line_of(offset);
+
+	const size_t line_start = m_line_index.line_start(line);
+	const size_t window_end = m_window_offset +
+		static_cast<size_t>(m_end - m_window);
+	column = 1 + offset - line_start;
+
+	if ((line_start >= m_window_offset) && (offset <= window_end)) {
+		const char * const start = m_window + (line_start - m_window_offset);
+		const char * const at = m_window + (offset - m_window_offset);
+		const size_t nr_tabs = static_cast<size_t>(
+			std::count(start, at, '\t'));
+		column = 1 + utf8_length(start, at)
+			+ nr_tabs * (m_env.spaces_per_tab - 1);
+	}
+}
+
+std::string_view stream_file_t::line_str(size_t offset) const
+{
+	const size_t line = m_line_index.line_of(offset);
+	const size_t line_start = m_line_index.line_start(line);
+	const size_t window_end = m_window_offset +
+		static_cast<size_t>(m_end - m_window);
+
+	if ((line_start < m_window_offset) || (line_start > window_end))
+		return std::string_view();
+
+	const size_t line_end = std::min(m_line_index.line_end(line), window_end);
+
+	return std::string_view(m_window + (line_start - m_window_offset),
+				line_end - line_start);
+}
@@ -9,6 +9,7 @@
 // token_t
 /////////////////////////////////////////////////////////////////////////////
 
+#include <array>
 #include <cmath>
 #include <ostream>
 #include <string.h>
@@ -17,11 +18,25 @@
 #include "token.hh"
 #include "hash.hh"
 #include "mmap_file.hh"
+#include "metrics.hh"
+#include "reserved.hh"
+#include "trace.hh"
+#include "work_pool.hh"
 #include "string.h"
 
 #define TOKEN_SEPARATORS         "\n\r\t "
-#define SINGLE_LETTER_IDENTIFIERS "()[]\{}"
-#define IDENTIFIER_INVALID_CHARS "\"'#" TOKEN_SEPARATORS
+#define SINGLE_LETTER_IDENTIFIERS "()[]{}"
+#define IDENTIFIER_INVALID_CHARS "\"'#"
+#define IDENTIFIER_BELOW         0x21
+
+// Character classes used for scanning, built at compile time. Identifiers
+// end at control characters and space, see NonWhiteSpaceChar in
+// sisdel.ebnf, and token separators are among them.
+static constexpr char_class_t blank_chars("\r ");
+static constexpr char_class_t newline_chars("\r\n");
+static constexpr char_class_t identifier_invalid_chars(IDENTIFIER_INVALID_CHARS,
+							 IDENTIFIER_BELOW);
+static constexpr char_class_t separator_chars(TOKEN_SEPARATORS);
 
 #ifndef NDEBUG
 
@@ -38,11 +53,41 @@ long double value_of_float(mp_float value)
 #endif // NDEBUG
 
 tokenizer_t::tokenizer_t(environment_t& env, const char *file)
-	: m_env(env), m_file(env, file),
-	  m_startofline(m_file.get_position())
+	: tokenizer_t(env, std::make_unique<mmap_file_t>(env, file))
 {
 }
 
+tokenizer_t::tokenizer_t(environment_t& env, std::unique_ptr<input_t> input)
+	: m_env(env), m_input(std::move(input)), m_file(*m_input),
+	  m_integers(), m_floats(), m_cache(nullptr), m_scanned(), m_cached(),
+	  m_cached_strings(), m_next_cached(0), m_cached_cursor(),
+	  m_counted(m_file.offset()), m_diagnostics(nullptr)
+{
+}
+
+tokenizer_t::tokenizer_t(environment_t& env, const char *file,
+			 token_cache_t& cache)
+	: tokenizer_t(env, file)
+{
+	const std::string_view contents(m_file.data(), m_file.remaining());
+
+	m_cached = cache.find(contents);
+	if (!m_cached) {
+		m_cache = &cache;
+		return;
+	}
+
+	// Strings are stored in order of first appearance, so they get the
+	// same indexes as when scanning the file
+	m_cached_strings.reserve(m_cached->nr_strings());
+	for (size_t idx = 0; idx < m_cached->nr_strings(); idx++)
+		m_cached_strings.push_back(m_env.sbucket().find_add_hashed(
+			m_cached->string(idx), m_cached->string_hash(idx)));
+
+	m_integers = m_cached->integers();
+	m_floats = m_cached->floats();
+}
+
 static bool valid_digit(char ch, char base)
 {
 	if (base > 10)
@@ -52,43 +97,192 @@ static bool valid_digit(char ch, char base)
 		return (ch >= '0') && (ch <= ('0' + base - 1));
 }
 
-void tokenizer_t::get_number(mp_int& nr, char base,
-			     const char *valid_digits, size_t& nr_digits)
+// Return value of a digit, or a value larger than any base if not a digit.
+static unsigned digit_value(char ch)
+{
+	if ((ch >= '0') && (ch <= '9'))
+		return static_cast<unsigned>(ch - '0');
+	if ((ch >= 'a') && (ch <= 'f'))
+		return static_cast<unsigned>(ch - 'a' + 10);
+	if ((ch >= 'A') && (ch <= 'F'))
+		return static_cast<unsigned>(ch - 'A' + 10);
+	return 255;
+}
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+
+// SWAR, SIMD within a register, parsing of decimal digits. Eight
+// characters are loaded into a 64-bit word, and checked and converted
+// using a few arithmetic operations instead of one loop iteration per
+// digit.
+#define HAVE_SWAR_DIGITS 1
+
+// Check whether all eight characters in the word are decimal digits.
+static bool swar_is_8_digits(uint64_t chars)
 {
-	char ch;
+	return ((chars & 0xf0f0f0f0f0f0f0f0) |
+		(((chars + 0x0606060606060606) & 0xf0f0f0f0f0f0f0f0) >> 4))
+		== 0x3333333333333333;
+}
 
+// Convert eight decimal digits, first digit in the least significant
+// byte, into their value.
+static uint64_t swar_parse_8_digits(uint64_t chars)
+{
+	const uint64_t mask = 0x000000ff000000ff;
+	const uint64_t mul1 = 100 + (1000000ULL << 32);
+	const uint64_t mul2 = 1 + (10000ULL << 32);
+
+	chars -= 0x3030303030303030;
+	chars = (chars * 10) + (chars >> 8);
+	return (((chars & mask) * mul1) + (((chars >> 16) & mask) * mul2)) >> 32;
+}
+
+#else
+#define HAVE_SWAR_DIGITS 0
+#endif
+
+// Scans digits, and digit separators, of a number in the given base.
+// The value is accumulated in a 64-bit word, and only moved to a
+// multi-precision integer if it overflows. Accumulation continues from
+// the given value, which is small if fits is true and big otherwise.
+// End of input needs no checking, since the '\0' following the window
+// is not a digit, and the padding after it allows reading eight bytes
+// anywhere in the window.
+bool tokenizer_t::get_number(uint64_t& small, mp_int& big, bool fits,
+			     unsigned base, size_t& nr_digits)
+{
 	nr_digits = 0;
-	while (!m_file.eof()) {
-		ch = m_file.peek();
-		
-		if (strchr(valid_digits, ch) != NULL) {
-			if ((ch >= '0') && (ch <= '9')) {
-				nr *= base;
-				nr += (ch - '0');
-			} else if ((ch >= 'a') && (ch <= 'f')) {
-				nr *= base;
-				nr += (ch - 'a' + 10);
-			} else if ((ch >= 'A') && (ch <= 'F')) {
-				nr *= base;
-				nr += (ch - 'A' + 10);
+	for (;;) {
+#if HAVE_SWAR_DIGITS
+		if (fits && (base == 10)) {
+			uint64_t chars;
+			memcpy(&chars, m_file.data(), sizeof(chars));
+			uint64_t scaled, sum;
+			if (swar_is_8_digits(chars) &&
+			    !__builtin_mul_overflow(small, 100000000u, &scaled) &&
+			    !__builtin_add_overflow(scaled, swar_parse_8_digits(chars), &sum)) {
+				small = sum;
+				nr_digits += 8;
+				m_file.skip_bytes(8);
+				continue;
 			}
-			nr_digits++;
-		} else {
+		}
+#endif
+
+		char ch = m_file.peek();
+
+		// Digit separator is only valid between two digits
+		if ((ch == '\'') && (nr_digits > 0) &&
+		    (digit_value(m_file.peek(1)) < base)) {
+			m_file.skip();
+			ch = m_file.peek();
+		}
+
+		const unsigned digit = digit_value(ch);
+		if (digit >= base)
 			break;
+
+		uint64_t scaled, sum;
+		if (!fits) {
+			big *= base;
+			big += digit;
+		} else if (!__builtin_mul_overflow(small, base, &scaled) &&
+			   !__builtin_add_overflow(scaled, digit, &sum)) {
+			small = sum;
+		} else {
+			// Promote to multi-precision integer
+			metrics_add(metric_t::big_literals);
+			fits = false;
+			big = small;
+			big *= base;
+			big += digit;
 		}
 
+		nr_digits++;
 		m_file.skip();
 	}
+
+	return fits;
 }
 
-const token_t* tokenizer_t::next(void)
+// Throw an error, or record it if errors are to be recorded. Tokens are
+// then not saved in the cache, since replaying them would not give the
+// errors.
+void tokenizer_t::report(error_code_t code, size_t token_start,
+			 size_t error_at)
+{
+	if (m_diagnostics == nullptr)
+		throw parser_error(m_file.get_position(token_start),
+				   m_file.get_position(error_at), code);
+
+	m_diagnostics->add(code, m_file.get_position(token_start),
+			   m_file.get_position(error_at));
+
+	m_cache = nullptr;
+	m_scanned.clear();
+}
+
+// Handle an error in the token starting at token_start, found at the
+// current position. Scanning resumes at the next token separator.
+void tokenizer_t::error(error_code_t code, size_t token_start)
+{
+	// At end of input, point at the start of the token rather than
+	// after the last line
+	report(code, token_start, m_file.eof() ? token_start : m_file.offset());
+
+	// Skip the character where the error was found, so that the same
+	// error is not found again, unless it is a token separator, e.g.
+	// after an identifier starting with '-'. Tab characters within a
+	// line are token separators, but not valid ones.
+	if (m_file.eof())
+		return;
+	const char ch = m_file.peek();
+	if (ch == '\t') {
+		m_file.skip('\t');
+		return;
+	}
+	if ((ch != '\0') && separator_chars.contains(ch))
+		return;
+	m_file.skip();
+	m_file.skip_until_any(separator_chars);
+}
+
+// Scan next token, reporting invalid UTF-8 in what was scanned. Checking
+// once per token keeps validation out of the scanning loops, which only
+// need to handle bytes.
+bool tokenizer_t::lex(compact_token_t& token)
+{
+	for (;;) {
+		const bool found = lex_token(token);
+		const size_t end = m_file.offset();
+
+		// Sequences before the token, e.g. in a comment
+		const size_t token_start = found ? token.offset : end;
+		size_t invalid;
+		while ((invalid = m_file.invalid_utf8()) < token_start) {
+			report(error_code_t::invalid_utf8, invalid, invalid);
+			m_file.drop_invalid_utf8(invalid + 1);
+		}
+
+		if (invalid >= end)
+			return found;
+
+		// Only the first sequence of a token is reported, and the
+		// token is dropped
+		m_file.drop_invalid_utf8(end);
+		report(error_code_t::invalid_utf8, token.offset, invalid);
+	}
+}
+
+bool tokenizer_t::lex_token(compact_token_t& token)
 {
 	for (;;) {
 		if (m_file.eof())
 			break;
 
 		// Skip carriage-return and space
-		m_file.skip("\r ");
+		m_file.skip(blank_chars);
 
 		// Check first character to determine token type
 		char ch = m_file.peek();
@@ -96,14 +290,14 @@ const token_t* tokenizer_t::next(void)
 		// Handle new-line
 		if (ch == '\n') {
 			// Handle multiple new-lines
-			(void) m_file.skip("\r\n");
+			(void) m_file.skip(newline_chars);
 
 			// Determine indentation level, which is number of
 			// tab characters
 			const size_t nr_tabs = m_file.skip('\t');
 
 			// Remove carriage-returns and spaces
-			m_file.skip("\r ");
+			m_file.skip(blank_chars);
 
 			ch = m_file.peek();
 			
@@ -118,87 +312,93 @@ const token_t* tokenizer_t::next(void)
 			}
 
 			// Return new-line token
-			return new token_eol_t(m_file.get_position(), nr_tabs);
+			token = { m_file.offset(), nr_tabs, token_kind_t::eol };
+			return true;
 		}
 
 		if (valid_digit(ch, 10)) {
 			// Handle numbers
 
-			const position_t start_of_number =
-				m_file.get_position();
+			const size_t start_of_number = m_file.offset();
 
 			// Determine base
-			const char *valid_digits;
-			char base;
-			if (ch == '0')
-				m_file.skip();
-			switch (m_file.peek()) {
-			case 'b':
-				base = 2;
-				valid_digits = "01";
-				m_file.skip();
-				break;
-			case 'o':
-				base = 8;
-				valid_digits = "01234567";
-				m_file.skip();
-				break;
-			case 'x':
-				base = 16;
-				valid_digits = "0123456789abcdefABCDEF";
-				m_file.skip();
-				break;
-			default:
-				base = 10;
-				valid_digits = "0123456789";
-				break;
+			unsigned base = 10;
+			if (ch == '0') {
+				switch (m_file.peek(1)) {
+				case 'b':
+					base = 2;
+					break;
+				case 'o':
+					base = 8;
+					break;
+				case 'x':
+					base = 16;
+					break;
+				}
+				if (base != 10)
+					m_file.skip_bytes(2);
 			}
 
 			size_t nr_digits;
-			mp_int integer(0);
-			get_number(integer, base, valid_digits, nr_digits);
+			uint64_t small = 0;
+			mp_int integer;
+			bool fits = get_number(small, integer, true, base,
+					       nr_digits);
 
 			if (m_file.peek() == '.') {
+				// Decimals are accumulated into the same
+				// mantissa as the integer part
 				size_t nr_decimals;
 				m_file.skip();
-				mp_int decimals(0);
-				get_number(decimals, base, valid_digits,
-					   nr_decimals);
-				mp_float d;
-				d = (mp_float)decimals / pow((mp_float) base, (mp_float) nr_digits);
-				d += integer;
-				d.precision(((nr_digits + nr_decimals) * base) / 10);
+				fits = get_number(small, integer, fits, base,
+						  nr_decimals);
 
 				// Ensure there's no trailing garbage
-				if (strchr(TOKEN_SEPARATORS, m_file.peek()) == NULL)
-					throw parser_error(
-						start_of_number,
-						m_file.get_position(),
-						"Trailing garbage after float constant");
+				if (strchr(TOKEN_SEPARATORS, m_file.peek()) == NULL) {
+					error(error_code_t::trailing_float,
+					      start_of_number);
+					continue;
+				}
 
 				// Return floating token
-				return new token_float_t(
-						start_of_number, d);
+				token = { start_of_number, m_floats.size(),
+					  token_kind_t::floating };
+				if (fits)
+					m_floats.emplace_back(base, small,
+							      nr_digits + nr_decimals,
+							      nr_decimals);
+				else
+					m_floats.emplace_back(base, integer,
+							      nr_digits + nr_decimals,
+							      nr_decimals);
+				return true;
 			}
 				
 			// Ensure there's no trailing garbage
-			if (strchr(TOKEN_SEPARATORS, m_file.peek()) == NULL)
-				throw parser_error(
-						start_of_number,
-						m_file.get_position(),
-						"Trailing garbage after integer constant");
+			if (strchr(TOKEN_SEPARATORS, m_file.peek()) == NULL) {
+				error(error_code_t::trailing_integer,
+				      start_of_number);
+				continue;
+			}
 
 
 			// Return integer token
-			return new token_integer_t(
-					start_of_number, integer);
+			if (fits) {
+				token = { start_of_number, small,
+					  token_kind_t::integer };
+			} else {
+				token = { start_of_number, m_integers.size(),
+					  token_kind_t::big_integer };
+				m_integers.push_back(std::move(integer));
+			}
+			return true;
 		}
 
 		if (ch == '"') {
 			// Handle strings
 
 			// Get start position for the string
-			const position_t string_start = m_file.get_position();
+			const size_t string_start = m_file.offset();
 
 			// Skip past current '"'
 			m_file.skip();
@@ -206,9 +406,16 @@ const token_t* tokenizer_t::next(void)
 			// Remember start of string
 			m_file.marker_start();
 			
-			// Skip until matching '"'
+			// Skip until matching '"', reaching end of input
+			// means the string is not terminated
 			hash_t hash;
 			m_file.skip_until_hashed('"', hash);
+			if (m_file.eof()) {
+				(void) m_file.marker_end();
+				error(error_code_t::unterminated_string,
+				      string_start);
+				continue;
+			}
 
 			// Create a string index from the string
 			const string_idx_t idx = m_env.sbucket().find_add_hashed(m_file.marker_end(), hash);
@@ -217,14 +424,15 @@ const token_t* tokenizer_t::next(void)
 			m_file.skip();
 
 			// Ensure there's no trailing garbage
-			if (strchr(TOKEN_SEPARATORS, m_file.peek()) == NULL)
-				throw parser_error(
-					string_start,
-					m_file.get_position(),
-					"Trailing garbage after string constant");
+			if (strchr(TOKEN_SEPARATORS, m_file.peek()) == NULL) {
+				error(error_code_t::trailing_string,
+				      string_start);
+				continue;
+			}
 
 			// Return string token
-			return new token_string_t(string_start, idx);
+			token = { string_start, idx, token_kind_t::string };
+			return true;
 		}
 
 		// If a comment, skip the rest of the line
@@ -233,49 +441,404 @@ const token_t* tokenizer_t::next(void)
 			continue;
 		}
 
-		// Check for single letter identifiers
-		bool is_single_letter_identifier = false;
-		if (strchr(SINGLE_LETTER_IDENTIFIERS, ch) != NULL)
-			is_single_letter_identifier = true;
-		
-		// Anything else becomes a name of an identifier
-		const position_t identifier_start = m_file.get_position();
+		// Single letter identifiers are reserved identifiers, so
+		// their string index is known without hashing
+		if ((ch != '\0') && (strchr(SINGLE_LETTER_IDENTIFIERS, ch) != NULL)) {
+			const size_t identifier_start = m_file.offset();
+			m_file.skip();
+
+			if (strchr(TOKEN_SEPARATORS, m_file.peek()) == NULL) {
+				error(error_code_t::invalid_identifier,
+				      identifier_start);
+				continue;
+			}
+
+			token = { identifier_start, reserved_find(&ch, 1),
+				  token_kind_t::identifier };
+			return true;
+		}
+
+		// Anything else becomes a name of an identifier, except that
+		// it must not start with '-', see ValidFirstChar in sisdel.ebnf
+		const size_t identifier_start = m_file.offset();
 		m_file.marker_start();
 		
 		// Skip until invalid character or token separator
 		hash_t hash;
 		const size_t size = m_file.skip_until_hashed(
-			IDENTIFIER_INVALID_CHARS, hash);
+			identifier_invalid_chars, hash);
 
-		if (size == 0)
-			throw parser_error(
-				identifier_start, m_file.get_position(),
-				"Invalid identifier name");
-		
-		if (strchr(TOKEN_SEPARATORS, m_file.peek()) == NULL)
-			throw parser_error(
-				identifier_start, m_file.get_position(),
-				"Invalid identifier name");
-
-		// Check that if this is supposed to be a single letter
-		// identifier, it doesn't consist of multiple letters
-		if (is_single_letter_identifier && (size > 1))
-			throw parser_error(
-				identifier_start, m_file.get_position(),
-				"Invalid identifier name");
+		if ((size == 0) || (ch == '-') ||
+		    (strchr(TOKEN_SEPARATORS, m_file.peek()) == NULL)) {
+			(void) m_file.marker_end();
+			error(error_code_t::invalid_identifier,
+			      identifier_start);
+			continue;
+		}
 
 		// Create a string index from the identifier name
 		const string_idx_t idx = m_env.sbucket().find_add_hashed(
 			m_file.marker_end(), hash);
 		
 		// Return identifier token
-		return new token_identifier_t(identifier_start, idx);
+		token = { identifier_start, idx, token_kind_t::identifier };
+		return true;
 	}
 
 	// No more input
+	return false;
+}
+
+// Read next token from the cache entry.
+void tokenizer_t::replay(compact_token_t& token)
+{
+	token = m_cached->next(m_cached_cursor);
+	m_next_cached++;
+	if ((token.kind == token_kind_t::string) ||
+	    (token.kind == token_kind_t::identifier))
+		token.value = m_cached_strings[token.value];
+}
+
+// Save scanned tokens in the cache. Only done once, also if saving fails.
+void tokenizer_t::store(void)
+{
+	token_cache_t& cache = *m_cache;
+	const std::vector<compact_token_t> scanned = std::move(m_scanned);
+	m_cache = nullptr;
+
+	// The whole file is in the window
+	const std::string_view contents(m_file.data() - m_file.offset(),
+					m_file.offset() + m_file.remaining());
+	cache.store(contents, scanned, m_env.sbucket(), m_integers, m_floats);
+}
+
+// Count and trace tokens given to the caller, and count bytes scanned
+// since last call. Tokens are counted when they are given to the caller
+// rather than when scanned, since next_all() scans chunks with string
+// indexes of their own, and drops some tokens.
+void tokenizer_t::account(std::span<const compact_token_t> tokens)
+{
+	static_assert(static_cast<size_t>(metric_t::tokens_floating) -
+		      static_cast<size_t>(metric_t::tokens_eol) ==
+		      static_cast<size_t>(token_kind_t::floating),
+		      "Token counters must be in token_kind_t order");
+
+	if constexpr (metrics_enabled) {
+		std::array<uint64_t, static_cast<size_t>(token_kind_t::floating) + 1> kinds{};
+		for (const compact_token_t& token : tokens)
+			kinds[static_cast<size_t>(token.kind)]++;
+		for (size_t kind = 0; kind < kinds.size(); kind++)
+			if (kinds[kind] != 0)
+				metrics_add(static_cast<metric_t>(
+					static_cast<size_t>(metric_t::tokens_eol) + kind),
+					kinds[kind]);
+
+		metrics_add(metric_t::bytes_scanned, m_file.offset() - m_counted);
+		m_counted = m_file.offset();
+	}
+
+	for (const compact_token_t& token : tokens)
+		SISDEL_TRACE(token, m_file.id(), static_cast<int>(token.kind),
+			     token.offset, token.value);
+}
+
+// Get next token, from the cache entry if there is one. Otherwise the
+// token is scanned, and saved for the cache if there is one.
+bool tokenizer_t::scan(compact_token_t& token)
+{
+	if (m_cached) {
+		if (m_next_cached == m_cached->nr_tokens())
+			return false;
+		replay(token);
+		account(std::span(&token, 1));
+		return true;
+	}
+
+	if (!lex(token)) {
+		account({});
+		if (m_cache != nullptr)
+			store();
+		return false;
+	}
+
+	if (m_cache != nullptr)
+		m_scanned.push_back(token);
+	account(std::span(&token, 1));
+	return true;
+}
+
+const token_t* tokenizer_t::next(void)
+{
+	compact_token_t token;
+
+	if (!scan(token))
+		return NULL;
+
+	const position_t pos(m_file.get_position(token.offset));
+
+	switch (token.kind) {
+	case token_kind_t::eol:
+		return new token_eol_t(pos, token.value);
+	case token_kind_t::string:
+		return new token_string_t(pos, token.value);
+	case token_kind_t::identifier:
+		return new token_identifier_t(pos, token.value);
+	case token_kind_t::integer:
+	case token_kind_t::big_integer:
+		return new token_integer_t(pos, integer(token));
+	case token_kind_t::floating:
+		return new token_float_t(pos, floating(token).to_mp_float());
+	}
+
 	return NULL;
 }
 
+size_t tokenizer_t::next_batch(std::span<compact_token_t> tokens)
+{
+	size_t count = 0;
+
+	if ((m_cache == nullptr) && !m_cached) {
+		while ((count < tokens.size()) && lex(tokens[count]))
+			count++;
+		account(tokens.first(count));
+		return count;
+	}
+
+	while ((count < tokens.size()) && scan(tokens[count]))
+		count++;
+
+	return count;
+}
+
+// Scan tokens starting before end, and append them to tokens. Scanning
+// stops at the first token starting at or after end, which is dropped
+// together with any literal it added. Returns offset after the last
+// appended token.
+size_t tokenizer_t::lex_until(size_t end, std::vector<compact_token_t>& tokens)
+{
+	size_t resume = m_file.offset();
+	compact_token_t token;
+
+	for (;;) {
+		const size_t nr_integers = m_integers.size();
+		const size_t nr_floats = m_floats.size();
+
+		if (!lex(token))
+			break;
+
+		if (token.offset >= end) {
+			m_integers.erase(m_integers.begin() + nr_integers,
+					 m_integers.end());
+			m_floats.erase(m_floats.begin() + nr_floats,
+				       m_floats.end());
+			break;
+		}
+
+		tokens.push_back(token);
+		resume = m_file.offset();
+	}
+
+	return resume;
+}
+
+// Find offsets where to cut [begin, end) into at most nr_chunks chunks,
+// returned including begin and end. Cuts are at '\n' characters not
+// preceded by another line break character. Sequential scanning is then
+// always between tokens when reaching a cut, unless a token spans it.
+static std::vector<size_t> find_cuts(const char *data, size_t begin,
+				     size_t end, size_t nr_chunks)
+{
+	std::vector<size_t> cuts{ begin };
+
+	for (size_t chunk = 1; chunk < nr_chunks; chunk++) {
+		size_t pos = begin + (end - begin) / nr_chunks * chunk;
+		if (pos <= cuts.back())
+			continue;
+
+		const char *found;
+		while ((found = static_cast<const char*>(
+				memchr(data + pos, '\n', end - pos))) != NULL) {
+			pos = static_cast<size_t>(found - data);
+			if (!newline_chars.contains(data[pos - 1]))
+				break;
+			pos++;
+		}
+		if (found == NULL)
+			break;
+
+		cuts.push_back(pos);
+	}
+
+	cuts.push_back(end);
+	return cuts;
+}
+
+size_t tokenizer_t::next_all(std::vector<compact_token_t>& tokens,
+			     work_pool_t& pool, size_t min_chunk_size)
+{
+	const size_t nr_before = tokens.size();
+	const size_t begin = m_file.offset();
+	compact_token_t token;
+
+	if (m_cached) {
+		while (scan(token))
+			tokens.push_back(token);
+		return tokens.size() - nr_before;
+	}
+
+	// Save tokens in the cache, if there is one
+	const auto finish = [&]() {
+		account(std::span(tokens).subspan(nr_before));
+		if (m_cache != nullptr) {
+			m_scanned.insert(m_scanned.end(),
+					 tokens.begin() + static_cast<ptrdiff_t>(nr_before),
+					 tokens.end());
+			store();
+		}
+		return tokens.size() - nr_before;
+	};
+
+	// Scanned by one chunk per worker, and some more to even out
+	// differences in chunk scanning time. Inputs refilling their window
+	// are loaded whole first, if they can be.
+	size_t nr_chunks = 1;
+	const bool whole = (pool.nr_workers() > 1) && m_file.load_all();
+	const size_t end = begin + m_file.remaining();
+	if (whole)
+		nr_chunks = std::min(pool.nr_workers() * 4,
+				     (end - begin) / std::max<size_t>(min_chunk_size, 1));
+
+	std::vector<size_t> cuts;
+	if (nr_chunks > 1)
+		cuts = find_cuts(m_file.data() - begin, begin, end, nr_chunks);
+
+	// Scan each chunk using its own string bucket. A chunk is valid if
+	// its last token ends before the next cut, since the next chunk
+	// then starts scanning in the same state as sequential scanning.
+	struct chunk_t {
+		std::unique_ptr<environment_t> env;
+		std::unique_ptr<tokenizer_t> lexer;
+		std::vector<compact_token_t> tokens;
+		std::vector<string_idx_t> strings;
+		size_t first_token = 0;
+		bool valid = false;
+	};
+	std::vector<chunk_t> chunks(cuts.empty() ? 0 : cuts.size() - 1);
+
+	pool.run(chunks.size(), [&](size_t idx, size_t) {
+		chunk_t& chunk = chunks[idx];
+		try {
+			chunk.env = std::make_unique<environment_t>();
+			chunk.lexer = std::make_unique<tokenizer_t>(*chunk.env,
+				std::make_unique<input_view_t>(m_file, cuts[idx]));
+			// The last chunk includes the end of line token at
+			// end of input
+			const size_t cut = (idx + 1 < chunks.size())
+				? cuts[idx + 1] : SIZE_MAX;
+			chunk.valid = chunk.lexer->lex_until(cut, chunk.tokens) <= cut;
+		}
+		catch (...) {
+			chunk.valid = false;
+		}
+	});
+
+	bool valid = (chunks.size() > 1);
+	for (const chunk_t& chunk : chunks)
+		valid = valid && chunk.valid;
+
+	if (!valid) {
+		// Sequential scanning gives the same exceptions as next_batch()
+		while (lex(token))
+			tokens.push_back(token);
+		return finish();
+	}
+
+	// Add strings to the environment bucket in chunk order, and in order
+	// of first appearance within each chunk, which is the order
+	// sequential scanning would add them
+	size_t nr_tokens = 0;
+	for (chunk_t& chunk : chunks) {
+		const class sbucket& strings = chunk.env->sbucket();
+		chunk.strings.resize(strings.size());
+		for (string_idx_t idx = 0; idx < strings.size(); idx++) {
+			const std::string_view str = strings.view(idx);
+			chunk.strings[idx] = m_env.sbucket().find_add_hashed(
+				str, hash_bytes(str.data(), str.size()));
+		}
+
+		chunk.first_token = nr_before + nr_tokens;
+		nr_tokens += chunk.tokens.size();
+	}
+
+	// Translate string indexes and literal table indexes while copying
+	// tokens to their final place
+	std::vector<size_t> first_integer, first_float;
+	for (chunk_t& chunk : chunks) {
+		first_integer.push_back(m_integers.size());
+		first_float.push_back(m_floats.size());
+		std::move(chunk.lexer->m_integers.begin(), chunk.lexer->m_integers.end(),
+			  std::back_inserter(m_integers));
+		std::move(chunk.lexer->m_floats.begin(), chunk.lexer->m_floats.end(),
+			  std::back_inserter(m_floats));
+	}
+
+	tokens.resize(nr_before + nr_tokens);
+	pool.run(chunks.size(), [&](size_t idx, size_t) {
+		const chunk_t& chunk = chunks[idx];
+		compact_token_t *dest = &tokens[chunk.first_token];
+
+		for (compact_token_t chunk_token : chunk.tokens) {
+			switch (chunk_token.kind) {
+			case token_kind_t::string:
+			case token_kind_t::identifier:
+				chunk_token.value = chunk.strings[chunk_token.value];
+				break;
+			case token_kind_t::big_integer:
+				chunk_token.value += first_integer[idx];
+				break;
+			case token_kind_t::floating:
+				chunk_token.value += first_float[idx];
+				break;
+			default:
+				break;
+			}
+			*dest++ = chunk_token;
+		}
+	});
+
+	m_file.skip_bytes(m_file.remaining());
+	return finish();
+}
+
+void tokenizer_t::print(std::ostream& os, const compact_token_t& token) const
+{
+	switch (token.kind) {
+	case token_kind_t::eol:
+		os << "token_eol_t(indent: " << token.value;
+		break;
+	case token_kind_t::string:
+		os << "token_string_t(" << token.value;
+		break;
+	case token_kind_t::identifier:
+		os << "token_identifier_t(" << token.value;
+		break;
+	case token_kind_t::integer:
+		os << "token_integer_t(" << token.value;
+		break;
+	case token_kind_t::big_integer:
+		os << "token_integer_t(" << integer(token);
+		break;
+	case token_kind_t::floating: {
+		const mp_float value(floating(token).to_mp_float());
+		os.precision(value.precision());
+		os << "token_float_t(" << value << ':' << value.precision();
+		break;
+	}
+	}
+
+	os << ')';
+}
+
 std::ostream& operator<<(std::ostream& os, const token_t& t)
 {
 	const std::type_info& ti = typeid(t);
@@ -0,0 +1,592 @@
+/*
+  Implementation of the token_cache_t class.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <system_error>
+#include <unordered_map>
+
+#include "token_cache.hh"
+#include "metrics.hh"
+#include "token.hh"
+
+/*
+ * Entry file layout, all sections aligned to 64 bytes:
+ *
+ *   cache_header_t
+ *   uint8_t[tokens_size]          Variable length encoded tokens
+ *   cache_string_t[nr_strings]    String table
+ *   cache_string_t[nr_integers]   Big integers, as decimal text
+ *   uint8_t[floats_size]          Variable length encoded floats
+ *   char[text_size]               Text of strings and big integers
+ *
+ * Each token is encoded as a LEB128 number holding the distance from the
+ * previous token offset shifted left 3 bits, and the kind in the low 3
+ * bits. It is followed by the token value as a LEB128 number, except
+ * for big_integer and floating tokens, whose values are the number of
+ * earlier tokens of the same kind. String values are string table
+ * indexes, numbered in order of first appearance.
+ *
+ * Floating point literals are encoded as LEB128 numbers: base shifted
+ * left 1 bit, with the low bit set if the mantissa does not fit in 64
+ * bits, then number of digits and number of decimals, and last the
+ * mantissa. For mantissas not fitting in 64 bits, the last number is
+ * instead the length of the mantissa as decimal text, which follows.
+ *
+ * Like sbucket images, other integers are stored in the byte order of
+ * the machine that wrote the entry.
+ */
+
+namespace {
+
+struct cache_header_t {
+	char magic[8];              // cache_magic
+	uint32_t version;           // cache_version
+	uint32_t tokenizer_version; // tokenizer_version
+	uint32_t hash_check;        // Hash of cache_magic, detects hash changes
+	uint32_t reserved;
+	uint64_t content_size;      // Size of source file
+	uint64_t content_hash;      // content_hash() of source file
+	uint64_t nr_tokens;
+	uint64_t nr_strings;
+	uint64_t nr_integers;
+	uint64_t nr_floats;
+	uint64_t tokens_offset;
+	uint64_t tokens_size;
+	uint64_t strings_offset;
+	uint64_t integers_offset;
+	uint64_t floats_offset;
+	uint64_t floats_size;
+	uint64_t text_offset;
+	uint64_t text_size;
+};
+
+struct cache_string_t {
+	uint64_t offset;            // Offset in text section
+	uint32_t length;
+	hash_t hash;                // Unused for big integers
+};
+
+// Decoded floating point literal
+struct cache_float_t {
+	uint64_t base;
+	uint64_t nr_digits;
+	uint64_t nr_decimals;
+	uint64_t mantissa;          // Mantissa, if it fits in 64 bits
+	std::string_view text;      // Otherwise, mantissa as decimal text
+};
+
+}
+
+static constexpr char cache_magic[8] = {'S', 'I', 'S', 'D', 'E', 'L', 'T', 'C'};
+
+// Increment when the entry format changes
+static constexpr uint32_t cache_version = 1;
+
+static constexpr size_t cache_alignment = 64;
+
+static inline uint64_t cache_align(uint64_t offset)
+{
+	return (offset + cache_alignment - 1) & ~(cache_alignment - 1);
+}
+
+static void put_leb128(std::string& out, uint64_t value)
+{
+	for (; value >= 0x80; value >>= 7)
+		out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+	out.push_back(static_cast<char>(value));
+}
+
+// Returns false if the number does not end before end, or is too long.
+static bool get_leb128(const uint8_t *&pos, const uint8_t *end, uint64_t& value)
+{
+	value = 0;
+	for (unsigned shift = 0; (pos < end) && (shift < 64); shift += 7) {
+		const uint8_t byte = *pos++;
+		value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+// Decode a token. Returns false if the encoding is not valid.
+static bool decode_token(const uint8_t *&pos, const uint8_t *end,
+			 token_cache_t::entry_t::cursor_t& cursor,
+			 compact_token_t& token)
+{
+	uint64_t delta_kind;
+	if (!get_leb128(pos, end, delta_kind))
+		return false;
+
+	token.offset = cursor.offset + (delta_kind >> 3);
+	token.kind = static_cast<token_kind_t>(delta_kind & 7);
+	cursor.offset = token.offset;
+
+	switch (token.kind) {
+	case token_kind_t::eol:
+	case token_kind_t::string:
+	case token_kind_t::identifier:
+	case token_kind_t::integer:
+		return get_leb128(pos, end, token.value);
+	case token_kind_t::big_integer:
+		token.value = cursor.nr_integers++;
+		return true;
+	case token_kind_t::floating:
+		token.value = cursor.nr_floats++;
+		return true;
+	}
+
+	return false;
+}
+
+// Decode a floating point literal. Returns false if the encoding is not
+// valid.
+static bool decode_float(const uint8_t *&pos, const uint8_t *end,
+			 cache_float_t& f)
+{
+	uint64_t base_big;
+	if (!get_leb128(pos, end, base_big) ||
+	    !get_leb128(pos, end, f.nr_digits) ||
+	    !get_leb128(pos, end, f.nr_decimals) ||
+	    !get_leb128(pos, end, f.mantissa))
+		return false;
+
+	f.base = base_big >> 1;
+	f.text = std::string_view();
+	if ((base_big & 1) != 0) {
+		if (f.mantissa > static_cast<uint64_t>(end - pos))
+			return false;
+		f.text = std::string_view(reinterpret_cast<const char*>(pos), f.mantissa);
+		pos += f.mantissa;
+	}
+
+	return (f.base >= 2) && (f.base <= 16);
+}
+
+// Check that a string is a decimal number, so that it can be converted
+// to mp_int.
+static bool is_decimal(std::string_view str)
+{
+	return !str.empty() &&
+		(str.find_first_not_of("0123456789") == std::string_view::npos);
+}
+
+// Seed for the second half of the content hash
+static constexpr uint64_t content_seed2 = 0x9e3779b97f4a7c15;
+
+// 64-bit content hash, made from two hashes with different seeds
+static uint64_t content_hash(std::string_view contents)
+{
+	return (static_cast<uint64_t>(hash_bytes(contents.data(), contents.size())) << 32)
+		| hash_bytes(contents.data(), contents.size(), content_seed2);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: token_cache_t::entry_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static const cache_header_t& header_of(const char *map)
+{
+	return *reinterpret_cast<const cache_header_t*>(map);
+}
+
+token_cache_t::entry_t::entry_t(const char *filename, std::string_view contents)
+	: m_file(filename, O_RDONLY), m_map(nullptr)
+{
+	if (m_file.size() < sizeof(cache_header_t))
+		throw std::system_error(EINVAL, std::generic_category(),
+					std::string(filename) + ": Not a token cache entry");
+
+	void * const map = mmap(NULL, m_file.size(), PROT_READ, MAP_PRIVATE,
+				m_file.fd(), 0);
+	if (map == MAP_FAILED)
+		throw std::system_error(errno, std::generic_category(), filename);
+	m_map = static_cast<const char*>(map);
+
+	try {
+		validate(filename, contents);
+	}
+	catch (...) {
+		munmap(map, m_file.size());
+		throw;
+	}
+}
+
+token_cache_t::entry_t::~entry_t()
+{
+	munmap(const_cast<char*>(m_map), m_file.size());
+}
+
+void token_cache_t::entry_t::validate(const char *filename,
+				      std::string_view contents) const
+{
+	const cache_header_t& h = header_of(m_map);
+	const auto fail = [filename](const char *what) {
+		throw std::system_error(EINVAL, std::generic_category(),
+					std::string(filename) + ": " + what);
+	};
+
+	if (memcmp(h.magic, cache_magic, sizeof(cache_magic)) != 0)
+		fail("Not a token cache entry");
+	if ((h.version != cache_version) ||
+	    (h.tokenizer_version != tokenizer_version))
+		fail("Unsupported token cache entry version");
+	if (h.hash_check != hash_bytes(cache_magic, sizeof(cache_magic)))
+		fail("Token cache entry uses another hash function");
+	if ((h.content_size != contents.size()) ||
+	    (h.content_hash != content_hash(contents)))
+		fail("Token cache entry is for another file");
+
+	// Sections must be within the file, in order, and not overlap
+	const uint64_t size = m_file.size();
+	const auto section = [&](uint64_t offset, uint64_t nr, size_t entry_size,
+				 uint64_t min_offset) {
+		if ((offset % cache_alignment != 0) || (offset < min_offset) ||
+		    (offset > size) || (nr > (size - offset) / entry_size))
+			fail("Corrupt token cache entry");
+		return offset + nr * entry_size;
+	};
+	uint64_t end = sizeof(cache_header_t);
+	end = section(h.tokens_offset, h.tokens_size, 1, end);
+	end = section(h.strings_offset, h.nr_strings, sizeof(cache_string_t), end);
+	end = section(h.integers_offset, h.nr_integers, sizeof(cache_string_t), end);
+	end = section(h.floats_offset, h.floats_size, 1, end);
+	section(h.text_offset, h.text_size, 1, end);
+
+	// Tokens must decode, and values and text references must be within
+	// their tables, so that a damaged entry is rejected rather than used
+	const uint8_t *pos = tokens();
+	const uint8_t * const tokens_end = pos + h.tokens_size;
+	cursor_t cursor;
+	for (size_t idx = 0; idx < h.nr_tokens; idx++) {
+		compact_token_t token;
+		if (!decode_token(pos, tokens_end, cursor, token) ||
+		    (token.offset > h.content_size) ||
+		    (((token.kind == token_kind_t::string) ||
+		      (token.kind == token_kind_t::identifier)) &&
+		     (token.value >= h.nr_strings)))
+			fail("Corrupt token cache entry");
+	}
+	if ((pos != tokens_end) || (cursor.nr_integers != h.nr_integers) ||
+	    (cursor.nr_floats != h.nr_floats))
+		fail("Corrupt token cache entry");
+
+	const auto check_strings = [&](uint64_t offset, uint64_t nr, bool decimal) {
+		const cache_string_t * const strings =
+			reinterpret_cast<const cache_string_t*>(m_map + offset);
+		for (size_t idx = 0; idx < nr; idx++)
+			if ((strings[idx].offset > h.text_size) ||
+			    (strings[idx].length > h.text_size - strings[idx].offset) ||
+			    (decimal && !is_decimal(std::string_view(
+				    m_map + h.text_offset + strings[idx].offset,
+				    strings[idx].length))))
+				fail("Corrupt token cache entry");
+	};
+	check_strings(h.strings_offset, h.nr_strings, false);
+	check_strings(h.integers_offset, h.nr_integers, true);
+
+	const uint8_t *float_pos = reinterpret_cast<const uint8_t*>(
+		m_map + h.floats_offset);
+	const uint8_t * const floats_end = float_pos + h.floats_size;
+	for (size_t idx = 0; idx < h.nr_floats; idx++) {
+		cache_float_t f;
+		if (!decode_float(float_pos, floats_end, f) ||
+		    (!f.text.empty() && !is_decimal(f.text)))
+			fail("Corrupt token cache entry");
+	}
+	if (float_pos != floats_end)
+		fail("Corrupt token cache entry");
+}
+
+size_t token_cache_t::entry_t::nr_tokens(void) const noexcept
+{
+	return header_of(m_map).nr_tokens;
+}
+
+const uint8_t *token_cache_t::entry_t::tokens(void) const noexcept
+{
+	return reinterpret_cast<const uint8_t*>(m_map + header_of(m_map).tokens_offset);
+}
+
+compact_token_t token_cache_t::entry_t::next(cursor_t& cursor) const noexcept
+{
+	// Already validated by the constructor
+	const uint8_t *pos = tokens() + cursor.pos;
+	compact_token_t token;
+	decode_token(pos, tokens() + header_of(m_map).tokens_size, cursor, token);
+	cursor.pos = static_cast<size_t>(pos - tokens());
+	return token;
+}
+
+size_t token_cache_t::entry_t::nr_strings(void) const noexcept
+{
+	return header_of(m_map).nr_strings;
+}
+
+std::string_view token_cache_t::entry_t::string(size_t idx) const noexcept
+{
+	const cache_header_t& h = header_of(m_map);
+	const cache_string_t& str = reinterpret_cast<const cache_string_t*>(
+		m_map + h.strings_offset)[idx];
+	return std::string_view(m_map + h.text_offset + str.offset, str.length);
+}
+
+hash_t token_cache_t::entry_t::string_hash(size_t idx) const noexcept
+{
+	return reinterpret_cast<const cache_string_t*>(
+		m_map + header_of(m_map).strings_offset)[idx].hash;
+}
+
+std::vector<mp_int> token_cache_t::entry_t::integers(void) const
+{
+	const cache_header_t& h = header_of(m_map);
+	const cache_string_t * const integers = reinterpret_cast<const cache_string_t*>(
+		m_map + h.integers_offset);
+	std::vector<mp_int> result;
+	result.reserve(h.nr_integers);
+
+	for (size_t idx = 0; idx < h.nr_integers; idx++)
+		result.emplace_back(std::string(m_map + h.text_offset + integers[idx].offset,
+						integers[idx].length));
+
+	return result;
+}
+
+std::vector<float_literal_t> token_cache_t::entry_t::floats(void) const
+{
+	const cache_header_t& h = header_of(m_map);
+	const uint8_t *pos = reinterpret_cast<const uint8_t*>(m_map + h.floats_offset);
+	const uint8_t * const end = pos + h.floats_size;
+	std::vector<float_literal_t> result;
+	result.reserve(h.nr_floats);
+
+	// Already validated by the constructor
+	for (size_t idx = 0; idx < h.nr_floats; idx++) {
+		cache_float_t f;
+		decode_float(pos, end, f);
+		if (f.text.empty())
+			result.emplace_back(static_cast<unsigned>(f.base), f.mantissa,
+					    f.nr_digits, f.nr_decimals);
+		else
+			result.emplace_back(static_cast<unsigned>(f.base),
+					    mp_int(std::string(f.text)),
+					    f.nr_digits, f.nr_decimals);
+	}
+
+	return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: token_cache_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+token_cache_t::token_cache_t(const char *directory)
+	: m_directory(directory), m_nr_hits(0), m_nr_misses(0), m_nr_stores(0)
+{
+	if ((mkdir(directory, 0777) != 0) && (errno != EEXIST))
+		throw std::system_error(errno, std::generic_category(), directory);
+}
+
+token_cache_t::~token_cache_t()
+{
+}
+
+std::string token_cache_t::path(std::string_view contents) const
+{
+	char name[64];
+	snprintf(name, sizeof(name), "/%016" PRIx64 "-%" PRIu32 ".tok",
+		 content_hash(contents), tokenizer_version);
+	return m_directory + name;
+}
+
+std::unique_ptr<const token_cache_t::entry_t> token_cache_t::find(
+	std::string_view contents)
+{
+	const metrics_timer_t timer(phase_t::cache);
+	const std::string filename = path(contents);
+
+	// Entries that can not be used are the same as missing entries,
+	// they are replaced when the file has been scanned
+	try {
+		auto entry = std::make_unique<const entry_t>(filename.c_str(), contents);
+		m_nr_hits.fetch_add(1, std::memory_order_relaxed);
+		return entry;
+	}
+	catch (const std::system_error&) {
+		m_nr_misses.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+}
+
+void token_cache_t::store(std::string_view contents,
+			  std::span<const compact_token_t> tokens,
+			  const sbucket& strings,
+			  const std::vector<mp_int>& integers,
+			  const std::vector<float_literal_t>& floats)
+{
+	const metrics_timer_t timer(phase_t::cache);
+	cache_header_t header = {};
+	memcpy(header.magic, cache_magic, sizeof(cache_magic));
+	header.version = cache_version;
+	header.tokenizer_version = tokenizer_version;
+	header.hash_check = hash_bytes(cache_magic, sizeof(cache_magic));
+	header.content_size = contents.size();
+	header.content_hash = content_hash(contents);
+
+	// Strings are numbered in order of first appearance
+	std::string text;
+	std::string cache_tokens;
+	std::vector<cache_string_t> cache_strings;
+	std::unordered_map<string_idx_t, uint64_t> string_map;
+	size_t previous_offset = 0;
+
+	for (const compact_token_t& token : tokens) {
+		put_leb128(cache_tokens, ((token.offset - previous_offset) << 3) |
+			   static_cast<uint8_t>(token.kind));
+		previous_offset = token.offset;
+
+		uint64_t value = token.value;
+		if ((token.kind == token_kind_t::big_integer) ||
+		    (token.kind == token_kind_t::floating))
+			continue;
+		if ((token.kind == token_kind_t::string) ||
+		    (token.kind == token_kind_t::identifier)) {
+			const auto [it, added] = string_map.try_emplace(
+				token.value, cache_strings.size());
+			if (added) {
+				const std::string_view str = strings.view(token.value);
+				cache_strings.push_back(cache_string_t{
+					text.size(), static_cast<uint32_t>(str.size()),
+					hash_bytes(str.data(), str.size())});
+				text.append(str);
+			}
+			value = it->second;
+		}
+		put_leb128(cache_tokens, value);
+	}
+
+	for (const mp_int& integer : integers) {
+		const std::string str = integer.str();
+		cache_strings.push_back(cache_string_t{
+			text.size(), static_cast<uint32_t>(str.size()), 0});
+		text.append(str);
+	}
+
+	std::string cache_floats;
+	for (const float_literal_t& f : floats) {
+		const mp_int mantissa = f.mantissa();
+		const bool big = (mantissa > UINT64_MAX);
+		put_leb128(cache_floats, (f.base() << 1) | (big ? 1 : 0));
+		put_leb128(cache_floats, f.nr_digits());
+		put_leb128(cache_floats, f.nr_decimals());
+		if (big) {
+			const std::string str = mantissa.str();
+			put_leb128(cache_floats, str.size());
+			cache_floats.append(str);
+		} else {
+			put_leb128(cache_floats, static_cast<uint64_t>(mantissa));
+		}
+	}
+
+	header.nr_tokens = tokens.size();
+	header.tokens_size = cache_tokens.size();
+	header.nr_strings = cache_strings.size() - integers.size();
+	header.nr_integers = integers.size();
+	header.nr_floats = floats.size();
+	header.floats_size = cache_floats.size();
+	header.tokens_offset = cache_align(sizeof(header));
+	header.strings_offset = cache_align(header.tokens_offset +
+					    header.tokens_size);
+	header.integers_offset = cache_align(header.strings_offset +
+					     header.nr_strings * sizeof(cache_string_t));
+	header.floats_offset = cache_align(header.integers_offset +
+					   header.nr_integers * sizeof(cache_string_t));
+	header.text_offset = cache_align(header.floats_offset +
+					 header.floats_size);
+	header.text_size = text.size();
+
+	// Write to a uniquely named temporary file, and rename it when
+	// complete, so that concurrent writers and readers of the same
+	// entry are not affected
+	const std::string filename = path(contents);
+	std::string tmp_filename = filename + ".XXXXXX";
+	const int fd = mkstemp(tmp_filename.data());
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(), tmp_filename);
+	FILE * const file = fdopen(fd, "wb");
+	if (file == NULL) {
+		const int err = errno;
+		close(fd);
+		unlink(tmp_filename.c_str());
+		throw std::system_error(err, std::generic_category(), tmp_filename);
+	}
+
+	uint64_t offset = 0;
+	const auto write = [&](const void *data, size_t size) {
+		if (fwrite(data, 1, size, file) != size) {
+			const int err = errno;
+			fclose(file);
+			unlink(tmp_filename.c_str());
+			throw std::system_error(err, std::generic_category(),
+						tmp_filename);
+		}
+		offset += size;
+	};
+	const auto pad_to = [&](uint64_t to) {
+		static const char zeros[cache_alignment] = {};
+		write(zeros, to - offset);
+	};
+
+	write(&header, sizeof(header));
+	pad_to(header.tokens_offset);
+	write(cache_tokens.data(), cache_tokens.size());
+	pad_to(header.strings_offset);
+	write(cache_strings.data(), header.nr_strings * sizeof(cache_string_t));
+	pad_to(header.integers_offset);
+	write(cache_strings.data() + header.nr_strings,
+	      header.nr_integers * sizeof(cache_string_t));
+	pad_to(header.floats_offset);
+	write(cache_floats.data(), cache_floats.size());
+	pad_to(header.text_offset);
+	write(text.data(), text.size());
+
+	if (fclose(file) != 0) {
+		const int err = errno;
+		unlink(tmp_filename.c_str());
+		throw std::system_error(err, std::generic_category(), tmp_filename);
+	}
+
+	// mkstemp() creates the file readable by the owner only
+	chmod(tmp_filename.c_str(), 0644);
+
+	if (rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+		const int err = errno;
+		unlink(tmp_filename.c_str());
+		throw std::system_error(err, std::generic_category(), filename);
+	}
+
+	m_nr_stores.fetch_add(1, std::memory_order_relaxed);
+}
+
+token_cache_t::stats_t token_cache_t::stats(void) const noexcept
+{
+	return { m_nr_hits.load(std::memory_order_relaxed),
+		 m_nr_misses.load(std::memory_order_relaxed),
+		 m_nr_stores.load(std::memory_order_relaxed) };
+}
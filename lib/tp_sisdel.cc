@@ -0,0 +1,12 @@
+/*
+  Probes of the tp_sisdel LTTng tracepoint provider.
+  Only built when tracepoints are enabled.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#define TRACEPOINT_CREATE_PROBES
+#define TRACEPOINT_DEFINE
+
+#include "tp_sisdel.hh"
@@ -0,0 +1,349 @@
+/*
+  Implementation of UTF-8 validation.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <string.h>
+
+#include "char_class.hh"
+#include "utf8.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define UTF8_X86 1
+#include <immintrin.h>
+#else
+#define UTF8_X86 0
+#endif
+
+// High bit of every byte in a word.
+static constexpr uint64_t high_bits = 0x8080808080808080ULL;
+
+static uint64_t load_word(const char *p)
+{
+	uint64_t word;
+	memcpy(&word, p, sizeof(word));
+	return word;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Validation kernels
+//
+// All kernels start at a sequence boundary, or continue a sequence the
+// validator is in, and validate all of [p, end).
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static void validate_words(utf8_validator_t& validator, const char *p,
+			   const char *end, const char *begin, size_t offset,
+			   std::vector<size_t>& invalid)
+{
+	while (p < end) {
+		while (!validator.in_sequence() && (end - p >= 8) &&
+		       ((load_word(p) & high_bits) == 0))
+			p += 8;
+		p = validator.validate_scalar(p, p + 8, end, begin, offset, invalid);
+	}
+}
+
+#if UTF8_X86
+
+static void validate_sse2(utf8_validator_t& validator, const char *p,
+			  const char *end, const char *begin, size_t offset,
+			  std::vector<size_t>& invalid)
+{
+	while (p < end) {
+		while (!validator.in_sequence() && (end - p >= 16) &&
+		       (_mm_movemask_epi8(_mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(p))) == 0))
+			p += 16;
+		p = validator.validate_scalar(p, p + 16, end, begin, offset, invalid);
+	}
+}
+
+// Error bits of the lookup tables, see Keiser and Lemire. Each table
+// gives the errors a byte or nibble may be part of, and the bitwise and
+// of them the errors there are.
+enum : uint8_t {
+	TOO_SHORT = 1 << 0,      // Lead byte followed by lead or ASCII byte.
+	TOO_LONG = 1 << 1,       // ASCII byte followed by continuation.
+	OVERLONG_3 = 1 << 2,     // E0 followed by 80-9F.
+	TOO_LARGE = 1 << 3,      // F4 followed by 90-BF, or F5-FF.
+	SURROGATE = 1 << 4,      // ED followed by A0-BF.
+	OVERLONG_2 = 1 << 5,     // C0 or C1.
+	TOO_LARGE_1000 = 1 << 6, // F5-FF followed by 80-8F.
+	OVERLONG_4 = 1 << 6,     // F0 followed by 80-8F.
+	TWO_CONTS = 1 << 7,      // Continuation followed by continuation.
+	CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS
+};
+
+__attribute__((target("avx2")))
+static __m256i lookup16(__m256i nibbles, const uint8_t (&table)[16])
+{
+	const __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table));
+	return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(half), nibbles);
+}
+
+// Bytes of input preceded by the last n bytes of prev.
+#define PREV_BYTES(input, prev, n) \
+	_mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - (n))
+
+// Errors of each byte in input, given the 32 bytes before it.
+__attribute__((target("avx2")))
+static __m256i block_errors(__m256i input, __m256i prev)
+{
+	static const uint8_t byte_1_high[16] = {
+		// 0_______
+		TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+		TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+		// 10______
+		TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+		// 1100____
+		TOO_SHORT | OVERLONG_2,
+		// 1101____
+		TOO_SHORT,
+		// 1110____
+		TOO_SHORT | OVERLONG_3 | SURROGATE,
+		// 1111____
+		TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+	};
+	static const uint8_t byte_1_low[16] = {
+		// ____0000
+		CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+		// ____0001
+		CARRY | OVERLONG_2,
+		// ____001_
+		CARRY,
+		CARRY,
+		// ____0100
+		CARRY | TOO_LARGE,
+		// ____0101
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		// ____011_
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		// ____1___
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		// ____1101
+		CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000
+	};
+	static const uint8_t byte_2_high[16] = {
+		// 0_______
+		TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+		TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+		// 1000____
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+		// 1001____
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+		// 101_____
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+		// 11______
+		TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+	};
+
+	const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+	const __m256i prev1 = PREV_BYTES(input, prev, 1);
+
+	// Errors given by each pair of bytes
+	const __m256i special = _mm256_and_si256(
+		_mm256_and_si256(
+			lookup16(_mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_nibble),
+				 byte_1_high),
+			lookup16(_mm256_and_si256(prev1, low_nibble), byte_1_low)),
+		lookup16(_mm256_and_si256(_mm256_srli_epi16(input, 4), low_nibble),
+			 byte_2_high));
+
+	// The third and fourth byte of a sequence must be continuations,
+	// which is when the pair check found TWO_CONTS
+	const __m256i third = _mm256_subs_epu8(PREV_BYTES(input, prev, 2),
+					       _mm256_set1_epi8(static_cast<char>(0xe0 - 0x80)));
+	const __m256i fourth = _mm256_subs_epu8(PREV_BYTES(input, prev, 3),
+						_mm256_set1_epi8(static_cast<char>(0xf0 - 0x80)));
+	const __m256i must_be_continuation = _mm256_and_si256(
+		_mm256_or_si256(third, fourth),
+		_mm256_set1_epi8(static_cast<char>(0x80)));
+
+	return _mm256_xor_si256(must_be_continuation, special);
+}
+
+// Find the sequence boundary at or before p, given that [floor, p) is
+// valid UTF-8 except for a sequence not yet complete at p.
+static const char *sequence_start(const char *p, const char *floor)
+{
+	const char *q = p;
+	while ((q > floor) && (p - q < 3) &&
+	       ((static_cast<uint8_t>(q[-1]) & 0xc0) == 0x80))
+		q--;
+	if ((q > floor) && ((static_cast<uint8_t>(q[-1]) & 0xc0) == 0xc0))
+		return q - 1;
+	return p;
+}
+
+__attribute__((target("avx2")))
+static void validate_avx2(utf8_validator_t& validator, const char *p,
+			  const char *end, const char *begin, size_t offset,
+			  std::vector<size_t>& invalid)
+{
+	// Blocks are checked together with the 32 bytes before them, so
+	// start at a sequence boundary, with the bytes before taken as ASCII
+	if (validator.in_sequence())
+		p = validator.validate_scalar(p, p, end, begin, offset, invalid);
+
+	const char *floor = p;
+	__m256i prev = _mm256_setzero_si256();
+	bool prev_ascii = true;
+
+	while (end - p >= 32) {
+		const __m256i input = _mm256_loadu_si256(
+			reinterpret_cast<const __m256i*>(p));
+		const bool ascii = (_mm256_movemask_epi8(input) == 0);
+		const __m256i errors = (ascii && prev_ascii) ?
+			_mm256_setzero_si256() : block_errors(input, prev);
+
+		if (!_mm256_testz_si256(errors, errors)) {
+			// Locate the errors one byte at a time, and restart
+			// at the next sequence boundary
+			p = validator.validate_scalar(sequence_start(p, floor), p + 32,
+						      end, begin, offset, invalid);
+			floor = p;
+			prev = _mm256_setzero_si256();
+			prev_ascii = true;
+			continue;
+		}
+
+		prev = input;
+		prev_ascii = ascii;
+		p += 32;
+	}
+
+	// A sequence left incomplete by the last block is completed, or
+	// found to be invalid, by the scalar validation of the tail
+	validate_words(validator, sequence_start(p, floor), end, begin, offset,
+		       invalid);
+}
+
+#endif // UTF8_X86
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: utf8_validator_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+const char *utf8_validator_t::validate_scalar(const char *p, const char *stop,
+					      const char *end, const char *begin,
+					      size_t offset,
+					      std::vector<size_t>& invalid)
+{
+	while ((p < end) && ((p < stop) || (m_remaining > 0))) {
+		const uint8_t byte = static_cast<uint8_t>(*p);
+		const size_t at = offset + static_cast<size_t>(p - begin);
+
+		if (m_remaining > 0) {
+			if ((byte >= m_low) && (byte <= m_high)) {
+				m_remaining--;
+				m_low = 0x80;
+				m_high = 0xbf;
+				p++;
+				continue;
+			}
+
+			// Not a continuation, the byte is validated again as
+			// the start of the next sequence
+			invalid.push_back(m_start);
+			m_remaining = 0;
+			m_low = 0x80;
+			m_high = 0xbf;
+			continue;
+		}
+
+		p++;
+		if (byte < 0x80)
+			continue;
+
+		m_start = at;
+		if ((byte >= 0xc2) && (byte <= 0xdf)) {
+			m_remaining = 1;
+		} else if (byte == 0xe0) {
+			m_remaining = 2;
+			m_low = 0xa0;
+		} else if (byte == 0xed) {
+			m_remaining = 2;
+			m_high = 0x9f;
+		} else if ((byte >= 0xe1) && (byte <= 0xef)) {
+			m_remaining = 2;
+		} else if (byte == 0xf0) {
+			m_remaining = 3;
+			m_low = 0x90;
+		} else if ((byte >= 0xf1) && (byte <= 0xf3)) {
+			m_remaining = 3;
+		} else if (byte == 0xf4) {
+			m_remaining = 3;
+			m_high = 0x8f;
+		} else {
+			invalid.push_back(at);
+		}
+	}
+
+	return p;
+}
+
+void utf8_validator_t::validate(const char *begin, const char *end,
+				size_t offset, std::vector<size_t>& invalid)
+{
+	switch (char_class_t::simd_level()) {
+#if UTF8_X86
+	case simd_level_t::avx2:
+		validate_avx2(*this, begin, end, begin, offset, invalid);
+		break;
+	case simd_level_t::sse2:
+		validate_sse2(*this, begin, end, begin, offset, invalid);
+		break;
+#endif
+	default:
+		validate_words(*this, begin, end, begin, offset, invalid);
+		break;
+	}
+}
+
+void utf8_validator_t::finish(std::vector<size_t>& invalid)
+{
+	if (m_remaining > 0)
+		invalid.push_back(m_start);
+
+	m_remaining = 0;
+	m_low = 0x80;
+	m_high = 0xbf;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Code point counting
+//
+///////////////////////////////////////////////////////////////////////////////
+
+size_t utf8_length(const char *begin, const char *end) noexcept
+{
+	size_t length = static_cast<size_t>(end - begin);
+
+	// Continuation bytes have the high bit set and the next bit cleared
+	for (; end - begin >= 8; begin += 8) {
+		const uint64_t word = load_word(begin);
+		length -= static_cast<size_t>(
+			__builtin_popcountll(word & ~(word << 1) & high_bits));
+	}
+	for (; begin < end; begin++)
+		if ((static_cast<uint8_t>(*begin) & 0xc0) == 0x80)
+			length--;
+
+	return length;
+}
@@ -0,0 +1,152 @@
+/*
+  Implementation of the work_pool_t class.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <algorithm>
+
+#include "work_pool.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Class: work_pool_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+work_pool_t::work_pool_t(size_t nr_workers)
+	: m_queues(), m_threads(), m_nr_steals(0)
+{
+	if (nr_workers == 0)
+		nr_workers = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (size_t worker = 0; worker < nr_workers; worker++)
+		m_queues.emplace_back(new queue_t);
+
+	// Worker 0 is the thread calling run()
+	for (size_t worker = 1; worker < nr_workers; worker++)
+		m_threads.emplace_back(&work_pool_t::thread_main, this, worker);
+}
+
+work_pool_t::~work_pool_t()
+{
+	{
+		const std::lock_guard<std::mutex> guard(m_lock);
+		m_stop = true;
+	}
+	m_wakeup.notify_all();
+
+	for (auto& thread : m_threads)
+		thread.join();
+}
+
+void work_pool_t::run(std::span<const size_t> order, const task_fn_t& fn)
+{
+	if (order.empty())
+		return;
+
+	// Deal tasks round-robin, so every worker starts with one of the
+	// first tasks in the order
+	const size_t nr_queues = m_queues.size();
+	for (auto& queue : m_queues) {
+		queue->tasks.clear();
+		queue->front = 0;
+	}
+	for (size_t idx = 0; idx < order.size(); idx++)
+		m_queues[idx % nr_queues]->tasks.push_back(order[idx]);
+
+	{
+		const std::lock_guard<std::mutex> guard(m_lock);
+		m_fn = &fn;
+		m_error = nullptr;
+		m_nr_busy = nr_queues;
+		m_generation++;
+	}
+	m_wakeup.notify_all();
+
+	work(0);
+
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_nr_busy--;
+	m_done.wait(lock, [this]() { return m_nr_busy == 0; });
+	m_fn = nullptr;
+
+	if (m_error)
+		std::rethrow_exception(m_error);
+}
+
+void work_pool_t::run(size_t nr_tasks, const task_fn_t& fn)
+{
+	std::vector<size_t> order(nr_tasks);
+	for (size_t idx = 0; idx < nr_tasks; idx++)
+		order[idx] = idx;
+
+	run(order, fn);
+}
+
+bool work_pool_t::next_task(size_t worker, size_t& task)
+{
+	{
+		queue_t& own = *m_queues[worker];
+		const std::lock_guard<std::mutex> guard(own.lock);
+		if (own.front < own.tasks.size()) {
+			task = own.tasks[own.front++];
+			return true;
+		}
+	}
+
+	// Steal from the back, i.e. the task the owner would start last
+	for (size_t distance = 1; distance < m_queues.size(); distance++) {
+		queue_t& victim = *m_queues[(worker + distance) % m_queues.size()];
+		const std::lock_guard<std::mutex> guard(victim.lock);
+		if (victim.front < victim.tasks.size()) {
+			task = victim.tasks.back();
+			victim.tasks.pop_back();
+			m_nr_steals.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	// Tasks do not add tasks, so all queues stay empty
+	return false;
+}
+
+void work_pool_t::work(size_t worker)
+{
+	size_t task;
+
+	while (next_task(worker, task)) {
+		try {
+			(*m_fn)(task, worker);
+		}
+		catch (...) {
+			const std::lock_guard<std::mutex> guard(m_lock);
+			if (!m_error)
+				m_error = std::current_exception();
+		}
+	}
+}
+
+void work_pool_t::thread_main(size_t worker)
+{
+	size_t generation = 0;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			m_wakeup.wait(lock, [&]() {
+				return m_stop || (m_generation != generation);
+			});
+			if (m_stop)
+				return;
+			generation = m_generation;
+		}
+
+		work(worker);
+
+		const std::lock_guard<std::mutex> guard(m_lock);
+		if (--m_nr_busy == 0)
+			m_done.notify_all();
+	}
+}
@@ -1,58 +1,298 @@
 /*
   This file implements the unit test for the tokenizer_t class.
-  
+
   SPDX-License-Identifier: MIT
 
  */
 
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <memory>
 #include <system_error>
 #include <iostream>
 #include "token.hh"
+#include "stream_file.hh"
+#include "module_tree.hh"
+#include "metrics.hh"
+
+static void usage(const char *name)
+{
+	std::cerr << "Usage: " << name << " [-j threads] [-e extension] [-c directory] [-i image] [-k] [--stats[=json]] <file|directory|->\n"
+		  << "  Tokenize a file and print its tokens, or tokenize all modules\n"
+		  << "  in a directory tree and print statistics. \"-\" reads standard\n"
+		  << "  input.\n"
+		  << "  -j threads    Number of threads, default is number of hardware\n"
+		  << "                threads for directories, and 1 for files\n"
+		  << "  -e extension  Only tokenize files ending with extension\n"
+		  << "  -c directory  Token cache directory, files found in the cache\n"
+		  << "                are not scanned\n"
+		  << "  -i image      String bucket image, used to warm start when\n"
+		  << "                it exists, and saved when done\n"
+		  << "  -k            Keep going after errors in a file, and report all\n"
+		  << "                of them when done\n"
+		  << "  --stats[=format]\n"
+		  << "                Print performance counters to standard error\n"
+		  << "                when done, format is text (default) or json\n";
+}
+
+// Format of performance counters, if they are to be printed
+static bool print_stats = false;
+static metrics_format_t stats_format = metrics_format_t::text;
+
+// Print performance counters, if asked for
+static void report_stats(const sbucket& strings)
+{
+	if (!print_stats)
+		return;
+
+	if (!metrics_enabled)
+		std::cerr << "Performance counters are not enabled in this build\n";
+	metrics_print(std::cerr, metrics_snapshot(), stats_format, &strings);
+}
+
+// Create environment, warm started from the string bucket image if given
+// and it exists
+static std::unique_ptr<environment_t> make_environment(const char *image,
+						       sbucket_mode_t mode)
+{
+	if ((image != NULL) && (access(image, F_OK) == 0))
+		return std::make_unique<environment_t>(image, mode);
+	return std::make_unique<environment_t>(mode);
+}
+
+// Save string bucket image, if asked for
+static void save_image(const environment_t& env, const char *image)
+{
+	if (image != NULL)
+		env.sbucket().save(image);
+}
+
+// Print all tokens of a file
+static void print_tokens(tokenizer_t& lexer)
+{
+	std::array<compact_token_t, 256> tokens;
+
+	for (;;) {
+		size_t nr;
+		{
+			const metrics_timer_t timer(phase_t::scan);
+			nr = lexer.next_batch(tokens);
+		}
+		if (nr == 0)
+			break;
+
+		const metrics_timer_t timer(phase_t::output);
+		for (size_t idx = 0; idx < nr; idx++) {
+			lexer.print(std::cout, tokens[idx]);
+			switch (tokens[idx].kind) {
+			case token_kind_t::eol:
+				std::cout << '\n';
+				break;
+			default:
+				std::cout << ' ';
+				break;
+			}
+		}
+	}
+
+	std::cout << '\n';
+}
+
+// Print all tokens of a file, scanned by several threads
+static void print_tokens(tokenizer_t& lexer, size_t nr_threads)
+{
+	work_pool_t pool(nr_threads);
+	std::vector<compact_token_t> tokens;
+	{
+		const metrics_timer_t timer(phase_t::scan);
+		lexer.next_all(tokens, pool);
+	}
+
+	const metrics_timer_t timer(phase_t::output);
+	for (const compact_token_t& token : tokens) {
+		lexer.print(std::cout, token);
+		std::cout << ((token.kind == token_kind_t::eol) ? '\n' : ' ');
+	}
 
-int main(int argc, const char *argv[])
+	std::cout << '\n';
+}
+
+// Tokenize all modules in a directory tree, print per module results
+// sorted by path, and aggregate throughput. Returns number of modules
+// that failed.
+static size_t tokenize_tree(environment_t& env, const char *root,
+			    const char *extension, size_t nr_threads,
+			    token_cache_t *cache)
+{
+	work_pool_t pool(nr_threads);
+
+	const std::vector<module_file_t> files = find_modules(root, extension);
+
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<module_result_t> results;
+	{
+		const metrics_timer_t timer(phase_t::scan);
+		results = tokenize_modules(env, files, pool, cache);
+	}
+	const double seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	const metrics_timer_t timer(phase_t::output);
+
+	size_t nr_bytes = 0, nr_tokens = 0, nr_errors = 0;
+	for (size_t idx = 0; idx < files.size(); idx++) {
+		const module_result_t& result = results[idx];
+		nr_bytes += files[idx].size;
+		nr_tokens += result.nr_tokens;
+
+		std::cout << files[idx].path << ": " << files[idx].size
+			  << " bytes, " << result.nr_tokens << " tokens, "
+			  << result.seconds * 1e3 << " ms\n";
+		if (!result.error.empty()) {
+			std::cout << result.error << '\n';
+			nr_errors++;
+		}
+	}
+
+	std::cout << files.size() << " modules, " << nr_errors << " failed, "
+		  << nr_bytes << " bytes, " << nr_tokens << " tokens, "
+		  << pool.nr_workers() << " threads, " << pool.nr_steals()
+		  << " steals\n";
+	if (cache != nullptr)
+		std::cout << cache->stats().nr_hits << " cache hits, "
+			  << cache->stats().nr_stores << " cache stores\n";
+	std::cout << seconds << " s, "
+		  << static_cast<double>(nr_bytes) / seconds / 1e6 << " MB/s, "
+		  << static_cast<double>(nr_tokens) / seconds / 1e6 << " Mtokens/s\n";
+
+	return nr_errors;
+}
+
+int main(int argc, char * const argv[])
 {
-	if (argc != 2) {
+	size_t nr_threads = 0;
+	const char *extension = NULL;
+	const char *cache_directory = NULL;
+	const char *image = NULL;
+	bool keep_going = false;
+
+	static const struct option long_options[] = {
+		{ "stats", optional_argument, NULL, 's' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	for (int opt; (opt = getopt_long(argc, argv, "j:e:c:i:kh", long_options, NULL)) != -1; ) {
+		switch (opt) {
+		case 's':
+			print_stats = true;
+			if ((optarg == NULL) || (strcmp(optarg, "text") == 0)) {
+				stats_format = metrics_format_t::text;
+			} else if (strcmp(optarg, "json") == 0) {
+				stats_format = metrics_format_t::json;
+			} else {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'j':
+			nr_threads = strtoul(optarg, NULL, 10);
+			break;
+		case 'e':
+			extension = optarg;
+			break;
+		case 'c':
+			cache_directory = optarg;
+			break;
+		case 'i':
+			image = optarg;
+			break;
+		case 'k':
+			keep_going = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc - 1) {
 		std::cerr << "Expected file name to be parsed! Aborting.\n";
+		usage(argv[0]);
 		return 1;
 	}
+	const char * const name = argv[optind];
+
+	// Kept outside the try block, so that performance counters can be
+	// printed also when tokenizing failed
+	std::unique_ptr<environment_t> env;
+	int rc = 0;
 
-	environment_t e;
-	tokenizer_t lexer(e, argv[1]);
-	
 	try {
-		for (const token_t* t = lexer.next();
-		     t != NULL;
-		     t = lexer.next()) {
-			std::cout << *t;
-			if (typeid(*t) == typeid(token_eol_t))
-				std::cout << '\n';
+		std::unique_ptr<token_cache_t> cache;
+		if (cache_directory != NULL)
+			cache = std::make_unique<token_cache_t>(cache_directory);
+
+		if (std::filesystem::is_directory(name)) {
+			env = make_environment(image, sbucket_mode_t::concurrent);
+			const size_t nr_errors = tokenize_tree(
+				*env, name, extension, nr_threads, cache.get());
+			save_image(*env, image);
+			rc = (nr_errors == 0) ? 0 : 2;
+		} else {
+			// "-" reads standard input, which may be a pipe
+			env = make_environment(image, sbucket_mode_t::single_thread);
+			environment_t& e = *env;
+			tokenizer_t lexer = (strcmp(name, "-") == 0)
+				? tokenizer_t(e, std::make_unique<stream_file_t>(e, STDIN_FILENO, "<stdin>"))
+				: cache ? tokenizer_t(e, name, *cache) : tokenizer_t(e, name);
+
+			diagnostics_t diagnostics;
+			if (keep_going)
+				lexer.set_diagnostics(&diagnostics);
+
+			if (nr_threads > 1)
+				print_tokens(lexer, nr_threads);
 			else
-				std::cout << ' ';
-			delete t;
+				print_tokens(lexer);
+
+			// Printed while the input is still there
+			diagnostics.print(std::cerr);
+
+			save_image(e, image);
+
+			if (!diagnostics.empty()) {
+				std::cerr << diagnostics.size() << " errors\n";
+				rc = 2;
+			}
 		}
 	}
 
 	catch (const parser_error& e) {
 		std::cerr << "\nParser error: " << e.what() << "\n";
-		return 2;
+		rc = 2;
 	}
-	
+
 	catch (const std::system_error& e) {
 		std::cerr << "\nSystem error: " << e.what() << "\n";
-		return 3;
+		rc = 3;
 	}
 
 	catch (const std::runtime_error& e) {
 		std::cerr << "\nRuntime error: " << e.what() << "\n";
-		return 4;
+		rc = 4;
 	}
 
 	catch (...) {
 		std::cerr << "\nUnknown error " << "\n";
-		return 5;
+		rc = 5;
 	}
 
-	std::cout << '\n';
-	
-	return 0;
+	if (env)
+		report_stats(env->sbucket());
+
+	return rc;
 }
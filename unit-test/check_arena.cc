@@ -0,0 +1,121 @@
+/*
+  This file implements the unit test for the arena_t class.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <stdint.h>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "arena.hh"
+
+namespace {
+
+// Node of a binary tree, referring to its children by plain pointers
+struct node_t {
+	node_t *lhs;
+	node_t *rhs;
+	uint64_t value;
+};
+
+// Node recording its destruction
+struct tracked_t {
+	tracked_t(std::vector<int>& destroyed, int id)
+		: m_destroyed(destroyed), m_id(id) {}
+	~tracked_t()
+		{ m_destroyed.push_back(m_id); }
+
+	std::vector<int>& m_destroyed;
+	const int m_id;
+};
+
+struct alignas(64) aligned_t {
+	char data[64];
+};
+
+}
+
+TEST_CASE("arena:tree") {
+	arena_t arena(4096);
+	REQUIRE(arena.nr_chunks() == 0);
+
+	// Complete binary tree, built bottom up
+	std::vector<node_t*> level;
+	for (uint64_t idx = 0; idx < 1024; idx++)
+		level.push_back(arena.create<node_t>(node_t{ nullptr, nullptr, idx }));
+	while (level.size() > 1) {
+		std::vector<node_t*> parents;
+		for (size_t idx = 0; idx < level.size(); idx += 2)
+			parents.push_back(arena.create<node_t>(node_t{
+				level[idx], level[idx + 1],
+				level[idx]->value + level[idx + 1]->value }));
+		level = std::move(parents);
+	}
+	REQUIRE(level[0]->value == 1023 * 1024 / 2);
+
+	// Allocations are by chunk, not by node
+	const size_t nr_nodes = 2047;
+	REQUIRE(arena.bytes_used() == nr_nodes * sizeof(node_t));
+	REQUIRE(arena.nr_chunks() <= nr_nodes * sizeof(node_t) / (4096 - 64) + 1);
+
+	arena.release();
+	REQUIRE(arena.nr_chunks() == 0);
+	REQUIRE(arena.bytes_used() == 0);
+
+	// Usable again after release
+	REQUIRE(arena.create<node_t>(node_t{ nullptr, nullptr, 17 })->value == 17);
+	REQUIRE(arena.nr_chunks() == 1);
+}
+
+TEST_CASE("arena:destructors") {
+	std::vector<int> destroyed;
+	{
+		arena_t arena;
+		for (int id = 0; id < 3; id++)
+			arena.create<tracked_t>(destroyed, id);
+		REQUIRE(destroyed.empty());
+	}
+	REQUIRE(destroyed == std::vector<int>{ 2, 1, 0 });
+}
+
+TEST_CASE("arena:alignment") {
+	arena_t arena(1024);
+
+	for (size_t idx = 0; idx < 100; idx++) {
+		REQUIRE(reinterpret_cast<uintptr_t>(arena.alloc(1 + idx % 7, 1)) != 0);
+		REQUIRE(reinterpret_cast<uintptr_t>(arena.create<aligned_t>()) % 64 == 0);
+		REQUIRE(reinterpret_cast<uintptr_t>(arena.alloc(8, 8)) % 8 == 0);
+	}
+
+	// Large allocations get chunks of their own, and leave the current
+	// chunk in use
+	arena_t large(1024);
+	char * const small = static_cast<char*>(large.alloc(16));
+	char * const big = static_cast<char*>(large.alloc(5000, 4096));
+	REQUIRE(reinterpret_cast<uintptr_t>(big) % 4096 == 0);
+	REQUIRE(large.nr_chunks() == 2);
+	REQUIRE(static_cast<char*>(large.alloc(16)) == small + 16);
+	REQUIRE(large.nr_chunks() == 2);
+}
+
+TEST_CASE("arena:pmr") {
+	arena_t arena;
+
+	// Containers of nodes allocate from the arena, and need not be
+	// destructed to free their memory
+	auto *names = arena.create<std::pmr::map<int, std::pmr::string>>(&arena);
+	for (int idx = 0; idx < 1000; idx++)
+		names->emplace(idx, std::to_string(idx) + " is a number long enough to allocate");
+	REQUIRE(names->at(500).substr(0, 3) == "500");
+	REQUIRE(names->at(500).get_allocator().resource() == &arena);
+	REQUIRE(arena.nr_chunks() < 100);
+
+	std::pmr::vector<int> numbers(&arena);
+	numbers.resize(10000);
+	REQUIRE(arena.is_equal(arena));
+	REQUIRE(!arena.is_equal(*std::pmr::new_delete_resource()));
+}
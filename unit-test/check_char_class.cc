@@ -0,0 +1,122 @@
+/*
+  This file implements the unit test for the char_class_t class.
+  
+  SPDX-License-Identifier: MIT
+
+ */
+
+#include <random>
+#include <string>
+#include <string.h>
+#include <catch2/catch.hpp>
+#include "char_class.hh"
+
+// Reference implementation using strchr(), which is what the scanning
+// primitives replaced.
+static const char *reference_find(const char *begin, const char *end,
+				  const char *chars, bool want_member)
+{
+	while ((begin < end) &&
+	       ((strchr(chars, *begin) != NULL) != want_member))
+		begin++;
+	return begin;
+}
+
+TEST_CASE("test_char_class:contains") {
+	constexpr char_class_t cls("\r ");
+
+	STATIC_REQUIRE(cls.contains(' '));
+	STATIC_REQUIRE(cls.contains('\r'));
+	STATIC_REQUIRE(cls.contains('\0'));
+	STATIC_REQUIRE(!cls.contains('\n'));
+	STATIC_REQUIRE(!char_class_t('\t').contains('\0'));
+}
+
+TEST_CASE("test_char_class:scan") {
+	const char *classes[] = {
+		"\r ", "\r\n", "\"'#\n\r\t ", "a",
+		// More members than the vector implementations handle
+		"abcdefghijklmnopqrstuvwxyz",
+	};
+	const simd_level_t levels[] = {
+		simd_level_t::scalar, simd_level_t::sse2, simd_level_t::avx2
+	};
+
+	std::default_random_engine r;
+	std::uniform_int_distribution<int> len_dist(0, 200);
+	std::string alphabet("  \r\n\t\"'#abcxyz\x80\xff");
+	alphabet.push_back('\0');
+	std::uniform_int_distribution<size_t> ch_dist(0, alphabet.size() - 1);
+
+	const simd_level_t original = char_class_t::simd_level();
+
+	for (int round = 0; round < 500; round++) {
+		std::string buff;
+		const int len = len_dist(r);
+		for (int idx = 0; idx < len; idx++)
+			buff.push_back(alphabet[ch_dist(r)]);
+		const char * const begin = buff.data();
+		const char * const end = begin + buff.size();
+
+		for (const char *chars : classes) {
+			const char_class_t cls(chars);
+			for (simd_level_t level : levels) {
+				char_class_t::set_simd_level(level);
+				REQUIRE(cls.find_first_of(begin, end) ==
+					reference_find(begin, end, chars, true));
+				REQUIRE(cls.find_first_not_of(begin, end) ==
+					reference_find(begin, end, chars, false));
+			}
+		}
+	}
+
+	char_class_t::set_simd_level(original);
+}
+
+TEST_CASE("test_char_class:below") {
+	constexpr char_class_t cls("\"'#", 0x21);
+
+	STATIC_REQUIRE(cls.contains('\0'));
+	STATIC_REQUIRE(cls.contains('\x01'));
+	STATIC_REQUIRE(cls.contains(' '));
+	STATIC_REQUIRE(cls.contains('#'));
+	STATIC_REQUIRE(!cls.contains('!'));
+	STATIC_REQUIRE(!cls.contains('\x80'));
+	STATIC_REQUIRE(cls.nr_members() == 3);
+
+	const simd_level_t levels[] = {
+		simd_level_t::scalar, simd_level_t::sse2, simd_level_t::avx2
+	};
+	const simd_level_t original = char_class_t::simd_level();
+
+	std::default_random_engine r;
+	std::uniform_int_distribution<int> byte_dist(0, 255);
+	for (int round = 0; round < 500; round++) {
+		// Mostly members or mostly non-members, with some random bytes
+		std::string buff;
+		for (int idx = 0; idx < 100; idx++) {
+			const int byte = byte_dist(r);
+			if (byte_dist(r) < 4)
+				buff.push_back(static_cast<char>(byte));
+			else
+				buff.push_back(static_cast<char>((round % 2) ? (byte % 0x21) : (byte | 0x40)));
+		}
+		const char * const begin = buff.data();
+		const char * const end = begin + buff.size();
+
+		const char *first_of = begin;
+		while ((first_of < end) && !cls.contains(*first_of))
+			first_of++;
+		const char *first_not_of = begin;
+		while ((first_not_of < end) && cls.contains(*first_not_of))
+			first_not_of++;
+
+		for (simd_level_t level : levels) {
+			char_class_t::set_simd_level(level);
+			REQUIRE(cls.find_first_of(begin, end) == first_of);
+			REQUIRE(cls.find_first_not_of(begin, end) == first_not_of);
+		}
+	}
+
+	char_class_t::set_simd_level(original);
+}
@@ -0,0 +1,130 @@
+/*
+  This file implements the unit test for recording lexical errors.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <array>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "memory_input.hh"
+#include "token.hh"
+#include "work_pool.hh"
+
+// Scan all tokens of text, recording errors
+static std::vector<compact_token_t> scan(environment_t& env,
+					 const std::string& text,
+					 diagnostics_t& diagnostics)
+{
+	tokenizer_t lexer(env, std::make_unique<memory_input_t>(env, text, "text"));
+	lexer.set_diagnostics(&diagnostics);
+
+	std::vector<compact_token_t> tokens;
+	std::array<compact_token_t, 3> batch;
+	for (size_t nr = lexer.next_batch(batch); nr > 0; nr = lexer.next_batch(batch))
+		tokens.insert(tokens.end(), batch.begin(), batch.begin() + nr);
+
+	return tokens;
+}
+
+TEST_CASE("diagnostics:recover") {
+	const std::string text =
+		"a 1x b\n"
+		"c 1.5y \"s\"t d\n"
+		"(e f\tg 'h i\n"
+		"j \"unterminated\n";
+	environment_t env;
+	diagnostics_t diagnostics;
+
+	const std::vector<compact_token_t> tokens = scan(env, text, diagnostics);
+
+	REQUIRE(diagnostics.size() == 7);
+	const std::array<error_code_t, 7> codes = {
+		error_code_t::trailing_integer,
+		error_code_t::trailing_float,
+		error_code_t::trailing_string,
+		error_code_t::invalid_identifier,
+		error_code_t::invalid_identifier,
+		error_code_t::invalid_identifier,
+		error_code_t::unterminated_string
+	};
+	const std::array<size_t, 7> starts = { 2, 9, 14, 21, 25, 28, 35 };
+	for (size_t idx = 0; idx < codes.size(); idx++) {
+		REQUIRE(diagnostics[idx].code == codes[idx]);
+		REQUIRE(diagnostics[idx].start == starts[idx]);
+	}
+	REQUIRE(diagnostics[0].at == 3);
+	REQUIRE(diagnostics[6].at == 35);
+
+	// Scanning resumes at the next token separator
+	std::string identifiers;
+	for (const compact_token_t& token : tokens)
+		if (token.kind == token_kind_t::identifier)
+			identifiers += env.sbucket().view(token.value);
+	REQUIRE(identifiers == "abcdfgij");
+}
+
+TEST_CASE("diagnostics:print") {
+	const std::string text = "abc\n  def 12z\n";
+	environment_t env;
+	tokenizer_t lexer(env, std::make_unique<memory_input_t>(env, text, "text"));
+	std::array<compact_token_t, 16> batch;
+
+	// Same message as when thrown
+	std::string thrown;
+	try {
+		while (lexer.next_batch(batch) > 0)
+			;
+	}
+	catch (const parser_error& e) {
+		thrown = e.what();
+	}
+	REQUIRE(thrown == "text:2:7: error: Trailing garbage after integer constant\n"
+		"          def 12z\n"
+		"                ^");
+
+	diagnostics_t diagnostics;
+	tokenizer_t recovering(env, std::make_unique<memory_input_t>(env, text, "text"));
+	recovering.set_diagnostics(&diagnostics);
+	while (recovering.next_batch(batch) > 0)
+		;
+
+	std::ostringstream printed;
+	diagnostics.print(printed);
+	REQUIRE(printed.str() == thrown + '\n');
+}
+
+TEST_CASE("diagnostics:next_all") {
+	std::string text;
+	for (size_t idx = 0; idx < 200; idx++)
+		text += "line " + std::to_string(idx) + ((idx % 50 == 7) ? "x" : "") + "\n";
+
+	char name[] = "/tmp/check_diagnostics.XXXXXX";
+	const int fd = mkstemp(name);
+	REQUIRE(fd >= 0);
+	close(fd);
+	std::ofstream(name) << text;
+
+	work_pool_t pool(4);
+	environment_t env;
+	tokenizer_t lexer(env, name);
+	diagnostics_t diagnostics;
+	lexer.set_diagnostics(&diagnostics);
+	std::vector<compact_token_t> tokens;
+	lexer.next_all(tokens, pool, 1);
+
+	REQUIRE(diagnostics.size() == 4);
+	REQUIRE(diagnostics[0].start_position().line() == 8);
+	REQUIRE(diagnostics[3].start_position().line() == 158);
+	// Each line gives an end of line token, and two tokens unless wrong
+	REQUIRE(tokens.size() == 200 * 3 - 4);
+
+	unlink(name);
+}
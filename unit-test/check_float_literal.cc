@@ -0,0 +1,117 @@
+/*
+  This file implements the unit test for the float_literal_t class.
+  
+  SPDX-License-Identifier: MIT
+
+ */
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <stdlib.h>
+#include <catch2/catch.hpp>
+#include "float_literal.hh"
+
+// Reference conversion, relies on strtod() being correctly rounded
+static double reference(uint64_t w, int64_t q)
+{
+	const std::string str = std::to_string(w) + "e" + std::to_string(q);
+	return strtod(str.c_str(), NULL);
+}
+
+TEST_CASE("test_float_literal:decimal_to_double") {
+	std::default_random_engine r;
+	std::uniform_int_distribution<uint64_t> w_dist;
+	std::uniform_int_distribution<int> digits_dist(1, 19);
+	std::uniform_int_distribution<int64_t> q_dist(-360, 320);
+
+	// Edge cases
+	REQUIRE(0.0 == decimal_to_double(0, 0));
+	REQUIRE(0.0 == decimal_to_double(1, -400));
+	REQUIRE(std::isinf(decimal_to_double(1, 400)));
+	REQUIRE(reference(9007199254740993, 0) == decimal_to_double(9007199254740993, 0));
+	REQUIRE(reference(UINT64_MAX, -20) == decimal_to_double(UINT64_MAX, -20));
+	REQUIRE(std::numeric_limits<double>::denorm_min() == decimal_to_double(49406564584124654, -340));
+	REQUIRE(std::numeric_limits<double>::max() == decimal_to_double(17976931348623157, 292));
+
+	for (int round = 0; round < 100000; round++) {
+		// Mix of short and long mantissas
+		uint64_t w = w_dist(r);
+		const int digits = digits_dist(r);
+		if (digits < 19)
+			w %= static_cast<uint64_t>(std::pow(10.0, digits));
+		const int64_t q = q_dist(r);
+		const double expected = reference(w, q);
+		const double result = decimal_to_double(w, q);
+		INFO("w = " << w << ", q = " << q);
+		REQUIRE(memcmp(&expected, &result, sizeof(double)) == 0);
+	}
+}
+
+TEST_CASE("test_float_literal:to_double") {
+	// 123.123
+	REQUIRE(123.123 == float_literal_t(10, 123123, 6, 3).to_double());
+	// 0x123.123
+	REQUIRE(0x123.123p0 == float_literal_t(16, 0x123123, 6, 3).to_double());
+	// 0b110.110
+	REQUIRE(6.75 == float_literal_t(2, 0x36, 6, 3).to_double());
+	// 0o123.123
+	REQUIRE(83.0 + 83.0 / 512.0 == float_literal_t(8, 0123123, 6, 3).to_double());
+
+	// Decimal mantissa not fitting in 64 bits,
+	// 12345678901234567890.12345678901234567890
+	const mp_int big_decimal("1234567890123456789012345678901234567890");
+	REQUIRE(12345678901234567890.12345678901234567890 ==
+		float_literal_t(10, big_decimal, 40, 20).to_double());
+
+	// Binary mantissa not fitting in 64 bits, exactly half way between
+	// two doubles plus a sticky bit far below, which must round up:
+	// 2^53 + 1 + 2^-80, written with 80 binary decimals
+	const mp_int big_binary = ((mp_int(1) << 53) + 1) * (mp_int(1) << 80) + 1;
+	REQUIRE(std::ldexp(1.0, 53) + 2.0 ==
+		float_literal_t(2, big_binary, 134, 80).to_double());
+
+	// Same without sticky bit rounds to even, i.e. down
+	const mp_int tie = ((mp_int(1) << 53) + 1) * (mp_int(1) << 80);
+	REQUIRE(std::ldexp(1.0, 53) ==
+		float_literal_t(2, tie, 134, 80).to_double());
+
+	// Subnormal binary result, 2^-1074 written in hex with decimals
+	// 0x0.000...0004 where the 4 is hex digit 269, i.e. 4 * 16^-269
+	REQUIRE(std::numeric_limits<double>::denorm_min() ==
+		float_literal_t(16, 4, 270, 269).to_double());
+	REQUIRE(std::numeric_limits<double>::denorm_min() * 3 ==
+		float_literal_t(2, 3, 1075, 1074).to_double());
+}
+
+TEST_CASE("test_float_literal:to_mp_float") {
+	const float_literal_t literal(16, 0x123123, 6, 3);
+	REQUIRE(literal.to_mp_float() == mp_float(0x123.123p0));
+	REQUIRE(float_literal_t(10, 5, 2, 1).to_mp_float() == mp_float(1) / 2);
+}
+
+TEST_CASE("test_float_literal:to_mp_float_long") {
+	// 1.000...0001 with 200 decimal digits, which the default precision
+	// of 50 digits would round to 1
+	const mp_int ten199 = boost::multiprecision::pow(mp_int(10), 199);
+	const mp_float decimal = float_literal_t(10, ten199 + 1, 200, 199).to_mp_float();
+	REQUIRE(decimal.precision() >= 200);
+	REQUIRE(decimal > 1);
+	mp_float scaled(decimal, 210);
+	scaled -= 1;
+	scaled *= mp_float(ten199.str(), 210);
+	REQUIRE(abs(scaled - 1) < mp_float(1e-5));
+
+	// 1 + 2^-999 written with 1000 binary digits is represented exactly
+	const mp_int two999 = mp_int(1) << 999;
+	const mp_int mantissa = two999 + 1;
+	const mp_float binary = float_literal_t(2, mantissa, 1000, 999).to_mp_float();
+	mp_float expected(0, 310);
+	expected = mantissa;
+	mp_float power(0, 310);
+	power = two999;
+	mp_float product(binary, 310);
+	product *= power;
+	REQUIRE(product == expected);
+}
@@ -0,0 +1,52 @@
+/*
+  This file implements the unit test for the string hash functions.
+  
+  SPDX-License-Identifier: MIT
+
+ */
+
+#include <string>
+#include <unordered_set>
+#include <catch2/catch.hpp>
+#include "hash.hh"
+
+TEST_CASE("test_hash:incremental") {
+	std::string str;
+	for (size_t idx = 0; idx < 40; idx++)
+		str.push_back(static_cast<char>('a' + (idx * 7) % 26));
+
+	// Any split into two or three updates gives the same hash as
+	// hashing all bytes in one go
+	for (size_t len = 0; len <= str.size(); len++) {
+		const hash_t expected = hash_bytes(str.data(), len);
+		for (size_t split1 = 0; split1 <= len; split1++) {
+			for (size_t split2 = split1; split2 <= len; split2++) {
+				hasher_t hasher;
+				hasher.update(str.data(), split1);
+				hasher.update(str.data() + split1, split2 - split1);
+				hasher.update(str.data() + split2, len - split2);
+				INFO("len = " << len << ", split1 = " << split1 <<
+				     ", split2 = " << split2);
+				REQUIRE(hasher.finish() == expected);
+			}
+		}
+	}
+}
+
+TEST_CASE("test_hash:distinct") {
+	// Trailing zero bytes change the hash
+	const char zeros[16] = {};
+	std::unordered_set<hash_t> hashes;
+	for (size_t len = 0; len <= sizeof(zeros); len++)
+		hashes.insert(hash_bytes(zeros, len));
+	REQUIRE(hashes.size() == sizeof(zeros) + 1);
+
+	// Similar identifiers, expected number of 32-bit collisions among
+	// 100000 random values is about 1
+	hashes.clear();
+	for (size_t idx = 0; idx < 100000; idx++) {
+		const std::string str = "identifier_" + std::to_string(idx);
+		hashes.insert(hash_bytes(str.data(), str.size()));
+	}
+	REQUIRE(hashes.size() >= 99990);
+}
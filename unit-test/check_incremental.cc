@@ -0,0 +1,144 @@
+/*
+  This file implements the unit test for the incremental_tokenizer_t
+  class.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <random>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "incremental.hh"
+#include "memory_input.hh"
+
+// Check that the incremental token stream is the same as when scanning
+// the whole text
+static void check_tokens(environment_t& env, const std::string& text,
+			 const incremental_tokenizer_t& incremental)
+{
+	tokenizer_t lexer(env, std::make_unique<memory_input_t>(env, text, "full"));
+	std::vector<compact_token_t> expected;
+	compact_token_t token;
+	while (lexer.next_batch(std::span(&token, 1)) == 1)
+		expected.push_back(token);
+
+	const std::vector<compact_token_t> tokens = incremental.tokens();
+	REQUIRE(tokens.size() == expected.size());
+	REQUIRE(incremental.size() == expected.size());
+
+	for (size_t idx = 0; idx < tokens.size(); idx++) {
+		REQUIRE(tokens[idx].offset == expected[idx].offset);
+		REQUIRE(tokens[idx].kind == expected[idx].kind);
+		switch (tokens[idx].kind) {
+		case token_kind_t::big_integer:
+			REQUIRE(incremental.integer(tokens[idx]) == lexer.integer(expected[idx]));
+			break;
+		case token_kind_t::floating:
+			REQUIRE(incremental.floating(tokens[idx]).to_mp_float()
+				== lexer.floating(expected[idx]).to_mp_float());
+			break;
+		default:
+			REQUIRE(tokens[idx].value == expected[idx].value);
+			break;
+		}
+	}
+}
+
+TEST_CASE("incremental:random_edits") {
+	environment_t env;
+	incremental_tokenizer_t incremental(env, "edited");
+
+	std::string text;
+	for (size_t line = 0; line < 300; line++)
+		text += std::string(line % 3, '\t') + "name" + std::to_string(line)
+			+ " is " + std::to_string(line * 31) + " \"s\" 2.5\n"
+			+ ((line % 5 == 0) ? "# comment\n\n" : "");
+	incremental.update(text, 0, 0, text.size());
+	check_tokens(env, text, incremental);
+
+	// Edits that keep the text valid, including ones changing
+	// indentation, and adding and removing lines and comments
+	static const char * const insertions[] = {
+		"", "x", " y", "\n", "\n\t", "\t", "\nz is 12345678901234567890123\n",
+		"# note", "\n# note\n", "\n\n", "1.25 ", "\"a b\" ",
+	};
+	std::default_random_engine r(4711);
+
+	for (size_t nr = 0; nr < 2000; nr++) {
+		const std::string inserted = insertions[r() % std::size(insertions)];
+		const size_t offset = r() % (text.size() + 1);
+		const size_t removed = std::min<size_t>(r() % 4, text.size() - offset);
+		std::string edited = text;
+		edited.replace(offset, removed, inserted);
+
+		try {
+			const incremental_tokenizer_t::change_t change =
+				incremental.update(edited, offset, removed, inserted.size());
+			REQUIRE(change.first <= incremental.size());
+		}
+		catch (const parser_error&) {
+			// Text has errors, undo the edit. The undo is combined
+			// with the failed edit by the next update.
+			incremental.update(text, offset, inserted.size(), removed);
+			check_tokens(env, text, incremental);
+			continue;
+		}
+		text = std::move(edited);
+		check_tokens(env, text, incremental);
+	}
+}
+
+TEST_CASE("incremental:local") {
+	environment_t env;
+	incremental_tokenizer_t incremental(env, "edited");
+
+	std::string text;
+	for (size_t line = 0; line < 100000; line++)
+		text += "name" + std::to_string(line) + " is " + std::to_string(line) + "\n";
+	incremental.update(text, 0, 0, text.size());
+	const size_t nr_tokens = incremental.size();
+
+	// A single character edit only scans the edited line
+	const size_t offset = text.find("name50000 ") + 4;
+	text.insert(offset, "x");
+	const incremental_tokenizer_t::change_t change =
+		incremental.update(text, offset, 0, 1);
+	REQUIRE(incremental.nr_scanned() < 100);
+	REQUIRE(change.nr_removed == change.nr_inserted);
+	REQUIRE(incremental.size() == nr_tokens);
+	REQUIRE(env.sbucket().view(incremental[change.first + 1].value) == "namex50000");
+	check_tokens(env, text, incremental);
+
+	// Inconsistent edits are rejected
+	REQUIRE_THROWS_AS(incremental.update(text, text.size(), 1, 0), std::system_error);
+}
+
+TEST_CASE("incremental:identity") {
+	environment_t env;
+	std::string text = "first line\n";
+	incremental_tokenizer_t incremental(env, "edited");
+	incremental.update(text, 0, 0, text.size());
+	REQUIRE(std::string(input_t::filename(incremental.id())) == "edited");
+
+	// Updates share one input identity, so typing does not grow the
+	// input registry
+	const size_t nr_ids = input_t::nr_ids();
+	for (size_t idx = 0; idx < 4 * input_t::id_reuse_delay; idx++) {
+		text.insert(text.size() - 1, "x");
+		incremental.update(text, text.size() - 2, 0, 1);
+	}
+	REQUIRE(input_t::nr_ids() == nr_ids);
+
+	// Errors are reported with the name of the identity
+	text += "-bad line\n";
+	try {
+		incremental.update(text, text.size() - 10, 0, 10);
+		FAIL("No parser_error thrown");
+	}
+	catch (const parser_error& error) {
+		REQUIRE(std::string(error.what()).find("edited:2:") != std::string::npos);
+	}
+	REQUIRE(std::string(input_t::filename(incremental.id())) == "edited");
+}
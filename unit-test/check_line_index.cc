@@ -0,0 +1,63 @@
+/*
+  This file implements the unit test for the line_index_t class.
+  
+  SPDX-License-Identifier: MIT
+
+ */
+
+#include <random>
+#include <string>
+#include <catch2/catch.hpp>
+#include "line_index.hh"
+#include "char_class.hh"
+
+TEST_CASE("test_line_index:empty") {
+	const char * const empty = "";
+	const line_index_t index(empty, empty);
+
+	REQUIRE(static_cast<size_t>(1) == index.nr_lines());
+	REQUIRE(static_cast<size_t>(1) == index.line_of(0));
+	REQUIRE(static_cast<size_t>(0) == index.line_start(1));
+	REQUIRE(static_cast<size_t>(0) == index.line_end(1));
+}
+
+TEST_CASE("test_line_index:lookup") {
+	const simd_level_t levels[] = {
+		simd_level_t::scalar, simd_level_t::sse2, simd_level_t::avx2
+	};
+	const simd_level_t original = char_class_t::simd_level();
+
+	std::default_random_engine r;
+	std::uniform_int_distribution<int> len_dist(0, 300);
+	std::uniform_int_distribution<int> ch_dist(0, 9);
+
+	for (int round = 0; round < 200; round++) {
+		std::string buff;
+		const int len = len_dist(r);
+		for (int idx = 0; idx < len; idx++)
+			buff.push_back((ch_dist(r) == 0) ? '\n' : 'x');
+
+		for (simd_level_t level : levels) {
+			char_class_t::set_simd_level(level);
+			const line_index_t index(buff.data(),
+						 buff.data() + buff.size());
+
+			// Walk the buffer, tracking line the simple way
+			size_t line = 1;
+			size_t start = 0;
+			for (size_t offset = 0; offset <= buff.size(); offset++) {
+				REQUIRE(line == index.line_of(offset));
+				REQUIRE(start == index.line_start(line));
+				if ((offset < buff.size()) && (buff[offset] == '\n')) {
+					REQUIRE(offset == index.line_end(line));
+					line++;
+					start = offset + 1;
+				}
+			}
+			REQUIRE(line == index.nr_lines());
+			REQUIRE(buff.size() == index.line_end(line));
+		}
+	}
+
+	char_class_t::set_simd_level(original);
+}
@@ -0,0 +1,145 @@
+/*
+  This file implements the unit test for the performance counters.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <array>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "memory_input.hh"
+#include "metrics.hh"
+#include "reserved.hh"
+#include "token.hh"
+
+// Difference of a counter between two snapshots
+static uint64_t delta(const metrics_snapshot_t& before,
+		      const metrics_snapshot_t& after, metric_t metric)
+{
+	return after[metric] - before[metric];
+}
+
+#ifdef SISDEL_METRICS
+
+TEST_CASE("metrics:tokenizer") {
+	const std::string text =
+		"abc is 12 \"str\" 1.5\n"
+		"abc 123456789012345678901234567890\n";
+	environment_t env;
+
+	const metrics_snapshot_t before = metrics_snapshot();
+
+	tokenizer_t lexer(env, std::make_unique<memory_input_t>(env, text, "text"));
+	std::array<uint64_t, 6> kinds{};
+	std::array<compact_token_t, 4> batch;
+	for (size_t nr = lexer.next_batch(batch); nr > 0; nr = lexer.next_batch(batch))
+		for (size_t idx = 0; idx < nr; idx++)
+			kinds[static_cast<size_t>(batch[idx].kind)]++;
+
+	const metrics_snapshot_t after = metrics_snapshot();
+
+	REQUIRE(delta(before, after, metric_t::bytes_scanned) == text.size());
+	REQUIRE(delta(before, after, metric_t::tokens_eol) ==
+		kinds[static_cast<size_t>(token_kind_t::eol)]);
+	REQUIRE(delta(before, after, metric_t::tokens_identifier) == 3);
+	REQUIRE(delta(before, after, metric_t::tokens_string) == 1);
+	REQUIRE(delta(before, after, metric_t::tokens_integer) == 1);
+	REQUIRE(delta(before, after, metric_t::tokens_big_integer) == 1);
+	REQUIRE(delta(before, after, metric_t::tokens_floating) == 1);
+	REQUIRE(delta(before, after, metric_t::big_literals) == 1);
+
+	// The input name, "abc" and "str" are added, "is" is reserved and
+	// "abc" is found
+	REQUIRE(delta(before, after, metric_t::sbucket_misses) == 3);
+	REQUIRE(delta(before, after, metric_t::sbucket_hits) == 2);
+	REQUIRE(delta(before, after, metric_t::bytes_interned) == 10);
+}
+
+// Pre-seeding the reserved identifiers is not counted as lookups
+TEST_CASE("metrics:sbucket_seed") {
+	const metrics_snapshot_t before = metrics_snapshot();
+	const sbucket single;
+	const sbucket concurrent(sbucket_mode_t::concurrent);
+	const metrics_snapshot_t after = metrics_snapshot();
+
+	REQUIRE(single.size() == nr_reserved);
+	REQUIRE(concurrent.size() == nr_reserved);
+	REQUIRE(delta(before, after, metric_t::sbucket_misses) == 0);
+	REQUIRE(delta(before, after, metric_t::sbucket_hits) == 0);
+	REQUIRE(delta(before, after, metric_t::bytes_interned) == 0);
+	for (size_t idx = 0; idx < before.probes.size(); idx++)
+		REQUIRE(after.probes[idx] == before.probes[idx]);
+}
+
+TEST_CASE("metrics:threads") {
+	const metrics_snapshot_t before = metrics_snapshot();
+
+	// Counters of exited threads are kept
+	std::vector<std::thread> threads;
+	for (size_t idx = 0; idx < 4; idx++)
+		threads.emplace_back([]() {
+			for (size_t nr = 0; nr < 1000; nr++)
+				metrics_add(metric_t::float_conversions);
+			metrics_probe(1);
+			metrics_probe(3);
+			metrics_probe(1000);
+		});
+	for (std::thread& thread : threads)
+		thread.join();
+
+	const metrics_snapshot_t after = metrics_snapshot();
+	REQUIRE(delta(before, after, metric_t::float_conversions) == 4000);
+	REQUIRE(after.probes[0] - before.probes[0] == 4);
+	REQUIRE(after.probes[1] - before.probes[1] == 4);
+	REQUIRE(after.probes[nr_probe_buckets - 1] -
+		before.probes[nr_probe_buckets - 1] == 4);
+
+	{
+		const metrics_timer_t timer(phase_t::output);
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+	REQUIRE(metrics_snapshot().phase_ns[static_cast<size_t>(phase_t::output)] -
+		after.phase_ns[static_cast<size_t>(phase_t::output)] >= 2000000);
+}
+
+#else
+
+TEST_CASE("metrics:disabled") {
+	metrics_add(metric_t::float_conversions, 10);
+	{
+		const metrics_timer_t timer(phase_t::output);
+	}
+
+	const metrics_snapshot_t snapshot = metrics_snapshot();
+	REQUIRE(snapshot[metric_t::float_conversions] == 0);
+	REQUIRE(snapshot.phase_ns[static_cast<size_t>(phase_t::output)] == 0);
+	REQUIRE(delta(snapshot, snapshot, metric_t::bytes_scanned) == 0);
+}
+
+#endif // SISDEL_METRICS
+
+TEST_CASE("metrics:print") {
+	environment_t env;
+	metrics_snapshot_t snapshot;
+	snapshot.counters[static_cast<size_t>(metric_t::tokens_string)] = 17;
+	snapshot.probes[2] = 5;
+
+	std::ostringstream text;
+	metrics_print(text, snapshot, metrics_format_t::text, &env.sbucket());
+	REQUIRE(text.str().find("tokens_string") != std::string::npos);
+	REQUIRE(text.str().find("sbucket load_factor") != std::string::npos);
+
+	std::ostringstream json;
+	metrics_print(json, snapshot, metrics_format_t::json);
+	REQUIRE(json.str().find("\"tokens_string\":17") != std::string::npos);
+	REQUIRE(json.str().find("\"sbucket_probes\":{\"1\":0,\"2-3\":0,\"4-7\":5,") !=
+		std::string::npos);
+	REQUIRE(json.str().find("\"sbucket\"") == std::string::npos);
+	REQUIRE(json.str().front() == '{');
+	REQUIRE(json.str().back() == '\n');
+}
@@ -5,8 +5,22 @@
 
  */
 
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+#include <memory>
+#include <string>
 #include <catch2/catch.hpp>
 #include "mmap_file.hh"
+#include "memory_input.hh"
+
+// Check that the window is followed by input_padding zero bytes
+static void check_padding(const input_t& input)
+{
+	const char * const end = input.data() + input.remaining();
+	for (size_t idx = 0; idx < input_padding; idx++)
+		REQUIRE(end[idx] == '\0');
+}
 
 TEST_CASE("test_mmap_file:file_not_found") {
 	environment_t m_env;
@@ -45,3 +59,205 @@ TEST_CASE("test_mmap_file:skip") {
 	REQUIRE(line3.length()+1 == file.get_position().column());
 }
 
+
+TEST_CASE("test_mmap_file:skip_until_hashed") {
+	environment_t env;
+	mmap_file_t file(env, "check_mmap_file.data");
+
+	// Skip the first word, "#", and the space following it
+	REQUIRE(static_cast<size_t>(1) == file.skip('#'));
+	REQUIRE(static_cast<size_t>(1) == file.skip(' '));
+
+	// Hash the next word, and compare with hashing it separately
+	file.marker_start();
+	hash_t hash;
+	REQUIRE(static_cast<size_t>(4) == file.skip_until_hashed(" \n", hash));
+	const std::string word(file.marker_end());
+	REQUIRE(word == "Some");
+
+	REQUIRE(hash_bytes(word.data(), word.size()) == hash);
+
+	// Skipping across several lines should keep line and column count
+	file.skip_until_hashed(char_class_t("\t"), hash);
+	REQUIRE(static_cast<size_t>(4) == file.get_position().line());
+	REQUIRE(static_cast<size_t>(5) == file.get_position().column());
+}
+
+// Reaching end of input while skipping is not an error
+TEST_CASE("test_mmap_file:skip_until_eof") {
+	environment_t env;
+	const std::string text = "# comment";
+
+	memory_input_t line(env, text, "line");
+	line.skip_until('\n');
+	REQUIRE(line.eof());
+	REQUIRE(line.offset() == text.size());
+
+	memory_input_t word(env, text, "word");
+	word.skip();
+	word.skip(' ');
+	hash_t hash;
+	REQUIRE(word.skip_until_hashed(char_class_t(" \n"), hash) == 7);
+	REQUIRE(word.eof());
+	REQUIRE(hash == hash_bytes("comment", 7));
+
+	memory_input_t quoted(env, text, "quoted");
+	REQUIRE(quoted.skip_until_hashed('"', hash) == text.size());
+	REQUIRE(quoted.eof());
+	REQUIRE(hash == hash_bytes(text.data(), text.size()));
+}
+
+TEST_CASE("test_mmap_file:position") {
+	environment_t env;
+	std::unique_ptr<mmap_file_t> file(
+		new mmap_file_t(env, "check_mmap_file.data"));
+
+	file->skip_until('\n');
+	file->skip('\n');
+	const position_t pos(file->get_position());
+	REQUIRE(pos == file->get_position(pos.offset()));
+	REQUIRE(static_cast<size_t>(3) == pos.line());
+	REQUIRE(static_cast<size_t>(1) == pos.column());
+
+	// Positions can still be printed after the file has been destructed
+	file.reset();
+	REQUIRE(std::string("check_mmap_file.data") == pos.filename());
+	REQUIRE(static_cast<size_t>(0) == pos.line());
+	REQUIRE(pos.str().empty());
+}
+
+TEST_CASE("test_mmap_file:id_reuse") {
+	environment_t env;
+	const std::string text = "a b\n";
+
+	// Names of destructed inputs are kept for a while
+	const file_id_t first = memory_input_t(env, text, "first").id();
+	const char * const first_name = input_t::filename(first);
+	for (size_t idx = 0; idx < input_t::id_reuse_delay; idx++) {
+		memory_input_t input(env, text, "other");
+		REQUIRE(input.id() != first);
+		REQUIRE(input_t::find(input.id()) == &input);
+	}
+	const size_t nr_ids = input_t::nr_ids();
+
+	// Then identities are reused, and the registry does not grow
+	bool reused = false;
+	for (size_t idx = 0; idx < 10 * input_t::id_reuse_delay; idx++) {
+		memory_input_t input(env, text, "later");
+		reused = reused || (input.id() == first);
+	}
+	REQUIRE(reused);
+	REQUIRE(input_t::nr_ids() == nr_ids);
+	REQUIRE(std::string(input_t::filename(first)) == "later");
+
+	// Names already returned are not changed by the reuse
+	REQUIRE(std::string(first_name) == "first");
+}
+
+TEST_CASE("test_mmap_file:load_strategy") {
+	environment_t env;
+	const std::string line1("# Some test data used for the check_mmap_file unit test");
+
+	// Every strategy gives the same contents
+	std::string expected;
+	for (size_t idx = 1; idx < nr_load_strategies; idx++) {
+		const load_strategy_t strategy = static_cast<load_strategy_t>(idx);
+		INFO("strategy = " << load_strategy_name(strategy));
+		env.load_options.strategy = strategy;
+
+		const load_counters_t before = file_loader_t::counters();
+		mmap_file_t file(env, "check_mmap_file.data");
+		const load_counters_t after = file_loader_t::counters();
+
+		REQUIRE(file.load_strategy() == strategy);
+		REQUIRE(after.nr_files[idx] == before.nr_files[idx] + 1);
+		REQUIRE(after.nr_bytes[idx] == before.nr_bytes[idx] + file.remaining());
+		REQUIRE(file.get_position().str() == line1);
+
+		const std::string contents(file.data(), file.remaining());
+		if (expected.empty())
+			expected = contents;
+		REQUIRE(contents == expected);
+	}
+
+	// Small files are read, and read buffers are reused
+	env.load_options = load_options_t();
+	{
+		mmap_file_t file(env, "check_mmap_file.data");
+		REQUIRE(file.load_strategy() == load_strategy_t::read);
+	}
+	const size_t nr_reuses = file_loader_t::counters().nr_buffer_reuses;
+	{
+		mmap_file_t file(env, "check_mmap_file.data");
+		REQUIRE(file.load_strategy() == load_strategy_t::read);
+	}
+	REQUIRE(file_loader_t::counters().nr_buffer_reuses == nr_reuses + 1);
+
+	// Larger files are mapped
+	env.load_options.read_limit = 16;
+	{
+		mmap_file_t file(env, "check_mmap_file.data");
+		REQUIRE(file.load_strategy() == load_strategy_t::mmap_populate);
+	}
+	env.load_options.populate_limit = 16;
+	{
+		mmap_file_t file(env, "check_mmap_file.data");
+		REQUIRE(file.load_strategy() == load_strategy_t::mmap);
+	}
+}
+
+TEST_CASE("test_mmap_file:padding") {
+	environment_t env;
+	char name[] = "/tmp/check_mmap_file.XXXXXX";
+	const int fd = mkstemp(name);
+	REQUIRE(fd >= 0);
+	close(fd);
+
+	// Sizes filling the last page, and leaving too little of it for the
+	// padding, as well as an empty file
+	const long page_size = sysconf(_SC_PAGESIZE);
+	for (const long size : { page_size, 2 * page_size - 1, 0L, 100L }) {
+		std::ofstream(name) << std::string(static_cast<size_t>(size), '1');
+
+		for (size_t idx = 1; idx < nr_load_strategies; idx++) {
+			const load_strategy_t strategy = static_cast<load_strategy_t>(idx);
+			INFO("strategy = " << load_strategy_name(strategy) << ", size = " << size);
+			env.load_options.strategy = strategy;
+
+			mmap_file_t file(env, name);
+			REQUIRE(file.remaining() == static_cast<size_t>(size));
+			check_padding(file);
+
+			// Scanning stops at end of input without exceptions
+			REQUIRE(file.skip('1') == static_cast<size_t>(size));
+			REQUIRE(file.peek() == '\0');
+			file.skip();
+			REQUIRE(file.eof());
+		}
+	}
+
+	const std::string text = "abc";
+	const memory_input_t input(env, text, "text");
+	REQUIRE(input.data() != text.data());
+	check_padding(input);
+
+	// Texts larger than a chunk are copied chunk by chunk, or whole by
+	// load_all()
+	std::string large;
+	while (large.size() < 3 * memory_input_t::chunk_size)
+		large += "line " + std::to_string(large.size()) + "\n";
+	for (const size_t start : { size_t(0), size_t(100) }) {
+		memory_input_t chunked(env, large, "large", start);
+		REQUIRE(!chunked.in_memory());
+		REQUIRE(chunked.remaining() == memory_input_t::chunk_size);
+		REQUIRE(chunked.load_all());
+		REQUIRE(chunked.in_memory());
+		REQUIRE(chunked.offset() == start);
+		REQUIRE(chunked.remaining() == large.size() - start);
+		REQUIRE(std::string_view(chunked.data(), chunked.remaining()) ==
+			std::string_view(large).substr(start));
+		check_padding(chunked);
+	}
+
+	unlink(name);
+}
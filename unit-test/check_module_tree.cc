@@ -0,0 +1,79 @@
+/*
+  This file implements the test for finding and tokenizing modules.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <stdlib.h>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <catch2/catch.hpp>
+#include "module_tree.hh"
+#include "token.hh"
+
+namespace fs = std::filesystem;
+
+static void write_file(const fs::path& path, const std::string& contents)
+{
+	std::ofstream file(path);
+	file << contents;
+}
+
+TEST_CASE("module_tree:tokenize") {
+	char dir_template[] = "/tmp/check_module_tree.XXXXXX";
+	REQUIRE(mkdtemp(dir_template) != NULL);
+	const fs::path root(dir_template);
+
+	// Module hierarchy, with modules of different sizes
+	fs::create_directories(root / "sub" / "deeper");
+	fs::create_directories(root / ".hidden");
+	write_file(root / "a.sis", "use b\n");
+	write_file(root / "sub" / "b.sis", "x is 1\ny is \"text\"\n");
+	std::string big;
+	for (size_t idx = 0; idx < 5000; idx++)
+		big += "name" + std::to_string(idx) + " is " + std::to_string(idx) + "\n";
+	write_file(root / "sub" / "deeper" / "c.sis", big);
+	write_file(root / "sub" / "bad.sis", "1x\n");
+	write_file(root / "sub" / "notes.txt", "not a module\n");
+	write_file(root / ".hidden" / "d.sis", "hidden\n");
+
+	const std::vector<module_file_t> files = find_modules(root.c_str(), ".sis");
+	REQUIRE(files.size() == 4);
+	REQUIRE(files[0].path == (root / "a.sis").string());
+	REQUIRE(files[1].path == (root / "sub" / "b.sis").string());
+	REQUIRE(files[2].path == (root / "sub" / "bad.sis").string());
+	REQUIRE(files[3].path == (root / "sub" / "deeper" / "c.sis").string());
+	REQUIRE(files[3].size == big.size());
+
+	REQUIRE(find_modules(root.c_str(), NULL).size() == 5);
+
+	for (size_t nr_workers : {1, 4}) {
+		INFO("nr_workers = " << nr_workers);
+		environment_t env(sbucket_mode_t::concurrent);
+		work_pool_t pool(nr_workers);
+		const std::vector<module_result_t> results =
+			tokenize_modules(env, files, pool);
+
+		REQUIRE(results.size() == files.size());
+		REQUIRE(results[0].nr_tokens == 3);
+		REQUIRE(results[0].error.empty());
+		REQUIRE(results[1].nr_tokens == 8);
+		REQUIRE(!results[2].error.empty());
+		REQUIRE(results[3].nr_tokens == 5000 * 4);
+		REQUIRE(results[3].error.empty());
+
+		// Strings are shared between modules
+		REQUIRE(env.sbucket().find_add("name4999") <
+			env.sbucket().size());
+	}
+
+	// Several workers need a concurrent string bucket
+	environment_t env;
+	work_pool_t pool(2);
+	REQUIRE_THROWS_AS(tokenize_modules(env, files, pool), std::system_error);
+
+	fs::remove_all(root);
+}
@@ -5,10 +5,20 @@
 
 */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <random>
 #include <algorithm>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
 #include <catch2/catch.hpp>
 #include "environment.hh"
+#include "reserved.hh"
 
 TEST_CASE("sbucket") {
 	constexpr size_t m_max_size = 1024;
@@ -54,14 +64,8 @@ TEST_CASE("sbucket") {
 
 			// Calculate hash
 			if (variant == 0) {
-				hash_t hash = 0;
-				for (size_t c = 0; c < test_str.length(); c++) {
-					// Random character
-					const char ch = static_cast<char>(u(r));
-					if (variant == 0)
-						hash = hash_next(ch, hash);
-				}
-				m_hash[i] = hash_finish(hash);
+				m_hash[i] = hash_bytes(test_str.data(),
+						       test_str.length());
 			}
 		}
 	}
@@ -80,19 +84,18 @@ TEST_CASE("sbucket") {
 		}
 
 		for (size_t i = 0; i < m_nr_strings; i++) {
-			EXPECT_EQ(str_idx[i],
+			INFO("i = " << i);
+			REQUIRE(str_idx[i] ==
 					m_env.sbucket().find_add_hashed(
 						m_strings[0][i].c_str(),
 						m_strings[0][i].size(),
-						m_hash[i])) << "i = " << i;
+						m_hash[i]));
 		}
 
 		for (size_t i = 0; i < m_nr_strings; i++) {
-			EXPECT_STREQ(
-					m_env.sbucket()[str_idx[i]],
-					m_strings[0][i].c_str()) << "i = " << i
-				<< ", str_idx[i] = "
-				<< str_idx[i];
+			INFO("i = " << i << ", str_idx[i] = " << str_idx[i]);
+			REQUIRE(std::string(m_env.sbucket()[str_idx[i]]) ==
+					m_strings[0][i]);
 		}
 	}
 
@@ -108,20 +111,302 @@ TEST_CASE("sbucket") {
 		}
 
 		for (size_t i = 0; i < m_nr_strings; i++) {
-			EXPECT_EQ(str_idx[i],
+			INFO("i = " << i);
+			REQUIRE(str_idx[i] ==
 					m_env.sbucket().find_add(
-						m_strings[1][i].c_str()))
-				<< "i = " << i;
+						m_strings[1][i].c_str()));
 		}
 
 		for (size_t i = 0; i < m_nr_strings; i++) {
-			EXPECT_STREQ(
-					m_env.sbucket()[str_idx[i]],
-					m_strings[1][i].c_str())
-				<< "i = " << i << ", str_idx[i] = "
-				<< str_idx[i];
+			INFO("i = " << i << ", str_idx[i] = " << str_idx[i]);
+			REQUIRE(std::string(m_env.sbucket()[str_idx[i]]) ==
+					m_strings[1][i]);
 		}
 	}
 
 }
 
+// Add enough strings to make the hash table grow several times, and check
+// that string indexes are dense and survive the growth
+TEST_CASE("sbucket:grow") {
+	constexpr size_t nr_strings = 100000;
+	sbucket bucket;
+
+	// Added strings follow the reserved identifiers
+	const size_t first_idx = nr_reserved;
+	const size_t last_idx = first_idx + nr_strings;
+
+	REQUIRE(bucket.find_add("id0") == first_idx);
+	const char * const first = bucket[first_idx];
+
+	for (size_t i = 1; i < nr_strings; i++) {
+		const std::string str = "id" + std::to_string(i);
+		REQUIRE(bucket.find_add(str.c_str()) == first_idx + i);
+	}
+	REQUIRE(bucket.size() == last_idx);
+
+	// Strings do not move when more strings are added
+	REQUIRE(bucket[first_idx] == first);
+
+	for (size_t i = 0; i < nr_strings; i++) {
+		const std::string str = "id" + std::to_string(i);
+		REQUIRE(bucket.find_add(str.c_str()) == first_idx + i);
+		REQUIRE(std::string(bucket[first_idx + i]) == str);
+		REQUIRE(bucket.view(first_idx + i) == str);
+	}
+
+	// Strings longer than an arena chunk
+	const std::string long_str(200000, 'x');
+	REQUIRE(bucket.find_add(long_str.c_str()) == last_idx);
+	REQUIRE(bucket.view(last_idx) == long_str);
+	REQUIRE(bucket.find_add("") == last_idx + 1);
+	REQUIRE(bucket.view(last_idx + 1).empty());
+
+	// Strings with equal hash values must still be told apart
+	REQUIRE(bucket.find_add_hashed("abc", 3, 0) == last_idx + 2);
+	REQUIRE(bucket.find_add_hashed("abd", 3, 0) == last_idx + 3);
+	REQUIRE(bucket.find_add_hashed("ab", 2, 0) == last_idx + 4);
+	REQUIRE(bucket.find_add_hashed("abc", 3, 0) == last_idx + 2);
+
+	const sbucket::stats_t stats = bucket.stats();
+	REQUIRE(stats.nr_strings == last_idx + 5);
+	REQUIRE(stats.nr_slots * 7 >= stats.nr_strings * 8);
+	REQUIRE(stats.total_probes >= stats.nr_strings);
+}
+
+// Several threads add the same strings in different order. Each string
+// must get the same index in all threads, and indexes must be dense.
+TEST_CASE("sbucket:concurrent") {
+	constexpr size_t nr_threads = 8;
+	constexpr size_t nr_strings = 50000;
+	sbucket bucket(sbucket_mode_t::concurrent);
+
+	std::vector<std::string> strings;
+	for (size_t i = 0; i < nr_strings; i++)
+		strings.push_back("s" + std::to_string(i * 7919));
+
+	std::vector<std::vector<string_idx_t>> result(
+		nr_threads, std::vector<string_idx_t>(nr_strings));
+	std::vector<std::thread> threads;
+
+	for (size_t t = 0; t < nr_threads; t++) {
+		threads.emplace_back([&, t]() {
+			std::vector<size_t> order(nr_strings);
+			for (size_t i = 0; i < nr_strings; i++)
+				order[i] = i;
+			std::shuffle(order.begin(), order.end(),
+				     std::default_random_engine(t));
+			for (size_t i : order)
+				result[t][i] = bucket.find_add(strings[i].c_str());
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	REQUIRE(bucket.size() == nr_reserved + nr_strings);
+
+	std::vector<bool> seen(nr_reserved + nr_strings, false);
+	for (size_t i = 0; i < nr_strings; i++) {
+		const string_idx_t idx = result[0][i];
+		INFO("i = " << i);
+		REQUIRE(idx >= nr_reserved);
+		REQUIRE(idx < nr_reserved + nr_strings);
+		REQUIRE(!seen[idx]);
+		seen[idx] = true;
+		REQUIRE(bucket.view(idx) == strings[i]);
+		for (size_t t = 1; t < nr_threads; t++)
+			REQUIRE(result[t][i] == idx);
+	}
+
+	const sbucket::stats_t stats = bucket.stats();
+	REQUIRE(stats.nr_strings == nr_reserved + nr_strings);
+	REQUIRE(stats.total_probes >= nr_strings);
+}
+
+// Reserved identifiers have the same fixed index in every bucket
+TEST_CASE("sbucket:reserved") {
+	sbucket bucket;
+	sbucket concurrent_bucket(sbucket_mode_t::concurrent);
+
+	REQUIRE(bucket.size() == nr_reserved);
+
+	for (size_t idx = 0; idx < nr_reserved; idx++) {
+		const std::string spelling(reserved_spellings[idx]);
+		INFO("spelling = " << spelling);
+		REQUIRE(reserved_find(spelling.data(), spelling.size()) == idx);
+		REQUIRE(bucket.find_add(spelling.c_str()) == idx);
+		REQUIRE(concurrent_bucket.find_add(spelling.c_str()) == idx);
+		REQUIRE(bucket.view(idx) == spelling);
+	}
+
+	REQUIRE(bucket.find_add("(") == reserved_paren_open);
+	REQUIRE(bucket.find_add("foreach") == reserved_foreach);
+
+	// Near misses are not reserved
+	for (const char *str : {"", "u", "us", "uses", "Use", "esu", "(("
+		    , "operators", "foreac", "d", "is ", "<", "thin"}) {
+		INFO("str = " << str);
+		REQUIRE(reserved_find(str, strlen(str)) == reserved_not_found);
+	}
+	REQUIRE(bucket.size() == nr_reserved);
+	REQUIRE(bucket.find_add("uses") == nr_reserved);
+}
+
+// Save a bucket as an image, and construct new buckets from it
+TEST_CASE("sbucket:image") {
+	constexpr size_t nr_strings = 20000;
+	char filename[] = "/tmp/check_sbucket.XXXXXX";
+	const int fd = mkstemp(filename);
+	REQUIRE(fd >= 0);
+	close(fd);
+
+	std::vector<string_idx_t> saved_idx(nr_strings);
+	{
+		sbucket bucket;
+		for (size_t i = 0; i < nr_strings; i++) {
+			const std::string str = "img" + std::to_string(i);
+			saved_idx[i] = bucket.find_add(str.c_str());
+		}
+		REQUIRE(bucket.find_add("") == nr_reserved + nr_strings);
+		bucket.save(filename);
+	}
+
+	struct stat before;
+	REQUIRE(stat(filename, &before) == 0);
+
+	for (const auto mode : {sbucket_mode_t::single_thread,
+				sbucket_mode_t::concurrent}) {
+		sbucket bucket(filename, mode);
+		REQUIRE(bucket.image_size() == nr_reserved + nr_strings + 1);
+		REQUIRE(bucket.size() == bucket.image_size());
+
+		// Strings keep their indexes
+		for (size_t idx = 0; idx < nr_reserved; idx++)
+			REQUIRE(bucket.view(idx) == reserved_spellings[idx]);
+		for (size_t i = 0; i < nr_strings; i++) {
+			const std::string str = "img" + std::to_string(i);
+			INFO("str = " << str);
+			REQUIRE(bucket.find_add(str.c_str()) == saved_idx[i]);
+			REQUIRE(std::string(bucket[saved_idx[i]]) == str);
+		}
+		REQUIRE(bucket.find_add("") == nr_reserved + nr_strings);
+
+		// New strings follow the image strings
+		REQUIRE(bucket.find_add("new0") == bucket.image_size());
+		REQUIRE(bucket.find_add("new1") == bucket.image_size() + 1);
+		REQUIRE(bucket.find_add("new0") == bucket.image_size());
+		REQUIRE(bucket.view(bucket.image_size() + 1) == "new1");
+		REQUIRE(bucket.stats().nr_strings == bucket.image_size() + 2);
+	}
+
+	// Image file is not changed by adding strings
+	struct stat after;
+	REQUIRE(stat(filename, &after) == 0);
+	REQUIRE(after.st_size == before.st_size);
+	REQUIRE(after.st_mtime == before.st_mtime);
+
+	// An extended bucket can be saved again, including the strings of
+	// the image it was constructed from
+	{
+		sbucket bucket(filename);
+		REQUIRE(bucket.find_add("extended") == bucket.image_size());
+		bucket.save(filename);
+	}
+	{
+		sbucket bucket(filename);
+		REQUIRE(bucket.image_size() == nr_reserved + nr_strings + 2);
+		REQUIRE(bucket.find_add("img7") == saved_idx[7]);
+		REQUIRE(bucket.find_add("extended") == nr_reserved + nr_strings + 1);
+	}
+
+	// Damaged slots and entries are not trusted. Lookups of their
+	// strings fail, and damaged entries read as empty strings. Entries
+	// are 16 bytes with the string offset first and the length next,
+	// slots are 12 bytes with the string index last. Section offsets are
+	// at offsets 32, 40 and 48 of the header.
+	{
+		std::vector<char> image(static_cast<size_t>(after.st_size) + 100);
+		FILE * const in = fopen(filename, "rb");
+		REQUIRE(in != NULL);
+		image.resize(fread(image.data(), 1, image.size(), in));
+		fclose(in);
+
+		uint64_t nr_slots, entries_offset, slots_offset, strings_offset;
+		memcpy(&nr_slots, image.data() + 24, sizeof(nr_slots));
+		memcpy(&entries_offset, image.data() + 32, sizeof(entries_offset));
+		memcpy(&slots_offset, image.data() + 40, sizeof(slots_offset));
+		memcpy(&strings_offset, image.data() + 48, sizeof(strings_offset));
+
+		// Overwrite the null terminator of a string
+		uint64_t offset;
+		uint32_t length;
+		const char * const entry = image.data() + entries_offset +
+			16 * saved_idx[10];
+		memcpy(&offset, entry, sizeof(offset));
+		memcpy(&length, entry + 8, sizeof(length));
+		image[strings_offset + offset + length] = 'x';
+
+		const uint64_t bad_offset = UINT64_MAX - 1;
+		memcpy(image.data() + entries_offset + 16 * saved_idx[7],
+		       &bad_offset, sizeof(bad_offset));
+
+		bool patched = false;
+		for (uint64_t slot = 0; slot < nr_slots; slot++) {
+			char * const idx_ptr = image.data() + slots_offset +
+				12 * slot + 8;
+			uint32_t idx;
+			memcpy(&idx, idx_ptr, sizeof(idx));
+			if (idx == saved_idx[8]) {
+				const uint32_t bad_idx = UINT32_MAX - 1;
+				memcpy(idx_ptr, &bad_idx, sizeof(bad_idx));
+				patched = true;
+			}
+		}
+		REQUIRE(patched);
+
+		FILE * const out = fopen(filename, "wb");
+		REQUIRE(out != NULL);
+		fwrite(image.data(), 1, image.size(), out);
+		fclose(out);
+
+		sbucket bucket(filename);
+		REQUIRE(bucket.view(saved_idx[7]).empty());
+		REQUIRE(std::string(bucket[saved_idx[7]]).empty());
+		REQUIRE(std::string(bucket[saved_idx[10]]).empty());
+		REQUIRE(bucket.find_add("img7") == bucket.image_size());
+		REQUIRE(bucket.find_add("img8") == bucket.image_size() + 1);
+		REQUIRE(bucket.find_add("img10") == bucket.image_size() + 2);
+		REQUIRE(bucket.find_add("img9") == saved_idx[9]);
+	}
+
+	// Section sizes overflowing 64 bits are rejected. 2^62 slots of 12
+	// bytes each wrap around to a size of 0. The number of slots is at
+	// offset 24 of the header.
+	{
+		std::vector<char> image(static_cast<size_t>(after.st_size) + 100);
+		FILE * const in = fopen(filename, "rb");
+		REQUIRE(in != NULL);
+		image.resize(fread(image.data(), 1, image.size(), in));
+		fclose(in);
+
+		const uint64_t nr_slots = uint64_t(1) << 62;
+		memcpy(image.data() + 24, &nr_slots, sizeof(nr_slots));
+		FILE * const out = fopen(filename, "wb");
+		REQUIRE(out != NULL);
+		fwrite(image.data(), 1, image.size(), out);
+		fclose(out);
+		REQUIRE_THROWS_AS(sbucket(filename), std::system_error);
+	}
+
+	// Files that are not images are rejected
+	FILE * const file = fopen(filename, "wb");
+	REQUIRE(file != NULL);
+	fputs("Not an image, but long enough to hold an image header.......\n",
+	      file);
+	fclose(file);
+	REQUIRE_THROWS_AS(sbucket(filename), std::system_error);
+	REQUIRE_THROWS_AS(sbucket("/nonexistent/sbucket.image"),
+			  std::system_error);
+
+	unlink(filename);
+}
@@ -0,0 +1,178 @@
+/*
+  This file implements the unit test for the stream_file_t class.
+  
+  SPDX-License-Identifier: MIT
+
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <array>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "token.hh"
+#include "stream_file.hh"
+#include "memory_input.hh"
+
+static std::string read_file(const char *name)
+{
+	std::ifstream file(name);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+static std::vector<compact_token_t> all_tokens(tokenizer_t& lexer)
+{
+	std::vector<compact_token_t> result;
+	std::array<compact_token_t, 16> tokens;
+
+	for (size_t nr = lexer.next_batch(tokens);
+	     nr > 0;
+	     nr = lexer.next_batch(tokens))
+		result.insert(result.end(), tokens.begin(), tokens.begin() + nr);
+
+	return result;
+}
+
+// Compare tokens from a stream with tokens from the memory mapped file
+static void compare_tokens(tokenizer_t& expected_lexer, tokenizer_t& lexer)
+{
+	const std::vector<compact_token_t> expected = all_tokens(expected_lexer);
+	const std::vector<compact_token_t> tokens = all_tokens(lexer);
+
+	REQUIRE(tokens.size() == expected.size());
+	for (size_t idx = 0; idx < tokens.size(); idx++) {
+		INFO("idx = " << idx);
+		REQUIRE(tokens[idx].kind == expected[idx].kind);
+		REQUIRE(tokens[idx].offset == expected[idx].offset);
+		REQUIRE(lexer.position(tokens[idx]).line() ==
+			expected_lexer.position(expected[idx]).line());
+
+		switch (tokens[idx].kind) {
+		case token_kind_t::big_integer:
+			REQUIRE(lexer.integer(tokens[idx]) ==
+				expected_lexer.integer(expected[idx]));
+			break;
+		case token_kind_t::floating:
+			REQUIRE(lexer.floating(tokens[idx]).mantissa() ==
+				expected_lexer.floating(expected[idx]).mantissa());
+			REQUIRE(lexer.floating(tokens[idx]).nr_decimals() ==
+				expected_lexer.floating(expected[idx]).nr_decimals());
+			break;
+		default:
+			REQUIRE(tokens[idx].value == expected[idx].value);
+			break;
+		}
+	}
+}
+
+TEST_CASE("stream_file:file") {
+	environment_t env;
+
+	// Longest token in the file is less than 200 bytes
+	for (size_t capacity : {200, 256, 1000, 64 * 1024}) {
+		INFO("capacity = " << capacity);
+		tokenizer_t expected(env, "check_token.data");
+		tokenizer_t lexer(env, std::make_unique<stream_file_t>(
+					  env, "check_token.data", capacity));
+		compare_tokens(expected, lexer);
+	}
+}
+
+TEST_CASE("stream_file:pipe") {
+	environment_t env;
+	const std::string contents = read_file("check_token.data");
+
+	int fds[2];
+	REQUIRE(pipe(fds) == 0);
+
+	// Write in small pieces, so reads return partial buffers
+	std::thread writer([&]() {
+		for (size_t pos = 0; pos < contents.size(); pos += 7) {
+			const size_t len = std::min<size_t>(7, contents.size() - pos);
+			if (write(fds[1], contents.data() + pos, len) !=
+			    static_cast<ssize_t>(len))
+				break;
+		}
+		close(fds[1]);
+	});
+
+	tokenizer_t expected(env, "check_token.data");
+	tokenizer_t lexer(env, std::make_unique<stream_file_t>(
+				  env, fds[0], "<pipe>", 256));
+	compare_tokens(expected, lexer);
+
+	writer.join();
+	close(fds[0]);
+}
+
+TEST_CASE("stream_file:memory_input") {
+	environment_t env;
+
+	// Refills of a memory input copy chunks of the text, tokens
+	// spanning chunks, or longer than one, are kept contiguous
+	std::string text;
+	while (text.size() < 3 * memory_input_t::chunk_size)
+		text += read_file("check_token.data");
+	text += "a \"" + std::string(2 * memory_input_t::chunk_size, 's') + "\" 12345678901234567890\n";
+
+	char name[] = "/tmp/check_stream_file.XXXXXX";
+	const int fd = mkstemp(name);
+	REQUIRE(fd >= 0);
+	REQUIRE(write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size()));
+	close(fd);
+
+	tokenizer_t expected(env, name);
+	tokenizer_t lexer(env, std::make_unique<memory_input_t>(env, text, "text"));
+	compare_tokens(expected, lexer);
+
+	unlink(name);
+}
+
+TEST_CASE("stream_file:skip_until_hashed") {
+	environment_t env;
+	stream_file_t file(env, "check_mmap_file.data", 16);
+
+	REQUIRE(static_cast<size_t>(1) == file.skip('#'));
+	REQUIRE(static_cast<size_t>(1) == file.skip(' '));
+
+	file.marker_start();
+	hash_t hash;
+	REQUIRE(static_cast<size_t>(4) == file.skip_until_hashed(" \n", hash));
+	const std::string word(file.marker_end());
+	REQUIRE(word == "Some");
+	REQUIRE(hash_bytes(word.data(), word.size()) == hash);
+
+	// Hash is the same when the skipped characters span refills
+	const std::string contents = read_file("check_mmap_file.data");
+	const size_t from = file.offset();
+	const size_t nr = file.skip_until_hashed(char_class_t("\t"), hash);
+	REQUIRE(hash_bytes(contents.data() + from, nr) == hash);
+	REQUIRE(file.nr_refills() > 1);
+	REQUIRE(static_cast<size_t>(4) == file.get_position().line());
+	REQUIRE(static_cast<size_t>(5) == file.get_position().column());
+}
+
+TEST_CASE("stream_file:token_too_long") {
+	environment_t env;
+	const std::string contents = "short " + std::string(100, 'x') + "\n";
+
+	int fds[2];
+	REQUIRE(pipe(fds) == 0);
+	REQUIRE(write(fds[1], contents.data(), contents.size()) ==
+		static_cast<ssize_t>(contents.size()));
+	close(fds[1]);
+
+	tokenizer_t lexer(env, std::make_unique<stream_file_t>(
+				  env, fds[0], "<pipe>", 32));
+	std::array<compact_token_t, 4> tokens;
+	REQUIRE_THROWS_AS(lexer.next_batch(tokens), parser_error);
+
+	close(fds[0]);
+}
@@ -0,0 +1,266 @@
+/*
+  This file implements the unit test for the tokenizer_t class.
+  
+  SPDX-License-Identifier: MIT
+
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <array>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <catch2/catch.hpp>
+#include "memory_input.hh"
+#include "token.hh"
+#include "reserved.hh"
+#include "work_pool.hh"
+
+TEST_CASE("test_token:next_batch") {
+	environment_t env;
+	tokenizer_t legacy(env, "check_token.data");
+	tokenizer_t batched(env, "check_token.data");
+
+	// Use an odd sized buffer to get batches ending mid-line
+	std::array<compact_token_t, 7> tokens;
+	size_t nr_tokens = 0;
+
+	for (size_t nr = batched.next_batch(tokens);
+	     nr > 0;
+	     nr = batched.next_batch(tokens)) {
+		for (size_t idx = 0; idx < nr; idx++) {
+			const compact_token_t& token = tokens[idx];
+			std::unique_ptr<const token_t> expected(legacy.next());
+			REQUIRE(expected);
+			const position_t pos(batched.position(token));
+			REQUIRE(expected->position().line() == pos.line());
+			REQUIRE(expected->position().column() == pos.column());
+			REQUIRE(expected->position().str() == pos.str());
+
+			switch (token.kind) {
+			case token_kind_t::eol:
+				REQUIRE(typeid(*expected) == typeid(token_eol_t));
+				REQUIRE(dynamic_cast<const token_eol_t&>(*expected).indent_level() == token.value);
+				break;
+			case token_kind_t::string:
+				REQUIRE(typeid(*expected) == typeid(token_string_t));
+				REQUIRE(dynamic_cast<const token_string_t&>(*expected).string() == token.value);
+				break;
+			case token_kind_t::identifier:
+				REQUIRE(typeid(*expected) == typeid(token_identifier_t));
+				REQUIRE(dynamic_cast<const token_identifier_t&>(*expected).name() == token.value);
+				break;
+			case token_kind_t::integer:
+			case token_kind_t::big_integer:
+				REQUIRE(typeid(*expected) == typeid(token_integer_t));
+				REQUIRE(dynamic_cast<const token_integer_t&>(*expected).value() == batched.integer(token));
+				break;
+			case token_kind_t::floating:
+				REQUIRE(typeid(*expected) == typeid(token_float_t));
+				REQUIRE(dynamic_cast<const token_float_t&>(*expected).value() == batched.floating(token).to_mp_float());
+				break;
+			}
+			nr_tokens++;
+		}
+	}
+
+	REQUIRE(legacy.next() == NULL);
+	REQUIRE(nr_tokens == static_cast<size_t>(41));
+}
+
+TEST_CASE("test_token:reserved") {
+	environment_t env;
+	tokenizer_t lexer(env, "check_token.data");
+	std::array<compact_token_t, 64> tokens;
+	size_t nr_parens = 0;
+
+	// Single letter identifiers get their reserved index directly
+	for (size_t nr = lexer.next_batch(tokens); nr > 0;
+	     nr = lexer.next_batch(tokens)) {
+		for (size_t idx = 0; idx < nr; idx++) {
+			if (tokens[idx].kind != token_kind_t::identifier)
+				continue;
+			const std::string_view name = env.sbucket().view(tokens[idx].value);
+			if (name == "(") {
+				REQUIRE(tokens[idx].value == reserved_paren_open);
+				nr_parens++;
+			} else if (name == ")") {
+				REQUIRE(tokens[idx].value == reserved_paren_close);
+				nr_parens++;
+			} else {
+				REQUIRE(tokens[idx].value >= nr_reserved);
+			}
+		}
+	}
+
+	REQUIRE(nr_parens == 2);
+}
+
+// The last line does not need a trailing new-line
+TEST_CASE("test_token:no_trailing_newline") {
+	environment_t env;
+	std::array<compact_token_t, 8> tokens;
+
+	tokenizer_t words(env, std::make_unique<memory_input_t>(env, "foo bar", "words"));
+	REQUIRE(words.next_batch(tokens) == 2);
+	REQUIRE(env.sbucket().view(tokens[0].value) == "foo");
+	REQUIRE(env.sbucket().view(tokens[1].value) == "bar");
+	REQUIRE(words.next_batch(tokens) == 0);
+
+	tokenizer_t comment(env, std::make_unique<memory_input_t>(env, "foo\n# c", "comment"));
+	REQUIRE(comment.next_batch(tokens) == 1);
+	REQUIRE(env.sbucket().view(tokens[0].value) == "foo");
+	REQUIRE(comment.next_batch(tokens) == 0);
+
+	// An unterminated string is still an error
+	tokenizer_t string(env, std::make_unique<memory_input_t>(env, "foo \"bar", "string"));
+	REQUIRE_THROWS_AS(string.next_batch(tokens), parser_error);
+}
+
+TEST_CASE("test_token:integers") {
+	environment_t env;
+	tokenizer_t lexer(env, "check_token_numbers.data");
+
+	const mp_int big_max("18446744073709551615");
+	const struct {
+		token_kind_t kind;
+		mp_int value;
+	} expected[] = {
+		{ token_kind_t::integer, 0 },
+		{ token_kind_t::integer, 1 },
+		{ token_kind_t::integer, 42 },
+		{ token_kind_t::integer, mp_int("34891093321") },
+		{ token_kind_t::integer, 0x436 },
+		{ token_kind_t::integer, 043447136771 },
+		{ token_kind_t::integer, mp_int("0xa0ffa00ffebcdc") },
+		{ token_kind_t::integer, 12345678 },
+		{ token_kind_t::integer, mp_int("1234567890123456789") },
+		{ token_kind_t::integer, big_max },
+		{ token_kind_t::big_integer, big_max + 1 },
+		{ token_kind_t::big_integer, mp_int("123456789012345678901234567890") },
+	};
+
+	std::array<compact_token_t, 32> tokens;
+	const size_t nr = lexer.next_batch(tokens);
+	size_t idx = 0;
+
+	for (size_t token = 0; token < nr; token++) {
+		if (tokens[token].kind == token_kind_t::eol)
+			continue;
+		REQUIRE(idx < std::size(expected));
+		REQUIRE(tokens[token].kind == expected[idx].kind);
+		REQUIRE(lexer.integer(tokens[token]) == expected[idx].value);
+		idx++;
+	}
+
+	REQUIRE(idx == std::size(expected));
+}
+
+// Scan a file with next_all(), and check that tokens, literals and
+// string indexes are the same as when scanning with next_batch()
+static void check_next_all(const char *name, work_pool_t& pool,
+			   size_t min_chunk_size)
+{
+	environment_t seq_env;
+	tokenizer_t seq_lexer(seq_env, name);
+	std::vector<compact_token_t> expected;
+	std::array<compact_token_t, 64> batch;
+	for (size_t nr = seq_lexer.next_batch(batch); nr > 0;
+	     nr = seq_lexer.next_batch(batch))
+		expected.insert(expected.end(), batch.begin(), batch.begin() + nr);
+
+	environment_t par_env;
+	tokenizer_t par_lexer(par_env, name);
+	std::vector<compact_token_t> tokens;
+	REQUIRE(par_lexer.next_all(tokens, pool, min_chunk_size) == expected.size());
+	REQUIRE(tokens.size() == expected.size());
+	REQUIRE(par_lexer.next_batch(batch) == 0);
+
+	for (size_t idx = 0; idx < tokens.size(); idx++) {
+		REQUIRE(tokens[idx].offset == expected[idx].offset);
+		REQUIRE(tokens[idx].kind == expected[idx].kind);
+		REQUIRE(tokens[idx].value == expected[idx].value);
+		if (tokens[idx].kind == token_kind_t::big_integer)
+			REQUIRE(par_lexer.integer(tokens[idx]) == seq_lexer.integer(expected[idx]));
+		if (tokens[idx].kind == token_kind_t::floating)
+			REQUIRE(par_lexer.floating(tokens[idx]).to_mp_float() ==
+				seq_lexer.floating(expected[idx]).to_mp_float());
+	}
+
+	REQUIRE(par_env.sbucket().size() == seq_env.sbucket().size());
+	for (string_idx_t idx = 0; idx < seq_env.sbucket().size(); idx++)
+		REQUIRE(par_env.sbucket().view(idx) == seq_env.sbucket().view(idx));
+}
+
+TEST_CASE("test_token:next_all") {
+	work_pool_t pool(4);
+
+	// Lines of different kinds, so that cuts end up next to empty
+	// lines, comment lines, indentation and line break sequences
+	std::string text;
+	for (size_t idx = 0; idx < 2000; idx++) {
+		text += std::string(idx % 4, '\t') + "name" + std::to_string(idx % 300)
+			+ " is " + std::to_string(idx * 7919) + " \"str" + std::to_string(idx % 50)
+			+ "\" 1.5 123456789012345678901234567890";
+		switch (idx % 7) {
+		case 0: text += "\n\n"; break;
+		case 1: text += " # comment\n"; break;
+		case 2: text += "\r\n"; break;
+		case 3: text += "\n\t\t\n  \n"; break;
+		case 4: text += "\n# comment line\n"; break;
+		case 5: text += "\n\r\n\r\n"; break;
+		default: text += "\n"; break;
+		}
+	}
+
+	char name[] = "/tmp/check_token_next_all.XXXXXX";
+	const int fd = mkstemp(name);
+	REQUIRE(fd >= 0);
+	REQUIRE(write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size()));
+	close(fd);
+
+	for (size_t min_chunk_size : { 1, 13, 100, 4096, 1 << 20 })
+		check_next_all(name, pool, min_chunk_size);
+	check_next_all("check_token.data", pool, 1);
+
+	// A memory input larger than its refill chunk is loaded whole, and
+	// gives the same tokens as the file
+	{
+		environment_t file_env;
+		tokenizer_t file_lexer(file_env, name);
+		std::vector<compact_token_t> expected;
+		file_lexer.next_all(expected, pool, 4096);
+
+		environment_t env;
+		REQUIRE(text.size() > memory_input_t::chunk_size);
+		tokenizer_t lexer(env, std::make_unique<memory_input_t>(env, text, "text"));
+		std::vector<compact_token_t> tokens;
+		REQUIRE(lexer.next_all(tokens, pool, 4096) == expected.size());
+		for (size_t idx = 0; idx < tokens.size(); idx++) {
+			REQUIRE(tokens[idx].offset == expected[idx].offset);
+			REQUIRE(tokens[idx].kind == expected[idx].kind);
+			REQUIRE(tokens[idx].value == expected[idx].value);
+		}
+	}
+
+	// A string spanning a cut makes the chunks invalid, so the file is
+	// scanned sequentially
+	std::string multi_line = "a \"first\nsecond\" b\n";
+	for (size_t idx = 0; idx < 100; idx++)
+		multi_line += "x is \"line\n" + std::to_string(idx) + "\"\n";
+	std::ofstream(name) << multi_line;
+	check_next_all(name, pool, 1);
+
+	// Errors are reported as for sequential scanning
+	std::ofstream(name) << text << "1x\n" << text;
+	{
+		environment_t env;
+		tokenizer_t lexer(env, name);
+		std::vector<compact_token_t> tokens;
+		REQUIRE_THROWS_AS(lexer.next_all(tokens, pool, 100), parser_error);
+	}
+
+	unlink(name);
+}
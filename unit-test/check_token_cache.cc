@@ -0,0 +1,128 @@
+/*
+  This file implements the unit test for the token_cache_t class.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "token.hh"
+#include "token_cache.hh"
+#include "work_pool.hh"
+
+namespace fs = std::filesystem;
+
+// Scan all tokens, with string values replaced by the strings, so that
+// token streams from different environments can be compared
+struct scanned_t {
+	std::vector<compact_token_t> tokens;
+	std::vector<std::string> values;
+};
+
+static scanned_t scan(environment_t& env, tokenizer_t& lexer)
+{
+	scanned_t scanned;
+	std::array<compact_token_t, 16> batch;
+
+	for (size_t nr = lexer.next_batch(batch); nr > 0; nr = lexer.next_batch(batch))
+		for (size_t idx = 0; idx < nr; idx++) {
+			const compact_token_t& token = batch[idx];
+			scanned.tokens.push_back(token);
+			switch (token.kind) {
+			case token_kind_t::string:
+			case token_kind_t::identifier:
+				scanned.values.emplace_back(env.sbucket().view(token.value));
+				break;
+			case token_kind_t::integer:
+			case token_kind_t::big_integer:
+				scanned.values.push_back(lexer.integer(token).str());
+				break;
+			case token_kind_t::floating:
+				scanned.values.push_back(lexer.floating(token).to_mp_float().str());
+				break;
+			default:
+				scanned.values.push_back(std::to_string(token.value));
+				break;
+			}
+		}
+
+	return scanned;
+}
+
+TEST_CASE("token_cache:replay") {
+	char dir_template[] = "/tmp/check_token_cache.XXXXXX";
+	REQUIRE(mkdtemp(dir_template) != NULL);
+	const fs::path root(dir_template);
+	const std::string source = (root / "module.sis").string();
+	std::ofstream(source) << "use b\n\tx is \"text\" 12 0x1f 1.5\n"
+		"\ty is 123456789012345678901234567890 # comment\n"
+		"\tz is 3.14159265358979323846264338327950288 x\n";
+
+	environment_t expected_env;
+	tokenizer_t expected_lexer(expected_env, source.c_str());
+	const scanned_t expected = scan(expected_env, expected_lexer);
+
+	token_cache_t cache((root / "cache").c_str());
+
+	// First use scans the file and saves the tokens
+	{
+		environment_t env;
+		tokenizer_t lexer(env, source.c_str(), cache);
+		const scanned_t scanned = scan(env, lexer);
+		REQUIRE(scanned.values == expected.values);
+		REQUIRE(cache.stats().nr_misses == 1);
+		REQUIRE(cache.stats().nr_stores == 1);
+	}
+
+	// Then the tokens are replayed, with the same string indexes as
+	// when scanning, also in an environment with other strings
+	{
+		environment_t env;
+		tokenizer_t lexer(env, source.c_str(), cache);
+		const scanned_t scanned = scan(env, lexer);
+		REQUIRE(cache.stats().nr_hits == 1);
+		REQUIRE(cache.stats().nr_stores == 1);
+		REQUIRE(scanned.values == expected.values);
+		REQUIRE(scanned.tokens.size() == expected.tokens.size());
+		for (size_t idx = 0; idx < scanned.tokens.size(); idx++) {
+			REQUIRE(scanned.tokens[idx].offset == expected.tokens[idx].offset);
+			REQUIRE(scanned.tokens[idx].kind == expected.tokens[idx].kind);
+			REQUIRE(scanned.tokens[idx].value == expected.tokens[idx].value);
+		}
+	}
+	{
+		environment_t env;
+		env.sbucket().find_add("other");
+		tokenizer_t lexer(env, source.c_str(), cache);
+		work_pool_t pool(2);
+		std::vector<compact_token_t> tokens;
+		REQUIRE(lexer.next_all(tokens, pool) == expected.tokens.size());
+		REQUIRE(env.sbucket().view(tokens[1].value) == "b");
+		REQUIRE(cache.stats().nr_hits == 2);
+	}
+
+	// Changed contents miss the cache
+	std::ofstream(source, std::ios::app) << "w is 1\n";
+	{
+		environment_t env;
+		tokenizer_t lexer(env, source.c_str(), cache);
+		scan(env, lexer);
+		REQUIRE(cache.stats().nr_misses == 2);
+		REQUIRE(cache.stats().nr_stores == 2);
+	}
+
+	// Damaged entries are not used, and are replaced
+	const std::string contents = "a b\n";
+	const std::string entry = cache.path(contents);
+	std::ofstream(entry) << "SISDELTC garbage";
+	REQUIRE(cache.find(contents) == nullptr);
+
+	fs::remove_all(root);
+}
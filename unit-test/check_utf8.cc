@@ -0,0 +1,282 @@
+/*
+  This file implements the unit test for UTF-8 validation.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <array>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "char_class.hh"
+#include "memory_input.hh"
+#include "stream_file.hh"
+#include "token.hh"
+#include "utf8.hh"
+
+// Reference implementation, decoding one sequence at a time. An invalid
+// sequence ends at the first byte that cannot continue it.
+static std::vector<size_t> reference_invalid(const std::string& text)
+{
+	std::vector<size_t> invalid;
+	size_t pos = 0;
+
+	while (pos < text.size()) {
+		const uint8_t lead = static_cast<uint8_t>(text[pos]);
+		size_t length = 0;
+		uint8_t low = 0x80, high = 0xbf;
+
+		if (lead < 0x80)
+			length = 1;
+		else if ((lead >= 0xc2) && (lead <= 0xdf))
+			length = 2;
+		else if ((lead >= 0xe0) && (lead <= 0xef))
+			length = 3;
+		else if ((lead >= 0xf0) && (lead <= 0xf4))
+			length = 4;
+
+		if (lead == 0xe0)
+			low = 0xa0;
+		else if (lead == 0xed)
+			high = 0x9f;
+		else if (lead == 0xf0)
+			low = 0x90;
+		else if (lead == 0xf4)
+			high = 0x8f;
+
+		if (length == 0) {
+			invalid.push_back(pos);
+			pos++;
+			continue;
+		}
+
+		size_t next = pos + 1;
+		for (; next < pos + length; next++) {
+			if (next == text.size())
+				break;
+			const uint8_t byte = static_cast<uint8_t>(text[next]);
+			if ((byte < low) || (byte > high))
+				break;
+			low = 0x80;
+			high = 0xbf;
+		}
+		if (next < pos + length)
+			invalid.push_back(pos);
+		pos = next;
+	}
+
+	return invalid;
+}
+
+// Validate text given in parts split at the given offsets
+static std::vector<size_t> validate(const std::string& text,
+				    const std::vector<size_t>& splits)
+{
+	utf8_validator_t validator;
+	std::vector<size_t> invalid;
+	size_t from = 0;
+
+	for (const size_t split : splits) {
+		validator.validate(text.data() + from, text.data() + split, from,
+				   invalid);
+		from = split;
+	}
+	validator.validate(text.data() + from, text.data() + text.size(), from,
+			   invalid);
+	validator.finish(invalid);
+
+	return invalid;
+}
+
+static const simd_level_t levels[] = {
+	simd_level_t::scalar, simd_level_t::sse2, simd_level_t::avx2
+};
+
+TEST_CASE("utf8:validate") {
+	const std::string valid[] = {
+		"", "abc", "\xc2\x80", "\xdf\xbf", "\xe0\xa0\x80", "\xed\x9f\xbf",
+		"\xee\x80\x80", "\xf0\x90\x80\x80", "\xf4\x8f\xbf\xbf",
+		"r\xc3\xa4ksm\xc3\xb6rg\xc3\xa5s \xe2\x82\xac \xf0\x9f\x98\x80",
+	};
+	const std::string invalid[] = {
+		"\x80", "\xbf", "\xc0\x80", "\xc1\xbf", "\xc2", "\xc2\x41",
+		"\xe0\x9f\xbf", "\xed\xa0\x80", "\xe1\x80", "\xf0\x8f\xbf\xbf",
+		"\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xff",
+	};
+	const simd_level_t original = char_class_t::simd_level();
+
+	for (simd_level_t level : levels) {
+		char_class_t::set_simd_level(level);
+		for (const std::string& text : valid) {
+			// Long enough for the vector implementations
+			const std::string padded = std::string(40, 'a') + text + std::string(40, 'b');
+			REQUIRE(validate(text, {}).empty());
+			REQUIRE(validate(padded, {}).empty());
+		}
+		for (const std::string& text : invalid) {
+			const std::string padded = std::string(40, 'a') + text + std::string(40, 'b');
+			// Bytes following an invalid lead byte may be invalid
+			// too
+			const std::vector<size_t> found = validate(text, {});
+			REQUIRE(!found.empty());
+			REQUIRE(found.front() == 0);
+			REQUIRE(found == reference_invalid(text));
+			REQUIRE(validate(padded, {}).front() == 40);
+		}
+	}
+
+	char_class_t::set_simd_level(original);
+}
+
+TEST_CASE("utf8:random") {
+	// Mostly valid text, with some bytes that may break sequences
+	const std::string pieces[] = {
+		"a", "abcdefgh", " ", "\xc3\xa4", "\xe2\x82\xac", "\xf0\x9f\x98\x80",
+		"\x80", "\xbf", "\xc0", "\xc3", "\xe0", "\xed", "\xf0", "\xf4", "\xf5",
+		"\xa0", "\x90",
+	};
+	std::default_random_engine r;
+	std::uniform_int_distribution<size_t> piece_dist(0, 5);
+	std::uniform_int_distribution<size_t> all_dist(0, std::size(pieces) - 1);
+	const simd_level_t original = char_class_t::simd_level();
+
+	for (int round = 0; round < 1000; round++) {
+		std::string text;
+		const size_t nr_pieces = r() % 100;
+		for (size_t idx = 0; idx < nr_pieces; idx++)
+			text += pieces[(r() % 8 == 0) ? all_dist(r) : piece_dist(r)];
+
+		std::vector<size_t> splits;
+		for (size_t split = 0; split < text.size(); split += 1 + r() % 50)
+			splits.push_back(split);
+
+		const std::vector<size_t> expected = reference_invalid(text);
+		for (simd_level_t level : levels) {
+			char_class_t::set_simd_level(level);
+			INFO("round " << round << " level " << static_cast<int>(level));
+			REQUIRE(validate(text, {}) == expected);
+			REQUIRE(validate(text, splits) == expected);
+		}
+	}
+
+	char_class_t::set_simd_level(original);
+}
+
+TEST_CASE("utf8:length") {
+	REQUIRE(utf8_length(nullptr, nullptr) == 0);
+
+	const std::string text = "r\xc3\xa4ksm\xc3\xb6rg\xc3\xa5s \xe2\x82\xac \xf0\x9f\x98\x80";
+	REQUIRE(utf8_length(text.data(), text.data() + text.size()) == 14);
+	REQUIRE(utf8_length(text.data(), text.data() + 3) == 2);
+}
+
+// Scan all tokens of text, recording errors
+static std::vector<compact_token_t> scan(tokenizer_t& lexer,
+					 diagnostics_t& diagnostics)
+{
+	lexer.set_diagnostics(&diagnostics);
+
+	std::vector<compact_token_t> tokens;
+	std::array<compact_token_t, 4> batch;
+	for (size_t nr = lexer.next_batch(batch); nr > 0; nr = lexer.next_batch(batch))
+		tokens.insert(tokens.end(), batch.begin(), batch.begin() + nr);
+
+	return tokens;
+}
+
+TEST_CASE("utf8:tokenizer") {
+	const std::string text =
+		"\xc3\xa4pple \xe2\x82\xac 1\n"
+		"b\xff c \"s\xc3\"\n"
+		"# \xe0 comment\n"
+		"-x d\x01 \x02 e\n"
+		"f \"\xf0\x9f";
+	environment_t env;
+	tokenizer_t lexer(env, std::make_unique<memory_input_t>(env, text, "text"));
+	diagnostics_t diagnostics;
+
+	const std::vector<compact_token_t> tokens = scan(lexer, diagnostics);
+
+	const std::array<error_code_t, 8> codes = {
+		error_code_t::invalid_utf8,
+		error_code_t::invalid_utf8,
+		error_code_t::invalid_utf8,
+		error_code_t::invalid_identifier,
+		error_code_t::invalid_identifier,
+		error_code_t::invalid_identifier,
+		error_code_t::unterminated_string,
+		error_code_t::invalid_utf8
+	};
+	const std::array<size_t, 8> starts = { 13, 18, 25, 35, 38, 41, 47, 48 };
+	const std::array<size_t, 8> ats = { 14, 20, 25, 37, 39, 41, 47, 48 };
+	REQUIRE(diagnostics.size() == codes.size());
+	for (size_t idx = 0; idx < codes.size(); idx++) {
+		INFO("idx = " << idx);
+		REQUIRE(diagnostics[idx].code == codes[idx]);
+		REQUIRE(diagnostics[idx].start == starts[idx]);
+		REQUIRE(diagnostics[idx].at == ats[idx]);
+	}
+
+	// Identifiers may start with any character but digits and '-'
+	std::string identifiers;
+	for (const compact_token_t& token : tokens)
+		if (token.kind == token_kind_t::identifier)
+			identifiers += std::string(env.sbucket().view(token.value)) + ' ';
+	REQUIRE(identifiers == "\xc3\xa4pple \xe2\x82\xac c e f ");
+
+	// Columns count code points
+	const position_t one = lexer.position(tokens[2]);
+	REQUIRE(one.line() == 1);
+	REQUIRE(one.column() == 9);
+	REQUIRE(lexer.position(tokens[1]).column() == 7);
+
+	// Without recording, the first error is thrown
+	tokenizer_t throwing(env, std::make_unique<memory_input_t>(env, text, "text"));
+	std::array<compact_token_t, 16> batch;
+	REQUIRE_THROWS_AS(throwing.next_batch(batch), parser_error);
+}
+
+TEST_CASE("utf8:refill") {
+	// Sequences split between refills, and invalid sequences past the
+	// first window
+	std::string text;
+	for (size_t idx = 0; idx < 3000; idx++)
+		text += "\xc3\xa4\xe2\x82\xac\xf0\x9f\x98\x80 " + std::to_string(idx) + "\n";
+	const size_t first = text.size();
+	text += "x\xc3\n";
+	const size_t second = text.size();
+	text += "\"y\xe2\x82";
+
+	char name[] = "/tmp/check_utf8.XXXXXX";
+	const int fd = mkstemp(name);
+	REQUIRE(fd >= 0);
+	close(fd);
+	std::ofstream(name) << text;
+
+	environment_t env;
+	std::vector<std::unique_ptr<input_t>> inputs;
+	inputs.push_back(std::make_unique<memory_input_t>(env, text, "text"));
+	inputs.push_back(std::make_unique<stream_file_t>(env, name, 100));
+
+	for (std::unique_ptr<input_t>& input : inputs) {
+		tokenizer_t lexer(env, std::move(input));
+		diagnostics_t diagnostics;
+		const std::vector<compact_token_t> tokens = scan(lexer, diagnostics);
+
+		REQUIRE(diagnostics.size() == 3);
+		REQUIRE(diagnostics[0].at == first + 1);
+		REQUIRE(diagnostics[1].code == error_code_t::unterminated_string);
+		REQUIRE(diagnostics[2].at == second + 2);
+		// Two tokens per line, and end of line tokens before all but
+		// the first line
+		REQUIRE(tokens.size() == 3000 * 3 + 1);
+	}
+
+	unlink(name);
+}
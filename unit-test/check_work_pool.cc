@@ -0,0 +1,87 @@
+/*
+  This file implements the test for the work_pool_t class.
+
+  SPDX-License-Identifier: MIT
+
+*/
+
+#include <atomic>
+#include <latch>
+#include <stdexcept>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "work_pool.hh"
+
+TEST_CASE("work_pool:run") {
+	constexpr size_t nr_tasks = 10000;
+
+	for (size_t nr_workers : {1, 2, 4, 8}) {
+		INFO("nr_workers = " << nr_workers);
+		work_pool_t pool(nr_workers);
+		REQUIRE(pool.nr_workers() == nr_workers);
+
+		// Run several times, each task exactly once per run
+		for (size_t run = 0; run < 3; run++) {
+			std::vector<std::atomic<size_t>> count(nr_tasks);
+			std::atomic<bool> bad_worker(false);
+			pool.run(nr_tasks, [&](size_t task, size_t worker) {
+				count[task].fetch_add(1);
+				if (worker >= nr_workers)
+					bad_worker = true;
+			});
+			for (size_t task = 0; task < nr_tasks; task++)
+				REQUIRE(count[task].load() == 1);
+			REQUIRE(!bad_worker);
+		}
+	}
+}
+
+// Tasks of a busy worker are stolen by the others
+TEST_CASE("work_pool:steal") {
+	constexpr size_t nr_workers = 4;
+	constexpr size_t nr_tasks = 64;
+	work_pool_t pool(nr_workers);
+	std::vector<size_t> order;
+	for (size_t task = 0; task < nr_tasks; task++)
+		order.push_back(task);
+
+	// Worker 0 is dealt every fourth task. It is held in its first task
+	// until another worker has run one of its tasks, which can only
+	// happen by stealing.
+	std::vector<std::atomic<size_t>> count(nr_tasks);
+	std::latch stolen(1);
+	std::atomic<bool> any_stolen(false);
+	pool.run(order, [&](size_t task, size_t worker) {
+		count[task].fetch_add(1);
+		if ((task % nr_workers == 0) && (worker != 0)) {
+			if (!any_stolen.exchange(true))
+				stolen.count_down();
+		}
+		if (worker == 0)
+			stolen.wait();
+	});
+
+	// Stealing does not lose tasks, nor run them twice
+	for (size_t task = 0; task < nr_tasks; task++)
+		REQUIRE(count[task].load() == 1);
+	REQUIRE(pool.nr_steals() > 0);
+}
+
+TEST_CASE("work_pool:exception") {
+	work_pool_t pool(3);
+	std::atomic<size_t> nr_run(0);
+
+	REQUIRE_THROWS_AS(pool.run(100, [&](size_t task, size_t) {
+		nr_run++;
+		if (task == 17)
+			throw std::runtime_error("task failed");
+	}), std::runtime_error);
+
+	// Other tasks still run
+	REQUIRE(nr_run.load() == 100);
+
+	// Pool is usable after an exception
+	nr_run = 0;
+	pool.run(10, [&](size_t, size_t) { nr_run++; });
+	REQUIRE(nr_run.load() == 10);
+}